@@ -0,0 +1,373 @@
+#!/usr/bin/env python
+
+"""
+Run random traffic experiments with multiple episodes in parallel.
+
+Each episode runs in isolation, with its own carla server (port), ROS master
+(port), and ROS home directory, where the logs, bags, and the episode result
+are written. The end of an episode is detected by the exit of its processes:
+the simulator node shuts down the launch once the simulation time reaches
+max_simulation_time, and writes the episode result before that. Crashes of the
+simulator, the planners, or the carla server also end the episode, which is
+recorded in the experiment results.
+
+Example:
+    ./random_traffic_experiment.py --method ego_slc_lattice_planner --jobs 3 \\
+        --max-experiment-time 3600 --output-dir ~/experiments/slc
+"""
+
+from __future__ import division
+from __future__ import print_function
+
+import os
+import os.path
+import sys
+import json
+import time
+import errno
+import signal
+import socket
+import argparse
+import threading
+import subprocess
+
+# The results database module lives in the scripts directory.
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'scripts'))
+import results_database
+
+
+def wait_for_port(port, process, timeout):
+    """ Wait until the port on localhost accepts connections.
+
+    Returns False if the timeout is reached or the process exits before that.
+    """
+    deadline = time.time() + timeout
+    delay = 0.1
+    while time.time() < deadline:
+        if process.poll() is not None: return False
+        try:
+            sock = socket.create_connection(('localhost', port), timeout=1.0)
+            sock.close()
+            return True
+        except socket.error:
+            time.sleep(delay)
+            delay = min(delay*2.0, 2.0)
+    return False
+
+
+def terminate(process, sig=signal.SIGINT, grace=10.0):
+    """ Terminate the process group of the process, escalating the signal
+        if the processes do not exit within the grace period.
+    """
+    if process is None or process.poll() is not None: return
+    for s in [sig, signal.SIGTERM, signal.SIGKILL]:
+        try:
+            os.killpg(process.pid, s)
+        except OSError as e:
+            if e.errno == errno.ESRCH: return
+            raise
+        deadline = time.time() + grace
+        while time.time() < deadline:
+            if process.poll() is not None: return
+            time.sleep(0.1)
+
+
+class Episode(object):
+    """ A single episode with its own carla server and ROS master. """
+
+    def __init__(self, index, slot, args):
+        self.index = index
+        self.slot = slot
+        self.args = args
+
+        # Carla uses the given port and the next one for streaming.
+        self.carla_port = args.carla_port + 4*slot
+        self.master_port = args.master_port + slot
+
+        # Each episode has its own seed, so that any episode can be reproduced.
+        self.seed = args.seed + index
+
+        self.directory = os.path.join(
+                args.output_dir, 'episode_{:04d}'.format(index))
+        self.result_file = os.path.join(self.directory, 'result.json')
+
+        self.carla = None
+        self.roslaunch = None
+        self.stopped = threading.Event()
+        self.ended = threading.Event()
+
+    def log(self, msg):
+        print('[episode {} slot {}] {}'.format(self.index, self.slot, msg))
+        sys.stdout.flush()
+
+    def popen(self, cmd, log_name, env=None, cwd=None):
+        with open(os.path.join(self.directory, log_name), 'a') as log:
+            # Start a new session so that the whole process group can be killed.
+            return subprocess.Popen(cmd, stdout=log, stderr=subprocess.STDOUT,
+                                    env=env, cwd=cwd, preexec_fn=os.setsid)
+
+    def watch(self, process):
+        """ Set the ended event once the process exits. """
+        def wait():
+            process.wait()
+            self.ended.set()
+        thread = threading.Thread(target=wait)
+        thread.daemon = True
+        thread.start()
+
+    def start_carla(self):
+        env = dict(os.environ)
+        # Start the carla server without display.
+        env['DISPLAY'] = ''
+        self.carla = self.popen(
+                ['./CarlaUE4.sh', '-opengl', '-quality-level=Low',
+                 '-carla-port={}'.format(self.carla_port)],
+                'carla.log', env=env, cwd=self.args.carla_dist)
+
+        if not wait_for_port(self.carla_port, self.carla, self.args.startup_timeout):
+            return False
+
+        # Configure the world, each call returns once the setting is applied.
+        config = ['python', 'config.py', '--host', 'localhost',
+                  '--port', str(self.carla_port)]
+        config_dir = os.path.join(self.args.carla_dist, 'PythonAPI', 'util')
+        for setting in [['--map', 'Town04'],
+                        ['--no-rendering'],
+                        ['--delta-seconds', str(self.args.fixed_delta_seconds)]]:
+            config_process = self.popen(config+setting, 'carla_config.log', cwd=config_dir)
+            if config_process.wait() != 0: return False
+        return True
+
+    def start_roslaunch(self):
+        env = dict(os.environ)
+        env['ROS_MASTER_URI'] = 'http://localhost:{}'.format(self.master_port)
+        env['ROS_HOME'] = self.directory
+        env['ROS_LOG_DIR'] = os.path.join(self.directory, 'log')
+
+        # roslaunch starts a new master on the given port.
+        cmd = ['roslaunch', '-p', str(self.master_port),
+               'conformal_lattice_planner', 'autonomous_driving.launch',
+               'random_traffic:=true',
+               '{}:=true'.format(self.args.method),
+               'agents_lane_follower:=true',
+               'record_bags:={}'.format('false' if self.args.no_bags else 'true'),
+               'port:={}'.format(self.carla_port),
+               'fixed_delta_seconds:={}'.format(self.args.fixed_delta_seconds),
+               'max_simulation_time:={}'.format(self.args.max_episode_time),
+               'result_file:={}'.format(self.result_file),
+               'seed:={}'.format(self.seed)] + self.args.launch_arg
+        self.roslaunch = self.popen(cmd, 'roslaunch.log', env=env, cwd=self.directory)
+
+    def stop(self):
+        """ Stop the episode from another thread, e.g. on Ctrl+C. """
+        self.stopped.set()
+        self.ended.set()
+
+    def run(self):
+        os.makedirs(self.directory)
+        start_time = time.time()
+        status = None
+
+        try:
+            self.log('start carla server on port {}.'.format(self.carla_port))
+            if not self.start_carla():
+                status = 'carla_failed'
+            else:
+                self.log('start ROS master on port {}.'.format(self.master_port))
+                self.start_roslaunch()
+                self.watch(self.carla)
+                self.watch(self.roslaunch)
+                # Wait until any of the processes exits.
+                if not self.ended.wait(self.args.episode_timeout):
+                    status = 'timeout'
+                elif self.stopped.is_set():
+                    status = 'stopped'
+                elif self.carla.poll() is not None and self.roslaunch.poll() is None:
+                    status = 'carla_crashed'
+        finally:
+            # Stop the ROS nodes first, so that the bags are closed properly.
+            terminate(self.roslaunch, signal.SIGINT)
+            terminate(self.carla, signal.SIGTERM)
+
+        result = {}
+        if os.path.isfile(self.result_file):
+            with open(self.result_file) as f:
+                result = json.loads(f.read())
+        if status is None:
+            # The simulator may not write a result, e.g. another node crashes first.
+            status = result.get('status', 'failed')
+
+        result.update({
+            'episode': self.index,
+            'method': self.args.method,
+            'seed': self.seed,
+            'status': status,
+            'directory': self.directory,
+            'carla_port': self.carla_port,
+            'master_port': self.master_port,
+            'episode_wall_time': time.time() - start_time,
+            'roslaunch_returncode': None if self.roslaunch is None else self.roslaunch.returncode,
+            'carla_returncode': None if self.carla is None else self.carla.returncode,
+        })
+        self.log('{} simulation time:{} wall time:{:.1f}'.format(
+            status, result.get('simulation_time', 0.0), result['episode_wall_time']))
+        return result
+
+
+class Experiment(object):
+    """ Schedule the episodes on a number of parallel slots. """
+
+    def __init__(self, args):
+        self.args = args
+        self.lock = threading.Lock()
+        self.next_episode = 0
+        self.experiment_time = 0.0
+        self.failures = 0
+        self.running = {}
+        self.stopped = False
+        self.results_file = os.path.join(args.output_dir, 'results.jsonl')
+        self.experiment = args.experiment or os.path.basename(
+                os.path.normpath(args.output_dir))
+
+        # The parameter set shared by all episodes of the experiment.
+        self.params = {
+            'method': args.method,
+            'max_episode_time': args.max_episode_time,
+            'fixed_delta_seconds': args.fixed_delta_seconds,
+            'jobs': args.jobs,
+            'record_bags': not args.no_bags,
+        }
+        for launch_arg in args.launch_arg:
+            key, value = launch_arg.split(':=', 1)
+            self.params[key] = value
+
+    def schedule(self):
+        """ Get the index of the next episode, None if no more episodes. """
+        with self.lock:
+            if self.stopped: return None
+            if self.args.episodes > 0 and self.next_episode >= self.args.episodes:
+                return None
+            if self.args.episodes <= 0 and self.experiment_time >= self.args.max_experiment_time:
+                return None
+            if self.failures >= self.args.max_failures:
+                print('Too many failed episodes, stop scheduling.')
+                return None
+            index = self.next_episode
+            self.next_episode += 1
+            return index
+
+    def record(self, result):
+        with self.lock:
+            if result['status'] == 'completed':
+                self.experiment_time += result.get('simulation_time', 0.0)
+            else:
+                self.failures += 1
+            with open(self.results_file, 'a') as f:
+                f.write(json.dumps(result, sort_keys=True) + '\n')
+            # Summarize the episode in the results database.
+            try:
+                db = results_database.connect(self.args.database)
+                results_database.insert_episode(db, self.experiment, result, self.params)
+                db.close()
+            except Exception as e:
+                print('Cannot write episode {} to {}: {}'.format(
+                    result.get('episode'), self.args.database, e))
+
+    def worker(self, slot):
+        while True:
+            index = self.schedule()
+            if index is None: return
+            episode = Episode(index, slot, self.args)
+            with self.lock: self.running[slot] = episode
+            try:
+                result = episode.run()
+            except Exception as e:
+                result = {'episode': index, 'method': self.args.method,
+                          'status': 'orchestrator_error', 'message': str(e)}
+            with self.lock: del self.running[slot]
+            self.record(result)
+
+    def stop(self):
+        with self.lock:
+            self.stopped = True
+            for episode in self.running.values(): episode.stop()
+
+    def run(self):
+        if not os.path.isdir(self.args.output_dir):
+            os.makedirs(self.args.output_dir)
+
+        workers = []
+        for slot in range(self.args.jobs):
+            worker = threading.Thread(target=self.worker, args=(slot,))
+            worker.daemon = True
+            worker.start()
+            workers.append(worker)
+
+        try:
+            # Join with a timeout so that Ctrl+C is handled by the main thread.
+            while any(worker.is_alive() for worker in workers):
+                for worker in workers: worker.join(1.0)
+        except KeyboardInterrupt:
+            print('Interrupted, stopping the running episodes.')
+            self.stop()
+            for worker in workers: worker.join()
+
+        print('Experiment finishes: {} episodes, {} failed, {:.1f}s simulation time.'.format(
+            self.next_episode, self.failures, self.experiment_time))
+        print('Results: {} (experiment {} in {})'.format(
+            self.results_file, self.experiment, self.args.database))
+
+
+if __name__ == '__main__':
+
+    parser = argparse.ArgumentParser(
+            description='Run random traffic experiments with parallel episodes.')
+    parser.add_argument('--method', default='ego_slc_lattice_planner',
+            help='The ego planner launch argument, e.g. ego_idm_lattice_planner.')
+    parser.add_argument('--jobs', type=int, default=1,
+            help='Number of episodes running in parallel.')
+    parser.add_argument('--episodes', type=int, default=0,
+            help='Number of episodes, 0 to run until --max-experiment-time is reached.')
+    parser.add_argument('--max-episode-time', type=float, default=500.0,
+            help='Simulation time of each episode (s).')
+    parser.add_argument('--max-experiment-time', type=float, default=3600.0,
+            help='Total simulation time of the completed episodes (s).')
+    parser.add_argument('--episode-timeout', type=float, default=3600.0,
+            help='Wall time after which an episode is killed (s).')
+    parser.add_argument('--startup-timeout', type=float, default=60.0,
+            help='Wall time to wait for a carla server to accept connections (s).')
+    parser.add_argument('--max-failures', type=int, default=10,
+            help='Stop scheduling new episodes after this many failed episodes.')
+    parser.add_argument('--seed', type=int, default=0,
+            help='Seed of the traffic in the first episode, episode i uses seed + i.')
+    parser.add_argument('--fixed-delta-seconds', type=float, default=0.05,
+            help='Simulation time step (s).')
+    parser.add_argument('--carla-port', type=int, default=2000,
+            help='Carla port of the first slot, each slot uses 4 ports from here.')
+    parser.add_argument('--master-port', type=int, default=11311,
+            help='ROS master port of the first slot.')
+    parser.add_argument('--carla-dist', default=os.environ.get('Carla_DIST', ''),
+            help='Directory of the carla distribution, $Carla_DIST by default.')
+    parser.add_argument('--output-dir', default=os.path.join(
+            os.getcwd(), time.strftime('random_traffic_%Y%m%d_%H%M%S')),
+            help='Directory of the experiment results.')
+    parser.add_argument('--no-bags', action='store_true',
+            help='Do not record the /carla topics of the episodes.')
+    parser.add_argument('--launch-arg', action='append', default=[],
+            help='Additional roslaunch argument, name:=value, recorded with the results, '
+                 'can be repeated.')
+    parser.add_argument('--database', default=os.path.join(os.getcwd(), 'experiments.db'),
+            help='SQLite database collecting the episode summaries.')
+    parser.add_argument('--experiment', default='',
+            help='Name of the experiment in the database, the output directory name by default.')
+    args = parser.parse_args()
+
+    if not args.carla_dist:
+        parser.error('the carla distribution is not given, set --carla-dist or $Carla_DIST.')
+    if args.jobs < 1:
+        parser.error('--jobs should be at least 1.')
+    for launch_arg in args.launch_arg:
+        if ':=' not in launch_arg:
+            parser.error('launch argument {} is not in the form name:=value.'.format(launch_arg))
+
+    Experiment(args).run()
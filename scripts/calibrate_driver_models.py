@@ -0,0 +1,212 @@
+#!/usr/bin/env python
+
+"""
+Calibrate the driver models of the agents from recorded trajectories.
+
+The intelligent driver model (the ACC variant used by the planners and the
+agents, see src/planner/common/intelligent_driver_model.h) is fitted to every
+agent in the states extracted by offline_planner_evaluation.py. The leaders
+and gaps of the agents are found on the traffic lattice through the python
+bindings (the lattice_planners module built from src/python), so that they
+are the same as the ones seen by the planners.
+
+The per-agent fits are grouped into vehicle classes by the vehicle length,
+and the median of each class is written as a YAML file which can be loaded
+as the driver_models parameter of the planning nodes, e.g.
+    roslaunch conformal_lattice_planner autonomous_driving.launch \\
+        driver_models:=$(pwd)/driver_models.yaml
+
+Usage:
+    ./offline_planner_evaluation.py extract traffic_data_*.bag --output states.npz
+    ./calibrate_driver_models.py states.npz --xodr Town04.xodr \\
+        --classes two_wheeler:2.5,car:5.5,truck:inf --threads 8 \\
+        --output driver_models.yaml
+"""
+
+from __future__ import division
+from __future__ import print_function
+
+import math
+import argparse
+import collections
+from multiprocessing.pool import ThreadPool
+
+import numpy as np
+from scipy.optimize import least_squares
+
+# Columns of a vehicle state row, see lattice_planners.VEHICLE_COLUMNS.
+ID, SPEED, POLICY_SPEED, EXTENT_X = 0, 7, 8, 11
+
+# Fitted parameters with their initial values and bounds, the initial values
+# are the defaults of planner::IntelligentDriverModel.
+PARAMS = collections.OrderedDict([
+    ('time_gap',        (1.0, 0.3, 4.0)),
+    ('distance_gap',    (6.0, 0.5, 20.0)),
+    ('comfort_accel',   (1.5, 0.3, 5.0)),
+    ('comfort_decel',   (2.5, 0.3, 8.0)),
+    ('coolness_factor', (0.9, 0.0, 1.0)),
+])
+
+def parse_classes(classes):
+    """ Parse name:max_length pairs into a list sorted by the max length. """
+    output = []
+    for item in classes.split(','):
+        name, max_length = item.split(':')
+        output.append((name, float(max_length)))
+    return sorted(output, key=lambda c: c[1])
+
+def vehicle_class(classes, length):
+    """ The first class whose max length is not shorter than the vehicle, the same as
+        planner::DriverModelTable::model(). None if the vehicle is longer than all classes,
+        in which case the planners use the default model. """
+    for name, max_length in classes:
+        if length <= max_length: return name
+    return None
+
+def collect_samples(args):
+    """ Collect the (speed, policy speed, lead speed, gap, accel) samples of each agent. """
+    import lattice_planners as lp
+
+    states = np.load(args.states)
+    times, egos, agents = states['t'], states['ego'], states['agents']
+    world = lp.World(args.xodr)
+
+    # Episodes are split where the simulation time goes back,
+    # since the agent IDs are only unique within an episode.
+    episodes = np.concatenate([[0], np.cumsum(np.diff(times) <= 0.0)])
+
+    # Leader and gap of every agent in every state, found on the traffic lattice.
+    leaders = [None] * egos.shape[0]
+    def find_leaders(i):
+        try:
+            snapshot = lp.Snapshot(world, egos[i], agents[i])
+            vehicles = snapshot.vehicles()
+            speeds = dict(zip(vehicles[:, ID].astype(int), vehicles[:, SPEED]))
+            output = {}
+            for agent in snapshot.agent_ids():
+                front = snapshot.front(agent)
+                if front is None: output[agent] = (np.nan, np.nan)
+                else: output[agent] = (speeds[front[0]], front[1])
+            leaders[i] = output
+        except RuntimeError as e:
+            if args.verbose: print('state {}: {}'.format(i, e))
+
+    pool = ThreadPool(args.threads)
+    pool.map(find_leaders, range(egos.shape[0]))
+    pool.close()
+    pool.join()
+
+    # The observed acceleration is the change of speed between consecutive states.
+    samples = collections.defaultdict(list)
+    lengths = {}
+    for i in range(egos.shape[0]-1):
+        if leaders[i] is None or episodes[i] != episodes[i+1]: continue
+        dt = times[i+1] - times[i]
+        if dt <= 0.0: continue
+
+        next_speeds = {}
+        for row in agents[i+1]:
+            if not np.isnan(row[ID]): next_speeds[int(row[ID])] = row[SPEED]
+
+        for row in agents[i]:
+            if np.isnan(row[ID]): continue
+            agent = int(row[ID])
+            if agent not in leaders[i] or agent not in next_speeds: continue
+            lead_speed, gap = leaders[i][agent]
+            accel = (next_speeds[agent]-row[SPEED]) / dt
+            key = (episodes[i], agent)
+            samples[key].append([row[SPEED], row[POLICY_SPEED], lead_speed, gap, accel])
+            lengths[key] = 2.0 * row[EXTENT_X]
+
+    return dict((k, np.array(v)) for k, v in samples.items()), lengths
+
+def fit_agent(args, samples, names):
+    """ Fit the parameters of one agent with bounded least squares. """
+    import lattice_planners as lp
+
+    x0 = np.array([PARAMS[n][0] for n in names])
+    lower = np.array([PARAMS[n][1] for n in names])
+    upper = np.array([PARAMS[n][2] for n in names])
+
+    def residuals(x):
+        return lp.driver_model_accelerations(dict(zip(names, x)),
+                samples[:, 0], samples[:, 1], samples[:, 2], samples[:, 3]) - samples[:, 4]
+
+    result = least_squares(residuals, x0, bounds=(lower, upper), loss=args.loss)
+    rmse = math.sqrt(np.mean(result.fun**2))
+    return dict(zip(names, result.x)), rmse
+
+def calibrate(args):
+    classes = parse_classes(args.classes)
+    names = [n for n in PARAMS if n != 'coolness_factor' or args.fit_coolness]
+
+    samples, lengths = collect_samples(args)
+    agents = [k for k in samples if samples[k].shape[0] >= args.min_samples]
+    print('{} agents, {} with at least {} samples.'.format(
+        len(samples), len(agents), args.min_samples))
+
+    # Agents longer than all classes follow the default model, which is not fitted.
+    excluded = [k for k in agents if vehicle_class(classes, lengths[k]) is None]
+    if excluded:
+        print('{} agents longer than all classes, excluded.'.format(len(excluded)))
+        agents = [k for k in agents if vehicle_class(classes, lengths[k]) is not None]
+
+    def fit(key):
+        return key, fit_agent(args, samples[key], names)
+    pool = ThreadPool(args.threads)
+    fits = dict(pool.map(fit, agents))
+    pool.close()
+    pool.join()
+
+    lines = ['driver_models:']
+    for name, max_length in classes:
+        members = [k for k in agents if vehicle_class(classes, lengths[k]) == name]
+        if not members:
+            print('class {}: no agents, skipped.'.format(name))
+            continue
+
+        num_samples = sum(samples[k].shape[0] for k in members)
+        rmse = np.median([fits[k][1] for k in members])
+        lines.append('  - name: {}'.format(name))
+        if not math.isinf(max_length):
+            lines.append('    max_length: {}'.format(max_length))
+        for n in names:
+            lines.append('    {}: {:.4f}'.format(n, np.median([fits[k][0][n] for k in members])))
+        lines.append('    # agents: {}, samples: {}, median rmse: {:.4f}m/s^2'.format(
+            len(members), num_samples, rmse))
+        print('class {}: {} agents, median rmse {:.4f}m/s^2.'.format(name, len(members), rmse))
+
+    with open(args.output, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+    print('driver models written to {}.'.format(args.output))
+
+    if args.agents_output:
+        with open(args.agents_output, 'w') as f:
+            f.write(','.join(['episode', 'agent', 'length', 'samples', 'rmse'] + names) + '\n')
+            for k in sorted(agents):
+                params, rmse = fits[k]
+                f.write(','.join([str(k[0]), str(k[1]), str(lengths[k]),
+                    str(samples[k].shape[0]), str(rmse)] + [str(params[n]) for n in names]) + '\n')
+
+if __name__ == '__main__':
+
+    parser = argparse.ArgumentParser(description='Calibrate the driver models of the agents.')
+    parser.add_argument('states',
+            help='States extracted by offline_planner_evaluation.py.')
+    parser.add_argument('--xodr', required=True,
+            help='OpenDRIVE file of the map, e.g. Town04.xodr.')
+    parser.add_argument('--classes', default='two_wheeler:2.5,car:5.5,truck:inf',
+            help='Vehicle classes as name:max_length pairs, in meters.')
+    parser.add_argument('--fit-coolness', action='store_true',
+            help='Fit the coolness factor of the ACC as well.')
+    parser.add_argument('--loss', default='soft_l1',
+            choices=['linear', 'soft_l1', 'huber', 'cauchy'])
+    parser.add_argument('--min-samples', type=int, default=50)
+    parser.add_argument('--threads', type=int, default=1)
+    parser.add_argument('--output', default='driver_models.yaml')
+    parser.add_argument('--agents-output', default='',
+            help='Optional CSV file of the per-agent fits.')
+    parser.add_argument('--verbose', action='store_true')
+
+    args = parser.parse_args()
+    calibrate(args)
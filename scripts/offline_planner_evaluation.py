@@ -0,0 +1,151 @@
+#!/usr/bin/env python
+
+"""
+Offline evaluation of the planners over logged traffic states.
+
+The planners are invoked in-process through the python bindings
+(the lattice_planners module built from src/python), without ROS or a carla
+server. The carla map is loaded from its OpenDRIVE file instead, e.g.
+$Carla_DIST/CarlaUE4/Content/Carla/Maps/OpenDrive/Town04.xodr.
+
+Usage:
+    # Extract the ego planning goals recorded in the bags into arrays.
+    ./offline_planner_evaluation.py extract traffic_data_*.bag --output states.npz
+
+    # Evaluate a planner over the states on 8 threads.
+    ./offline_planner_evaluation.py evaluate states.npz --xodr Town04.xodr \\
+        --planner slc --threads 8 --output slc.npz
+"""
+
+from __future__ import division
+from __future__ import print_function
+
+import math
+import time
+import argparse
+import threading
+from multiprocessing.pool import ThreadPool
+
+import numpy as np
+
+# Number of columns of a vehicle state row, see lattice_planners.VEHICLE_COLUMNS.
+NUM_VEHICLE_COLUMNS = 14
+
+# Lane change types, the same as the path_type field of the ego plan result.
+LANE_CHANGES = {'keep_lane': 0, 'left_lane_change': 1, 'right_lane_change': 2, 'none': 3}
+
+def quaternion_to_rpy(q):
+    """ Roll, pitch, yaw (deg) of a quaternion, the same as tf2::Matrix3x3::getRPY(). """
+    roll = math.atan2(2.0*(q.w*q.x + q.y*q.z), 1.0 - 2.0*(q.x*q.x + q.y*q.y))
+    pitch = math.asin(max(-1.0, min(1.0, 2.0*(q.w*q.y - q.z*q.x))))
+    yaw = math.atan2(2.0*(q.w*q.z + q.x*q.y), 1.0 - 2.0*(q.y*q.y + q.z*q.z))
+    return [math.degrees(roll), math.degrees(pitch), math.degrees(yaw)]
+
+def vehicle_row(msg):
+    """ Convert a conformal_lattice_planner/Vehicle message into a row of VEHICLE_COLUMNS. """
+    position = msg.transform.position
+    extent = msg.bounding_box.extent
+    return [msg.id, position.x, position.y, position.z] + \
+           quaternion_to_rpy(msg.transform.orientation) + \
+           [msg.speed, msg.policy_speed, msg.acceleration, msg.curvature,
+            extent.x, extent.y, extent.z]
+
+def extract(args):
+    import rosbag
+
+    times, egos, agents = [], [], []
+    for bagfile in args.bags:
+        bag = rosbag.Bag(bagfile, 'r')
+        for topic, msg, t in bag.read_messages(topics=[args.topic]):
+            times.append(msg.goal.simulation_time)
+            egos.append(vehicle_row(msg.goal.snapshot.ego))
+            agents.append([vehicle_row(agent) for agent in msg.goal.snapshot.agents])
+        bag.close()
+
+    # Pad the agents with NaN rows, which are ignored by the snapshots.
+    max_agents = max([len(a) for a in agents] + [1])
+    agents_array = np.full((len(agents), max_agents, NUM_VEHICLE_COLUMNS), np.nan)
+    for i, a in enumerate(agents):
+        if a: agents_array[i, :len(a), :] = a
+
+    np.savez_compressed(args.output,
+            t=np.array(times), ego=np.array(egos), agents=agents_array)
+    print('{} states written to {}.'.format(len(egos), args.output))
+
+def evaluate(args):
+    import lattice_planners as lp
+
+    states = np.load(args.states)
+    egos, agents = states['ego'], states['agents']
+    world = lp.World(args.xodr)
+
+    # Each thread owns its planners, which are not thread safe.
+    local = threading.local()
+    def create_planner():
+        if args.planner == 'idm':
+            return lp.IDMLatticePlanner(world, args.sim_time_step, args.spatial_horizon)
+        if args.planner == 'slc':
+            return lp.SLCLatticePlanner(world, args.sim_time_step, args.spatial_horizon)
+        if args.planner == 'spatiotemporal':
+            return lp.SpatiotemporalLatticePlanner(world, args.sim_time_step, args.spatial_horizon)
+        return lp.LaneFollower(world)
+
+    lane_change = np.full(egos.shape[0], -1, dtype=int)
+    acceleration = np.full(egos.shape[0], np.nan)
+    planning_time = np.full(egos.shape[0], np.nan)
+
+    def plan(i):
+        if not hasattr(local, 'planner'): local.planner = create_planner()
+        try:
+            start = time.time()
+            snapshot = lp.Snapshot(world, egos[i], agents[i])
+            result = local.planner.plan_path(snapshot)
+            planning_time[i] = time.time() - start
+            lane_change[i] = LANE_CHANGES[result['lane_change']]
+            acceleration[i] = result['acceleration']
+        except RuntimeError as e:
+            if args.verbose: print('state {}: {}'.format(i, e))
+
+    start = time.time()
+    pool = ThreadPool(args.threads)
+    pool.map(plan, range(egos.shape[0]))
+    pool.close()
+    pool.join()
+    wall_time = time.time() - start
+
+    failures = np.count_nonzero(lane_change < 0)
+    print('{} states, {} failures, {:.1f}s wall time, {:.1f} states/s.'.format(
+        egos.shape[0], failures, wall_time, egos.shape[0]/max(wall_time, 1e-6)))
+    if args.output:
+        np.savez_compressed(args.output, lane_change=lane_change,
+                acceleration=acceleration, planning_time=planning_time)
+
+if __name__ == '__main__':
+
+    parser = argparse.ArgumentParser(description='Offline evaluation of the planners.')
+    subparsers = parser.add_subparsers(dest='command')
+    subparsers.required = True
+
+    extract_parser = subparsers.add_parser('extract',
+            help='Extract the ego planning goals in bags into a .npz file.')
+    extract_parser.add_argument('bags', nargs='+')
+    extract_parser.add_argument('--topic', default='/carla/carla_simulator/ego_plan/goal')
+    extract_parser.add_argument('--output', default='states.npz')
+    extract_parser.set_defaults(func=extract)
+
+    evaluate_parser = subparsers.add_parser('evaluate',
+            help='Plan for every state in a .npz file.')
+    evaluate_parser.add_argument('states')
+    evaluate_parser.add_argument('--xodr', required=True,
+            help='OpenDRIVE file of the map, e.g. Town04.xodr.')
+    evaluate_parser.add_argument('--planner', default='slc',
+            choices=['idm', 'slc', 'spatiotemporal', 'lane_follower'])
+    evaluate_parser.add_argument('--sim-time-step', type=float, default=0.1)
+    evaluate_parser.add_argument('--spatial-horizon', type=float, default=150.0)
+    evaluate_parser.add_argument('--threads', type=int, default=1)
+    evaluate_parser.add_argument('--output', default='')
+    evaluate_parser.add_argument('--verbose', action='store_true')
+    evaluate_parser.set_defaults(func=evaluate)
+
+    args = parser.parse_args()
+    args.func(args)
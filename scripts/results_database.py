@@ -0,0 +1,261 @@
+#!/usr/bin/env python
+
+"""
+Local SQLite database of the experiment episodes.
+
+Each finished episode is stored as one row of summary statistics, i.e. the
+result written by the simulator node, together with the parameter set used
+in the episode. Planners and configurations can then be compared without
+re-parsing the bags.
+
+Usage:
+    # Import the episode results of an experiment, e.g. from older runs.
+    ./results_database.py --db experiments.db import results.jsonl \\
+        --experiment slc_baseline --param planning_time_budget=0.0
+
+    # Compare the planners, and the configurations of each planner.
+    ./results_database.py --db experiments.db compare --by method
+    ./results_database.py --db experiments.db compare --by method --by param:planning_time_budget
+"""
+
+from __future__ import division
+from __future__ import print_function
+
+import sys
+import json
+import sqlite3
+import argparse
+
+# Columns of the episodes table apart from the id, and their types.
+EPISODE_COLUMNS = [
+    ('experiment',              'TEXT'),
+    ('episode',                 'INTEGER'),
+    ('method',                  'TEXT'),
+    ('status',                  'TEXT'),
+    ('message',                 'TEXT'),
+    ('directory',               'TEXT'),
+    ('simulation_time',         'REAL'),
+    ('wall_time',               'REAL'),
+    ('ego_plans',               'INTEGER'),
+    ('mean_speed',              'REAL'),
+    ('speed_std',               'REAL'),
+    ('min_speed',               'REAL'),
+    ('max_speed',               'REAL'),
+    ('mean_acceleration',       'REAL'),
+    ('keep_lane_plans',         'INTEGER'),
+    ('left_lane_change_plans',  'INTEGER'),
+    ('right_lane_change_plans', 'INTEGER'),
+    ('unknown_path_plans',      'INTEGER'),
+    ('lane_changes',            'INTEGER'),
+    ('abandoned_manoeuvres',    'INTEGER'),
+    ('mean_ego_planning_time',  'REAL'),
+    ('p50_ego_planning_time',   'REAL'),
+    ('p90_ego_planning_time',   'REAL'),
+    ('p99_ego_planning_time',   'REAL'),
+    ('max_ego_planning_time',   'REAL'),
+    ('mean_lattice_construction_time', 'REAL'),
+    ('braking_events',          'INTEGER'),
+    ('collisions',              'INTEGER'),
+]
+
+# Aggregations of the compare command, (name, SQL expression).
+# Means over plans are weighted by the number of plans in each episode,
+# and event counts are normalized by the simulation time.
+METRICS = [
+    ('episodes',        'COUNT(*)'),
+    ('sim_time',        'SUM(e.simulation_time)'),
+    ('mean_speed',      'SUM(e.mean_speed*e.ego_plans) / SUM(e.ego_plans)'),
+    ('speed_std',       'AVG(e.speed_std)'),
+    ('mean_accel',      'SUM(e.mean_acceleration*e.ego_plans) / SUM(e.ego_plans)'),
+    ('lc_plan_ratio',   'SUM(e.left_lane_change_plans+e.right_lane_change_plans) / '
+                        'CAST(SUM(e.ego_plans) AS REAL)'),
+    ('lane_changes/h',  '3600.0 * SUM(e.lane_changes) / SUM(e.simulation_time)'),
+    ('abandoned/min',   '60.0 * SUM(e.abandoned_manoeuvres) / SUM(e.simulation_time)'),
+    ('braking/h',       '3600.0 * SUM(e.braking_events) / SUM(e.simulation_time)'),
+    ('collisions/h',    '3600.0 * SUM(e.collisions) / SUM(e.simulation_time)'),
+    ('plan_mean',       'SUM(e.mean_ego_planning_time*e.ego_plans) / SUM(e.ego_plans)'),
+    ('plan_p50',        'AVG(e.p50_ego_planning_time)'),
+    ('plan_p90',        'AVG(e.p90_ego_planning_time)'),
+    ('plan_p99',        'AVG(e.p99_ego_planning_time)'),
+    ('plan_max',        'MAX(e.max_ego_planning_time)'),
+    ('lattice_mean',    'SUM(e.mean_lattice_construction_time*e.ego_plans) / SUM(e.ego_plans)'),
+]
+
+
+def connect(path):
+    """ Open the database, creating the tables if necessary. """
+    # Episodes running in parallel may write at the same time.
+    db = sqlite3.connect(path, timeout=30.0)
+    db.execute('CREATE TABLE IF NOT EXISTS episodes ('
+               'id INTEGER PRIMARY KEY AUTOINCREMENT, ' +
+               ', '.join('{} {}'.format(name, t) for name, t in EPISODE_COLUMNS) +
+               ', finished_at TEXT DEFAULT CURRENT_TIMESTAMP'
+               ', UNIQUE(experiment, episode))')
+    # Add the columns introduced after the database was created.
+    existing = set(row[1] for row in db.execute('PRAGMA table_info(episodes)'))
+    for name, t in EPISODE_COLUMNS:
+        if name not in existing:
+            db.execute('ALTER TABLE episodes ADD COLUMN {} {}'.format(name, t))
+    db.execute('CREATE TABLE IF NOT EXISTS params ('
+               'episode_id INTEGER REFERENCES episodes(id) ON DELETE CASCADE, '
+               'key TEXT, value TEXT, PRIMARY KEY(episode_id, key))')
+    db.execute('CREATE INDEX IF NOT EXISTS params_key ON params(key, value)')
+    db.commit()
+    return db
+
+
+def insert_episode(db, experiment, result, params):
+    """ Insert (or replace) the summary of an episode.
+
+    Args:
+        db: The database connection.
+        experiment: Name of the experiment the episode belongs to.
+        result: The episode result, e.g. a line of results.jsonl.
+        params: Dict of the parameters used in the episode.
+    Returns:
+        The id of the episode row.
+    """
+    row = dict(result)
+    row['experiment'] = experiment
+    names = [name for name, _ in EPISODE_COLUMNS]
+
+    with db:
+        # Replace the episode and its parameters if it exists already.
+        db.execute('DELETE FROM params WHERE episode_id IN '
+                   '(SELECT id FROM episodes WHERE experiment=? AND episode=?)',
+                   (experiment, row.get('episode')))
+        db.execute('DELETE FROM episodes WHERE experiment=? AND episode=?',
+                   (experiment, row.get('episode')))
+        cursor = db.execute(
+                'INSERT INTO episodes ({}) VALUES ({})'.format(
+                    ', '.join(names), ', '.join('?'*len(names))),
+                [row.get(name) for name in names])
+        episode_id = cursor.lastrowid
+        db.executemany('INSERT INTO params (episode_id, key, value) VALUES (?, ?, ?)',
+                       [(episode_id, str(k), str(v)) for k, v in sorted(params.items())])
+    return episode_id
+
+
+def compare(db, by, statuses, experiments=None):
+    """ Aggregate the episodes grouped by columns or parameters.
+
+    Args:
+        db: The database connection.
+        by: Group keys, either an episodes column, e.g. 'method',
+            or a parameter, e.g. 'param:planning_time_budget'.
+        statuses: Only episodes with these statuses are included,
+            all episodes are included if empty.
+        experiments: Only episodes in these experiments are included if given.
+    Returns:
+        The header and the rows of the comparison table.
+    """
+    names = [name for name, _ in EPISODE_COLUMNS]
+    group_exprs = []
+    joins = []
+    args = []
+    for i, key in enumerate(by):
+        if key.startswith('param:'):
+            joins.append('LEFT JOIN params p{0} ON p{0}.episode_id=e.id AND p{0}.key=?'.format(i))
+            args.append(key[len('param:'):])
+            group_exprs.append('p{}.value'.format(i))
+        elif key in names:
+            group_exprs.append('e.{}'.format(key))
+        else:
+            raise ValueError('unknown group key {}'.format(key))
+
+    conditions = []
+    if statuses:
+        conditions.append('e.status IN ({})'.format(', '.join('?'*len(statuses))))
+        args.extend(statuses)
+    if experiments:
+        conditions.append('e.experiment IN ({})'.format(', '.join('?'*len(experiments))))
+        args.extend(experiments)
+
+    query = 'SELECT {} FROM episodes e {}'.format(
+            ', '.join(group_exprs + [expr for _, expr in METRICS]), ' '.join(joins))
+    if conditions: query += ' WHERE ' + ' AND '.join(conditions)
+    if group_exprs:
+        query += ' GROUP BY {0} ORDER BY {0}'.format(', '.join(group_exprs))
+
+    header = list(by) + [name for name, _ in METRICS]
+    return header, db.execute(query, args).fetchall()
+
+
+def format_table(header, rows):
+    """ Format the rows into a fixed width text table. """
+    def cell(value):
+        if value is None: return '-'
+        if isinstance(value, float): return '{:.4g}'.format(value)
+        return str(value)
+
+    cells = [[cell(v) for v in row] for row in rows]
+    widths = [max([len(h)] + [len(row[i]) for row in cells]) for i, h in enumerate(header)]
+    lines = ['  '.join(h.rjust(w) for h, w in zip(header, widths)),
+             '  '.join('-'*w for w in widths)]
+    lines.extend('  '.join(c.rjust(w) for c, w in zip(row, widths)) for row in cells)
+    return '\n'.join(lines)
+
+
+def parse_params(items):
+    params = {}
+    for item in items:
+        if '=' not in item:
+            raise ValueError('parameter {} is not in the form key=value'.format(item))
+        key, value = item.split('=', 1)
+        params[key] = value
+    return params
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Experiment results database.')
+    parser.add_argument('--db', default='experiments.db', help='The database file.')
+    subparsers = parser.add_subparsers(dest='command')
+
+    import_parser = subparsers.add_parser(
+            'import', help='Import episode results from results.jsonl files.')
+    import_parser.add_argument('files', nargs='+')
+    import_parser.add_argument('--experiment', required=True,
+            help='Name of the experiment the episodes belong to.')
+    import_parser.add_argument('--param', action='append', default=[],
+            help='Parameter used in the episodes, key=value, can be repeated.')
+
+    compare_parser = subparsers.add_parser(
+            'compare', help='Compare the episodes across planners and configurations.')
+    compare_parser.add_argument('--by', action='append', default=[],
+            help='Group by an episode column or a parameter (param:<key>), can be repeated.')
+    compare_parser.add_argument('--status', action='append', default=None,
+            help='Include episodes with the status, "completed" by default, "all" for all.')
+    compare_parser.add_argument('--experiment', action='append', default=None,
+            help='Include episodes of the experiment, all experiments by default.')
+
+    args = parser.parse_args()
+    db = connect(args.db)
+
+    if args.command == 'import':
+        params = parse_params(args.param)
+        count = 0
+        for path in args.files:
+            with open(path) as f:
+                for line in f:
+                    if not line.strip(): continue
+                    result = json.loads(line)
+                    episode_params = dict(params)
+                    episode_params.setdefault('method', result.get('method'))
+                    insert_episode(db, args.experiment, result, episode_params)
+                    count += 1
+        print('Imported {} episodes into {}.'.format(count, args.db))
+
+    elif args.command == 'compare':
+        statuses = args.status or ['completed']
+        if 'all' in statuses: statuses = []
+        by = args.by or ['method']
+        header, rows = compare(db, by, statuses, args.experiment)
+        print(format_table(header, rows))
+
+    else:
+        parser.print_help()
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
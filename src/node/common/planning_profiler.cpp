@@ -0,0 +1,180 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <csignal>
+#include <ctime>
+#include <boost/format.hpp>
+#include <gperftools/profiler.h>
+#include <gperftools/heap-profiler.h>
+
+#include <node/common/planning_profiler.h>
+
+namespace node {
+
+std::atomic<int> PlanningProfiler::signal_(0);
+
+PlanningProfiler::PlanningProfiler(ros::NodeHandle& nh, const std::string& name) :
+  nh_(nh), name_(name) {
+  nh_.param<std::string>("profile_prefix", prefix_, prefix_);
+  service_ = nh_.advertiseService(
+      "profile_planning", &PlanningProfiler::serviceCallback, this);
+  return;
+}
+
+void PlanningProfiler::installSignalHandlers() {
+  std::signal(SIGUSR1, &PlanningProfiler::signalHandler);
+  std::signal(SIGUSR2, &PlanningProfiler::signalHandler);
+  return;
+}
+
+void PlanningProfiler::signalHandler(int signal) {
+  // Only async-signal-safe operations are allowed here.
+  signal_.store(signal);
+  return;
+}
+
+std::pair<std::string, std::string> PlanningProfiler::request(
+    const int cycles, std::string label, const bool heap) {
+
+  if (cycles <= 0) {
+    stop();
+    return std::make_pair(std::string(), std::string());
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (label.empty()) {
+    label = (boost::format("window%1%_%2%")
+        % windows_ % static_cast<long>(std::time(nullptr))).str();
+  }
+
+  pending_cycles_ = cycles;
+  pending_label_ = label;
+  pending_heap_ = heap;
+
+  ROS_INFO_NAMED(name_, "profiling of %d planning cycles requested, label: %s heap: %d",
+      cycles, label.c_str(), heap);
+
+  std::pair<std::string, std::string> profiles = files(label);
+  if (!heap) profiles.second.clear();
+  return profiles;
+}
+
+void PlanningProfiler::stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_cycles_ = 0;
+  if (active_) stopWindow();
+  return;
+}
+
+void PlanningProfiler::beginCycle(const size_t ego) {
+  handleSignal();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (active_ || pending_cycles_ <= 0) return;
+
+  const std::pair<std::string, std::string> profiles = files(pending_label_);
+  const int cycles = pending_cycles_;
+  const bool heap = pending_heap_;
+  pending_cycles_ = 0;
+
+  if (!ProfilerStart(profiles.first.c_str())) {
+    ROS_WARN_NAMED(name_, "cannot start the CPU profiler, output: %s",
+        profiles.first.c_str());
+    return;
+  }
+
+  heap_active_ = false;
+  if (heap) {
+    // The heap profiler only works if the process is linked with tcmalloc.
+    if (IsHeapProfilerRunning()) {
+      ROS_WARN_NAMED(name_, "the heap profiler is already running.");
+    } else {
+      HeapProfilerStart(profiles.second.c_str());
+      heap_active_ = true;
+    }
+  }
+
+  active_ = true;
+  window_cycles_ = cycles;
+  finished_cycles_.clear();
+  ++windows_;
+
+  ROS_INFO_NAMED(name_, "profiling starts at a cycle of ego %lu, %d cycles per ego, output: %s",
+      ego, cycles, profiles.first.c_str());
+  return;
+}
+
+void PlanningProfiler::endCycle(const size_t ego) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!active_) return;
+  // Stop once the (fastest) ego finishes its cycles, so that an ego which
+  // no longer plans cannot keep the window open.
+  if (++finished_cycles_[ego] >= window_cycles_) stopWindow();
+  return;
+}
+
+void PlanningProfiler::stopWindow() {
+  if (heap_active_) {
+    HeapProfilerDump("end of profiling window");
+    HeapProfilerStop();
+    heap_active_ = false;
+  }
+  ProfilerStop();
+  active_ = false;
+  window_cycles_ = 0;
+  finished_cycles_.clear();
+
+  ROS_INFO_NAMED(name_, "profiling stops.");
+  return;
+}
+
+void PlanningProfiler::handleSignal() {
+  const int signal = signal_.exchange(0);
+
+  if (signal == SIGUSR1) {
+    int cycles = 100;
+    bool heap = false;
+    nh_.param<int>("profile_cycles", cycles, 100);
+    nh_.param<bool>("profile_heap", heap, false);
+    request(cycles, "", heap);
+  } else if (signal == SIGUSR2) {
+    stop();
+  }
+
+  return;
+}
+
+bool PlanningProfiler::serviceCallback(
+    conformal_lattice_planner::ProfilePlanning::Request& req,
+    conformal_lattice_planner::ProfilePlanning::Response& res) {
+
+  const std::pair<std::string, std::string> profiles =
+    request(req.cycles, req.label, req.heap);
+
+  res.success = true;
+  res.cpu_profile = profiles.first;
+  res.heap_profile = profiles.second;
+  if (req.cycles > 0) {
+    res.message = (boost::format(
+          "profiling of %1% planning cycles starts at the next cycle.")
+        % req.cycles).str();
+  } else {
+    res.message = "profiling stopped.";
+  }
+
+  return true;
+}
+
+} // End namespace node.
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <boost/core/noncopyable.hpp>
+#include <ros/ros.h>
+
+#include <conformal_lattice_planner/ProfilePlanning.h>
+
+namespace node {
+
+/**
+ * \brief PlanningProfiler collects gperftools CPU and heap profiles over
+ *        a window of planning cycles, controlled at runtime.
+ *
+ * A profiling window is requested either through the \c profile_planning
+ * service advertised in the namespace of the given node handle, or by
+ * sending \c SIGUSR1 to the process, in which case the window length and
+ * the heap option are read from the \c profile_cycles and \c profile_heap
+ * parameters. \c SIGUSR2 (or a service call with non-positive cycles) stops
+ * the active window early.
+ *
+ * The profiler starts at the beginning of the next planning cycle and stops
+ * after the requested number of cycles have finished. Each window writes
+ * its own files, named after the \c profile_prefix parameter and the label
+ * of the window, i.e. \c <prefix>_<label>.prof for the CPU profile and
+ * \c <prefix>_<label>.*.heap for the heap profiles.
+ *
+ * Planning cycles should be marked with the \c Cycle guard. The class is
+ * thread-safe, since the service callback and the planning callback
+ * (the action server thread) run on different threads.
+ *
+ * The planning nodes of multiple egos in a process share one profiler.
+ * The cycles are counted per ego, and the window stops once any ego has
+ * finished the requested number of cycles, so that a window of \c n cycles
+ * covers about \c n cycles of every ego instead of \c n cycles in total.
+ */
+class PlanningProfiler : private boost::noncopyable {
+
+public:
+
+  /// Marks the scope of a planning cycle of an ego.
+  class Cycle : private boost::noncopyable {
+  public:
+    Cycle(PlanningProfiler& profiler, const size_t ego = 0) :
+      profiler_(profiler), ego_(ego) {
+      profiler_.beginCycle(ego_);
+    }
+    ~Cycle() { profiler_.endCycle(ego_); }
+  private:
+    PlanningProfiler& profiler_;
+    const size_t ego_;
+  }; // End class Cycle.
+
+protected:
+
+  mutable ros::NodeHandle nh_;
+  ros::ServiceServer service_;
+
+  /// Used as the name of the ROS logger.
+  std::string name_;
+
+  /// Prefix of the profile files, including the directory.
+  std::string prefix_ = "conformal_lattice_planner";
+
+  mutable std::mutex mutex_;
+
+  /// Number of cycles of the pending (not started) window.
+  int pending_cycles_ = 0;
+  /// Whether the pending window should collect heap profiles.
+  bool pending_heap_ = false;
+  /// Label of the pending window.
+  std::string pending_label_;
+
+  /// Number of cycles of each ego in the active window.
+  int window_cycles_ = 0;
+  /// Number of cycles finished by each ego in the active window.
+  std::map<size_t, int> finished_cycles_;
+  /// Whether the heap profiler is running in the active window.
+  bool heap_active_ = false;
+  /// Whether a window (CPU profiling) is active.
+  bool active_ = false;
+
+  /// Number of windows started so far, used in the default labels.
+  size_t windows_ = 0;
+
+  /// Set by the signal handler, handled at the beginning of the next cycle.
+  static std::atomic<int> signal_;
+
+public:
+
+  /**
+   * \brief Create the profiler and advertise the \c profile_planning service.
+   * \param[in] nh The node handle whose namespace holds the service
+   *               and the \c profile_* parameters.
+   * \param[in] name The name of the ROS logger.
+   */
+  PlanningProfiler(ros::NodeHandle& nh, const std::string& name);
+
+  /// Stops the active window, so that the profiles are flushed.
+  ~PlanningProfiler() { stop(); }
+
+  /// Install the \c SIGUSR1 and \c SIGUSR2 handlers for the process.
+  static void installSignalHandlers();
+
+  /**
+   * \brief Request profiling over the next planning cycles.
+   *
+   * The request replaces the pending request, if any. A request made while
+   * a window is active starts after the active window finishes.
+   *
+   * \param[in] cycles Number of planning cycles to profile.
+   * \param[in] label Label used in the file names. A label is generated
+   *                  from the window index and the current time if empty.
+   * \param[in] heap Whether to collect heap profiles as well.
+   * \return The CPU and heap profile file (prefixes) of the window.
+   */
+  std::pair<std::string, std::string> request(
+      const int cycles, std::string label, const bool heap);
+
+  /// Stop the active window and drop the pending request.
+  void stop();
+
+  /// Whether a profiling window is active.
+  bool active() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return active_;
+  }
+
+  /// Start the pending window, if any, at the beginning of a cycle of the ego.
+  void beginCycle(const size_t ego = 0);
+
+  /// Count a finished cycle of the ego towards the active window.
+  void endCycle(const size_t ego = 0);
+
+protected:
+
+  bool serviceCallback(
+      conformal_lattice_planner::ProfilePlanning::Request& req,
+      conformal_lattice_planner::ProfilePlanning::Response& res);
+
+  /// Handle the request left by the signal handler, if any.
+  void handleSignal();
+
+  /// The CPU and heap profile file (prefixes) with the given label.
+  std::pair<std::string, std::string> files(const std::string& label) const {
+    return std::make_pair(prefix_+"_"+label+".prof", prefix_+"_"+label);
+  }
+
+  /// Stop the profilers of the active window. \c mutex_ should be locked.
+  void stopWindow();
+
+  static void signalHandler(int signal);
+
+}; // End class PlanningProfiler.
+
+} // End namespace node.
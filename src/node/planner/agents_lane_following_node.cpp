@@ -25,6 +25,7 @@
 #include <planner/common/vehicle_speed_planner.h>
 #include <planner/lane_follower/lane_follower.h>
 #include <planner/common/utils.h>
+#include <router/common/waypoint_cache.h>
 #include <node/planner/agents_lane_following_node.h>
 
 using namespace router;
@@ -42,6 +43,17 @@ bool AgentsLaneFollowingNode::initialize() {
   all_param_exist &= nh_.param<std::string>("host", host, "localhost");
   all_param_exist &= nh_.param<int>("port", port, 2000);
 
+  // A negative seed picks a seed from the wall clock.
+  int seed = 0;
+  nh_.param<int>("seed", seed, 0);
+  if (seed < 0) rand_gen_.seed(std::chrono::system_clock::now().time_since_epoch().count());
+  else          rand_gen_.seed(seed);
+
+  // The driver models of the agents by their vehicle classes.
+  agent_models_ = driverModels();
+  if (agent_models_)
+    ROS_INFO_NAMED("agents_planner", "%s", agent_models_->string().c_str());
+
   // Get the world.
   ROS_INFO_NAMED("agents_planner", "connect to the server.");
   client_ = boost::make_shared<CarlaClient>(host, port);
@@ -70,8 +82,6 @@ void AgentsLaneFollowingNode::perturbAgentPolicies(
     current_agents.insert(agent.first);
 
   // Update the policy speed of all agents.
-  const size_t seed = std::chrono::system_clock::now().time_since_epoch().count();
-  std::default_random_engine rand_gen(seed);
 
   for (const size_t agent : current_agents) {
 
@@ -82,7 +92,7 @@ void AgentsLaneFollowingNode::perturbAgentPolicies(
       std::normal_distribution<double> normal_dist(
           sigma_xy/sigma*agent_policy_[agent].second,
           std::sqrt(sigma-sigma_xy*sigma_xy/sigma));
-      noise = normal_dist(rand_gen);
+      noise = normal_dist(rand_gen_);
     }
 
     agent_policy_[agent] =
@@ -113,16 +123,21 @@ void AgentsLaneFollowingNode::manageAgentIdms(
     current_agents.insert(agent.first);
 
   // Generate IDMs for new agents if necessary.
-  const size_t seed = std::chrono::system_clock::now().time_since_epoch().count();
-  std::default_random_engine rand_gen(seed);
   std::uniform_real_distribution<double> headway_noise_dist(-0.2, 0.2);
   std::uniform_real_distribution<double> distance_noise_dist(-1.0, 1.0);
 
   for (const size_t agent : current_agents) {
     if (agent_idm_.count(agent) > 0) continue;
-    agent_idm_[agent] = boost::make_shared<IntelligentDriverModel>(
-        1.0 + headway_noise_dist(rand_gen),
-        6.0 + distance_noise_dist(rand_gen));
+
+    // Perturb the model of the vehicle class of the agent.
+    boost::shared_ptr<IntelligentDriverModel> idm =
+      agent_models_ ?
+      boost::make_shared<IntelligentDriverModel>(*(agent_models_->model(
+            2.0*snapshot->agent(agent).boundingBox().extent.x))) :
+      boost::make_shared<IntelligentDriverModel>();
+    idm->timeGap() += headway_noise_dist(rand_gen_);
+    idm->distanceGap() += distance_noise_dist(rand_gen_);
+    agent_idm_[agent] = idm;
   }
 
   // Remove agents that are no longer in the snapshot.
@@ -164,8 +179,11 @@ void AgentsLaneFollowingNode::executeCallback(
     break;
   }
 
-  boost::shared_ptr<LaneFollower> path_planner =
-    boost::make_shared<LaneFollower>(map_, fast_map_, waypoint, range, router_);
+  if (!path_planner_) {
+    path_planner_ = boost::make_shared<LaneFollower>(map_, fast_map_, waypoint, range, router_);
+  } else {
+    path_planner_->updateWaypointLattice(waypoint, range);
+  }
 
   //// Create speed planner.
   //boost::shared_ptr<VehicleSpeedPlanner> speed_planner =
@@ -177,8 +195,13 @@ void AgentsLaneFollowingNode::executeCallback(
   // Compute the target speed and transform of all agents.
   conformal_lattice_planner::AgentPlanResult result;
 
+  // Agents controlled by the ego planners are left to them.
+  const std::unordered_set<size_t> ego_agents(
+      goal->ego_agents.begin(), goal->ego_agents.end());
+
   for (const auto& item : snapshot->agents()) {
-    const Vehicle& agent = item.second;
+    const ConstVehicleView agent = item.second;
+    if (ego_agents.count(agent.id()) > 0) continue;
 
     double accel = 0.0;
     double movement = 0.0;
@@ -190,7 +213,7 @@ void AgentsLaneFollowingNode::executeCallback(
       boost::shared_ptr<VehicleSpeedPlanner> speed_planner =
         boost::make_shared<VehicleSpeedPlanner>(agent_idm_[agent.id()]);
 
-      const DiscretePath path = path_planner->planPath(agent.id(), *snapshot);
+      const DiscretePath path = path_planner_->planPath(agent.id(), *snapshot);
       accel = speed_planner->planSpeed(agent.id(), *snapshot);
 
       movement = agent.speed()*dt + 0.5*accel*dt*dt;
@@ -207,7 +230,7 @@ void AgentsLaneFollowingNode::executeCallback(
       boost::shared_ptr<CarlaWaypoint> agent_waypoint =
         fast_map_->waypoint(agent.transform());
       std::vector<boost::shared_ptr<CarlaWaypoint>> front_waypoints =
-        agent_waypoint->GetNext(movement);
+        router::WaypointCache::instance().next(agent_waypoint, movement);
       updated_transform = front_waypoints.front()->GetTransform();
     }
 
@@ -241,6 +264,10 @@ void AgentsLaneFollowingNode::executeCallback(
     populateVehicleMsg(updated_agent, result.agents.back());
   }
 
+  // The cache is shared by all the callbacks, report it every 10s at most.
+  ROS_INFO_THROTTLE_NAMED(10.0, "agents_planner", "waypoint cache %s",
+      router::WaypointCache::instance().stats().string().c_str());
+
   // Inform the client the result of plan.
   result.header.stamp = ros::Time::now();
   result.success = true;
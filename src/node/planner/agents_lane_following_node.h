@@ -14,9 +14,11 @@
 
 #pragma once
 
+#include <random>
 #include <unordered_map>
 #include <actionlib/server/simple_action_server.h>
 #include <conformal_lattice_planner/AgentPlanAction.h>
+#include <planner/lane_follower/lane_follower.h>
 #include <node/planner/planning_node.h>
 
 namespace node {
@@ -41,6 +43,19 @@ protected:
   /// Stores the IDMs for different agents.
   std::unordered_map<size_t, boost::shared_ptr<planner::IntelligentDriverModel>> agent_idm_;
 
+  /// The driver models of the vehicle classes, which the IDMs of the
+  /// agents are perturbed from. The default IDM is used if not set.
+  boost::shared_ptr<const planner::DriverModelTable> agent_models_ = nullptr;
+
+  /// The path planner shared by all agents, whose waypoint lattice is shifted
+  /// with the traffic across planning cycles instead of being created at
+  /// every cycle, so that the cached lane center samples are reused.
+  boost::shared_ptr<planner::lane_follower::LaneFollower> path_planner_ = nullptr;
+
+  /// Random number generator for the agent policies and IDMs,
+  /// seeded by the \c seed parameter.
+  std::default_random_engine rand_gen_;
+
   mutable actionlib::SimpleActionServer<
     conformal_lattice_planner::AgentPlanAction> server_;
 
@@ -14,9 +14,10 @@
 
 #include <string>
 #include <chrono>
+#include <vector>
+#include <algorithm>
 #include <unordered_set>
 #include <boost/timer/timer.hpp>
-#include <gperftools/profiler.h>
 
 #include <ros/ros.h>
 #include <ros/console.h>
@@ -34,36 +35,58 @@ bool EgoIDMLatticePlanningNode::initialize() {
 
   // Create the publishers.
   path_pub_ = nh_.advertise<visualization_msgs::Marker>(
-      "ego_path", 1, true);
+      egoName("ego_path", ego_), 1, true);
   conformal_lattice_pub_ = nh_.advertise<visualization_msgs::MarkerArray>(
-      "conformal_lattice", 1, true);
+      egoName("conformal_lattice", ego_), 1, true);
   waypoint_lattice_pub_ = nh_.advertise<visualization_msgs::MarkerArray>(
-      "waypoint_lattice", 1, true);
+      egoName("waypoint_lattice", ego_), 1, true);
 
-  bool all_param_exist = true;
-
-  std::string host = "localhost";
-  int port = 2000;
-  all_param_exist &= nh_.param<std::string>("host", host, "localhost");
-  all_param_exist &= nh_.param<int>("port", port, 2000);
-
-  // Get the world.
-  ROS_INFO_NAMED("ego_planner", "connect to the server.");
-  client_ = boost::make_shared<CarlaClient>(host, port);
-  client_->SetTimeout(std::chrono::seconds(10));
-  world_ = boost::make_shared<CarlaWorld>(client_->GetWorld());
-  ros::Duration(1.0).sleep();
-
-  // Get the world and map.
-  world_ = boost::make_shared<CarlaWorld>(client_->GetWorld());
-  map_ = world_->GetMap();
-  fast_map_ = boost::make_shared<utils::FastWaypointMap>(map_);
+  // Get the world and map, which are shared with other egos in the process.
+  bool all_param_exist = connect();
 
   // Initialize the path and speed planner.
-  boost::shared_ptr<router::LoopRouter> router = boost::make_shared<router::LoopRouter>();
-  path_planner_ = boost::make_shared<planner::IDMLatticePlanner>(0.1, 150.0, router, map_, fast_map_);
+  // In the hierarchical mode, a coarse planner with a long horizon and long
+  // edges selects the lanes at a low rate, within which the path is refined.
+  bool hierarchical_planning = false;
+  nh_.param<bool>("hierarchical_planning", hierarchical_planning, false);
+
+  if (hierarchical_planning) {
+    double coarse_spatial_horizon = 300.0;
+    double coarse_station_spacing = 100.0;
+    int coarse_replan_period = 10;
+    nh_.param<double>("coarse_spatial_horizon", coarse_spatial_horizon, 300.0);
+    nh_.param<double>("coarse_station_spacing", coarse_station_spacing, 100.0);
+    nh_.param<int>("coarse_replan_period", coarse_replan_period, 10);
+
+    boost::shared_ptr<planner::HierarchicalIDMLatticePlanner> hierarchical_planner =
+      boost::make_shared<planner::HierarchicalIDMLatticePlanner>(
+          0.1, 150.0, coarse_spatial_horizon, coarse_station_spacing,
+          std::max(coarse_replan_period, 1), router_, map_, fast_map_);
+    nh_.param<bool>("align_to_coarse_plan", hierarchical_planner->alignToCoarsePlan(), true);
+    path_planner_ = hierarchical_planner;
+  } else {
+    path_planner_ = boost::make_shared<planner::IDMLatticePlanner>(0.1, 150.0, router_, map_, fast_map_);
+  }
+
+  // Edge lengths of the lattice, and the expansion budget (zero for unlimited).
+  path_planner_->edgeLengthPolicy() = edgeLengthPolicy();
+  int max_expansions = 0;
+  nh_.param<int>("max_expansions", max_expansions, 0);
+  path_planner_->maxExpansions() = static_cast<size_t>(std::max(max_expansions, 0));
+  nh_.param<bool>("lazy_lattice", path_planner_->lazyLattice(), false);
+  nh_.param<bool>("frenet_edges", path_planner_->frenetEdges(), false);
+  ROS_INFO_NAMED("ego_planner", "%s", path_planner_->edgeLengthPolicy().string().c_str());
+  path_planner_->planCommitment() = planCommitment();
+
+  // Driver models of the agents in the traffic simulation of the planner.
+  path_planner_->agentModels() = driverModels();
+  if (path_planner_->agentModels())
+    ROS_INFO_NAMED("ego_planner", "%s", path_planner_->agentModels()->string().c_str());
   speed_planner_ = boost::make_shared<planner::VehicleSpeedPlanner>();
 
+  // Profiling is requested at runtime through a service or signals.
+  if (!profiler_) profiler_ = boost::make_shared<PlanningProfiler>(nh_, "ego_planner");
+
   // Start the action server.
   ROS_INFO_NAMED("ego_planner", "start action server.");
   server_.start();
@@ -76,6 +99,7 @@ void EgoIDMLatticePlanningNode::executeCallback(
     const conformal_lattice_planner::EgoPlanGoalConstPtr& goal) {
 
   ROS_INFO_NAMED("ego_planner", "executeCallback()");
+  PlanningProfiler::Cycle profiling_cycle(*profiler_, ego_);
 
   // Update the carla world and map.
   world_ = boost::make_shared<CarlaWorld>(client_->GetWorld());
@@ -88,6 +112,16 @@ void EgoIDMLatticePlanningNode::executeCallback(
   ros::Time start_time = ros::Time::now();
   const DiscretePath ego_path = path_planner_->planPath(snapshot->ego().id(), *snapshot);
   ros::Duration path_planning_time = ros::Time::now() - start_time;
+  ROS_INFO_NAMED("ego_planner", "expanded stations: %lu", path_planner_->expansions());
+  ROS_INFO_NAMED("ego_planner", "lattice construction time: %f", path_planner_->latticeConstructionTime());
+
+  // Reuse of the traffic simulated along the coarse plan.
+  boost::shared_ptr<const planner::HierarchicalIDMLatticePlanner> hierarchical_planner =
+    boost::dynamic_pointer_cast<const planner::HierarchicalIDMLatticePlanner>(path_planner_);
+  if (hierarchical_planner) {
+    ROS_DEBUG_NAMED("ego_planner", "coarse edge hits: %lu misses: %lu",
+        hierarchical_planner->coarseEdgeHits(), hierarchical_planner->coarseEdgeMisses());
+  }
 
   // Publish the station graph.
   //conformal_lattice_pub_.publish(createConformalLatticeMsg(
@@ -139,6 +173,8 @@ void EgoIDMLatticePlanningNode::executeCallback(
   result.success = true;
   result.path_type = ego_path.laneChangeType();
   result.planning_time = path_planning_time.toSec();
+  result.lattice_construction_time = path_planner_->latticeConstructionTime();
+  result.manoeuvre_abandoned = path_planner_->manoeuvreAbandoned();
   populateVehicleMsg(updated_ego, result.ego);
   server_.setSucceeded(result);
 
@@ -156,14 +192,24 @@ int main(int argc, char** argv) {
     ros::console::notifyLoggerLevelsChanged();
   }
 
-  node::EgoIDMLatticePlanningNodePtr planner =
-    boost::make_shared<node::EgoIDMLatticePlanningNode>(nh);
-  if (!planner->initialize()) {
-    ROS_ERROR("Cannot initialize the ego IDM lattice planner.");
+  // One planner is created for each ego served by the process. The planners
+  // share the carla map, router, and waypoint cache, while each of them plans
+  // on the thread of its own action server, i.e. concurrently.
+  int num_egos = 1;
+  nh.param<int>("num_egos", num_egos, 1);
+
+  boost::shared_ptr<node::PlanningProfiler> profiler =
+    boost::make_shared<node::PlanningProfiler>(nh, "ego_planner");
+
+  std::vector<node::EgoIDMLatticePlanningNodePtr> planners;
+  for (int ego = 0; ego < std::max(num_egos, 1); ++ego) {
+    planners.push_back(boost::make_shared<node::EgoIDMLatticePlanningNode>(nh, ego, profiler));
+    if (!planners.back()->initialize()) {
+      ROS_ERROR("Cannot initialize the ego IDM lattice planner %d.", ego);
+    }
   }
 
-  //ProfilerStart("conformal_lattice_planner.stat");
+  node::PlanningProfiler::installSignalHandlers();
   ros::spin();
-  //ProfilerStop();
   return 0;
 }
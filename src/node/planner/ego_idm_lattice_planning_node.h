@@ -21,6 +21,8 @@
 #include <conformal_lattice_planner/EgoPlanAction.h>
 #include <planner/common/vehicle_speed_planner.h>
 #include <planner/idm_lattice_planner/idm_lattice_planner.h>
+#include <planner/idm_lattice_planner/hierarchical_idm_lattice_planner.h>
+#include <node/common/planning_profiler.h>
 #include <node/planner/planning_node.h>
 
 namespace node {
@@ -42,6 +44,9 @@ protected:
   boost::shared_ptr<planner::IDMLatticePlanner> path_planner_ = nullptr;
   boost::shared_ptr<planner::VehicleSpeedPlanner> speed_planner_ = nullptr;
 
+  /// Runtime controlled profiling of the planning cycles.
+  boost::shared_ptr<PlanningProfiler> profiler_ = nullptr;
+
   mutable ros::Publisher path_pub_;
   mutable ros::Publisher conformal_lattice_pub_;
   mutable ros::Publisher waypoint_lattice_pub_;
@@ -51,11 +56,20 @@ protected:
 
 public:
 
-  EgoIDMLatticePlanningNode(ros::NodeHandle& nh) :
-    Base(nh),
+  /**
+   * \param[in] nh The node handle of the planning node.
+   * \param[in] ego The index of the ego to plan for, see \c egoName().
+   * \param[in] profiler The profiler shared by the planning nodes in the
+   *                     process. A profiler is created if not provided.
+   */
+  EgoIDMLatticePlanningNode(ros::NodeHandle& nh,
+                                const size_t ego = 0,
+                                const boost::shared_ptr<PlanningProfiler>& profiler = nullptr) :
+    Base(nh, ego),
+    profiler_(profiler),
     server_(
         nh,
-        "ego_plan",
+        egoName(nh.resolveName("ego_plan"), ego),
         boost::bind(&EgoIDMLatticePlanningNode::executeCallback, this, _1),
         false) {}
 
@@ -14,6 +14,8 @@
 
 #include <string>
 #include <chrono>
+#include <vector>
+#include <algorithm>
 #include <unordered_set>
 
 #include <ros/ros.h>
@@ -35,26 +37,10 @@ namespace node {
 bool EgoLaneFollowingNode::initialize() {
 
   // Create publishers and subscribers.
-  path_pub_ = nh_.advertise<visualization_msgs::Marker>("ego_path", 1, true);
+  path_pub_ = nh_.advertise<visualization_msgs::Marker>(egoName("ego_path", ego_), 1, true);
 
-  // Load parameters.
-  bool all_param_exist = true;
-
-  std::string host = "localhost";
-  int port = 2000;
-  all_param_exist &= nh_.param<std::string>("host", host, "localhost");
-  all_param_exist &= nh_.param<int>("port", port, 2000);
-
-  // Get the world.
-  ROS_INFO_NAMED("ego_planner", "connect to the server.");
-  client_ = boost::make_shared<CarlaClient>(host, port);
-  client_->SetTimeout(std::chrono::seconds(10));
-  client_->GetWorld();
-
-  // Create world and map.
-  world_ = boost::make_shared<CarlaWorld>(client_->GetWorld());
-  map_ = world_->GetMap();
-  fast_map_ = boost::make_shared<utils::FastWaypointMap>(map_);
+  // Get the world and map, which are shared with other egos in the process.
+  bool all_param_exist = connect();
 
   // Start the action server.
   ROS_INFO_NAMED("ego_planner", "start action server.");
@@ -81,12 +67,15 @@ void EgoLaneFollowingNode::executeCallback(
 
   // Plan path.
   // The range of the lattice is just enough for the ego vehicle.
-  boost::shared_ptr<LaneFollower> path_planner =
-    boost::make_shared<LaneFollower>(
-      map_, fast_map_, carlaVehicleWaypoint(snapshot->ego().id()), 55.0, router_);
+  if (!path_planner_) {
+    path_planner_ = boost::make_shared<LaneFollower>(
+        map_, fast_map_, ego_waypoint, 55.0, router_);
+  } else {
+    path_planner_->updateWaypointLattice(ego_waypoint, 55.0);
+  }
 
   const DiscretePath ego_path =
-    path_planner->planPath(snapshot->ego().id(), *snapshot);
+    path_planner_->planPath(snapshot->ego().id(), *snapshot);
 
   // Plan speed.
   boost::shared_ptr<VehicleSpeedPlanner> speed_planner =
@@ -153,10 +142,18 @@ int main(int argc, char** argv) {
     ros::console::notifyLoggerLevelsChanged();
   }
 
-  node::EgoLaneFollowingNodePtr planner =
-    boost::make_shared<node::EgoLaneFollowingNode>(nh);
-  if (!planner->initialize()) {
-    ROS_ERROR("Cannot initialize the ego lane following planner.");
+  // One planner is created for each ego served by the process. The planners
+  // share the carla map, router, and waypoint cache, while each of them plans
+  // on the thread of its own action server, i.e. concurrently.
+  int num_egos = 1;
+  nh.param<int>("num_egos", num_egos, 1);
+
+  std::vector<node::EgoLaneFollowingNodePtr> planners;
+  for (int ego = 0; ego < std::max(num_egos, 1); ++ego) {
+    planners.push_back(boost::make_shared<node::EgoLaneFollowingNode>(nh, ego));
+    if (!planners.back()->initialize()) {
+      ROS_ERROR("Cannot initialize the ego lane following planner %d.", ego);
+    }
   }
 
   ros::spin();
@@ -16,6 +16,7 @@
 
 #include <actionlib/server/simple_action_server.h>
 #include <conformal_lattice_planner/EgoPlanAction.h>
+#include <planner/lane_follower/lane_follower.h>
 #include <node/planner/planning_node.h>
 
 namespace node {
@@ -34,15 +35,22 @@ public:
 
 protected:
 
+  /// The path planner, whose waypoint lattice is shifted with the ego
+  /// across planning cycles instead of being created at every cycle.
+  boost::shared_ptr<planner::lane_follower::LaneFollower> path_planner_ = nullptr;
+
   mutable ros::Publisher path_pub_;
   mutable actionlib::SimpleActionServer<
     conformal_lattice_planner::EgoPlanAction> server_;
 
 public:
 
-  EgoLaneFollowingNode(ros::NodeHandle& nh) :
-    Base(nh),
-    server_(nh, "ego_plan", boost::bind(&EgoLaneFollowingNode::executeCallback, this, _1), false) {}
+  EgoLaneFollowingNode(ros::NodeHandle& nh, const size_t ego = 0) :
+    Base(nh, ego),
+    server_(nh,
+            egoName(nh.resolveName("ego_plan"), ego),
+            boost::bind(&EgoLaneFollowingNode::executeCallback, this, _1),
+            false) {}
 
   virtual ~EgoLaneFollowingNode() {}
 
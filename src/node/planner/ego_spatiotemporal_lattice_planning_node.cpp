@@ -14,9 +14,10 @@
 
 #include <string>
 #include <chrono>
+#include <vector>
+#include <algorithm>
 #include <unordered_set>
 #include <boost/timer/timer.hpp>
-#include <gperftools/profiler.h>
 
 #include <ros/ros.h>
 #include <ros/console.h>
@@ -34,34 +35,54 @@ bool EgoSpatiotemporalLatticePlanningNode::initialize() {
 
   // Create the publishers.
   path_pub_ = nh_.advertise<visualization_msgs::Marker>(
-      "ego_path", 1, true);
+      egoName("ego_path", ego_), 1, true);
   conformal_lattice_pub_ = nh_.advertise<visualization_msgs::MarkerArray>(
-      "conformal_lattice", 1, true);
+      egoName("conformal_lattice", ego_), 1, true);
   waypoint_lattice_pub_ = nh_.advertise<visualization_msgs::MarkerArray>(
-      "waypoint_lattice", 1, true);
+      egoName("waypoint_lattice", ego_), 1, true);
 
-  bool all_param_exist = true;
-
-  std::string host = "localhost";
-  int port = 2000;
-  all_param_exist &= nh_.param<std::string>("host", host, "localhost");
-  all_param_exist &= nh_.param<int>("port", port, 2000);
-
-  // Get the world.
-  ROS_INFO_NAMED("ego_planner", "connect to the server.");
-  client_ = boost::make_shared<CarlaClient>(host, port);
-  client_->SetTimeout(std::chrono::seconds(10));
-  world_ = boost::make_shared<CarlaWorld>(client_->GetWorld());
-  ros::Duration(1.0).sleep();
-
-  // Get the world and map.
-  world_ = boost::make_shared<CarlaWorld>(client_->GetWorld());
-  map_ = world_->GetMap();
-  fast_map_ = boost::make_shared<utils::FastWaypointMap>(map_);
+  // Get the world and map, which are shared with other egos in the process.
+  bool all_param_exist = connect();
 
   // Initialize the path and speed planner.
-  boost::shared_ptr<router::LoopRouter> router = boost::make_shared<router::LoopRouter>();
-  traj_planner_ = boost::make_shared<planner::SpatiotemporalLatticePlanner>(0.1, 150.0, router, map_, fast_map_);
+  // The boundaries of the speed bins at each station (m/s).
+  std::vector<double> speed_bin_boundaries =
+    planner::spatiotemporal_lattice_planner::Vertex::defaultSpeedBins()->boundaries();
+  nh_.param<std::vector<double>>("speed_bins", speed_bin_boundaries, speed_bin_boundaries);
+  boost::shared_ptr<const utils::Bins> speed_bins =
+    boost::make_shared<const utils::Bins>(speed_bin_boundaries);
+  ROS_INFO_NAMED("ego_planner", "speed bins: %s", speed_bins->string().c_str());
+
+  // The boundaries of the arrival time bins at each station (s).
+  // The last boundary is the temporal planning horizon.
+  std::vector<double> time_bin_boundaries =
+    planner::spatiotemporal_lattice_planner::Vertex::defaultTimeBins()->boundaries();
+  nh_.param<std::vector<double>>("time_bins", time_bin_boundaries, time_bin_boundaries);
+  boost::shared_ptr<const utils::Bins> time_bins =
+    boost::make_shared<const utils::Bins>(time_bin_boundaries);
+  ROS_INFO_NAMED("ego_planner", "time bins: %s", time_bins->string().c_str());
+
+  traj_planner_ = boost::make_shared<planner::SpatiotemporalLatticePlanner>(
+      0.1, 150.0, router_, map_, fast_map_, speed_bins, time_bins);
+
+  // Wall-clock time budget of the planner (s), non-positive for unlimited.
+  nh_.param<double>("planning_time_budget", traj_planner_->timeBudget(), 0.5);
+
+  // Edge lengths of the lattice, and the expansion budget (zero for unlimited).
+  traj_planner_->edgeLengthPolicy() = edgeLengthPolicy();
+  int max_expansions = 0;
+  nh_.param<int>("max_expansions", max_expansions, 0);
+  traj_planner_->maxExpansions() = static_cast<size_t>(std::max(max_expansions, 0));
+  nh_.param<bool>("lazy_lattice", traj_planner_->lazyLattice(), false);
+  ROS_INFO_NAMED("ego_planner", "%s", traj_planner_->edgeLengthPolicy().string().c_str());
+
+  // Driver models of the agents in the traffic simulation of the planner.
+  traj_planner_->agentModels() = driverModels();
+  if (traj_planner_->agentModels())
+    ROS_INFO_NAMED("ego_planner", "%s", traj_planner_->agentModels()->string().c_str());
+
+  // Profiling is requested at runtime through a service or signals.
+  if (!profiler_) profiler_ = boost::make_shared<PlanningProfiler>(nh_, "ego_planner");
 
   // Start the action server.
   ROS_INFO_NAMED("ego_planner", "start action server.");
@@ -75,6 +96,7 @@ void EgoSpatiotemporalLatticePlanningNode::executeCallback(
     const conformal_lattice_planner::EgoPlanGoalConstPtr& goal) {
 
   ROS_INFO_NAMED("ego_planner", "executeCallback()");
+  PlanningProfiler::Cycle profiling_cycle(*profiler_, ego_);
 
   // Update the carla world and map.
   world_ = boost::make_shared<CarlaWorld>(client_->GetWorld());
@@ -88,6 +110,9 @@ void EgoSpatiotemporalLatticePlanningNode::executeCallback(
   const std::list<std::pair<ContinuousPath, double>> ego_traj =
     traj_planner_->planTraj(snapshot->ego().id(), *snapshot);
   ros::Duration traj_planning_time = ros::Time::now() - start_time;
+  ROS_INFO_NAMED("ego_planner", "lattice construction time: %f", traj_planner_->latticeConstructionTime());
+  ROS_DEBUG_NAMED("ego_planner", "vertex pruning %s",
+      traj_planner_->pruningStats().string().c_str());
 
   DiscretePath ego_path(ego_traj.front().first);
   for (auto iter = ++(ego_traj.begin()); iter!=ego_traj.end(); ++iter)
@@ -143,6 +168,7 @@ void EgoSpatiotemporalLatticePlanningNode::executeCallback(
   result.success = true;
   result.path_type = ego_path.laneChangeType();
   result.planning_time = traj_planning_time.toSec();
+  result.lattice_construction_time = traj_planner_->latticeConstructionTime();
   populateVehicleMsg(updated_ego, result.ego);
   server_.setSucceeded(result);
 
@@ -160,14 +186,24 @@ int main(int argc, char** argv) {
     ros::console::notifyLoggerLevelsChanged();
   }
 
-  node::EgoSpatiotemporalLatticePlanningNodePtr planner =
-    boost::make_shared<node::EgoSpatiotemporalLatticePlanningNode>(nh);
-  if (!planner->initialize()) {
-    ROS_ERROR("Cannot initialize the ego IDM lattice planner.");
+  // One planner is created for each ego served by the process. The planners
+  // share the carla map, router, and waypoint cache, while each of them plans
+  // on the thread of its own action server, i.e. concurrently.
+  int num_egos = 1;
+  nh.param<int>("num_egos", num_egos, 1);
+
+  boost::shared_ptr<node::PlanningProfiler> profiler =
+    boost::make_shared<node::PlanningProfiler>(nh, "ego_planner");
+
+  std::vector<node::EgoSpatiotemporalLatticePlanningNodePtr> planners;
+  for (int ego = 0; ego < std::max(num_egos, 1); ++ego) {
+    planners.push_back(boost::make_shared<node::EgoSpatiotemporalLatticePlanningNode>(nh, ego, profiler));
+    if (!planners.back()->initialize()) {
+      ROS_ERROR("Cannot initialize the ego IDM lattice planner %d.", ego);
+    }
   }
 
-  //ProfilerStart("conformal_lattice_planner.stat");
+  node::PlanningProfiler::installSignalHandlers();
   ros::spin();
-  //ProfilerStop();
   return 0;
 }
@@ -21,6 +21,7 @@
 #include <conformal_lattice_planner/EgoPlanAction.h>
 #include <planner/common/vehicle_speed_planner.h>
 #include <planner/spatiotemporal_lattice_planner/spatiotemporal_lattice_planner.h>
+#include <node/common/planning_profiler.h>
 #include <node/planner/planning_node.h>
 
 namespace node {
@@ -41,6 +42,9 @@ protected:
 
   boost::shared_ptr<planner::SpatiotemporalLatticePlanner> traj_planner_ = nullptr;
 
+  /// Runtime controlled profiling of the planning cycles.
+  boost::shared_ptr<PlanningProfiler> profiler_ = nullptr;
+
   mutable ros::Publisher path_pub_;
   mutable ros::Publisher conformal_lattice_pub_;
   mutable ros::Publisher waypoint_lattice_pub_;
@@ -50,11 +54,20 @@ protected:
 
 public:
 
-  EgoSpatiotemporalLatticePlanningNode(ros::NodeHandle& nh) :
-    Base(nh),
+  /**
+   * \param[in] nh The node handle of the planning node.
+   * \param[in] ego The index of the ego to plan for, see \c egoName().
+   * \param[in] profiler The profiler shared by the planning nodes in the
+   *                     process. A profiler is created if not provided.
+   */
+  EgoSpatiotemporalLatticePlanningNode(ros::NodeHandle& nh,
+                                           const size_t ego = 0,
+                                           const boost::shared_ptr<PlanningProfiler>& profiler = nullptr) :
+    Base(nh, ego),
+    profiler_(profiler),
     server_(
         nh,
-        "ego_plan",
+        egoName(nh.resolveName("ego_plan"), ego),
         boost::bind(&EgoSpatiotemporalLatticePlanningNode::executeCallback, this, _1),
         false) {}
 
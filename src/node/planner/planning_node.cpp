@@ -12,6 +12,11 @@
  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <limits>
+
 #include <tf2/LinearMath/Quaternion.h>
 #include <tf2/LinearMath/Matrix3x3.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
@@ -20,6 +25,124 @@
 
 namespace node {
 
+namespace {
+
+/// The carla objects and the router shared by the planning nodes in a process.
+struct SharedResources {
+  boost::shared_ptr<carla::client::Client> client = nullptr;
+  boost::shared_ptr<carla::client::Map> map = nullptr;
+  boost::shared_ptr<utils::FastWaypointMap> fast_map = nullptr;
+  boost::shared_ptr<router::LoopRouter> router = nullptr;
+};
+
+std::mutex shared_resources_mutex;
+SharedResources shared_resources;
+
+} // End anonymous namespace.
+
+bool PlanningNode::connect() {
+
+  bool all_param_exist = true;
+
+  std::string host = "localhost";
+  int port = 2000;
+  all_param_exist &= nh_.param<std::string>("host", host, "localhost");
+  all_param_exist &= nh_.param<int>("port", port, 2000);
+
+  std::lock_guard<std::mutex> lock(shared_resources_mutex);
+
+  if (!shared_resources.client) {
+    ROS_INFO_NAMED("planning_node", "connect to the server.");
+    shared_resources.client = boost::make_shared<CarlaClient>(host, port);
+    shared_resources.client->SetTimeout(std::chrono::seconds(10));
+    shared_resources.client->GetWorld();
+    ros::Duration(1.0).sleep();
+
+    shared_resources.map = shared_resources.client->GetWorld().GetMap();
+    shared_resources.fast_map =
+      boost::make_shared<utils::FastWaypointMap>(shared_resources.map);
+    shared_resources.router = boost::make_shared<router::LoopRouter>();
+  }
+
+  client_   = shared_resources.client;
+  world_    = boost::make_shared<CarlaWorld>(client_->GetWorld());
+  map_      = shared_resources.map;
+  fast_map_ = shared_resources.fast_map;
+  router_   = shared_resources.router;
+
+  return all_param_exist;
+}
+
+planner::EdgeLengthPolicy PlanningNode::edgeLengthPolicy() const {
+
+  std::vector<double> lengths {50.0};
+  double near_range = 100.0;
+  double travel_time = 3.0;
+  double alignment = 0.0;
+  nh_.param<std::vector<double>>("edge_lengths", lengths, std::vector<double>{50.0});
+  nh_.param<double>("edge_near_range", near_range, 100.0);
+  nh_.param<double>("edge_travel_time", travel_time, 3.0);
+  nh_.param<double>("edge_alignment", alignment, 0.0);
+
+  return planner::EdgeLengthPolicy(lengths, near_range, travel_time, alignment);
+}
+
+planner::PlanCommitment PlanningNode::planCommitment() const {
+  double hysteresis = 0.0;
+  nh_.param<double>("commitment_hysteresis", hysteresis, 0.0);
+  return planner::PlanCommitment(std::max(hysteresis, 0.0));
+}
+
+boost::shared_ptr<const planner::DriverModelTable> PlanningNode::driverModels() const {
+
+  XmlRpc::XmlRpcValue classes;
+  if (!nh_.getParam("driver_models", classes)) return nullptr;
+  if (classes.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+    throw std::runtime_error(
+        "PlanningNode::driverModels(): "
+        "driver_models should be a list of vehicle classes.\n");
+  }
+
+  // Numbers on the parameter server can be either integers or doubles.
+  auto number = [](XmlRpc::XmlRpcValue& vehicle_class,
+                   const std::string& key)->boost::optional<double>{
+    if (!vehicle_class.hasMember(key)) return boost::none;
+    XmlRpc::XmlRpcValue& value = vehicle_class[key];
+    if (value.getType() == XmlRpc::XmlRpcValue::TypeInt)
+      return static_cast<double>(static_cast<int&>(value));
+    if (value.getType() == XmlRpc::XmlRpcValue::TypeDouble)
+      return static_cast<double&>(value);
+    throw std::runtime_error(
+        "PlanningNode::driverModels(): "
+        "driver model parameter " + key + " is not a number.\n");
+  };
+
+  boost::shared_ptr<planner::DriverModelTable> table =
+    boost::make_shared<planner::DriverModelTable>();
+
+  for (int i = 0; i < classes.size(); ++i) {
+    XmlRpc::XmlRpcValue& vehicle_class = classes[i];
+    const std::string name = vehicle_class.hasMember("name") ?
+      static_cast<std::string&>(vehicle_class["name"]) :
+      (boost::format("class_%1%") % i).str();
+    const boost::optional<double> max_length = number(vehicle_class, "max_length");
+
+    table->add(name,
+               max_length ? *max_length : std::numeric_limits<double>::infinity(),
+               boost::make_shared<const planner::IntelligentDriverModel>(
+                 number(vehicle_class, "time_gap"),
+                 number(vehicle_class, "distance_gap"),
+                 number(vehicle_class, "accel_exp"),
+                 number(vehicle_class, "comfort_accel"),
+                 number(vehicle_class, "comfort_decel"),
+                 number(vehicle_class, "max_accel"),
+                 number(vehicle_class, "max_decel"),
+                 number(vehicle_class, "coolness_factor")));
+  }
+
+  return table;
+}
+
 boost::shared_ptr<planner::Snapshot> PlanningNode::createSnapshot(
     const conformal_lattice_planner::TrafficSnapshot& snapshot_msg) {
 
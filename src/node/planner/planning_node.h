@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <string>
 #include <utility>
 #include <unordered_map>
 
@@ -32,8 +33,12 @@
 #include <ros/ros.h>
 #include <router/loop_router/loop_router.h>
 #include <planner/common/snapshot.h>
+#include <planner/common/edge_length_policy.h>
+#include <planner/common/plan_commitment.h>
+#include <planner/common/driver_model_table.h>
 #include <planner/common/utils.h>
 #include <planner/common/fast_waypoint_map.h>
+#include <node/common/multi_ego.h>
 #include <conformal_lattice_planner/TrafficSnapshot.h>
 
 namespace node {
@@ -58,12 +63,16 @@ protected:
   boost::shared_ptr<CarlaWorld> world_   = nullptr;
   boost::shared_ptr<CarlaMap> map_       = nullptr;
 
+  /// Index of the ego served by this object, if there are several
+  /// planner-controlled vehicles in the simulation. See \c egoName().
+  size_t ego_ = 0;
+
   mutable ros::NodeHandle nh_;
 
 public:
 
-  PlanningNode(ros::NodeHandle& nh) :
-    router_(boost::make_shared<router::LoopRouter>()), nh_(nh) {}
+  PlanningNode(ros::NodeHandle& nh, const size_t ego = 0) :
+    router_(boost::make_shared<router::LoopRouter>()), ego_(ego), nh_(nh) {}
 
   virtual ~PlanningNode() {}
 
@@ -71,6 +80,53 @@ public:
 
 protected:
 
+  /**
+   * \brief Connect to the carla server given by the \c host and \c port
+   *        parameters, and set up the world, map, fast waypoint map, and router.
+   *
+   * Several planning nodes may be hosted in the same process, one for each
+   * ego. The carla client, map, fast waypoint map, and router are created
+   * by the first node that connects, and shared by all nodes in the process
+   * afterwards. Together with the process-wide \c router::WaypointCache,
+   * the map queries are therefore cached once for all egos. The shared
+   * objects support concurrent queries, so that the nodes may plan in
+   * parallel on their action server threads.
+   *
+   * \return false If any of the parameters does not exist.
+   */
+  bool connect();
+
+  /**
+   * \brief Create the policy selecting the edge lengths of the lattice planners
+   *        from the \c edge_lengths, \c edge_near_range, \c edge_travel_time,
+   *        and \c edge_alignment parameters.
+   *
+   * The default policy uses 50m edges everywhere.
+   */
+  planner::EdgeLengthPolicy edgeLengthPolicy() const;
+
+  /**
+   * \brief Create the commitment of the lattice planners to the selected
+   *        manoeuvre from the \c commitment_hysteresis parameter.
+   *
+   * The default zero hysteresis always selects the cheapest plan.
+   */
+  planner::PlanCommitment planCommitment() const;
+
+  /**
+   * \brief Create the driver models of the vehicle classes from the
+   *        \c driver_models parameter.
+   *
+   * The parameter is a list of vehicle classes, each with the \c name,
+   * \c max_length, and the parameters of the intelligent driver model,
+   * e.g. written by \c scripts/calibrate_driver_models.py. Missing model
+   * parameters take the default values, and a class without \c max_length
+   * covers all longer vehicles.
+   *
+   * \return \c nullptr if the parameter is not set.
+   */
+  boost::shared_ptr<const planner::DriverModelTable> driverModels() const;
+
   virtual boost::shared_ptr<planner::Snapshot> createSnapshot(
       const conformal_lattice_planner::TrafficSnapshot& snapshot_msg);
 
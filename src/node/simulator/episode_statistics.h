@@ -0,0 +1,266 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <boost/format.hpp>
+
+namespace node {
+
+/// The p-th percentile (p in [0, 100]) of the values, nearest rank.
+inline double percentile(std::vector<double> values, const double p) {
+  if (values.empty()) return 0.0;
+  const double rank = std::ceil(p/100.0*values.size());
+  const size_t n = std::min(static_cast<size_t>(std::max(rank, 1.0)), values.size()) - 1;
+  std::nth_element(values.begin(), values.begin()+n, values.end());
+  return values[n];
+}
+
+/// The mean of the values.
+inline double mean(const std::vector<double>& values) {
+  if (values.empty()) return 0.0;
+  double sum = 0.0;
+  for (const double v : values) sum += v;
+  return sum / values.size();
+}
+
+/**
+ * \brief EpisodeStatistics accumulates the summary of an episode from the
+ *        results returned by the ego planner.
+ *
+ * The summary is serialized as a JSON object, which ends up in the episode
+ * result file and the experiment results database, so that the episodes can
+ * be compared without re-parsing the bags.
+ */
+class EpisodeStatistics {
+
+protected:
+
+  /// Deceleration (m/s^2, positive) beyond which the ego is braking hard.
+  double hard_braking_deceleration_ = 3.0;
+
+  /// Number of ego plans.
+  size_t plans_ = 0;
+
+  /// Accumulated ego speed and squared speed.
+  double speed_sum_ = 0.0;
+  double speed_squared_sum_ = 0.0;
+  double min_speed_ = std::numeric_limits<double>::infinity();
+  double max_speed_ = 0.0;
+
+  /// Accumulated ego acceleration.
+  double acceleration_sum_ = 0.0;
+
+  /// Number of plans for each path type, i.e. keep lane,
+  /// left lane change, right lane change, and unknown.
+  std::vector<size_t> path_types_ = std::vector<size_t>(4, 0);
+
+  /// Number of lane change manuevers, i.e. switches into lane change paths.
+  size_t lane_changes_ = 0;
+  size_t last_path_type_ = 0;
+
+  /// Number of lane changes abandoned by the planner before being completed.
+  size_t abandoned_manoeuvres_ = 0;
+
+  /// Number of hard braking events, consecutive hard braking plans
+  /// are counted as one event.
+  size_t braking_events_ = 0;
+  bool braking_ = false;
+
+  /// Number of collisions reported by the simulator.
+  size_t collisions_ = 0;
+
+  /// Planning time of all plans (s).
+  std::vector<double> planning_times_;
+
+  /// Accumulated time spent on constructing the waypoint lattice (s),
+  /// which is included in the planning time.
+  double lattice_construction_time_sum_ = 0.0;
+
+public:
+
+  EpisodeStatistics() = default;
+
+  EpisodeStatistics(const double hard_braking_deceleration) :
+    hard_braking_deceleration_(hard_braking_deceleration) {}
+
+  /// Add the result of an ego plan.
+  void addPlan(const double speed,
+               const double acceleration,
+               const int path_type,
+               const double planning_time,
+               const bool manoeuvre_abandoned = false,
+               const double lattice_construction_time = 0.0) {
+    ++plans_;
+
+    speed_sum_ += speed;
+    speed_squared_sum_ += speed * speed;
+    min_speed_ = std::min(min_speed_, speed);
+    max_speed_ = std::max(max_speed_, speed);
+    acceleration_sum_ += acceleration;
+
+    const size_t type = path_type>=0 && path_type<3 ? path_type : 3;
+    ++path_types_[type];
+    if ((type==1 || type==2) && type!=last_path_type_) ++lane_changes_;
+    last_path_type_ = type;
+    if (manoeuvre_abandoned) ++abandoned_manoeuvres_;
+
+    const bool braking = acceleration < -hard_braking_deceleration_;
+    if (braking && !braking_) ++braking_events_;
+    braking_ = braking;
+
+    planning_times_.push_back(planning_time);
+    lattice_construction_time_sum_ += lattice_construction_time;
+    return;
+  }
+
+  /// Add a collision.
+  void addCollision() { ++collisions_; }
+
+  const size_t plans() const { return plans_; }
+  const size_t collisions() const { return collisions_; }
+  const size_t brakingEvents() const { return braking_events_; }
+  const size_t laneChanges() const { return lane_changes_; }
+  const size_t abandonedManoeuvres() const { return abandoned_manoeuvres_; }
+
+  const double meanSpeed() const {
+    return plans_ > 0 ? speed_sum_/plans_ : 0.0;
+  }
+
+  const double speedStd() const {
+    if (plans_ == 0) return 0.0;
+    const double mean = meanSpeed();
+    return std::sqrt(std::max(speed_squared_sum_/plans_-mean*mean, 0.0));
+  }
+
+  /// The p-th percentile (p in [0, 100]) of the planning time, nearest rank.
+  const double planningTimePercentile(const double p) const {
+    return percentile(planning_times_, p);
+  }
+
+  const double meanPlanningTime() const { return mean(planning_times_); }
+
+  const double meanLatticeConstructionTime() const {
+    return plans_ > 0 ? lattice_construction_time_sum_/plans_ : 0.0;
+  }
+
+  /// Members of a JSON object (without the braces) summarizing the episode.
+  std::string json() const {
+    boost::format format(
+        "\"ego_plans\": %1%, "
+        "\"mean_speed\": %2%, \"speed_std\": %3%, "
+        "\"min_speed\": %4%, \"max_speed\": %5%, "
+        "\"mean_acceleration\": %6%, "
+        "\"keep_lane_plans\": %7%, \"left_lane_change_plans\": %8%, "
+        "\"right_lane_change_plans\": %9%, \"unknown_path_plans\": %10%, "
+        "\"lane_changes\": %11%, "
+        "\"mean_ego_planning_time\": %12%, \"p50_ego_planning_time\": %13%, "
+        "\"p90_ego_planning_time\": %14%, \"p99_ego_planning_time\": %15%, "
+        "\"max_ego_planning_time\": %16%, "
+        "\"braking_events\": %17%, \"collisions\": %18%, "
+        "\"abandoned_manoeuvres\": %19%, "
+        "\"mean_lattice_construction_time\": %20%");
+    return (format
+        % plans_
+        % meanSpeed() % speedStd()
+        % (plans_>0 ? min_speed_ : 0.0) % max_speed_
+        % (plans_>0 ? acceleration_sum_/plans_ : 0.0)
+        % path_types_[0] % path_types_[1] % path_types_[2] % path_types_[3]
+        % lane_changes_
+        % meanPlanningTime() % planningTimePercentile(50.0)
+        % planningTimePercentile(90.0) % planningTimePercentile(99.0)
+        % planningTimePercentile(100.0)
+        % braking_events_ % collisions_
+        % abandoned_manoeuvres_
+        % meanLatticeConstructionTime()).str();
+  }
+
+}; // End class EpisodeStatistics.
+
+/**
+ * \brief EgoPlanningLatency records the latencies of the plans of one ego,
+ *        if there are several planner-controlled vehicles in the simulation.
+ *
+ * Two latencies are recorded for each plan, the planning time reported by
+ * the planner, and the response time from sending the goal to receiving
+ * the result in the simulator. Since the goals of all egos are sent at
+ * the same time, the difference of the two reveals the queueing and
+ * contention among the planners sharing the host.
+ */
+class EgoPlanningLatency {
+
+protected:
+
+  /// ID of the ego vehicle.
+  size_t id_ = 0;
+
+  /// Name of the action serving the ego.
+  std::string action_;
+
+  /// Planning time of all plans (s).
+  std::vector<double> planning_times_;
+
+  /// Response time of all plans (s).
+  std::vector<double> response_times_;
+
+public:
+
+  EgoPlanningLatency() = default;
+
+  EgoPlanningLatency(const size_t id, const std::string& action) :
+    id_(id), action_(action) {}
+
+  /// Add the latencies of a plan.
+  void addPlan(const double planning_time, const double response_time) {
+    planning_times_.push_back(planning_time);
+    response_times_.push_back(response_time);
+    return;
+  }
+
+  const size_t id() const { return id_; }
+  const std::string& action() const { return action_; }
+  const size_t plans() const { return planning_times_.size(); }
+
+  const std::vector<double>& planningTimes() const { return planning_times_; }
+  const std::vector<double>& responseTimes() const { return response_times_; }
+
+  /// A JSON object summarizing the latencies.
+  std::string json() const {
+    boost::format format(
+        "{\"id\": %1%, \"action\": \"%2%\", \"plans\": %3%, "
+        "\"mean_planning_time\": %4%, \"p50_planning_time\": %5%, "
+        "\"p90_planning_time\": %6%, \"p99_planning_time\": %7%, "
+        "\"max_planning_time\": %8%, "
+        "\"mean_response_time\": %9%, \"p50_response_time\": %10%, "
+        "\"p90_response_time\": %11%, \"p99_response_time\": %12%, "
+        "\"max_response_time\": %13%}");
+    return (format
+        % id_ % action_ % plans()
+        % mean(planning_times_)
+        % percentile(planning_times_, 50.0) % percentile(planning_times_, 90.0)
+        % percentile(planning_times_, 99.0) % percentile(planning_times_, 100.0)
+        % mean(response_times_)
+        % percentile(response_times_, 50.0) % percentile(response_times_, 90.0)
+        % percentile(response_times_, 99.0) % percentile(response_times_, 100.0)).str();
+  }
+
+}; // End class EgoPlanningLatency.
+
+} // End namespace node.
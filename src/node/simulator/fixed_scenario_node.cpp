@@ -141,10 +141,17 @@ int main(int argc, char** argv) {
 
   node::FixedScenarioNodePtr sim =
     boost::make_shared<node::FixedScenarioNode>(nh);
-  if (!sim->initialize()) {
-    ROS_ERROR("Cannot initialize the CARLA simulator.");
+
+  // Record the crash in the episode result before bailing out.
+  try {
+    if (!sim->initialize()) {
+      ROS_ERROR("Cannot initialize the CARLA simulator.");
+    }
+    ros::spin();
+  } catch (const std::exception& e) {
+    sim->writeResult("crashed", e.what());
+    throw;
   }
 
-  ros::spin();
   return 0;
 }
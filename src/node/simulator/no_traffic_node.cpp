@@ -94,6 +94,7 @@ bool NoTrafficNode::initialize() {
   // Initialize the ego vehicle.
   ROS_INFO_NAMED("carla_simulator", "spawn the vehicles.");
   spawnVehicles();
+  assignEgoPlanners();
 
   // Publish the ego vehicle marker.
   ROS_INFO_NAMED("carla_simulator", "publish ego and agents.");
@@ -101,7 +102,7 @@ bool NoTrafficNode::initialize() {
 
   // Wait for the planner servers.
   ROS_INFO_NAMED("carla_simulator", "waiting for action servers.");
-  ego_client_.waitForServer(ros::Duration(2.0));
+  waitForEgoPlanners(ros::Duration(2.0));
   //agents_client_.waitForServer(ros::Duration(5.0));
 
   // Send out the first goal of ego.
@@ -184,10 +185,17 @@ int main(int argc, char** argv) {
 
   node::NoTrafficNodePtr sim =
     boost::make_shared<node::NoTrafficNode>(nh);
-  if (!sim->initialize()) {
-    ROS_ERROR("Cannot initialize the CARLA simulator.");
+
+  // Record the crash in the episode result before bailing out.
+  try {
+    if (!sim->initialize()) {
+      ROS_ERROR("Cannot initialize the CARLA simulator.");
+    }
+    ros::spin();
+  } catch (const std::exception& e) {
+    sim->writeResult("crashed", e.what());
+    throw;
   }
 
-  ros::spin();
   return 0;
 }
@@ -17,6 +17,7 @@
 #include <limits>
 #include <random>
 #include <chrono>
+#include <algorithm>
 #include <unordered_set>
 #include <boost/timer/timer.hpp>
 #include <boost/format.hpp>
@@ -62,7 +63,7 @@ void RandomTrafficNode::spawnVehicles() {
 
   // Initialize the traffic manager.
   traffic_manager_ = boost::make_shared<TrafficManager>(
-      start_waypoint, 150.0, loop_router_, map_, fast_map_);
+      start_waypoint, 150.0, loop_router_, map_, fast_map_, seed_);
 
   // Spawn the ego vehicle.
   // The ego vehicle is at 50m on the lattice, and there is an 100m buffer
@@ -162,8 +163,6 @@ boost::optional<size_t> RandomTrafficNode::spawnEgoVehicle(
   world_->Tick();
 
   // Set the ego vehicle policy.
-  const size_t seed = std::chrono::system_clock::now().time_since_epoch().count();
-  std::default_random_engine rand_gen(seed);
   std::uniform_real_distribution<double> uni_real_dist(-4.0, 4.0);
 
   populateVehicleObj(vehicle, ego_);
@@ -172,8 +171,8 @@ boost::optional<size_t> RandomTrafficNode::spawnEgoVehicle(
   ego_.policySpeed() = policy_speed;
 
   if (noisy_speed) {
-    ego_.speed() += uni_real_dist(rand_gen);
-    ego_.policySpeed() += uni_real_dist(rand_gen);
+    ego_.speed() += uni_real_dist(rand_gen_);
+    ego_.policySpeed() += uni_real_dist(rand_gen_);
   }
 
   return vehicle->GetId();
@@ -188,7 +187,8 @@ boost::optional<size_t> RandomTrafficNode::spawnAgentVehicle(
   // vehicle blueprint library.
   boost::shared_ptr<CarlaBlueprintLibrary> blueprint_library =
     world_->GetBlueprintLibrary()->Filter("vehicle");
-  auto blueprint = (*blueprint_library)[std::rand() % blueprint_library->size()];
+  std::uniform_int_distribution<size_t> blueprint_dist(0, blueprint_library->size()-1);
+  auto blueprint = (*blueprint_library)[blueprint_dist(rand_gen_)];
 
   // Make sure the vehicle will fall onto the ground instead of fall endlessly.
   CarlaTransform transform = waypoint->GetTransform();
@@ -219,8 +219,6 @@ boost::optional<size_t> RandomTrafficNode::spawnAgentVehicle(
   world_->Tick();
 
   // Set the agent vehicle policy
-  const size_t seed = std::chrono::system_clock::now().time_since_epoch().count();
-  std::default_random_engine rand_gen(seed);
   std::uniform_real_distribution<double> uni_real_dist(-4.0, 4.0);
 
   planner::Vehicle agent;
@@ -230,8 +228,8 @@ boost::optional<size_t> RandomTrafficNode::spawnAgentVehicle(
   agent.policySpeed() = policy_speed;
 
   if (noisy_speed) {
-    agent.speed() = policy_speed + uni_real_dist(rand_gen);
-    agent.policySpeed() = policy_speed + uni_real_dist(rand_gen);
+    agent.speed() = policy_speed + uni_real_dist(rand_gen_);
+    agent.policySpeed() = policy_speed + uni_real_dist(rand_gen_);
   }
 
   // Store the newly created agent vehicle.
@@ -260,6 +258,7 @@ void RandomTrafficNode::manageTraffic() {
   if (!traffic_manager_->moveTrafficForward(
         vehicles, shift_distance, disappear_vehicles)) {
     ROS_ERROR_NAMED("carla simulator", "Collision detected");
+    episode_stats_.addCollision();
   }
 
   // Remove the vehicles that disappear.
@@ -269,6 +268,9 @@ void RandomTrafficNode::manageTraffic() {
       throw std::runtime_error("The ego vehicle is removed from the simulation.");
     }
 
+    // The planner controlling the vehicle, if any, is idle from now on.
+    releaseEgoPlanner(id);
+
     // Remove the vehicle from the carla server.
     boost::shared_ptr<CarlaVehicle> vehicle = agentVehicle(id);
     if (!world_->GetActor(id)->Destroy())
@@ -279,60 +281,89 @@ void RandomTrafficNode::manageTraffic() {
     agents_.erase(id);
   }
 
-  // Spawn more vehicles if the number of agents around the ego vehicle
+  // Spawn more vehicles if the traffic around the ego vehicle
   // does not meet the requirement.
   // At most one vehicle is spawned every time this function is called.
-  if (agents_.size() < 8) {
-
-    const double min_distance = 30.0;
-    boost::optional<std::pair<double, boost::shared_ptr<const CarlaWaypoint>>> front =
-      traffic_manager_->frontSpawnWaypoint(min_distance);
-    boost::optional<std::pair<double, boost::shared_ptr<const CarlaWaypoint>>> back =
-      traffic_manager_->backSpawnWaypoint(min_distance);
-
-    double front_distance = 0.0;
-    double back_distance = 0.0;
-    if (front && traffic_manager_->back(front->second, 30.0)) front_distance = front->first;
-    if (back  && traffic_manager_->front(back->second, 30.0)) back_distance = back->first;
-
-    // Waypoint to spawn the new vehicle.
-    boost::shared_ptr<const CarlaWaypoint> spawn_waypoint = nullptr;
-    double policy_speed = 0.0;
-
-    const size_t seed = std::chrono::system_clock::now().time_since_epoch().count();
-    std::default_random_engine rand_gen(seed);
-    std::uniform_real_distribution<double> uni_real_dist(-10.0, 10.0);
-
-    if (front_distance>=back_distance && front_distance>=min_distance) {
-      // Spawn a new vehicle at the front of the lattice.
-      const double distance = min_distance/2.0 + uni_real_dist(rand_gen);
-      boost::shared_ptr<const CarlaWaypoint> waypoint = front->second;
-      spawn_waypoint = traffic_manager_->back(waypoint, distance)->waypoint();
+  const double min_distance = 30.0;
+  boost::shared_ptr<const CarlaWaypoint> spawn_waypoint = nullptr;
+
+  // The traffic does not change until a vehicle is spawned. Index the
+  // vehicles by lane once and share it among the queries below.
+  const LaneOccupancy occupancy = traffic_manager_->laneOccupancy();
+
+  if (target_density_ <= 0.0) {
+    // Maintain a fixed number of agents.
+    if (agents_.size() >= 8) return;
+    spawn_waypoint = spawnWaypoint(occupancy, min_distance);
+
+  } else {
+    // Try the lanes below the target density, starting from the sparsest one.
+    const std::vector<double> densities = traffic_manager_->laneDensities(occupancy);
+    std::vector<size_t> lanes;
+    for (size_t lane = 0; lane < densities.size(); ++lane) {
+      if (densities[lane] < target_density_) lanes.push_back(lane);
     }
+    if (lanes.empty()) return;
 
-    if (front_distance<back_distance && back_distance>=min_distance) {
-      // Spawn a new vehicle at the back of the lattice.
-      const double distance = min_distance/2.0 + uni_real_dist(rand_gen);
-      boost::shared_ptr<const CarlaWaypoint> waypoint = back->second;
-      spawn_waypoint = traffic_manager_->front(waypoint, distance)->waypoint();
+    std::stable_sort(lanes.begin(), lanes.end(),
+        [&densities](const size_t a, const size_t b) { return densities[a] < densities[b]; });
+    for (const size_t lane : lanes) {
+      spawn_waypoint = spawnWaypoint(occupancy, min_distance, lane);
+      if (spawn_waypoint) break;
     }
+  }
 
-    if (!spawn_waypoint) {
-      ROS_WARN_NAMED("carla simulator",
-          "Cannot find a spawn waypoint for a new agent vehicle.");
-      return;
-    }
+  if (!spawn_waypoint) {
+    ROS_WARN_NAMED("carla simulator",
+        "Cannot find a spawn waypoint for a new agent vehicle.");
+    return;
+  }
 
-    if (!spawnAgentVehicle(spawn_waypoint, nominal_policy_speed_)) {
-      ROS_WARN_NAMED("carla simulator",
-          "Cannot spawn a new agent vehicle at the given waypoint.");
-      return;
-    }
+  if (!spawnAgentVehicle(spawn_waypoint, nominal_policy_speed_)) {
+    ROS_WARN_NAMED("carla simulator",
+        "Cannot spawn a new agent vehicle at the given waypoint.");
+    return;
   }
 
   return;
 }
 
+boost::shared_ptr<const carla::client::Waypoint> RandomTrafficNode::spawnWaypoint(
+    const LaneOccupancy& occupancy,
+    const double min_distance,
+    const boost::optional<size_t>& lane) {
+
+  boost::optional<std::pair<double, boost::shared_ptr<const CarlaWaypoint>>> front =
+    traffic_manager_->frontSpawnWaypoint(occupancy, min_distance, lane);
+  boost::optional<std::pair<double, boost::shared_ptr<const CarlaWaypoint>>> back =
+    traffic_manager_->backSpawnWaypoint(occupancy, min_distance, lane);
+
+  double front_distance = 0.0;
+  double back_distance = 0.0;
+  if (front && traffic_manager_->back(front->second, 30.0)) front_distance = front->first;
+  if (back  && traffic_manager_->front(back->second, 30.0)) back_distance = back->first;
+
+  // Waypoint to spawn the new vehicle.
+  boost::shared_ptr<const CarlaWaypoint> spawn_waypoint = nullptr;
+  std::uniform_real_distribution<double> uni_real_dist(-10.0, 10.0);
+
+  if (front_distance>=back_distance && front_distance>=min_distance) {
+    // Spawn a new vehicle at the front of the lattice.
+    const double distance = min_distance/2.0 + uni_real_dist(rand_gen_);
+    boost::shared_ptr<const CarlaWaypoint> waypoint = front->second;
+    spawn_waypoint = traffic_manager_->back(waypoint, distance)->waypoint();
+  }
+
+  if (front_distance<back_distance && back_distance>=min_distance) {
+    // Spawn a new vehicle at the back of the lattice.
+    const double distance = min_distance/2.0 + uni_real_dist(rand_gen_);
+    boost::shared_ptr<const CarlaWaypoint> waypoint = back->second;
+    spawn_waypoint = traffic_manager_->front(waypoint, distance)->waypoint();
+  }
+
+  return spawn_waypoint;
+}
+
 void RandomTrafficNode::tickWorld() {
 
   // This tick is for update the vehicle transforms set by the planners.
@@ -407,10 +438,17 @@ int main(int argc, char** argv) {
 
   node::RandomTrafficNodePtr sim =
     boost::make_shared<node::RandomTrafficNode>(nh);
-  if (!sim->initialize()) {
-    ROS_ERROR("Cannot initialize the CARLA simulator.");
+
+  // Record the crash in the episode result before bailing out.
+  try {
+    if (!sim->initialize()) {
+      ROS_ERROR("Cannot initialize the CARLA simulator.");
+    }
+    ros::spin();
+  } catch (const std::exception& e) {
+    sim->writeResult("crashed", e.what());
+    throw;
   }
 
-  ros::spin();
   return 0;
 }
@@ -45,9 +45,15 @@ protected:
   /// Nominal policy speed of all vehicles.
   const double nominal_policy_speed_ = 20.0;
 
+  /// Target traffic density (vehicles/km) of each lane around the ego.
+  /// If non-positive, a fixed number of agents is maintained instead.
+  double target_density_ = 0.0;
+
 public:
 
-  RandomTrafficNode(ros::NodeHandle nh) : Base(nh) {}
+  RandomTrafficNode(ros::NodeHandle nh) : Base(nh) {
+    nh_.param<double>("target_density", target_density_, 0.0);
+  }
 
 protected:
 
@@ -66,6 +72,19 @@ protected:
   /// Manager (add/delete) the vehicles in the simulation.
   void manageTraffic();
 
+  /**
+   * \brief Find a waypoint to spawn a new agent vehicle at either the front or
+   *        the back of the traffic lattice, whichever has the larger gap.
+   * \param[in] occupancy The lane occupancy of the current traffic.
+   * \param[in] min_distance The minimum gap to the existing vehicles.
+   * \param[in] lane If given, only spawn on this lane.
+   * \return \c nullptr if there is no valid waypoint.
+   */
+  boost::shared_ptr<const CarlaWaypoint> spawnWaypoint(
+      const planner::LaneOccupancy& occupancy,
+      const double min_distance,
+      const boost::optional<size_t>& lane = boost::none);
+
   virtual void tickWorld() override;
 
   virtual void publishTraffic() const override;
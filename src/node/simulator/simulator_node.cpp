@@ -15,6 +15,9 @@
 #include <string>
 #include <random>
 #include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <boost/format.hpp>
 
 #include <tf2/LinearMath/Quaternion.h>
 #include <tf2/LinearMath/Matrix3x3.h>
@@ -40,6 +43,13 @@ bool SimulatorNode::initialize() {
   all_param_exist &= nh_.param<std::string>("host", host, "localhost");
   all_param_exist &= nh_.param<int>("port", port, 2000);
 
+  // Episode settings, these are optional.
+  nh_.param<double>("max_simulation_time", max_simulation_time_, 0.0);
+  nh_.param<std::string>("result_file", result_file_, "");
+  double hard_braking_deceleration = 3.0;
+  nh_.param<double>("hard_braking_deceleration", hard_braking_deceleration, 3.0);
+  episode_stats_ = EpisodeStatistics(hard_braking_deceleration);
+
   ROS_INFO_NAMED("carla_simulator", "connect to the server.");
   client_ = boost::make_shared<CarlaClient>(host, port);
   client_->SetTimeout(std::chrono::seconds(10));
@@ -95,6 +105,7 @@ bool SimulatorNode::initialize() {
   // Initialize the ego vehicle.
   ROS_INFO_NAMED("carla_simulator", "spawn the vehicles.");
   spawnVehicles();
+  assignEgoPlanners();
 
   // Publish the ego vehicle marker.
   ROS_INFO_NAMED("carla_simulator", "publish ego and agents.");
@@ -102,11 +113,12 @@ bool SimulatorNode::initialize() {
 
   // Wait for the planner servers.
   ROS_INFO_NAMED("carla_simulator", "waiting for action servers.");
-  ego_client_.waitForServer(ros::Duration(2.5));
+  waitForEgoPlanners(ros::Duration(2.5));
   agents_client_.waitForServer(ros::Duration(2.5));
 
   // Send out the first goal of ego.
   ROS_INFO_NAMED("carla_simulator", "send the first goals to action servers");
+  start_wall_time_ = ros::WallTime::now();
   sendEgoGoal();
   sendAgentsGoal();
 
@@ -114,6 +126,60 @@ bool SimulatorNode::initialize() {
   return all_param_exist;
 }
 
+bool SimulatorNode::episodeFinished() {
+  if (max_simulation_time_ <= 0.0 ||
+      simulation_time_ < max_simulation_time_) return false;
+
+  ROS_INFO_NAMED("carla_simulator",
+      "episode finishes at simulation time %f.", simulation_time_);
+  for (const auto& planner : ego_planners_) {
+    ROS_INFO_NAMED("carla_simulator",
+        "ego %lu (%s) plans:%lu p50 planning time:%f p50 response time:%f",
+        planner.latency.id(), planner.latency.action().c_str(), planner.latency.plans(),
+        percentile(planner.latency.planningTimes(), 50.0),
+        percentile(planner.latency.responseTimes(), 50.0));
+  }
+  writeResult("completed");
+  ros::shutdown();
+  return true;
+}
+
+void SimulatorNode::writeResult(
+    const std::string& status, const std::string& message) const {
+  if (result_file_.empty()) return;
+
+  // Keep the result on a single line with valid JSON strings.
+  std::string escaped_message = message;
+  std::replace(escaped_message.begin(), escaped_message.end(), '"', '\'');
+  std::replace(escaped_message.begin(), escaped_message.end(), '\\', '/');
+  std::replace(escaped_message.begin(), escaped_message.end(), '\n', ' ');
+
+  const double wall_time = start_wall_time_.isZero() ?
+    0.0 : (ros::WallTime::now()-start_wall_time_).toSec();
+
+  // Latencies of all ego planners, including the released ones.
+  std::string egos;
+  for (const auto& latency : released_latencies_)
+    egos += (egos.empty() ? "" : ", ") + latency.json();
+  for (const auto& planner : ego_planners_)
+    egos += (egos.empty() ? "" : ", ") + planner.latency.json();
+
+  std::ofstream result(result_file_);
+  if (!result) {
+    ROS_ERROR_NAMED("carla_simulator",
+        "cannot write the episode result to %s.", result_file_.c_str());
+    return;
+  }
+
+  result << (boost::format(
+      "{\"status\": \"%1%\", \"message\": \"%2%\", "
+      "\"simulation_time\": %3%, \"wall_time\": %4%, %5%, \"egos\": [%6%]}\n")
+      % status % escaped_message
+      % simulation_time_ % wall_time
+      % episode_stats_.json() % egos).str();
+  return;
+}
+
 boost::optional<size_t> SimulatorNode::spawnEgoVehicle(
     const boost::shared_ptr<const CarlaWaypoint>& waypoint,
     const double policy_speed,
@@ -143,8 +209,6 @@ boost::optional<size_t> SimulatorNode::spawnEgoVehicle(
   world_->Tick();
 
   // Set the ego vehicle.
-  const size_t seed = std::chrono::system_clock::now().time_since_epoch().count();
-  std::default_random_engine rand_gen(seed);
   std::uniform_real_distribution<double> uni_real_dist(-2.0, 2.0);
 
   populateVehicleObj(vehicle, ego_);
@@ -153,8 +217,8 @@ boost::optional<size_t> SimulatorNode::spawnEgoVehicle(
   ego_.policySpeed() = policy_speed;
 
   if (noisy_speed) {
-    ego_.speed() += uni_real_dist(rand_gen);
-    ego_.policySpeed() += uni_real_dist(rand_gen);
+    ego_.speed() += uni_real_dist(rand_gen_);
+    ego_.policySpeed() += uni_real_dist(rand_gen_);
   }
 
   return vehicle->GetId();
@@ -169,7 +233,8 @@ boost::optional<size_t> SimulatorNode::spawnAgentVehicle(
   // vehicle blueprint library.
   boost::shared_ptr<CarlaBlueprintLibrary> blueprint_library =
     world_->GetBlueprintLibrary()->Filter("vehicle");
-  auto blueprint = (*blueprint_library)[std::rand() % blueprint_library->size()];
+  std::uniform_int_distribution<size_t> blueprint_dist(0, blueprint_library->size()-1);
+  auto blueprint = (*blueprint_library)[blueprint_dist(rand_gen_)];
 
   // Make sure the vehicle will fall onto the ground instead of fall endlessly.
   CarlaTransform transform = waypoint->GetTransform();
@@ -190,8 +255,6 @@ boost::optional<size_t> SimulatorNode::spawnAgentVehicle(
   world_->Tick();
 
   // Set the agent vehicle.
-  const size_t seed = std::chrono::system_clock::now().time_since_epoch().count();
-  std::default_random_engine rand_gen(seed);
   std::uniform_real_distribution<double> uni_real_dist(-2.0, 2.0);
 
   planner::Vehicle agent;
@@ -201,8 +264,8 @@ boost::optional<size_t> SimulatorNode::spawnAgentVehicle(
   agent.policySpeed() = policy_speed;
 
   if (noisy_speed) {
-    agent.speed() = policy_speed + uni_real_dist(rand_gen);
-    agent.policySpeed() = policy_speed + uni_real_dist(rand_gen);
+    agent.speed() = policy_speed + uni_real_dist(rand_gen_);
+    agent.policySpeed() = policy_speed + uni_real_dist(rand_gen_);
   }
 
   // Store the newly created agent vehicle.
@@ -246,6 +309,69 @@ void SimulatorNode::spawnCamera() {
   return;
 }
 
+void SimulatorNode::assignEgoPlanners() {
+
+  ego_planners_.front().id = ego_.id();
+  ego_planners_.front().latency = EgoPlanningLatency(ego_.id(), egoName("ego_plan", 0));
+
+  // The other planners control the agents closest to the ego.
+  std::vector<std::pair<double, size_t>> agents;
+  for (const auto& agent : agents_) {
+    const double distance = ego_.transform().location.Distance(
+        agent.second.transform().location);
+    agents.push_back(std::make_pair(distance, agent.first));
+  }
+  std::sort(agents.begin(), agents.end());
+
+  if (agents.size()+1 < ego_planners_.size()) {
+    ROS_WARN_NAMED("carla_simulator",
+        "%lu ego planners are required, but only %lu vehicles are available.",
+        ego_planners_.size(), agents.size()+1);
+    ego_planners_.resize(agents.size()+1);
+  }
+
+  for (size_t i = 1; i < ego_planners_.size(); ++i) {
+    ego_planners_[i].id = agents[i-1].second;
+    ego_planners_[i].latency = EgoPlanningLatency(
+        agents[i-1].second, egoName("ego_plan", i));
+    ROS_INFO_NAMED("carla_simulator", "ego planner %lu controls vehicle %lu.",
+        i, ego_planners_[i].id);
+  }
+
+  return;
+}
+
+bool SimulatorNode::releaseEgoPlanner(const size_t id) {
+  for (size_t i = 1; i < ego_planners_.size(); ++i) {
+    if (ego_planners_[i].id != id) continue;
+    ROS_WARN_NAMED("carla_simulator",
+        "vehicle %lu controlled by ego planner %lu leaves the simulation.", id, i);
+    released_latencies_.push_back(ego_planners_[i].latency);
+    ego_planners_.erase(ego_planners_.begin()+i);
+    return true;
+  }
+  return false;
+}
+
+void SimulatorNode::waitForEgoPlanners(const ros::Duration& timeout) {
+  for (const auto& planner : ego_planners_)
+    planner.client->waitForServer(timeout);
+  return;
+}
+
+bool SimulatorNode::egoPlannersReady() const {
+  for (const auto& planner : ego_planners_)
+    if (!planner.ready) return false;
+  return true;
+}
+
+std::vector<size_t> SimulatorNode::egoAgents() const {
+  std::vector<size_t> ids;
+  for (size_t i = 1; i < ego_planners_.size(); ++i)
+    ids.push_back(ego_planners_[i].id);
+  return ids;
+}
+
 void SimulatorNode::publishImage(
     const boost::shared_ptr<CarlaSensorData>& data) const {
 
@@ -362,24 +488,58 @@ void SimulatorNode::publishTraffic() const {
 }
 
 void SimulatorNode::sendEgoGoal() {
+  for (auto& planner : ego_planners_) sendEgoGoal(planner);
+  return;
+}
+
+void SimulatorNode::sendEgoGoal(EgoPlanner& ego_planner) {
 
   conformal_lattice_planner::EgoPlanGoal goal;
+
+  if (ego_planner.id == ego_.id()) {
+    populateEgoPlanGoal(ego_, agents_, goal);
+  } else {
+    // The ego of the goal is the controlled agent, while the ego of
+    // the simulation becomes one of the agents.
+    std::unordered_map<size_t, planner::Vehicle> agents = agents_;
+    agents.erase(ego_planner.id);
+    agents[ego_.id()] = ego_;
+    populateEgoPlanGoal(agents_.at(ego_planner.id), agents, goal);
+  }
+
+  const size_t id = ego_planner.id;
+  ego_planner.client->sendGoal(
+      goal,
+      boost::bind(&SimulatorNode::egoPlanDoneCallback, this, id, _1, _2),
+      boost::bind(&SimulatorNode::egoPlanActiveCallback, this),
+      boost::bind(&SimulatorNode::egoPlanFeedbackCallback, this, _1));
+
+  ego_planner.goal_time = ros::WallTime::now();
+  ego_planner.ready = false;
+  return;
+}
+
+void SimulatorNode::populateEgoPlanGoal(
+    const planner::Vehicle& ego,
+    const std::unordered_map<size_t, planner::Vehicle>& agents,
+    conformal_lattice_planner::EgoPlanGoal& goal) {
+
   goal.header.stamp = ros::Time::now();
   goal.simulation_time = simulation_time_;
-  populateVehicleMsg(ego_, goal.snapshot.ego);
-  for (const auto& item : agents_) {
+  populateVehicleMsg(ego, goal.snapshot.ego);
+  for (const auto& item : agents) {
     goal.snapshot.agents.push_back(conformal_lattice_planner::Vehicle());
     populateVehicleMsg(item.second, goal.snapshot.agents.back());
   }
 
   // Figure out the leader and follower of the ego vehicle.
   boost::shared_ptr<planner::Snapshot> snapshot =
-    boost::make_shared<planner::Snapshot>(ego_, agents_, loop_router_, map_, fast_map_);
+    boost::make_shared<planner::Snapshot>(ego, agents, loop_router_, map_, fast_map_);
 
   boost::optional<std::pair<size_t, double>> front_leader =
     snapshot->trafficLattice()->front(snapshot->ego().id());
   if (front_leader) {
-    populateVehicleMsg(agents_[front_leader->first], goal.front_leader);
+    populateVehicleMsg(agents.at(front_leader->first), goal.front_leader);
     goal.front_distance = front_leader->second;
   } else {
     goal.front_distance = -1.0;
@@ -388,7 +548,7 @@ void SimulatorNode::sendEgoGoal() {
   boost::optional<std::pair<size_t, double>> left_front_leader =
     snapshot->trafficLattice()->leftFront(snapshot->ego().id());
   if (left_front_leader) {
-    populateVehicleMsg(agents_[left_front_leader->first], goal.left_front_leader);
+    populateVehicleMsg(agents.at(left_front_leader->first), goal.left_front_leader);
     goal.left_front_distance = left_front_leader->second;
   } else {
     goal.left_front_distance = -1.0;
@@ -397,7 +557,7 @@ void SimulatorNode::sendEgoGoal() {
   boost::optional<std::pair<size_t, double>> right_front_leader =
     snapshot->trafficLattice()->rightFront(snapshot->ego().id());
   if (right_front_leader) {
-    populateVehicleMsg(agents_[right_front_leader->first], goal.right_front_leader);
+    populateVehicleMsg(agents.at(right_front_leader->first), goal.right_front_leader);
     goal.right_front_distance = right_front_leader->second;
   } else {
     goal.right_front_distance = -1.0;
@@ -406,7 +566,7 @@ void SimulatorNode::sendEgoGoal() {
   boost::optional<std::pair<size_t, double>> back_follower =
     snapshot->trafficLattice()->back(snapshot->ego().id());
   if (back_follower) {
-    populateVehicleMsg(agents_[back_follower->first], goal.back_follower);
+    populateVehicleMsg(agents.at(back_follower->first), goal.back_follower);
     goal.back_distance = back_follower->second;
   } else {
     goal.back_distance = -1.0;
@@ -415,7 +575,7 @@ void SimulatorNode::sendEgoGoal() {
   boost::optional<std::pair<size_t, double>> left_back_follower =
     snapshot->trafficLattice()->leftBack(snapshot->ego().id());
   if (left_back_follower) {
-    populateVehicleMsg(agents_[left_back_follower->first], goal.left_back_follower);
+    populateVehicleMsg(agents.at(left_back_follower->first), goal.left_back_follower);
     goal.left_back_distance = left_back_follower->second;
   } else {
     goal.left_back_distance = -1.0;
@@ -424,37 +584,50 @@ void SimulatorNode::sendEgoGoal() {
   boost::optional<std::pair<size_t, double>> right_back_follower =
     snapshot->trafficLattice()->rightBack(snapshot->ego().id());
   if (right_back_follower) {
-    populateVehicleMsg(agents_[right_back_follower->first], goal.right_back_follower);
+    populateVehicleMsg(agents.at(right_back_follower->first), goal.right_back_follower);
     goal.right_back_distance = right_back_follower->second;
   } else {
     goal.right_back_distance = -1.0;
   }
 
-  ego_client_.sendGoal(
-      goal,
-      boost::bind(&SimulatorNode::egoPlanDoneCallback, this, _1, _2),
-      boost::bind(&SimulatorNode::egoPlanActiveCallback, this),
-      boost::bind(&SimulatorNode::egoPlanFeedbackCallback, this, _1));
-
-  ego_ready_ = false;
   return;
 }
 
 void SimulatorNode::egoPlanDoneCallback(
+    const size_t id,
     const actionlib::SimpleClientGoalState& state,
     const conformal_lattice_planner::EgoPlanResultConstPtr& result) {
 
-  ROS_INFO_NAMED("carla_simulator", "egoPlanDoneCallback().");
+  ROS_INFO_NAMED("carla_simulator", "egoPlanDoneCallback() for vehicle %lu.", id);
 
-  if (result->ego.id != ego_.id())
+  std::vector<EgoPlanner>::iterator ego_planner = std::find_if(
+      ego_planners_.begin(), ego_planners_.end(),
+      [id](const EgoPlanner& p){ return p.id == id; });
+
+  if (ego_planner == ego_planners_.end() || result->ego.id != id)
     throw std::runtime_error("The ego ID in the action result does not exist.");
 
-  // Update the ego vehicle.
-  populateVehicleObj(result->ego, ego_);
+  ego_planner->latency.addPlan(
+      result->planning_time, (ros::WallTime::now()-ego_planner->goal_time).toSec());
+  ego_planner->ready = true;
 
-  ego_ready_ = true;
+  if (id == ego_.id()) {
+    // Update the ego vehicle.
+    populateVehicleObj(result->ego, ego_);
 
-  if (ego_ready_ && agents_ready_) {
+    episode_stats_.addPlan(result->ego.speed,
+                           result->ego.acceleration,
+                           result->path_type,
+                           result->planning_time,
+                           result->manoeuvre_abandoned,
+                           result->lattice_construction_time);
+  } else {
+    // Update the agent controlled by the ego planner.
+    populateVehicleObj(result->ego, agents_.at(id));
+  }
+
+  if (egoPlannersReady() && agents_ready_) {
+    if (episodeFinished()) return;
     ROS_INFO_NAMED("carla_simulator", "tick world by ego client.");
     tickWorld();
   }
@@ -473,6 +646,9 @@ void SimulatorNode::sendAgentsGoal() {
     populateVehicleMsg(item.second, goal.snapshot.agents.back());
   }
 
+  // The agents controlled by the ego planners are not planned for.
+  for (const size_t id : egoAgents()) goal.ego_agents.push_back(id);
+
   agents_client_.sendGoal(
       goal,
       boost::bind(&SimulatorNode::agentsPlanDoneCallback, this, _1, _2),
@@ -499,7 +675,8 @@ void SimulatorNode::agentsPlanDoneCallback(
 
   agents_ready_ = true;
 
-  if (ego_ready_ && agents_ready_) {
+  if (egoPlannersReady() && agents_ready_) {
+    if (episodeFinished()) return;
     ROS_INFO_NAMED("carla_simulator", "tick world by agents client.");
     tickWorld();
   }
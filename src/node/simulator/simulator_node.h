@@ -14,8 +14,12 @@
 
 #pragma once
 
+#include <string>
 #include <vector>
+#include <random>
+#include <chrono>
 #include <utility>
+#include <algorithm>
 #include <unordered_map>
 
 #include <boost/smart_ptr.hpp>
@@ -41,6 +45,8 @@
 #include <router/loop_router/loop_router.h>
 #include <planner/common/fast_waypoint_map.h>
 #include <planner/common/vehicle.h>
+#include <node/common/multi_ego.h>
+#include <node/simulator/episode_statistics.h>
 
 #include <conformal_lattice_planner/EgoPlanAction.h>
 #include <conformal_lattice_planner/AgentPlanAction.h>
@@ -64,19 +70,67 @@ protected:
   using CarlaBGRAImage        = carla::sensor::data::Image;
   using CarlaTransform        = carla::geom::Transform;
 
+  using EgoPlanClient = actionlib::SimpleActionClient<
+    conformal_lattice_planner::EgoPlanAction>;
+
+  /**
+   * \brief A vehicle controlled by an ego planner through the \c EgoPlan action.
+   *
+   * The first planner controls \c ego_. If more planner-controlled vehicles
+   * are required, the other planners control vehicles in \c agents_, which
+   * are then excluded from the goals of the agents planner. The planners are
+   * served by the actions named by \c egoName("ego_plan", index).
+   */
+  struct EgoPlanner {
+    /// ID of the controlled vehicle.
+    size_t id = 0;
+    /// Client of the action serving the vehicle.
+    boost::shared_ptr<EgoPlanClient> client = nullptr;
+    /// Whether the planner has returned the result of the last goal.
+    bool ready = true;
+    /// The wall time when the last goal is sent.
+    ros::WallTime goal_time;
+    /// Latencies of the plans of the vehicle.
+    EgoPlanningLatency latency;
+  };
+
 protected:
 
   /// The actual simulation time starting from 0.
   double simulation_time_ = 0.0;
 
+  /// The episode ends once the simulation time reaches this value (s).
+  /// Non-positive for an episode without a time limit.
+  double max_simulation_time_ = 0.0;
+
+  /// The file to write the episode result into. Nothing is written if empty.
+  std::string result_file_;
+
+  /// The wall time when the simulation starts.
+  ros::WallTime start_wall_time_;
+
+  /// Summary of the episode, written into the result file.
+  EpisodeStatistics episode_stats_;
+
+  /// Latencies of the ego planners whose vehicles have left the simulation.
+  std::vector<EgoPlanningLatency> released_latencies_;
+
   /// The ego vehicle.
   planner::Vehicle ego_;
 
   /// Agent vehicles.
   std::unordered_map<size_t, planner::Vehicle> agents_;
 
-  /// Indicates if the ego planner action server has returned success.
-  bool ego_ready_ = true;
+  /// Seed of the random number generators in the simulation, set by the
+  /// \c seed parameter. A negative parameter picks a seed from the wall clock.
+  size_t seed_ = 0;
+
+  /// Random number generator for the vehicle blueprints and policy speeds.
+  std::default_random_engine rand_gen_;
+
+  /// The ego planners, the first of which controls \c ego_.
+  /// The number of planners is set by the \c num_egos parameter.
+  std::vector<EgoPlanner> ego_planners_;
 
   /// Indicates if the agents' planner action server has returned success.
   bool agents_ready_ = true;
@@ -124,10 +178,6 @@ protected:
   /// Publishing images for the following camera.
   mutable image_transport::Publisher following_img_pub_;
 
-  /// The actionlib client for the ego vehicle planner.
-  mutable actionlib::SimpleActionClient<
-    conformal_lattice_planner::EgoPlanAction> ego_client_;
-
   /// The actionlib client for the planner controlling all agent vehicles.
   mutable actionlib::SimpleActionClient<
     conformal_lattice_planner::AgentPlanAction> agents_client_;
@@ -142,15 +192,41 @@ public:
     loop_router_(new router::LoopRouter),
     nh_(nh),
     img_transport_(nh),
-    ego_client_(nh_, "ego_plan", false),
     agents_client_(nh_, "agents_plan", false),
-    sim_time_server_(nh_.advertiseService("simulation_time", &SimulatorNode::simTimeCallback, this)){}
+    sim_time_server_(nh_.advertiseService("simulation_time", &SimulatorNode::simTimeCallback, this)){
+
+    int seed = 0;
+    nh_.param<int>("seed", seed, 0);
+    if (seed < 0) seed_ = std::chrono::system_clock::now().time_since_epoch().count();
+    else          seed_ = seed;
+    rand_gen_.seed(seed_);
+
+    int num_egos = 1;
+    nh_.param<int>("num_egos", num_egos, 1);
+    ego_planners_.resize(std::max(num_egos, 1));
+    for (size_t i = 0; i < ego_planners_.size(); ++i) {
+      ego_planners_[i].client = boost::make_shared<EgoPlanClient>(
+          nh_, egoName("ego_plan", i), false);
+    }
+  }
 
   virtual ~SimulatorNode() {}
 
   /// Initialize the simulator ROS node.
   virtual bool initialize();
 
+  /**
+   * \brief Write the result of the episode into \c result_file_.
+   *
+   * The result is a single line JSON object, which is consumed by the
+   * experiment orchestrator (\c launch/random_traffic_experiment.py).
+   *
+   * \param[in] status The status of the episode, e.g. "completed" or "crashed".
+   * \param[in] message Additional information, e.g. the error message.
+   */
+  virtual void writeResult(const std::string& status,
+                           const std::string& message="") const;
+
 protected:
 
   /// Spawn the vehicles.
@@ -168,6 +244,35 @@ protected:
 
   virtual void spawnCamera();
 
+  /**
+   * \brief Assign the vehicles controlled by the ego planners.
+   *
+   * The first planner controls \c ego_, and the others control the agents
+   * closest to \c ego_. Planners without a vehicle to control are dropped.
+   * This should be called once the vehicles are spawned.
+   */
+  virtual void assignEgoPlanners();
+
+  /**
+   * \brief Release the ego planner controlling the given vehicle, if any.
+   *
+   * This should be called before an agent is removed from the simulation.
+   * The planner of \c ego_ cannot be released.
+   *
+   * \param[in] id The ID of the vehicle.
+   * \return true If a planner is released.
+   */
+  virtual bool releaseEgoPlanner(const size_t id);
+
+  /// Wait for the action servers of all ego planners.
+  void waitForEgoPlanners(const ros::Duration& timeout);
+
+  /// Whether all ego planners have returned the results of the last goals.
+  bool egoPlannersReady() const;
+
+  /// IDs of the agents controlled by the ego planners.
+  std::vector<size_t> egoAgents() const;
+
   /// Simulate the world forward by one time step.
   virtual void tickWorld() {
     world_->Tick();
@@ -186,6 +291,17 @@ protected:
     return;
   }
 
+  /**
+   * \brief Check if the episode has reached \c max_simulation_time_.
+   *
+   * Once the episode is finished, the result is written and the node is
+   * shut down, which also brings down the launch file since the simulator
+   * nodes are required.
+   *
+   * \return true If the episode is finished.
+   */
+  virtual bool episodeFinished();
+
   /// Publish the following image.
   void publishImage(const boost::shared_ptr<CarlaSensorData>& data) const;
 
@@ -231,18 +347,34 @@ protected:
    * @name Ego actionlib client callbacks
    */
   /// @{
-  /// Send the goal for the ego.
+  /// Send the goals for all ego planners at the same time,
+  /// so that the planners may plan concurrently.
   virtual void sendEgoGoal();
 
-  /// Done callback for \c ego_client_.
+  /// Send the goal for an ego planner.
+  virtual void sendEgoGoal(EgoPlanner& ego_planner);
+
+  /**
+   * \brief Populate the goal of an ego planner.
+   * \param[in] ego The vehicle controlled by the planner.
+   * \param[in] agents All other vehicles in the simulation.
+   * \param[out] goal The goal of the planner.
+   */
+  virtual void populateEgoPlanGoal(
+      const planner::Vehicle& ego,
+      const std::unordered_map<size_t, planner::Vehicle>& agents,
+      conformal_lattice_planner::EgoPlanGoal& goal);
+
+  /// Done callback for the ego planner controlling the given vehicle.
   virtual void egoPlanDoneCallback(
+      const size_t id,
       const actionlib::SimpleClientGoalState& state,
       const conformal_lattice_planner::EgoPlanResultConstPtr& result);
 
-  /// Action callback for \c ego_client_.
+  /// Action callback for the ego planners.
   virtual void egoPlanActiveCallback() {}
 
-  /// Feedback callback for \c ego_client_.
+  /// Feedback callback for the ego planners.
   virtual void egoPlanFeedbackCallback(
       const conformal_lattice_planner::EgoPlanFeedbackConstPtr& feedback) {}
   /// @}
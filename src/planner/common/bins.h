@@ -0,0 +1,208 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/format.hpp>
+#include <boost/optional.hpp>
+
+namespace utils {
+
+/**
+ * \brief Bins partitions a range of a scalar (e.g. speed) into consecutive intervals.
+ *
+ * The bins are defined by their sorted boundaries. With boundaries
+ * {b0, b1, ..., bn}, there are n bins, and the i-th bin is [bi, bi+1),
+ * i.e. left-closed and right-open. Values outside [b0, bn) are not in any bin.
+ *
+ * The boundaries can be set at runtime. Looking up the bin of a value is a
+ * binary search, so it stays cheap with fine resolutions.
+ */
+class Bins {
+
+protected:
+
+  std::vector<double> boundaries_;
+
+public:
+
+  /**
+   * \brief Constructor of the class.
+   * \param[in] boundaries Strictly increasing boundaries of the bins.
+   *                       There should be at least two boundaries.
+   */
+  explicit Bins(const std::vector<double>& boundaries) :
+    boundaries_(boundaries) {
+    if (boundaries_.size() < 2) {
+      throw std::runtime_error(
+          "Bins::Bins(): at least two boundaries are required.\n");
+    }
+    for (size_t i = 1; i < boundaries_.size(); ++i) {
+      if (boundaries_[i] > boundaries_[i-1]) continue;
+      throw std::runtime_error((boost::format(
+              "Bins::Bins(): boundaries are not strictly increasing at %1%.\n")
+            % i).str());
+    }
+    return;
+  }
+
+  /**
+   * \brief Create bins with the same width.
+   * \param[in] min The lower bound of the first bin.
+   * \param[in] max The upper bound of the last bin.
+   * \param[in] num The number of bins.
+   */
+  static Bins uniform(const double min, const double max, const size_t num) {
+    if (num == 0 || !(max > min)) {
+      throw std::runtime_error((boost::format(
+              "Bins::uniform(): invalid range [%1%, %2%) or bin number %3%.\n")
+            % min % max % num).str());
+    }
+
+    std::vector<double> boundaries(num+1);
+    for (size_t i = 0; i <= num; ++i)
+      boundaries[i] = min + (max-min)*static_cast<double>(i)/static_cast<double>(num);
+    return Bins(boundaries);
+  }
+
+  /// Number of bins.
+  const size_t size() const { return boundaries_.size() - 1; }
+
+  const std::vector<double>& boundaries() const { return boundaries_; }
+
+  /// The lower bound of the bin with the given index.
+  const double lower(const size_t idx) const { return boundaries_.at(idx); }
+
+  /// The upper bound of the bin with the given index.
+  const double upper(const size_t idx) const { return boundaries_.at(idx+1); }
+
+  /**
+   * \brief Figure out the bin index of the given value.
+   * \return \c boost::none if the value is not in any bin.
+   */
+  boost::optional<size_t> index(const double value) const {
+    if (!(value >= boundaries_.front()) || !(value < boundaries_.back()))
+      return boost::none;
+    std::vector<double>::const_iterator iter = std::upper_bound(
+        boundaries_.begin(), boundaries_.end(), value);
+    return static_cast<size_t>(iter - boundaries_.begin()) - 1;
+  }
+
+  bool operator==(const Bins& other) const { return boundaries_ == other.boundaries_; }
+  bool operator!=(const Bins& other) const { return !(*this == other); }
+
+  std::string string(const std::string& prefix = "") const {
+    std::string output = prefix;
+    for (size_t i = 0; i < size(); ++i)
+      output += (boost::format("[%1%, %2%) ") % lower(i) % upper(i)).str();
+    output += "\n";
+    return output;
+  }
+
+}; // End class Bins.
+
+/**
+ * \brief SparseBinArray stores values for only the populated bins.
+ *
+ * The values are kept in a vector sorted by the bin index. Compared to an
+ * array with one slot per bin, the memory grows with the number of populated
+ * bins instead of the total number of bins. Lookups are binary searches.
+ * Iterating the array visits pairs of (bin index, value) in the order of
+ * the bin index.
+ */
+template<typename T>
+class SparseBinArray {
+
+public:
+
+  using value_type     = std::pair<size_t, T>;
+  using iterator       = typename std::vector<value_type>::iterator;
+  using const_iterator = typename std::vector<value_type>::const_iterator;
+
+protected:
+
+  std::vector<value_type> values_;
+
+public:
+
+  SparseBinArray() = default;
+
+  /// Number of populated bins.
+  const size_t size() const { return values_.size(); }
+  const bool empty() const { return values_.empty(); }
+
+  void clear() { values_.clear(); return; }
+
+  iterator begin() { return values_.begin(); }
+  iterator end() { return values_.end(); }
+  const_iterator begin() const { return values_.begin(); }
+  const_iterator end() const { return values_.end(); }
+
+  /// Get the value in the given bin, \c nullptr if the bin is not populated.
+  /// @{
+  T* find(const size_t idx) {
+    iterator iter = lowerBound(idx);
+    if (iter == values_.end() || iter->first != idx) return nullptr;
+    return &(iter->second);
+  }
+
+  const T* find(const size_t idx) const {
+    return const_cast<SparseBinArray*>(this)->find(idx);
+  }
+  /// @}
+
+  /// Get the value in the given bin, populating the bin with a
+  /// default-constructed value if necessary.
+  T& operator[](const size_t idx) {
+    iterator iter = lowerBound(idx);
+    if (iter == values_.end() || iter->first != idx)
+      iter = values_.insert(iter, value_type(idx, T()));
+    return iter->second;
+  }
+
+  /// Set the value in the given bin.
+  void set(const size_t idx, const T& value) {
+    iterator iter = lowerBound(idx);
+    if (iter == values_.end() || iter->first != idx)
+      values_.insert(iter, value_type(idx, value));
+    else iter->second = value;
+    return;
+  }
+
+  /// Remove the value in the given bin if it is populated.
+  void erase(const size_t idx) {
+    iterator iter = lowerBound(idx);
+    if (iter != values_.end() && iter->first == idx) values_.erase(iter);
+    return;
+  }
+
+protected:
+
+  iterator lowerBound(const size_t idx) {
+    return std::lower_bound(values_.begin(), values_.end(), idx,
+        [](const value_type& value, const size_t idx)->bool{
+          return value.first < idx;
+        });
+  }
+
+}; // End class SparseBinArray.
+
+} // End namespace utils.
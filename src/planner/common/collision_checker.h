@@ -0,0 +1,342 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/format.hpp>
+#include <boost/optional.hpp>
+
+namespace utils {
+
+/**
+ * \brief OrientedBox is the 2D footprint of a vehicle.
+ *
+ * The box is centered at (\c x, \c y) and rotated by \c yaw (in radians).
+ * The half length is measured along the heading, and the half width is
+ * measured perpendicular to the heading.
+ */
+struct OrientedBox {
+  double x           = 0.0;
+  double y           = 0.0;
+  double yaw         = 0.0;
+  double half_length = 0.0;
+  double half_width  = 0.0;
+
+  OrientedBox() = default;
+
+  OrientedBox(const double x, const double y, const double yaw,
+              const double half_length, const double half_width) :
+    x(x), y(y), yaw(yaw), half_length(half_length), half_width(half_width) {}
+}; // End struct OrientedBox.
+
+/**
+ * \brief CollisionChecker finds the overlapping boxes within a group of
+ *        oriented boxes.
+ *
+ * The check is done in two phases:
+ * - The broad phase bins the axis-aligned bounds of the boxes into a
+ *   uniform grid. Only boxes sharing a grid cell with overlapping
+ *   axis-aligned bounds are considered as candidates.
+ * - The narrow phase runs the separating axis test on the candidate pairs.
+ *   The boxes are stored as structure of arrays, and the candidate pairs
+ *   are tested in a single branch-free loop over the arrays.
+ *
+ * The cell size should be roughly the size of the boxes, e.g. the length
+ * of a vehicle. Boxes touching each other are considered as colliding.
+ *
+ * All buffers, including the ones of the two phases, are kept by \c clear().
+ * Once the checker has seen the largest group of boxes, repeated checks
+ * do not allocate. The checks write these buffers, so the object should
+ * not be shared between threads.
+ */
+class CollisionChecker {
+
+protected:
+
+  /// Size of the cells in the uniform grid.
+  double cell_size_;
+
+  /// Centers, heading vectors, and half extents of the boxes.
+  std::vector<double> xs_;
+  std::vector<double> ys_;
+  std::vector<double> cos_yaws_;
+  std::vector<double> sin_yaws_;
+  std::vector<double> half_lengths_;
+  std::vector<double> half_widths_;
+
+  /// Axis-aligned bounds of the boxes.
+  std::vector<double> min_xs_;
+  std::vector<double> min_ys_;
+  std::vector<double> max_xs_;
+  std::vector<double> max_ys_;
+
+  /// The grid cells overlapped by the bounds of each box, as pairs of
+  /// cell key and box index. Sorted by the broad phase to group the boxes
+  /// by cell.
+  std::vector<std::pair<int64_t, size_t>> cells_;
+
+  /// Candidate pairs of the broad phase.
+  std::vector<std::pair<size_t, size_t>> candidates_;
+
+  /// Results of the separating axis test on each candidate pair.
+  std::vector<uint8_t> results_;
+
+  /// Colliding pairs found by the narrow phase.
+  std::vector<std::pair<size_t, size_t>> collisions_;
+
+public:
+
+  explicit CollisionChecker(const double cell_size = 5.0) :
+    cell_size_(cell_size) {
+    if (cell_size_ <= 0.0) {
+      std::string error_msg = (boost::format(
+            "CollisionChecker::CollisionChecker(): "
+            "invalid cell size %1%.\n") % cell_size_).str();
+      throw std::runtime_error(error_msg);
+    }
+    return;
+  }
+
+  const double cellSize() const { return cell_size_; }
+
+  size_t size() const { return xs_.size(); }
+
+  bool empty() const { return xs_.empty(); }
+
+  void reserve(const size_t capacity) {
+    xs_.reserve(capacity);
+    ys_.reserve(capacity);
+    cos_yaws_.reserve(capacity);
+    sin_yaws_.reserve(capacity);
+    half_lengths_.reserve(capacity);
+    half_widths_.reserve(capacity);
+    min_xs_.reserve(capacity);
+    min_ys_.reserve(capacity);
+    max_xs_.reserve(capacity);
+    max_ys_.reserve(capacity);
+    // A box overlaps with up to four cells if it is smaller than a cell.
+    cells_.reserve(4*capacity);
+    return;
+  }
+
+  /// Remove all boxes. The allocated memory is kept for reuse.
+  void clear() {
+    xs_.clear();
+    ys_.clear();
+    cos_yaws_.clear();
+    sin_yaws_.clear();
+    half_lengths_.clear();
+    half_widths_.clear();
+    min_xs_.clear();
+    min_ys_.clear();
+    max_xs_.clear();
+    max_ys_.clear();
+    cells_.clear();
+    candidates_.clear();
+    results_.clear();
+    collisions_.clear();
+    return;
+  }
+
+  /**
+   * \brief Add a box to the checker.
+   * \param[in] box The box to be added.
+   * \return The index of the box, used to report the collisions.
+   */
+  size_t add(const OrientedBox& box) {
+    const size_t index = xs_.size();
+    const double c = std::cos(box.yaw);
+    const double s = std::sin(box.yaw);
+
+    xs_.push_back(box.x);
+    ys_.push_back(box.y);
+    cos_yaws_.push_back(c);
+    sin_yaws_.push_back(s);
+    half_lengths_.push_back(box.half_length);
+    half_widths_.push_back(box.half_width);
+
+    const double extent_x = std::fabs(c)*box.half_length + std::fabs(s)*box.half_width;
+    const double extent_y = std::fabs(s)*box.half_length + std::fabs(c)*box.half_width;
+    min_xs_.push_back(box.x - extent_x);
+    min_ys_.push_back(box.y - extent_y);
+    max_xs_.push_back(box.x + extent_x);
+    max_ys_.push_back(box.y + extent_y);
+
+    const int32_t min_ix = cell(min_xs_.back());
+    const int32_t min_iy = cell(min_ys_.back());
+    const int32_t max_ix = cell(max_xs_.back());
+    const int32_t max_iy = cell(max_ys_.back());
+    for (int32_t ix = min_ix; ix <= max_ix; ++ix) {
+      for (int32_t iy = min_iy; iy <= max_iy; ++iy)
+        cells_.emplace_back(cellKey(ix, iy), index);
+    }
+
+    return index;
+  }
+
+  /**
+   * \brief Get all pairs of colliding boxes, with the smaller index first.
+   *
+   * The returned reference is valid until the checker is modified.
+   */
+  const std::vector<std::pair<size_t, size_t>>& collisions() {
+    broadPhase();
+    narrowPhase();
+    return collisions_;
+  }
+
+  /// Check if there is no collision among the boxes.
+  bool collisionFree() {
+    return collisions().empty();
+  }
+
+  /**
+   * \brief Check the boxes over a sequence of time steps.
+   *
+   * This is useful to check a whole simulated trajectory at once. The boxes
+   * at each time step are checked against each other only.
+   *
+   * \param[in] frames The boxes at each time step.
+   * \return The index of the first time step with collision, or
+   *         \c boost::none if there is no collision at all.
+   */
+  boost::optional<size_t> firstCollision(
+      const std::vector<std::vector<OrientedBox>>& frames) {
+    for (size_t i = 0; i < frames.size(); ++i) {
+      clear();
+      reserve(frames[i].size());
+      for (const OrientedBox& box : frames[i]) add(box);
+      if (!collisionFree()) return i;
+    }
+    return boost::none;
+  }
+
+  /// Separating axis test between two boxes.
+  static bool overlap(const OrientedBox& box1, const OrientedBox& box2) {
+    return overlap(box1.x, box1.y, std::cos(box1.yaw), std::sin(box1.yaw),
+                   box1.half_length, box1.half_width,
+                   box2.x, box2.y, std::cos(box2.yaw), std::sin(box2.yaw),
+                   box2.half_length, box2.half_width);
+  }
+
+protected:
+
+  int32_t cell(const double v) const {
+    return static_cast<int32_t>(std::floor(v/cell_size_));
+  }
+
+  static int64_t cellKey(const int32_t ix, const int32_t iy) {
+    return (static_cast<int64_t>(ix) << 32) |
+           static_cast<int64_t>(static_cast<uint32_t>(iy));
+  }
+
+  /**
+   * \brief Separating axis test between two boxes.
+   *
+   * The four candidate axes are the heading and lateral directions of the
+   * two boxes. The boxes overlap iff they are not separated along any of
+   * the axes.
+   */
+  static bool overlap(
+      const double x1, const double y1, const double c1, const double s1,
+      const double l1, const double w1,
+      const double x2, const double y2, const double c2, const double s2,
+      const double l2, const double w2) {
+
+    const double dx = x2 - x1;
+    const double dy = y2 - y1;
+
+    // Cosines between the axes of the two boxes.
+    const double cc = std::fabs(c1*c2 + s1*s2);
+    const double cs = std::fabs(c1*s2 - s1*c2);
+
+    // Heading and lateral axes of box 1.
+    const bool sep1 = std::fabs( c1*dx + s1*dy) > l1 + l2*cc + w2*cs;
+    const bool sep2 = std::fabs(-s1*dx + c1*dy) > w1 + l2*cs + w2*cc;
+    // Heading and lateral axes of box 2.
+    const bool sep3 = std::fabs( c2*dx + s2*dy) > l2 + l1*cc + w1*cs;
+    const bool sep4 = std::fabs(-s2*dx + c2*dy) > w2 + l1*cs + w1*cc;
+
+    return !(sep1 | sep2 | sep3 | sep4);
+  }
+
+  /// Collect the candidate pairs whose axis-aligned bounds overlap into \c candidates_.
+  void broadPhase() {
+
+    candidates_.clear();
+
+    // Group the boxes by cell. Sorting in place does not allocate.
+    std::sort(cells_.begin(), cells_.end());
+
+    for (size_t first = 0; first < cells_.size();) {
+      const int64_t key = cells_[first].first;
+      size_t last = first + 1;
+      while (last < cells_.size() && cells_[last].first == key) ++last;
+
+      for (size_t m = first; m < last; ++m) {
+        for (size_t n = m+1; n < last; ++n) {
+          const size_t i = std::min(cells_[m].second, cells_[n].second);
+          const size_t j = std::max(cells_[m].second, cells_[n].second);
+
+          const double min_x = std::max(min_xs_[i], min_xs_[j]);
+          const double min_y = std::max(min_ys_[i], min_ys_[j]);
+          if (min_x > std::min(max_xs_[i], max_xs_[j])) continue;
+          if (min_y > std::min(max_ys_[i], max_ys_[j])) continue;
+
+          // A pair of boxes may share several cells. The pair is only
+          // reported by the cell containing the lower corner of the
+          // overlapping bounds, so that each pair is reported once.
+          if (cellKey(cell(min_x), cell(min_y)) != key) continue;
+          candidates_.emplace_back(i, j);
+        }
+      }
+
+      first = last;
+    }
+
+    return;
+  }
+
+  /// Run the separating axis test on \c candidates_, the colliding pairs
+  /// are stored in \c collisions_.
+  void narrowPhase() {
+
+    results_.resize(candidates_.size());
+    for (size_t k = 0; k < candidates_.size(); ++k) {
+      const size_t i = candidates_[k].first;
+      const size_t j = candidates_[k].second;
+      results_[k] = overlap(
+          xs_[i], ys_[i], cos_yaws_[i], sin_yaws_[i], half_lengths_[i], half_widths_[i],
+          xs_[j], ys_[j], cos_yaws_[j], sin_yaws_[j], half_lengths_[j], half_widths_[j]);
+    }
+
+    collisions_.clear();
+    for (size_t k = 0; k < candidates_.size(); ++k) {
+      if (results_[k]) collisions_.push_back(candidates_[k]);
+    }
+    std::sort(collisions_.begin(), collisions_.end());
+
+    return;
+  }
+
+}; // End class CollisionChecker.
+
+} // End namespace utils.
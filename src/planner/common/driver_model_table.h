@@ -0,0 +1,137 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include <limits>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/format.hpp>
+#include <boost/smart_ptr.hpp>
+#include <planner/common/intelligent_driver_model.h>
+
+namespace planner {
+
+/**
+ * \brief DriverModelTable assigns intelligent driver models to the vehicles
+ *        by their classes.
+ *
+ * A vehicle class covers the vehicles no longer than its \c max_length, and
+ * longer than the \c max_length of the previous class. The class of a vehicle
+ * is therefore the first class, in the ascending order of \c max_length, that
+ * is long enough for the vehicle. Vehicles longer than all classes use the
+ * default model.
+ *
+ * The models of the classes are usually calibrated from the recorded
+ * trajectories of the agents, see \c scripts/calibrate_driver_models.py.
+ */
+class DriverModelTable {
+
+public:
+
+  struct VehicleClass {
+    /// Name of the class, e.g. car or truck.
+    std::string name;
+    /// Length (m) of the longest vehicle in the class.
+    double max_length;
+    /// The driver model of the vehicles in the class.
+    boost::shared_ptr<const IntelligentDriverModel> model;
+  };
+
+protected:
+
+  /// The vehicle classes in the ascending order of their maximum lengths.
+  std::vector<VehicleClass> classes_;
+
+  /// The model of the vehicles not covered by any class.
+  boost::shared_ptr<const IntelligentDriverModel> default_model_;
+
+public:
+
+  DriverModelTable() :
+    default_model_(boost::make_shared<const IntelligentDriverModel>()) {}
+
+  DriverModelTable(const boost::shared_ptr<const IntelligentDriverModel>& default_model) :
+    default_model_(default_model) {
+    if (!default_model_) {
+      throw std::runtime_error(
+          "DriverModelTable::DriverModelTable(): default model = nullptr.\n");
+    }
+  }
+
+  /**
+   * \brief Add a vehicle class.
+   * \param[in] name The name of the class.
+   * \param[in] max_length The length (m) of the longest vehicle in the class,
+   *                       which can be infinity.
+   * \param[in] model The driver model of the vehicles in the class.
+   */
+  void add(const std::string& name,
+           const double max_length,
+           const boost::shared_ptr<const IntelligentDriverModel>& model) {
+    if (!(max_length > 0.0)) {
+      throw std::runtime_error((boost::format(
+            "DriverModelTable::add(): "
+            "class %1% has non-positive maximum length %2%.\n") % name % max_length).str());
+    }
+    if (!model) {
+      throw std::runtime_error((boost::format(
+            "DriverModelTable::add(): class %1% has no model.\n") % name).str());
+    }
+
+    std::vector<VehicleClass>::iterator iter = std::upper_bound(
+        classes_.begin(), classes_.end(), max_length,
+        [](const double length, const VehicleClass& c)->bool{
+          return length < c.max_length;
+        });
+    classes_.insert(iter, VehicleClass{name, max_length, model});
+    return;
+  }
+
+  /// Get the vehicle classes in the ascending order of their maximum lengths.
+  const std::vector<VehicleClass>& classes() const { return classes_; }
+
+  /// Get the model of the vehicles not covered by any class.
+  const boost::shared_ptr<const IntelligentDriverModel>& defaultModel() const {
+    return default_model_;
+  }
+
+  /// Get the driver model of a vehicle with the given length (m).
+  const boost::shared_ptr<const IntelligentDriverModel>& model(const double length) const {
+    for (const VehicleClass& c : classes_) {
+      if (length <= c.max_length) return c.model;
+    }
+    return default_model_;
+  }
+
+  std::string string(const std::string& prefix = "") const {
+    std::string output = prefix;
+    for (const VehicleClass& c : classes_) {
+      output += (boost::format(
+            "%1% (<=%2%m): time gap:%3% distance gap:%4% comfort accel:%5% "
+            "comfort decel:%6% coolness:%7%\n")
+          % c.name % c.max_length
+          % c.model->timeGap() % c.model->distanceGap()
+          % c.model->comfortAccel() % c.model->comfortDecel()
+          % c.model->coolnessFactor()).str();
+    }
+    return output;
+  }
+
+}; // End class DriverModelTable.
+
+} // End namespace planner.
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/format.hpp>
+#include <boost/optional.hpp>
+
+namespace planner {
+
+/**
+ * \brief EdgeLengthPolicy selects the length of the edges leaving a vertex
+ *        from a set of candidate lengths.
+ *
+ * Within \c near_range of the root, the edge covers the distance the ego
+ * travels in \c travel_time at its current speed, which is further capped by
+ * the gap to the vehicle in front on the target lane. The shortest candidate
+ * no shorter than this distance is selected. Beyond \c near_range, the
+ * longest candidate is used. This leads to short edges close to the ego, in
+ * dense or slow traffic, and long edges further out.
+ *
+ * If \c alignment is positive, the selected length is extended so that the
+ * edge ends at a multiple of \c alignment from the root. Edges of different
+ * lengths from different vertices then end at the same nodes on the waypoint
+ * lattice, where the vertices (and the snapshots) are merged and reused.
+ *
+ * With a single candidate length and no alignment, which is the default,
+ * every edge has the same length, i.e. 50m.
+ */
+class EdgeLengthPolicy {
+
+protected:
+
+  /// The candidate edge lengths in the ascending order.
+  std::vector<double> lengths_;
+
+  /// Distance from the root within which the edge lengths adapt to the traffic.
+  double near_range_ = 100.0;
+
+  /// The time (s) for the ego to travel along an edge close to the root.
+  double travel_time_ = 3.0;
+
+  /// The edges end at multiples of this distance from the root, not used if non-positive.
+  double alignment_ = 0.0;
+
+public:
+
+  EdgeLengthPolicy() : lengths_({50.0}) {}
+
+  EdgeLengthPolicy(const std::vector<double>& lengths,
+                   const double near_range = 100.0,
+                   const double travel_time = 3.0,
+                   const double alignment = 0.0) :
+    lengths_(lengths),
+    near_range_(near_range),
+    travel_time_(travel_time),
+    alignment_(alignment) {
+
+    if (lengths_.empty()) {
+      throw std::runtime_error(
+          "EdgeLengthPolicy::EdgeLengthPolicy(): no candidate edge length is given.\n");
+    }
+    for (const double length : lengths_) {
+      if (length > 0.0) continue;
+      throw std::runtime_error((boost::format(
+            "EdgeLengthPolicy::EdgeLengthPolicy(): "
+            "candidate edge length %1% is not positive.\n") % length).str());
+    }
+
+    std::sort(lengths_.begin(), lengths_.end());
+    lengths_.erase(std::unique(lengths_.begin(), lengths_.end()), lengths_.end());
+    return;
+  }
+
+  /// Get the candidate edge lengths in the ascending order.
+  const std::vector<double>& lengths() const { return lengths_; }
+
+  const double shortest() const { return lengths_.front(); }
+  const double longest() const { return lengths_.back(); }
+
+  const double nearRange() const { return near_range_; }
+  const double travelTime() const { return travel_time_; }
+  const double alignment() const { return alignment_; }
+
+  /**
+   * \brief Select the length of an edge leaving a vertex.
+   *
+   * \param[in] distance The distance from the root to the vertex.
+   * \param[in] speed The speed of the ego at the vertex.
+   * \param[in] gap The gap to the vehicle in front on the target lane, if any.
+   * \return The length of the edge.
+   */
+  const double length(const double distance,
+                      const double speed,
+                      const boost::optional<double>& gap = boost::none) const {
+
+    double length = lengths_.back();
+
+    if (lengths_.size() > 1 && distance < near_range_) {
+      double preferred = speed * travel_time_;
+      if (gap) preferred = std::min(preferred, *gap);
+
+      std::vector<double>::const_iterator iter =
+        std::lower_bound(lengths_.begin(), lengths_.end(), preferred);
+      if (iter != lengths_.end()) length = *iter;
+    }
+
+    if (alignment_ <= 0.0) return length;
+
+    // Extend the edge to the next multiple of the alignment from the root.
+    // A small tolerance avoids extending an already aligned edge.
+    const double end = std::ceil((distance+length)/alignment_ - 1.0e-6) * alignment_;
+    return end - distance;
+  }
+
+  std::string string(const std::string& prefix = "") const {
+    std::string output = prefix + "edge lengths:";
+    for (const double length : lengths_)
+      output += (boost::format(" %1%") % length).str();
+    output += (boost::format(
+          "\nnear range:%1% travel time:%2% alignment:%3%\n")
+        % near_range_ % travel_time_ % alignment_).str();
+    return output;
+  }
+
+}; // End class EdgeLengthPolicy.
+
+} // End namespace planner.
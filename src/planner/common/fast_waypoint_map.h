@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <mutex>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -31,6 +32,17 @@
 
 namespace utils {
 
+/**
+ * \brief FastWaypointMap finds the carla waypoint closest to a location.
+ *
+ * The waypoints of the whole map are generated at the given resolution
+ * once in the constructor, and are kept in a KD tree afterwards.
+ *
+ * The map is immutable after construction. All const member functions can
+ * be called concurrently from multiple threads. Since FLANN does not
+ * guarantee its search to be free of internal state, the KD tree search is
+ * serialized internally, while the rest of the query runs in parallel.
+ */
 class FastWaypointMap : private boost::noncopyable {
 
 protected:
@@ -73,6 +85,9 @@ protected:
   /// The point cloud built with all waypoint locations.
   pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_ = nullptr;
 
+  /// Serializes the searches in \c kdtree_.
+  mutable std::mutex kdtree_mutex_;
+
 public:
 
   FastWaypointMap(const boost::shared_ptr<const CarlaMap>& map,
@@ -116,7 +131,11 @@ public:
     // Search for the closest point.
     std::vector<int> indices(1);
     std::vector<float> sqr_distance(1);
-    int num = kdtree_.nearestKSearch(query_point, 1, indices, sqr_distance);
+    int num = 0;
+    {
+      std::lock_guard<std::mutex> kdtree_lock(kdtree_mutex_);
+      num = kdtree_.nearestKSearch(query_point, 1, indices, sqr_distance);
+    }
 
     if (num <= 0) {
       std::string error_msg("Cannot find a waypoint close to the query location.\n");
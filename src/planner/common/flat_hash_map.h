@@ -0,0 +1,370 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <tuple>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <stdexcept>
+#include <functional>
+#include <type_traits>
+#include <initializer_list>
+#include <boost/optional.hpp>
+
+namespace utils {
+
+/**
+ * \brief FlatHashMap is an open-addressing hash map with linear probing.
+ *
+ * All key-value pairs are stored in a single contiguous array. Compared to
+ * \c std::unordered_map, there is no per-element allocation, and a lookup
+ * touches consecutive memory instead of chasing bucket pointers. This also
+ * makes copying the map (e.g. with every copy of a snapshot) a single
+ * array copy.
+ *
+ * The interface follows a subset of \c std::unordered_map, with the
+ * following differences:
+ * - Iterators and references are invalidated by any insertion or erasure.
+ * - Elements can only be erased by key.
+ * - The key in a dereferenced iterator is not const. It should never be
+ *   modified through the iterator.
+ *
+ * Erased slots are reclaimed with backward-shift deletion, so that there is
+ * no tombstone and the probe sequences stay short.
+ */
+template<typename Key,
+         typename Value,
+         typename Hash = std::hash<Key>,
+         typename KeyEqual = std::equal_to<Key>>
+class FlatHashMap {
+
+public:
+
+  using key_type    = Key;
+  using mapped_type = Value;
+  using value_type  = std::pair<Key, Value>;
+  using size_type   = size_t;
+
+protected:
+
+  using Slot = boost::optional<value_type>;
+
+  /// Forward iterator over the occupied slots.
+  template<bool IsConst>
+  class Iterator {
+
+    friend class FlatHashMap;
+    template<bool> friend class Iterator;
+
+  public:
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = typename FlatHashMap::value_type;
+    using difference_type   = std::ptrdiff_t;
+    using reference  = typename std::conditional<IsConst, const value_type&, value_type&>::type;
+    using pointer    = typename std::conditional<IsConst, const value_type*, value_type*>::type;
+
+  protected:
+
+    using Slots = typename std::conditional<
+      IsConst, const std::vector<Slot>, std::vector<Slot>>::type;
+
+    Slots* slots_ = nullptr;
+    size_t idx_ = 0;
+
+  public:
+
+    Iterator() = default;
+
+    Iterator(Slots* slots, const size_t idx) : slots_(slots), idx_(idx) {
+      skipEmptySlots();
+    }
+
+    /// Conversion from a non-const iterator to a const iterator.
+    template<bool OtherIsConst,
+             typename = typename std::enable_if<IsConst && !OtherIsConst>::type>
+    Iterator(const Iterator<OtherIsConst>& other) :
+      slots_(other.slots_), idx_(other.idx_) {}
+
+    reference operator*() const { return *((*slots_)[idx_]); }
+    pointer operator->() const { return &(*((*slots_)[idx_])); }
+
+    Iterator& operator++() {
+      ++idx_;
+      skipEmptySlots();
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator iter = *this;
+      ++(*this);
+      return iter;
+    }
+
+    bool operator==(const Iterator& other) const { return idx_ == other.idx_; }
+    bool operator!=(const Iterator& other) const { return idx_ != other.idx_; }
+
+  protected:
+
+    void skipEmptySlots() {
+      while (idx_ < slots_->size() && !((*slots_)[idx_])) ++idx_;
+    }
+
+  }; // End class Iterator.
+
+public:
+
+  using iterator       = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+protected:
+
+  /// Minimum number of slots once the map holds any element.
+  static constexpr size_t kMinCapacity_ = 8;
+
+  /// The storage of the key-value pairs. The size is always a power of 2.
+  std::vector<Slot> slots_;
+
+  /// Number of elements in the map.
+  size_t size_ = 0;
+
+  /// Right shift applied to the mixed hash value to get the home slot.
+  size_t shift_ = 64;
+
+  Hash hash_;
+  KeyEqual equal_;
+
+public:
+
+  FlatHashMap() = default;
+
+  /// Construct an empty map with space reserved for \c n elements.
+  explicit FlatHashMap(const size_t n) { reserve(n); }
+
+  template<typename InputIt>
+  FlatHashMap(InputIt first, InputIt last) {
+    for (; first != last; ++first) insert(*first);
+  }
+
+  FlatHashMap(std::initializer_list<value_type> init) :
+    FlatHashMap(init.begin(), init.end()) {}
+
+  /// Get the number of elements in the map.
+  size_t size() const { return size_; }
+
+  /// Check whether the map is empty.
+  bool empty() const { return size_ == 0; }
+
+  /// Get the number of slots allocated.
+  size_t capacity() const { return slots_.size(); }
+
+  /// Remove all elements. The allocated slots are kept for reuse.
+  void clear() {
+    for (auto& slot : slots_) slot = boost::none;
+    size_ = 0;
+    return;
+  }
+
+  /**
+   * \brief Make sure \c n elements can be held without rehashing.
+   *
+   * The map never shrinks with this function.
+   */
+  void reserve(const size_t n) {
+    size_t capacity = kMinCapacity_;
+    while (capacity*kMaxLoadNumerator_ < n*kMaxLoadDenominator_) capacity *= 2;
+    if (capacity > slots_.size()) rehash(capacity);
+    return;
+  }
+
+  iterator begin() { return iterator(&slots_, 0); }
+  iterator end() { return iterator(&slots_, slots_.size()); }
+
+  const_iterator begin() const { return const_iterator(&slots_, 0); }
+  const_iterator end() const { return const_iterator(&slots_, slots_.size()); }
+
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  iterator find(const Key& key) {
+    return iterator(&slots_, findSlot(key));
+  }
+
+  const_iterator find(const Key& key) const {
+    return const_iterator(&slots_, findSlot(key));
+  }
+
+  size_t count(const Key& key) const {
+    return findSlot(key) < slots_.size() ? 1 : 0;
+  }
+
+  Value& at(const Key& key) {
+    const size_t idx = findSlot(key);
+    if (idx >= slots_.size())
+      throw std::out_of_range("FlatHashMap::at(): key is not in the map.\n");
+    return slots_[idx]->second;
+  }
+
+  const Value& at(const Key& key) const {
+    const size_t idx = findSlot(key);
+    if (idx >= slots_.size())
+      throw std::out_of_range("FlatHashMap::at(): key is not in the map.\n");
+    return slots_[idx]->second;
+  }
+
+  /// Access the value of the given key, which is default constructed if absent.
+  Value& operator[](const Key& key) {
+    return emplace(key).first->second;
+  }
+
+  /**
+   * \brief Insert a key-value pair.
+   * \return The iterator to the element with the key, and whether the
+   *         insertion took place. An existing value is not overwritten.
+   */
+  std::pair<iterator, bool> insert(const value_type& value) {
+    return emplace(value.first, value.second);
+  }
+
+  /**
+   * \brief Construct a value in place if the key does not exist.
+   * \return The iterator to the element with the key, and whether the
+   *         insertion took place.
+   */
+  template<typename... Args>
+  std::pair<iterator, bool> emplace(const Key& key, Args&&... args) {
+    size_t idx = findSlot(key);
+    if (idx < slots_.size()) return std::make_pair(iterator(&slots_, idx), false);
+
+    // Grow the map if the load factor would exceed the limit.
+    if ((size_+1)*kMaxLoadDenominator_ > slots_.size()*kMaxLoadNumerator_)
+      rehash(slots_.empty() ? kMinCapacity_ : slots_.size()*2);
+
+    idx = homeSlot(key);
+    while (slots_[idx]) idx = nextSlot(idx);
+
+    slots_[idx] = value_type(
+        std::piecewise_construct,
+        std::forward_as_tuple(key),
+        std::forward_as_tuple(std::forward<Args>(args)...));
+    ++size_;
+    return std::make_pair(iterator(&slots_, idx), true);
+  }
+
+  /**
+   * \brief Erase the element with the given key.
+   * \return The number of erased elements, i.e. 0 or 1.
+   */
+  size_t erase(const Key& key) {
+    size_t idx = findSlot(key);
+    if (idx >= slots_.size()) return 0;
+
+    slots_[idx] = boost::none;
+    --size_;
+
+    // Shift the following elements of the same cluster backwards, if
+    // their home slots are not within (idx, next].
+    size_t next = nextSlot(idx);
+    while (slots_[next]) {
+      const size_t home = homeSlot(slots_[next]->first);
+      const bool movable = (idx <= next) ?
+        (home <= idx || home > next) : (home <= idx && home > next);
+
+      if (movable) {
+        slots_[idx] = std::move(slots_[next]);
+        slots_[next] = boost::none;
+        idx = next;
+      }
+      next = nextSlot(next);
+    }
+
+    return 1;
+  }
+
+  void swap(FlatHashMap& other) {
+    std::swap(slots_, other.slots_);
+    std::swap(size_, other.size_);
+    std::swap(shift_, other.shift_);
+    std::swap(hash_, other.hash_);
+    std::swap(equal_, other.equal_);
+    return;
+  }
+
+protected:
+
+  /// The maximum load factor is \c kMaxLoadNumerator_/kMaxLoadDenominator_.
+  static constexpr size_t kMaxLoadNumerator_ = 3;
+  static constexpr size_t kMaxLoadDenominator_ = 4;
+
+  /**
+   * \brief Find the home slot of a key.
+   *
+   * The hash value is mixed with the fibonacci multiplier before taking the
+   * top bits, since \c std::hash is the identity function for integers and
+   * the vehicle IDs are usually consecutive numbers.
+   */
+  size_t homeSlot(const Key& key) const {
+    static_assert(sizeof(size_t) == 8, "FlatHashMap requires 64-bit size_t.");
+    return (static_cast<uint64_t>(hash_(key)) * 0x9e3779b97f4a7c15ull) >> shift_;
+  }
+
+  size_t nextSlot(const size_t idx) const {
+    return (idx+1) & (slots_.size()-1);
+  }
+
+  /// Find the slot of the key, \c slots_.size() is returned if not found.
+  size_t findSlot(const Key& key) const {
+    if (size_ == 0) return slots_.size();
+
+    size_t idx = homeSlot(key);
+    while (slots_[idx]) {
+      if (equal_(slots_[idx]->first, key)) return idx;
+      idx = nextSlot(idx);
+    }
+    return slots_.size();
+  }
+
+  /// Rehash all elements into the given number of slots (a power of 2).
+  void rehash(const size_t capacity) {
+    std::vector<Slot> old_slots(capacity);
+    std::swap(slots_, old_slots);
+
+    shift_ = 64;
+    for (size_t c = capacity; c > 1; c >>= 1) --shift_;
+
+    for (auto& slot : old_slots) {
+      if (!slot) continue;
+      size_t idx = homeSlot(slot->first);
+      while (slots_[idx]) idx = nextSlot(idx);
+      slots_[idx] = std::move(slot);
+    }
+    return;
+  }
+
+}; // End class FlatHashMap.
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+constexpr size_t FlatHashMap<Key, Value, Hash, KeyEqual>::kMinCapacity_;
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+constexpr size_t FlatHashMap<Key, Value, Hash, KeyEqual>::kMaxLoadNumerator_;
+
+template<typename Key, typename Value, typename Hash, typename KeyEqual>
+constexpr size_t FlatHashMap<Key, Value, Hash, KeyEqual>::kMaxLoadDenominator_;
+
+} // End namespace utils.
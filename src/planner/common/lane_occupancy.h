@@ -0,0 +1,177 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/format.hpp>
+#include <boost/optional.hpp>
+
+namespace planner {
+
+/**
+ * \brief LaneOccupancy indexes the vehicles on a road segment by lane.
+ *
+ * Each vehicle occupies an interval [rear, head] of the longitudinal distance
+ * on a lane, and the intervals on each lane are kept sorted. Front and back
+ * vehicles of a location are then found with a binary search, instead of
+ * walking the nodes of the lane one at a time. A vehicle changing lanes
+ * may be added to both lanes, where it may overlap the other vehicles, so
+ * the heads of the intervals on a lane are not necessarily sorted.
+ */
+class LaneOccupancy {
+
+public:
+
+  /// The interval occupied by a vehicle on a lane.
+  struct Interval {
+    double rear;
+    double head;
+    size_t vehicle;
+  };
+
+protected:
+
+  /// Intervals of the vehicles on each lane, sorted by the rear distance.
+  std::vector<std::vector<Interval>> lanes_;
+
+  /// The furthest head among the intervals up to (including) each interval
+  /// on each lane, which is non-decreasing even if the heads are not.
+  std::vector<std::vector<double>> reaches_;
+
+public:
+
+  LaneOccupancy(const size_t lanes = 0) : lanes_(lanes), reaches_(lanes) {}
+
+  /// Number of lanes indexed.
+  const size_t lanes() const { return lanes_.size(); }
+
+  /// Number of vehicles on a lane.
+  const size_t count(const size_t lane) const {
+    if (lane >= lanes_.size()) return 0;
+    return lanes_[lane].size();
+  }
+
+  /// The sorted intervals of the vehicles on a lane.
+  const std::vector<Interval>& intervals(const size_t lane) const {
+    checkLane(lane, "intervals");
+    return lanes_[lane];
+  }
+
+  /**
+   * \brief Add a vehicle to a lane.
+   *
+   * The lanes are expanded if the given lane index is out of range.
+   *
+   * \param[in] lane The lane index.
+   * \param[in] rear The distance of the vehicle rear.
+   * \param[in] head The distance of the vehicle head.
+   * \param[in] vehicle The ID of the vehicle.
+   */
+  void add(const size_t lane, const double rear, const double head, const size_t vehicle) {
+    if (head < rear) {
+      throw std::runtime_error((boost::format(
+            "LaneOccupancy::add(): "
+            "vehicle %1% has head %2% behind rear %3%.\n") % vehicle % head % rear).str());
+    }
+
+    if (lane >= lanes_.size()) {
+      lanes_.resize(lane+1);
+      reaches_.resize(lane+1);
+    }
+    std::vector<Interval>& intervals = lanes_[lane];
+    std::vector<double>& reaches = reaches_[lane];
+
+    const Interval interval{rear, head, vehicle};
+    std::vector<Interval>::iterator iter = std::upper_bound(
+        intervals.begin(), intervals.end(), interval,
+        [](const Interval& a, const Interval& b) { return a.rear < b.rear; });
+    const size_t index = iter - intervals.begin();
+    intervals.insert(iter, interval);
+
+    // Update the reaches from the inserted interval on.
+    reaches.resize(intervals.size());
+    for (size_t i = index; i < intervals.size(); ++i) {
+      reaches[i] = i == 0 ? intervals[i].head :
+                            std::max(reaches[i-1], intervals[i].head);
+    }
+    return;
+  }
+
+  /**
+   * \brief Find the front vehicle of a location on a lane.
+   *
+   * The front vehicle is the first vehicle whose head is ahead of the location.
+   *
+   * \param[in] lane The lane index.
+   * \param[in] distance The distance of the query location.
+   * \return The front vehicle and the gap from the location to its rear,
+   *         which is negative if the vehicle overlaps the location.
+   *         \c boost::none if there is no front vehicle.
+   */
+  boost::optional<std::pair<size_t, double>> frontVehicle(
+      const size_t lane, const double distance) const {
+    if (lane >= lanes_.size()) return boost::none;
+    const std::vector<Interval>& intervals = lanes_[lane];
+    const std::vector<double>& reaches = reaches_[lane];
+
+    // The first interval whose head is ahead of the location is also the
+    // first one whose reach is ahead of it, and the reaches are sorted.
+    std::vector<double>::const_iterator iter = std::upper_bound(
+        reaches.begin(), reaches.end(), distance);
+    if (iter == reaches.end()) return boost::none;
+    const Interval& interval = intervals[iter-reaches.begin()];
+    return std::make_pair(interval.vehicle, interval.rear-distance);
+  }
+
+  /**
+   * \brief Find the back vehicle of a location on a lane.
+   *
+   * The back vehicle is the last vehicle whose rear is behind the location.
+   *
+   * \param[in] lane The lane index.
+   * \param[in] distance The distance of the query location.
+   * \return The back vehicle and the gap from its head to the location,
+   *         which is negative if the vehicle overlaps the location.
+   *         \c boost::none if there is no back vehicle.
+   */
+  boost::optional<std::pair<size_t, double>> backVehicle(
+      const size_t lane, const double distance) const {
+    if (lane >= lanes_.size()) return boost::none;
+    const std::vector<Interval>& intervals = lanes_[lane];
+
+    std::vector<Interval>::const_iterator iter = std::lower_bound(
+        intervals.begin(), intervals.end(), distance,
+        [](const Interval& interval, const double d) { return interval.rear < d; });
+    if (iter == intervals.begin()) return boost::none;
+    --iter;
+    return std::make_pair(iter->vehicle, distance-iter->head);
+  }
+
+protected:
+
+  void checkLane(const size_t lane, const std::string& func) const {
+    if (lane < lanes_.size()) return;
+    throw std::runtime_error((boost::format(
+          "LaneOccupancy::%1%(): lane %2% is out of range [0, %3%).\n")
+        % func % lane % lanes_.size()).str());
+  }
+
+}; // End class LaneOccupancy.
+
+} // End namespace planner.
@@ -14,10 +14,16 @@
 
 #pragma once
 
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
 #include <vector>
 #include <queue>
 #include <unordered_map>
 #include <string>
+#include <istream>
+#include <ostream>
+#include <functional>
 
 #include <boost/smart_ptr.hpp>
 #include <boost/pointer_cast.hpp>
@@ -30,6 +36,8 @@
 #include <carla/road/Lane.h>
 
 #include <router/common/router.h>
+#include <router/common/waypoint_cache.h>
+#include <planner/common/flat_hash_map.h>
 
 namespace planner {
 
@@ -174,6 +182,22 @@ public:
  * possible. The lattice is paved following the road sequence given by the router.
  *
  * See \c WaypointNode to find the interface required for the \c Node template.
+ *
+ * The const member functions only read the lattice, and can be called
+ * concurrently from multiple threads, as long as no thread modifies the
+ * lattice (e.g. \c extend(), \c shorten(), \c shift()) at the same time.
+ * A lattice to be shared by several planning threads should therefore be
+ * held as \c boost::shared_ptr<const Lattice>. The nodes returned by the
+ * queries are read-only, and stay valid as long as the returned pointers
+ * are held, even if the lattice is modified afterwards.
+ *
+ * A lattice can also be constructed lazily, in which case only the nodes
+ * around the start are created at first. The rest of the nodes within the
+ * range of the lattice, i.e. its \c horizon(), are created once a forward
+ * query through a non-const lattice reaches them. The nodes are created in
+ * the same way as \c extend() would, so that the queries return the same
+ * results as on an eagerly constructed lattice. Queries through a const
+ * lattice never modify the lattice, and only see the nodes created so far.
  */
 template<typename Node>
 class Lattice {
@@ -186,6 +210,28 @@ protected:
   using CarlaLane      = carla::road::Lane;
   using CarlaTransform = carla::geom::Transform;
   using CarlaVector3D  = carla::geom::Vector3D;
+  using CarlaLocation  = carla::geom::Location;
+
+public:
+
+  /**
+   * \brief Used to find the carla waypoint of a node while loading a serialized lattice.
+   *
+   * The arguments are the ID and the location of the waypoint at the time
+   * the lattice is serialized. The returned waypoint is not required to have
+   * the same ID, so that a lattice can be loaded against a stand-in map.
+   */
+  using WaypointResolver = std::function<
+    boost::shared_ptr<const carla::client::Waypoint>(
+        const size_t, const carla::geom::Location&)>;
+
+protected:
+
+  /// Magic number at the beginning of a serialized lattice.
+  static constexpr uint32_t kSerializationMagic_ = 0x4c504c43;
+
+  /// Version of the serialization format.
+  static constexpr uint32_t kSerializationVersion_ = 1;
 
 protected:
 
@@ -199,7 +245,7 @@ protected:
   std::vector<boost::weak_ptr<Node>> lattice_exits_;
 
   /// A mapping from carla waypoint ID to the corresponding node in the lattice.
-  std::unordered_map<size_t, boost::shared_ptr<Node>> waypoint_to_node_table_;
+  utils::FlatHashMap<size_t, boost::shared_ptr<Node>> waypoint_to_node_table_;
 
   /**
    * A mapping from road+lane IDs to the carla waypoint IDs on this road+lane.
@@ -209,12 +255,26 @@ protected:
    * For each element in the map, the key is the hash value combining the road
    * ID and the lane ID, the value is the waypoints on this road and lane.
    */
-  std::unordered_map<size_t, std::vector<size_t>> roadlane_to_waypoints_table_;
+  utils::FlatHashMap<size_t, std::vector<size_t>> roadlane_to_waypoints_table_;
 
   /// Range resolution (distance between two connected nodes) in the
   /// longitudinal direction.
   double longitudinal_resolution_;
 
+  /// The range up to which a lazy lattice is kept. Nodes within
+  /// the horizon are only created once queried.
+  double horizon_ = 0.0;
+
+  /// Whether the nodes are created on demand.
+  bool lazy_ = false;
+
+  /// Accumulated wall time (s) spent on creating and removing nodes.
+  double construction_time_ = 0.0;
+
+  /// Minimum range (m) by which a lazy lattice is extended at once, so that
+  /// the entries and exits are not searched again for every query.
+  static constexpr double kLazyExtension_ = 20.0;
+
 public:
 
   /**
@@ -225,23 +285,82 @@ public:
    * \param[in] longitudinal_resolution
    *            The distance between two consecutive nodes of the lattice on the same lane.
    * \param[in] router Used to tell roads and waypoints.
+   * \param[in] lazy If true, nodes beyond the start are only created
+   *                 once a forward query reaches them.
    */
   Lattice(const boost::shared_ptr<const CarlaWaypoint>& start,
           const double range,
           const double longitudinal_resolution,
+          const boost::shared_ptr<router::Router>& router,
+          const bool lazy = false);
+
+  /**
+   * \brief Construct the lattice from the data written by \c serialize().
+   *
+   * \param[in] is The input stream to read the lattice from.
+   * \param[in] resolver Used to find the carla waypoint of each node.
+   * \param[in] router Used to tell roads and waypoints.
+   */
+  Lattice(std::istream& is,
+          const WaypointResolver& resolver,
           const boost::shared_ptr<router::Router>& router);
 
   /// Copy constructor.
   Lattice(const Lattice& other);
 
+  /// Destructor.
+  virtual ~Lattice() {}
+
   /// Copy assignment operator.
   Lattice& operator=(Lattice other) {
     this->swap(other);
     return *this;
   }
 
+  /**
+   * \brief Write the lattice into a compact binary format.
+   *
+   * The waypoint ID and location, the distance, and the links of every node
+   * are written. The nodes are sorted by ID, so that the same lattice always
+   * results in the same data. The router is not serialized.
+   *
+   * Derived lattices with more states to save, e.g. \c TrafficLattice,
+   * override the function, so that the complete lattice is written even
+   * if it is serialized through a reference to the base class.
+   *
+   * \param[out] os The output stream to write the lattice to.
+   */
+  virtual void serialize(std::ostream& os) const;
+
+  /**
+   * \brief Get a \c WaypointResolver which projects the serialized locations
+   *        onto the given carla map.
+   */
+  static WaypointResolver mapWaypointResolver(
+      const boost::shared_ptr<const CarlaMap>& map) {
+    return [map](const size_t, const CarlaLocation& location)
+      ->boost::shared_ptr<const CarlaWaypoint> {
+      return map->GetWaypoint(location);
+    };
+  }
+
   const double longitudinalResolution() const { return longitudinal_resolution_; }
 
+  /// Whether the nodes are created on demand.
+  const bool lazy() const { return lazy_; }
+
+  /// The range up to which the lattice is kept, which may not be
+  /// fully constructed yet if the lattice is lazy.
+  const double horizon() const { return lazy_ ? horizon_ : range(); }
+
+  /**
+   * \brief Get the accumulated wall time (s) spent on constructing the lattice.
+   *
+   * This covers creating the nodes, either at construction or on demand,
+   * and removing the nodes while shortening the lattice, but not the queries.
+   */
+  const double constructionTime() const { return construction_time_; }
+
   /// Get the entry nodes of the lattice.
   std::vector<boost::shared_ptr<const Node>> latticeEntries() const {
     std::vector<boost::shared_ptr<const Node>> output;
@@ -256,6 +375,9 @@ public:
     return output;
   }
 
+  /// Return the number of nodes on the lattice.
+  const size_t size() const { return waypoint_to_node_table_.size(); }
+
   /// Return all nodes maintained by the lattice.
   std::unordered_map<size_t, boost::shared_ptr<const Node>> nodes() const;
 
@@ -299,16 +421,32 @@ public:
    * \brief Shift the lattice forward by some distance.
    *
    * The forward direction is defined by the road sequence in the router.
+   * A lazy lattice is only shortened from the back, and the nodes
+   * ahead are left to be created on demand.
    *
    * \param[in] movement How much distance to shift the lattice forward.
    */
   void shift(const double movement) {
     const double range = this->range();
+    if (lazy_) {
+      shorten(std::max(range-movement, 0.0));
+      return;
+    }
     extend(range + movement);
     shorten(range);
     return;
   }
 
+  /**
+   * \brief Make sure the nodes of a lazy lattice are created up to a distance.
+   *
+   * The lattice is not extended beyond its horizon. Nothing is done if the
+   * lattice is not lazy.
+   *
+   * \param[in] distance The lattice distance up to which nodes are required.
+   */
+  void materialize(const double distance);
+
   /**
    * \brief Find the closest node on the lattice given a carla waypoint.
    *
@@ -325,9 +463,7 @@ public:
   boost::shared_ptr<const Node> closestNode(
       const boost::shared_ptr<const CarlaWaypoint>& waypoint,
       const double tolerance) const {
-
-    Lattice* unconst_this = const_cast<Lattice*>(this);
-    return unconst_this->closestNode(waypoint, tolerance);
+    return findClosestNode(waypoint, tolerance);
   }
 
   /**
@@ -349,6 +485,8 @@ public:
    * If neither of the functions returns \c nullptr, they should return the
    * same node on the lattice.
    *
+   * The non-const versions of the forward queries create the nodes
+   * within the search range first, if the lattice is lazy.
    */
   /// @{
   boost::shared_ptr<const Node> front(
@@ -390,6 +528,41 @@ public:
   boost::shared_ptr<const Node> backRight(
       const boost::shared_ptr<const CarlaWaypoint>& query,
       const double range) const;
+
+  boost::shared_ptr<const Node> front(
+      const boost::shared_ptr<const CarlaWaypoint>& query,
+      const double range) {
+    materializeAhead(query, range);
+    return static_cast<const Lattice&>(*this).front(query, range);
+  }
+
+  boost::shared_ptr<const Node> leftFront(
+      const boost::shared_ptr<const CarlaWaypoint>& query,
+      const double range) {
+    materializeAhead(query, range);
+    return static_cast<const Lattice&>(*this).leftFront(query, range);
+  }
+
+  boost::shared_ptr<const Node> frontLeft(
+      const boost::shared_ptr<const CarlaWaypoint>& query,
+      const double range) {
+    materializeAhead(query, range);
+    return static_cast<const Lattice&>(*this).frontLeft(query, range);
+  }
+
+  boost::shared_ptr<const Node> rightFront(
+      const boost::shared_ptr<const CarlaWaypoint>& query,
+      const double range) {
+    materializeAhead(query, range);
+    return static_cast<const Lattice&>(*this).rightFront(query, range);
+  }
+
+  boost::shared_ptr<const Node> frontRight(
+      const boost::shared_ptr<const CarlaWaypoint>& query,
+      const double range) {
+    materializeAhead(query, range);
+    return static_cast<const Lattice&>(*this).frontRight(query, range);
+  }
   /// @}
 
   /// Get the string describing the lattice.
@@ -425,6 +598,20 @@ protected:
    */
   void swap(Lattice& other);
 
+  /**
+   * \brief Load the nodes of the lattice from the data written by \c serialize().
+   *
+   * Any existing nodes in the lattice are discarded.
+   *
+   * \param[in] is The input stream to read the lattice from.
+   * \param[in] resolver Used to find the carla waypoint of each node.
+   * \param[out] waypoint_id_table Maps the serialized waypoint IDs to the IDs
+   *                               of the resolved waypoints.
+   */
+  void deserialize(std::istream& is,
+                   const WaypointResolver& resolver,
+                   std::unordered_map<size_t, size_t>& waypoint_id_table);
+
   /**
    * \brief Add new element to the \c waypoint_to_node_ table.
    * \param[in] waypoint_id The id of the carla waypoint.
@@ -476,11 +663,48 @@ protected:
    */
   boost::shared_ptr<Node> closestNode(
       const boost::shared_ptr<const CarlaWaypoint>& waypoint,
-      const double tolerance);
+      const double tolerance) {
+    return findClosestNode(waypoint, tolerance);
+  }
+
+  /**
+   * \brief The implementation of \c closestNode().
+   *
+   * The search only reads the lattice, so that it is shared by both the
+   * const and non-const versions of \c closestNode().
+   */
+  boost::shared_ptr<Node> findClosestNode(
+      const boost::shared_ptr<const CarlaWaypoint>& waypoint,
+      const double tolerance) const;
 
   /// Find the entry and exit nodes on the lattice.
   void findLatticeEntriesAndExits();
 
+  /**
+   * \brief Create the nodes of a lazy lattice required by a forward query.
+   * \param[in] query The query waypoint.
+   * \param[in] range The range to search ahead.
+   */
+  void materializeAhead(
+      const boost::shared_ptr<const CarlaWaypoint>& query,
+      const double range) {
+    if (!lazy_) return;
+    const boost::shared_ptr<const Node> node =
+      findClosestNode(query, longitudinal_resolution_);
+    if (node) materialize(node->distance() + range + longitudinal_resolution_);
+    return;
+  }
+
+  /**
+   * \brief Add the wall time since \c start to the construction time.
+   * \param[in] start Where the construction started.
+   */
+  void addConstructionTime(const std::chrono::steady_clock::time_point& start) {
+    construction_time_ += std::chrono::duration<double>(
+        std::chrono::steady_clock::now()-start).count();
+    return;
+  }
+
   /**
    * \brief Find the front waypoint of the query waypoint.
    * \param[in] waypoint The query waypoint.
@@ -495,13 +719,13 @@ protected:
   /// Find the left waypoint of the query one.
   boost::shared_ptr<CarlaWaypoint> findLeftWaypoint(
       const boost::shared_ptr<const CarlaWaypoint>& waypoint) const {
-    return waypoint->GetLeft();
+    return router::WaypointCache::instance().left(waypoint);
   }
 
   /// Find the right waypoint of the query one.
   boost::shared_ptr<CarlaWaypoint> findRightWaypoint(
       const boost::shared_ptr<const CarlaWaypoint>& waypoint) const {
-    return waypoint->GetRight();
+    return router::WaypointCache::instance().right(waypoint);
   }
 
   /**
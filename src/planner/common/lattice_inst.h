@@ -14,26 +14,42 @@
 
 #pragma once
 
+#include <cmath>
 #include <limits>
 #include <utility>
 #include <stdexcept>
 #include <unordered_set>
 #include <algorithm>
 #include <string>
+#include <array>
 #include <boost/format.hpp>
+#include <boost/optional.hpp>
 
 #include <planner/common/lattice.h>
+#include <planner/common/serialization.h>
 
 namespace planner {
 
+template<typename Node>
+constexpr uint32_t Lattice<Node>::kSerializationMagic_;
+
+template<typename Node>
+constexpr uint32_t Lattice<Node>::kSerializationVersion_;
+
+template<typename Node>
+constexpr double Lattice<Node>::kLazyExtension_;
+
 template<typename Node>
 Lattice<Node>::Lattice(
   const boost::shared_ptr<const CarlaWaypoint>& start,
   const double range,
   const double longitudinal_resolution,
-  const boost::shared_ptr<router::Router>& router) :
+  const boost::shared_ptr<router::Router>& router,
+  const bool lazy) :
     router_(router),
-    longitudinal_resolution_(longitudinal_resolution) {
+    longitudinal_resolution_(longitudinal_resolution),
+    horizon_(std::ceil(range)),
+    lazy_(lazy) {
 
   if (range <= longitudinal_resolution_) {
     std::string error_msg = (boost::format(
@@ -52,8 +68,10 @@ Lattice<Node>::Lattice(
   augmentWaypointToNodeTable(start->GetId(), start_node);
   augmentRoadlaneToWaypointsTable(start);
 
-  // Construct the lattice.
-  extend(range);
+  // Construct the lattice. A lazy lattice only covers
+  // the start, and is extended as it is queried.
+  if (lazy_) extend(std::min(range, kLazyExtension_));
+  else extend(range);
 
   return;
 }
@@ -64,10 +82,14 @@ Lattice<Node>::Lattice(const Lattice<Node>& other) :
   lattice_entries_(other.lattice_entries_),
   lattice_exits_(other.lattice_exits_),
   roadlane_to_waypoints_table_(other.roadlane_to_waypoints_table_),
-  longitudinal_resolution_(other.longitudinal_resolution_) {
+  longitudinal_resolution_(other.longitudinal_resolution_),
+  horizon_(other.horizon_),
+  lazy_(other.lazy_),
+  construction_time_(other.construction_time_) {
 
   // Copy the \c waypoint_to_node_table_. Make sure this object
   // owns its own copy of the nodes pointed by shared pointers.
+  waypoint_to_node_table_.reserve(other.waypoint_to_node_table_.size());
   for (const auto& item : other.waypoint_to_node_table_) {
     waypoint_to_node_table_[item.first] = boost::make_shared<Node>(*(item.second));
   }
@@ -102,6 +124,165 @@ Lattice<Node>::Lattice(const Lattice<Node>& other) :
   return;
 }
 
+template<typename Node>
+Lattice<Node>::Lattice(
+    std::istream& is,
+    const WaypointResolver& resolver,
+    const boost::shared_ptr<router::Router>& router) :
+  router_(router) {
+
+  std::unordered_map<size_t, size_t> waypoint_id_table;
+  deserialize(is, resolver, waypoint_id_table);
+  return;
+}
+
+template<typename Node>
+void Lattice<Node>::serialize(std::ostream& os) const {
+
+  utils::writeBinary(os, kSerializationMagic_);
+  utils::writeBinary(os, kSerializationVersion_);
+  utils::writeBinary(os, longitudinal_resolution_);
+  utils::writeBinary(os, static_cast<uint64_t>(waypoint_to_node_table_.size()));
+
+  // Sort the nodes by ID so that the output does not depend on
+  // the iteration order of the hash table.
+  std::vector<size_t> waypoint_ids;
+  waypoint_ids.reserve(waypoint_to_node_table_.size());
+  for (const auto& item : waypoint_to_node_table_)
+    waypoint_ids.push_back(item.first);
+  std::sort(waypoint_ids.begin(), waypoint_ids.end());
+
+  // A link is written as a flag indicating whether the link exists,
+  // followed by the waypoint ID of the linked node.
+  auto writeLink = [&os](const boost::shared_ptr<const Node>& node)->void{
+    utils::writeBinary(os, static_cast<uint8_t>(node ? 1 : 0));
+    utils::writeBinary(os, static_cast<uint64_t>(node ? node->id() : 0));
+  };
+
+  for (const size_t id : waypoint_ids) {
+    const boost::shared_ptr<const Node> node = waypoint_to_node_table_.find(id)->second;
+    const CarlaLocation location = node->waypoint()->GetTransform().location;
+
+    utils::writeBinary(os, static_cast<uint64_t>(id));
+    utils::writeBinary(os, static_cast<double>(location.x));
+    utils::writeBinary(os, static_cast<double>(location.y));
+    utils::writeBinary(os, static_cast<double>(location.z));
+    utils::writeBinary(os, node->distance());
+
+    writeLink(node->front());
+    writeLink(node->back());
+    writeLink(node->left());
+    writeLink(node->right());
+  }
+
+  return;
+}
+
+template<typename Node>
+void Lattice<Node>::deserialize(
+    std::istream& is,
+    const WaypointResolver& resolver,
+    std::unordered_map<size_t, size_t>& waypoint_id_table) {
+
+  const uint32_t magic = utils::readBinary<uint32_t>(is);
+  const uint32_t version = utils::readBinary<uint32_t>(is);
+  if (magic != kSerializationMagic_ || version != kSerializationVersion_) {
+    std::string error_msg = (boost::format(
+          "Lattice::deserialize(): "
+          "invalid magic number [%1%] or version [%2%].\n")
+        % magic % version).str();
+    throw std::runtime_error(error_msg);
+  }
+
+  lattice_entries_.clear();
+  lattice_exits_.clear();
+  waypoint_to_node_table_.clear();
+  roadlane_to_waypoints_table_.clear();
+  waypoint_id_table.clear();
+
+  // A loaded lattice is always complete.
+  lazy_ = false;
+  horizon_ = 0.0;
+
+  longitudinal_resolution_ = utils::readBinary<double>(is);
+  const uint64_t node_num = utils::readBinary<uint64_t>(is);
+  waypoint_to_node_table_.reserve(node_num);
+
+  // Links of each node, in the order of front, back, left, and right.
+  // The links are kept with the serialized waypoint IDs, and are only
+  // resolved after all nodes are loaded.
+  using Links = std::array<boost::optional<size_t>, 4>;
+  std::vector<std::pair<boost::shared_ptr<Node>, Links>> node_links;
+  node_links.reserve(node_num);
+
+  for (uint64_t i = 0; i < node_num; ++i) {
+    const size_t id = utils::readBinary<uint64_t>(is);
+    const double x = utils::readBinary<double>(is);
+    const double y = utils::readBinary<double>(is);
+    const double z = utils::readBinary<double>(is);
+    const double distance = utils::readBinary<double>(is);
+
+    Links links;
+    for (auto& link : links) {
+      const uint8_t flag = utils::readBinary<uint8_t>(is);
+      const size_t link_id = utils::readBinary<uint64_t>(is);
+      if (flag) link = link_id;
+    }
+
+    const CarlaLocation location(x, y, z);
+    boost::shared_ptr<const CarlaWaypoint> waypoint = resolver(id, location);
+    if (!waypoint) {
+      std::string error_msg = (boost::format(
+            "Lattice::deserialize(): "
+            "cannot resolve waypoint %1% at x:%2% y:%3% z:%4%.\n")
+          % id % x % y % z).str();
+      throw std::runtime_error(error_msg);
+    }
+
+    if (waypoint_to_node_table_.count(waypoint->GetId()) > 0) {
+      std::string error_msg = (boost::format(
+            "Lattice::deserialize(): "
+            "waypoint %1% is resolved to an existing node %2%.\n")
+          % id % waypoint->GetId()).str();
+      throw std::runtime_error(error_msg);
+    }
+
+    boost::shared_ptr<Node> node = boost::make_shared<Node>(waypoint);
+    node->distance() = distance;
+
+    augmentWaypointToNodeTable(waypoint->GetId(), node);
+    augmentRoadlaneToWaypointsTable(waypoint);
+    waypoint_id_table[id] = waypoint->GetId();
+    node_links.push_back(std::make_pair(node, links));
+  }
+
+  // Link the nodes.
+  auto linkedNode = [this, &waypoint_id_table](
+      const boost::optional<size_t>& link)->boost::shared_ptr<Node>{
+    if (!link) return nullptr;
+    auto iter = waypoint_id_table.find(*link);
+    if (iter == waypoint_id_table.end()) {
+      std::string error_msg = (boost::format(
+            "Lattice::deserialize(): "
+            "linked waypoint %1% is not in the lattice.\n") % (*link)).str();
+      throw std::runtime_error(error_msg);
+    }
+    return waypoint_to_node_table_.find(iter->second)->second;
+  };
+
+  for (auto& item : node_links) {
+    const boost::shared_ptr<Node>& node = item.first;
+    const Links& links = item.second;
+    node->front() = linkedNode(links[0]);
+    node->back()  = linkedNode(links[1]);
+    node->left()  = linkedNode(links[2]);
+    node->right() = linkedNode(links[3]);
+  }
+
+  findLatticeEntriesAndExits();
+  return;
+}
+
 template<typename Node>
 void Lattice<Node>::swap(Lattice<Node>& other) {
 
@@ -110,6 +291,9 @@ void Lattice<Node>::swap(Lattice<Node>& other) {
   std::swap(waypoint_to_node_table_, other.waypoint_to_node_table_);
   std::swap(roadlane_to_waypoints_table_, other.roadlane_to_waypoints_table_);
   std::swap(longitudinal_resolution_, other.longitudinal_resolution_);
+  std::swap(horizon_, other.horizon_);
+  std::swap(lazy_, other.lazy_);
+  std::swap(construction_time_, other.construction_time_);
   std::swap(router_, other.router_);
 
   return;
@@ -235,6 +419,14 @@ void Lattice<Node>::extend(double range) {
   range = std::ceil(range);
   if (this->range() >= range) return;
 
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  // Reserve the node table, assuming the number of lanes at the
+  // lattice exits holds over the new range.
+  const size_t lane_num = std::max<size_t>(lattice_exits_.size(), 1);
+  waypoint_to_node_table_.reserve(
+      lane_num * static_cast<size_t>(range/longitudinal_resolution_+1.0));
+
   // A queue of nodes to be explored.
   // The queue is started from the lattice exits.
   std::queue<boost::shared_ptr<Node>> nodes_queue;
@@ -253,6 +445,22 @@ void Lattice<Node>::extend(double range) {
   // Update lattice entries and exits.
   findLatticeEntriesAndExits();
 
+  addConstructionTime(start);
+  return;
+}
+
+template<typename Node>
+void Lattice<Node>::materialize(const double distance) {
+
+  if (!lazy_) return;
+
+  // The distance of the nodes starts from 0 at the back of the lattice,
+  // which is the same as the range to be covered.
+  const double range = std::min(std::ceil(distance), horizon_);
+  const double current_range = this->range();
+  if (current_range >= range) return;
+
+  extend(std::min(std::max(range, current_range+kLazyExtension_), horizon_));
   return;
 }
 
@@ -271,6 +479,8 @@ void Lattice<Node>::shorten(double range) {
   range = std::ceil(range);
   if (this->range() <= range) return;
 
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
   // The distance before which nodes should be removed.
   const double safe_distance = this->range() - range;
 
@@ -341,6 +551,7 @@ void Lattice<Node>::shorten(double range) {
   // Update the distance of all remaining nodes.
   updateNodeDistance();
 
+  addConstructionTime(start);
   return;
 }
 
@@ -721,9 +932,9 @@ void Lattice<Node>::findLatticeEntriesAndExits() {
 }
 
 template<typename Node>
-boost::shared_ptr<Node> Lattice<Node>::closestNode(
+boost::shared_ptr<Node> Lattice<Node>::findClosestNode(
     const boost::shared_ptr<const CarlaWaypoint>& waypoint,
-    const double tolerance) {
+    const double tolerance) const {
 
   // Return nullptr is the input waypoint is invalid.
   if (!waypoint) return nullptr;
@@ -796,9 +1007,13 @@ std::string Lattice<Node>::string(const std::string& prefix) const {
 
   std::string lattice_msg = (boost::format(
         "lattice longitudinal resolution: %1%.\n"
-        "lattice node #: %2%\n")
+        "lattice node #: %2%\n"
+        "lattice range: %3% horizon: %4% lazy: %5%\n")
       % longitudinal_resolution_
-      % waypoint_to_node_table_.size()).str();
+      % waypoint_to_node_table_.size()
+      % range()
+      % horizon()
+      % lazy_).str();
 
   std::string lattice_entries_msg = (boost::format(
         "%1% lattice entries:\n") % lattice_entries_.size()).str();
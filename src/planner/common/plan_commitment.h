@@ -0,0 +1,171 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <stdexcept>
+#include <boost/format.hpp>
+
+namespace planner {
+
+/**
+ * \brief PlanCommitment keeps the manoeuvre selected by a lattice planner
+ *        across planning cycles, and suppresses switching to another
+ *        manoeuvre with a nearly equal cost.
+ *
+ * The manoeuvre of a plan is the first lane change on it, or keeping the lane
+ * if there is no lane change. A plan with a different manoeuvre replaces the
+ * committed one only if it is cheaper by more than \c hysteresis. With zero
+ * hysteresis, which is the default, the cheapest plan is always selected.
+ *
+ * A committed lane change is abandoned if a plan with another manoeuvre is
+ * selected before the ego reaches the end of the lane change edge. The number
+ * of abandoned lane changes is counted no matter the hysteresis, so that the
+ * replanning churn of different settings can be compared.
+ */
+class PlanCommitment {
+
+public:
+
+  /// The values are the same as the path types reported by the planner nodes.
+  enum class Manoeuvre : uint8_t {
+    KeepLane = 0,
+    LeftLaneChange = 1,
+    RightLaneChange = 2
+  };
+
+protected:
+
+  /// The cost margin a different manoeuvre has to win by.
+  double hysteresis_ = 0.0;
+
+  /// The manoeuvre selected in the last planning cycle.
+  Manoeuvre committed_ = Manoeuvre::KeepLane;
+
+  /// The manoeuvre on the first edge of the plan selected in the last planning cycle.
+  Manoeuvre next_ = Manoeuvre::KeepLane;
+
+  /// The number of planning cycles the committed manoeuvre has been kept.
+  size_t cycles_ = 0;
+
+  /// The number of abandoned lane changes.
+  size_t abandoned_ = 0;
+
+public:
+
+  PlanCommitment() = default;
+
+  PlanCommitment(const double hysteresis) : hysteresis_(hysteresis) {
+    if (hysteresis_ < 0.0) {
+      throw std::runtime_error((boost::format(
+            "PlanCommitment::PlanCommitment(): "
+            "hysteresis %1% should be non-negative.\n") % hysteresis_).str());
+    }
+  }
+
+  /// Get the cost margin a different manoeuvre has to win by.
+  const double hysteresis() const { return hysteresis_; }
+
+  /// Whether the planner sticks to the committed manoeuvre.
+  const bool enabled() const { return hysteresis_ > 0.0; }
+
+  /// Get the committed manoeuvre.
+  const Manoeuvre committed() const { return committed_; }
+
+  /// Get the number of planning cycles the committed manoeuvre has been kept.
+  const size_t cycles() const { return cycles_; }
+
+  /// Get the number of abandoned lane changes.
+  const size_t abandoned() const { return abandoned_; }
+
+  /// Whether the ego is executing the committed lane change, i.e. the first
+  /// edge of the plan selected in the last planning cycle is a lane change.
+  const bool executing() const { return next_ != Manoeuvre::KeepLane; }
+
+  /**
+   * \brief Whether the best plan with the committed manoeuvre should be
+   *        selected instead of the optimal plan.
+   * \param[in] optimal_cost The cost of the optimal plan.
+   * \param[in] committed_cost The cost of the best plan with the committed manoeuvre.
+   */
+  const bool keep(const double optimal_cost, const double committed_cost) const {
+    return committed_cost <= optimal_cost + hysteresis_;
+  }
+
+  /**
+   * \brief Update the commitment with the plan selected in this planning cycle.
+   *
+   * While the ego is executing the committed lane change, a plan following it
+   * leaves the commitment as it is, since the remaining part of the lane change
+   * may look like keeping the lane from where the ego currently is.
+   *
+   * \param[in] consistent Whether the selected plan follows the committed manoeuvre.
+   * \param[in] selected The manoeuvre of the selected plan.
+   * \param[in] next The manoeuvre on the first edge of the selected plan.
+   * \return True if a committed lane change is abandoned.
+   */
+  bool update(const bool consistent, const Manoeuvre selected, const Manoeuvre next) {
+    if (consistent) {
+      ++cycles_;
+      if (executing()) return false;
+      committed_ = selected;
+      next_ = next;
+      return false;
+    }
+
+    const bool abandoned = committed_ != Manoeuvre::KeepLane;
+    if (abandoned) ++abandoned_;
+
+    committed_ = selected;
+    next_ = next;
+    cycles_ = 1;
+    return abandoned;
+  }
+
+  /**
+   * \brief Notify that the ego has reached the end of the first edge of the
+   *        plan selected in the last planning cycle.
+   *
+   * If the edge is the committed lane change, the lane change is completed
+   * and the ego commits to keeping the lane thereafter.
+   */
+  void reached() {
+    if (executing()) {
+      committed_ = Manoeuvre::KeepLane;
+      cycles_ = 0;
+    }
+    next_ = Manoeuvre::KeepLane;
+    return;
+  }
+
+  /// Forget the committed manoeuvre, without counting it as abandoned.
+  void reset() {
+    committed_ = Manoeuvre::KeepLane;
+    next_ = Manoeuvre::KeepLane;
+    cycles_ = 0;
+    return;
+  }
+
+  std::string string(const std::string& prefix = "") const {
+    return prefix + (boost::format(
+          "hysteresis:%1% committed:%2% cycles:%3% abandoned:%4%\n")
+        % hysteresis_ % static_cast<int>(committed_) % cycles_ % abandoned_).str();
+  }
+
+}; // End class PlanCommitment.
+
+} // End namespace planner.
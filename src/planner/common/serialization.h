@@ -0,0 +1,64 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <boost/format.hpp>
+
+namespace utils {
+
+/**
+ * \defgroup Binary Serialization
+ *
+ * Helpers to write and read plain values in binary form. The values are
+ * written with the native byte order, i.e. the serialized data is only
+ * meant to be loaded on machines with the same architecture.
+ *
+ * @{
+ */
+template<typename T>
+void writeBinary(std::ostream& os, const T& val) {
+  static_assert(std::is_trivially_copyable<T>::value,
+      "utils::writeBinary(): only trivially copyable types can be written.");
+  os.write(reinterpret_cast<const char*>(&val), sizeof(T));
+  if (!os) {
+    throw std::runtime_error(
+        "utils::writeBinary(): failed to write to the output stream.\n");
+  }
+  return;
+}
+
+template<typename T>
+T readBinary(std::istream& is) {
+  static_assert(std::is_trivially_copyable<T>::value,
+      "utils::readBinary(): only trivially copyable types can be read.");
+  T val;
+  is.read(reinterpret_cast<char*>(&val), sizeof(T));
+  if (!is) {
+    throw std::runtime_error((boost::format(
+            "utils::readBinary(): "
+            "failed to read %1% bytes from the input stream.\n")
+          % sizeof(T)).str());
+  }
+  return val;
+}
+/**@}*/
+
+} // End namespace utils.
@@ -27,137 +27,151 @@ Snapshot::Snapshot(
     const boost::shared_ptr<router::Router>& router,
     const boost::shared_ptr<CarlaMap>& map,
     const boost::shared_ptr<utils::FastWaypointMap>& fast_map) :
-  ego_(ego),
-  agents_(agents) {
+  vehicles_(agents.size()+1) {
 
-  // Collect all vehicles into an array of tuples.
-  std::vector<std::tuple<size_t, CarlaTransform, CarlaBoundingBox>> vehicles;
-  vehicles.push_back(ego_.tuple());
-  for (const auto& agent : agents_) vehicles.push_back(agent.second.tuple());
+  // The ego is always stored at index 0.
+  vehicles_.push_back(ego);
+  for (const auto& agent : agents) vehicles_.push_back(agent.second);
 
   // Generate the waypoint lattice.
-  std::unordered_set<size_t> disappear_vehicles;
   traffic_lattice_ = boost::make_shared<TrafficLattice>(
-      vehicles, map, fast_map, router, disappear_vehicles);
+      vehicleTuples(), map, fast_map, router, disappear_vehicles_);
 
   // Remove the disappeared vehicles.
-  if (disappear_vehicles.count(ego_.id()) != 0) {
-    std::string error_msg(
-        "Snapshot::Snapshot(): "
-        "the ego vehicle is removed from the snapshot.\n");
-    std::string snapshot_msg = this->string();
-    throw std::runtime_error(error_msg + snapshot_msg);
-  }
-
-  for (const size_t agent : disappear_vehicles)
-    agents_.erase(agent);
-
+  syncWithTrafficLattice(disappear_vehicles_, "Snapshot::Snapshot()");
   return;
 }
 
 Snapshot::Snapshot(const Snapshot& other) :
-  ego_(other.ego_),
-  agents_(other.agents_),
+  vehicles_(other.vehicles_),
   traffic_lattice_(boost::make_shared<TrafficLattice>(*(other.traffic_lattice_))) {}
 
 Snapshot& Snapshot::operator=(const Snapshot& other) {
-  ego_ = other.ego_;
-  agents_ = other.agents_;
+  vehicles_ = other.vehicles_;
   traffic_lattice_ = boost::make_shared<TrafficLattice>(*(other.traffic_lattice_));
   return *this;
 }
 
-const Vehicle& Snapshot::agent(const size_t id) const {
-  std::unordered_map<size_t, Vehicle>::const_iterator iter = agents_.find(id);
-  if (iter == agents_.end()) {
+ConstVehicleView Snapshot::agent(const size_t id) const {
+  boost::optional<size_t> index = vehicles_.index(id);
+  if (!index || *index == 0) {
     std::string error_msg = (boost::format(
           "Snapshot::agent(): "
           "the required agent %1% does not exist in the snapshot.\n") % id).str();
     std::string snapshot_msg = this->string();
     throw std::runtime_error(error_msg + snapshot_msg);
   }
-  return iter->second;
+  return vehicles_.view(*index);
 }
 
-Vehicle& Snapshot::agent(const size_t id) {
-  std::unordered_map<size_t, Vehicle>::iterator iter = agents_.find(id);
-  if (iter == agents_.end()) {
+VehicleView Snapshot::agent(const size_t id) {
+  boost::optional<size_t> index = vehicles_.index(id);
+  if (!index || *index == 0) {
     std::string error_msg = (boost::format(
           "Snapshot::agent(): "
           "the required agent %1% does not exist in the snapshot.\n") % id).str();
     std::string snapshot_msg = this->string();
     throw std::runtime_error(error_msg + snapshot_msg);
   }
-  return iter->second;
+  return vehicles_.view(*index);
 }
 
-const Vehicle& Snapshot::vehicle(const size_t id) const {
-  if (id == ego_.id()) return ego_;
+ConstVehicleView Snapshot::vehicle(const size_t id) const {
+  if (id == ego().id()) return ego();
   else return agent(id);
 }
 
-Vehicle& Snapshot::vehicle(const size_t id) {
-  if (id == ego_.id()) return ego_;
+VehicleView Snapshot::vehicle(const size_t id) {
+  if (id == ego().id()) return ego();
   else return agent(id);
 }
 
+bool Snapshot::updateTraffic(const TrafficUpdate& update) {
+
+  // Update the transform, speed, and acceleration for all vehicles.
+  vehicles_.apply(update);
+
+  // Update the traffic lattice.
+  disappear_vehicles_.clear();
+  const bool no_collision = traffic_lattice_->moveTrafficForward(
+      vehicleTuples(), disappear_vehicles_);
+
+  // Remove the \c disappear_vehicles from the snapshot.
+  syncWithTrafficLattice(disappear_vehicles_, "Snapshot::UpdateTraffic()");
+  if (!no_collision) return false;
+
+  // The lattice check is tied to the node resolution. Check the
+  // footprints of the remaining vehicles as well.
+  return footprintsCollisionFree();
+}
+
 bool Snapshot::updateTraffic(
     const std::vector<std::tuple<size_t, CarlaTransform, double, double, double>>& updates) {
 
   // The tuple consists of the vehicle ID, transform, speed, acceleration, curvature.
+  TrafficUpdate update(vehicles_.size());
+  update.reset(vehicles_.size());
 
-  // Check the input vector has the updates for every vehicle in the snapshot.
-  std::unordered_set<size_t> updated_vehicles;
-  for (const auto& update : updates)
-    updated_vehicles.insert(std::get<0>(update));
-
-  // Update the transform, speed, and acceleration for all vehicles.
-  for (const auto& update : updates) {
-    size_t id; CarlaTransform update_transform;
-    double update_speed; double update_acceleration; double update_curvature;
-    std::tie(id, update_transform, update_speed, update_acceleration, update_curvature) = update;
-
-    // Update the status for the ego vehicle.
-    if (id == ego_.id()) {
-      ego_.transform() = update_transform;
-      ego_.speed() = update_speed;
-      ego_.acceleration() = update_acceleration;
-      ego_.curvature() = update_curvature;
-      continue;
-    }
-
-    // Update the status for the agent vehicles.
-    std::unordered_map<size_t, Vehicle>::iterator agent_iter = agents_.find(id);
+  for (const auto& item : updates) {
+    boost::optional<size_t> index = vehicles_.index(std::get<0>(item));
     // This vehicle is not in the snapshot.
-    if (agent_iter == agents_.end()) continue;
-
-    agent_iter->second.transform() = update_transform;
-    agent_iter->second.speed() = update_speed;
-    agent_iter->second.acceleration() = update_acceleration;
-    agent_iter->second.curvature() = update_curvature;
+    if (!index) continue;
+    update.set(*index, std::get<1>(item), std::get<2>(item),
+               std::get<3>(item), std::get<4>(item));
   }
 
-  // Update the traffic lattice.
-  std::vector<std::tuple<size_t, CarlaTransform, CarlaBoundingBox>> vehicles;
-  vehicles.push_back(ego_.tuple());
-  for (const auto& agent : agents_)
-    vehicles.push_back(agent.second.tuple());
+  return updateTraffic(update);
+}
 
-  std::unordered_set<size_t> disappear_vehicles;
-  const bool no_collision = traffic_lattice_->moveTrafficForward(vehicles, disappear_vehicles);
+bool Snapshot::footprintsCollisionFree() {
+  // The checker is cleared instead of recreated to keep its buffers.
+  collision_checker_.clear();
+  collision_checker_.reserve(vehicles_.size());
+  for (size_t i = 0; i < vehicles_.size(); ++i)
+    collision_checker_.add(vehicles_.view(i).footprint());
+  return collision_checker_.collisionFree();
+}
 
-  // Remove the \c disappear_vehicles from the snapshot.
-  if (disappear_vehicles.count(ego_.id()) != 0) {
-    std::string error_msg(
-        "Snapshot::UpdateTraffic(): "
+const std::vector<std::tuple<size_t,
+                             typename Snapshot::CarlaTransform,
+                             typename Snapshot::CarlaBoundingBox>>&
+  Snapshot::vehicleTuples() {
+  vehicle_tuples_.clear();
+  vehicle_tuples_.reserve(vehicles_.size());
+  for (size_t i = 0; i < vehicles_.size(); ++i)
+    vehicle_tuples_.push_back(vehicles_.view(i).tuple());
+  return vehicle_tuples_;
+}
+
+void Snapshot::syncWithTrafficLattice(
+    const std::unordered_set<size_t>& disappear_vehicles,
+    const std::string& caller) {
+
+  if (disappear_vehicles.count(ego().id()) != 0) {
+    std::string error_msg(caller + ": "
         "the ego vehicle is removed from the snapshot.\n");
     std::string snapshot_msg = this->string();
     throw std::runtime_error(error_msg + snapshot_msg);
   }
 
-  for (const size_t disappear_vehicle : disappear_vehicles)
-    agents_.erase(disappear_vehicle);
+  // The remaining vehicles keep their order, so that they are indexed
+  // the same as on the traffic lattice.
+  vehicles_.erase(disappear_vehicles);
+
+  bool matched = traffic_lattice_->vehicleNum() == vehicles_.size();
+  for (size_t i = 0; matched && i < vehicles_.size(); ++i)
+    matched = traffic_lattice_->vehicleId(i) == vehicles_.ids()[i];
+
+  if (!matched) {
+    std::string error_msg(caller + ": "
+        "the vehicles in the snapshot are not indexed the same as on the traffic lattice.\n");
+    std::string snapshot_msg = this->string();
+    throw std::runtime_error(error_msg + snapshot_msg);
+  }
+
+  for (size_t i = 0; i < vehicles_.size(); ++i)
+    vehicles_.latticeDistances()[i] = traffic_lattice_->vehicleDistanceAt(i);
 
-  return no_collision;
+  return;
 }
 } // End namespace planner.
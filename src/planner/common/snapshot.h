@@ -15,12 +15,15 @@
 #pragma once
 
 #include <unordered_map>
+#include <unordered_set>
 #include <carla/client/Map.h>
 #include <carla/client/Vehicle.h>
 #include <carla/geom/Transform.h>
 
 #include <router/common/router.h>
 #include <planner/common/vehicle.h>
+#include <planner/common/vehicle_states.h>
+#include <planner/common/collision_checker.h>
 #include <planner/common/traffic_lattice.h>
 
 namespace planner {
@@ -31,6 +34,16 @@ namespace planner {
  *
  * The snapshot objects uses TrafficLattice to bookkeep the relative locations
  * of the vehicles.
+ *
+ * The states of the vehicles are kept in \c VehicleStates as structure of
+ * arrays, with the ego at index 0 and the agents afterwards. Individual
+ * vehicles are returned as views, which share the interface of \c Vehicle.
+ *
+ * The vehicles are indexed the same in \c vehicles() and on the traffic
+ * lattice. The indexed queries of the traffic lattice, e.g.
+ * \c TrafficLattice::frontAt(), therefore return indices which address
+ * the arrays in \c vehicles() directly. Vehicle IDs are only required to
+ * find a vehicle from outside the snapshot.
  */
 class Snapshot {
 
@@ -41,19 +54,32 @@ protected:
   using CarlaTransform   = carla::geom::Transform;
   using CarlaBoundingBox = carla::geom::BoundingBox;
 
-protected:
+public:
+
+  using AgentRange      = BasicVehicleRange<false>;
+  using ConstAgentRange = BasicVehicleRange<true>;
 
-  /// The ego vehicle.
-  Vehicle ego_;
+protected:
 
-  /// Agents in the micro traffic, i.e. all vechiles other than the ego.
-  //std::vector<Vehicle> agents_;
-  std::unordered_map<size_t, Vehicle> agents_;
+  /// States of the ego (at index 0) and the agents in the micro traffic.
+  VehicleStates vehicles_;
 
   /// Traffic lattice which is used to keep track of the relative
   /// location among the vehicles.
   boost::shared_ptr<TrafficLattice> traffic_lattice_;
 
+  /**
+   * @name Scratch buffers
+   *
+   * Reused by \c updateTraffic() to avoid allocations at every simulation
+   * step. They are not part of the state, and are not copied.
+   */
+  /// @{
+  std::vector<std::tuple<size_t, CarlaTransform, CarlaBoundingBox>> vehicle_tuples_;
+  std::unordered_set<size_t> disappear_vehicles_;
+  utils::CollisionChecker collision_checker_;
+  /// @}
+
 public:
 
   Snapshot(const Vehicle& ego,
@@ -66,23 +92,43 @@ public:
 
   Snapshot& operator=(const Snapshot& other);
 
-  const Vehicle& ego() const { return ego_; }
-  Vehicle& ego() { return ego_; }
+  ConstVehicleView ego() const { return vehicles_.view(0); }
+  VehicleView ego() { return vehicles_.view(0); }
+
+  /// The agents are iterated as pairs of vehicle ID and vehicle view.
+  ConstAgentRange agents() const { return vehicles_.range(1, vehicles_.size()); }
+  AgentRange agents() { return vehicles_.range(1, vehicles_.size()); }
 
-  const std::unordered_map<size_t, Vehicle>& agents() const { return agents_; }
-  std::unordered_map<size_t, Vehicle>& agents() { return agents_; }
+  ConstVehicleView agent(const size_t id) const;
+  VehicleView agent(const size_t id);
 
-  const Vehicle& agent(const size_t id) const;
-  Vehicle& agent(const size_t id);
+  ConstVehicleView vehicle(const size_t id) const;
+  VehicleView vehicle(const size_t id);
 
-  const Vehicle& vehicle(const size_t id) const;
-  Vehicle& vehicle(const size_t id);
+  /// Get the states of all vehicles as arrays.
+  const VehicleStates& vehicles() const { return vehicles_; }
 
   const boost::shared_ptr<const TrafficLattice>
     trafficLattice() const { return traffic_lattice_; }
   const boost::shared_ptr<TrafficLattice>
     trafficLattice() { return traffic_lattice_; }
 
+  /**
+   * \brief Update the vehicles to the next simulation step.
+   *
+   * The update is indexed the same as \c vehicles(), i.e. the ego at index 0.
+   * Applying the update to the vehicles and the footprint check reuse their
+   * buffers and do not allocate in steady state. The traffic lattice update
+   * still allocates, since the vehicle tuples passed to the lattice and the
+   * moved vehicle nodes are rebuilt at every step. This is still the
+   * preferred interface in the simulation loops, since it avoids the ID
+   * lookups of the tuple interface.
+   *
+   * \param[in] update The updated states of all vehicles.
+   * \return false If collision is detected.
+   */
+  bool updateTraffic(const TrafficUpdate& update);
+
   // The input \c new_transforms should cover every vehicle in the snapshot.
   // The tuple consists of the vehicle ID, transform, speed, acceleration, curvature.
   bool updateTraffic(
@@ -90,13 +136,38 @@ public:
 
   std::string string(const std::string& prefix = "") const {
     std::string output = prefix;
-    output += ego_.string("ego ");
-    for (const auto& agent : agents_)
+    output += ego().string("ego ");
+    for (const auto& agent : agents())
       output += agent.second.string("agent ");
     output += "waypoint lattice range: " + std::to_string(traffic_lattice_->range()) + "\n";
     return output;
   }
 
+protected:
+
+  /// Collect the ID, transform, and bounding box of all vehicles
+  /// into \c vehicle_tuples_.
+  const std::vector<std::tuple<size_t, CarlaTransform, CarlaBoundingBox>>& vehicleTuples();
+
+  /**
+   * \brief Check if the footprints of the vehicles overlap.
+   *
+   * The traffic lattice only detects vehicles occupying the same node, which
+   * misses lateral overlaps, e.g. during lane changes. This check works with
+   * the oriented bounding boxes of the vehicles directly.
+   *
+   * The check reuses \c collision_checker_, therefore the function is
+   * non-const, so that const snapshots stay safe to share between threads.
+   */
+  bool footprintsCollisionFree();
+
+  /// Remove the vehicles no longer on the traffic lattice, and refresh the
+  /// lattice distances of the remaining ones. Throws \c std::runtime_error
+  /// if the vehicles are then not indexed the same as on the traffic lattice.
+  void syncWithTrafficLattice(
+      const std::unordered_set<size_t>& disappear_vehicles,
+      const std::string& caller);
+
 };
 } // End namespace planner.
 
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cmath>
+#include <stdexcept>
+#include <boost/format.hpp>
+
+#include <planner/common/snapshot_signature.h>
+
+namespace planner {
+
+SnapshotSignature::SnapshotSignature(
+    const Snapshot& snapshot, const Resolution& resolution) {
+
+  if (resolution.speed <= 0.0 || resolution.distance <= 0.0) {
+    std::string error_msg = (boost::format(
+          "SnapshotSignature::SnapshotSignature(): "
+          "invalid resolution speed:%1% distance:%2%.\n")
+        % resolution.speed % resolution.distance).str();
+    throw std::runtime_error(error_msg);
+  }
+
+  const size_t ego = snapshot.ego().id();
+  ego_speed_bin_ = bin(snapshot.ego().speed(), resolution.speed);
+
+  boost::shared_ptr<const TrafficLattice> traffic_lattice = snapshot.trafficLattice();
+  const std::array<boost::optional<std::pair<size_t, double>>, 6> neighbours {{
+    traffic_lattice->front(ego),
+    traffic_lattice->back(ego),
+    traffic_lattice->leftFront(ego),
+    traffic_lattice->leftBack(ego),
+    traffic_lattice->rightFront(ego),
+    traffic_lattice->rightBack(ego),
+  }};
+
+  for (size_t i = 0; i < neighbours.size(); ++i) {
+    if (!neighbours[i]) continue;
+    neighbours_[i] = std::make_tuple(
+        neighbours[i]->first,
+        bin(neighbours[i]->second, resolution.distance),
+        bin(snapshot.vehicle(neighbours[i]->first).speed(), resolution.speed));
+  }
+
+  return;
+}
+
+std::string SnapshotSignature::string(const std::string& prefix) const {
+
+  static const std::array<std::string, 6> names {{
+    "front", "back", "left front", "left back", "right front", "right back"}};
+
+  std::string output = prefix;
+  output += "ego speed bin: " + std::to_string(ego_speed_bin_) + "\n";
+
+  boost::format neighbour_format("%1%: id:%2% distance bin:%3% speed bin:%4%\n");
+  for (size_t i = 0; i < neighbours_.size(); ++i) {
+    if (!neighbours_[i]) {
+      output += names[i] + ":\n";
+      continue;
+    }
+    output += (boost::format(neighbour_format)
+        % names[i]
+        % std::get<0>(*neighbours_[i])
+        % std::get<1>(*neighbours_[i])
+        % std::get<2>(*neighbours_[i])).str();
+  }
+
+  return output;
+}
+
+const int32_t SnapshotSignature::bin(const double value, const double size) {
+  return static_cast<int32_t>(std::floor(value/size));
+}
+
+} // End namespace planner.
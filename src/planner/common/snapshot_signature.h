@@ -0,0 +1,99 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <array>
+#include <tuple>
+#include <string>
+#include <cstdint>
+#include <boost/optional.hpp>
+
+#include <planner/common/snapshot.h>
+
+namespace planner {
+
+/**
+ * \brief SnapshotSignature is a quantized summary of a snapshot from the
+ *        perspective of the ego.
+ *
+ * The signature consists of the speed bin of the ego, and the six neighbour
+ * vehicles of the ego (front, back, left front, left back, right front,
+ * right back), each of which is summarized by its ID, the bin of its
+ * distance to the ego, and the bin of its speed.
+ *
+ * Two snapshots with the same signature are considered as near-duplicates.
+ * The bin sizes in \c Resolution determine how much two such snapshots may
+ * differ from each other.
+ */
+class SnapshotSignature {
+
+public:
+
+  /// The bin sizes used to quantize the snapshot.
+  struct Resolution {
+    /// Bin size of the vehicle speeds (m/s).
+    double speed = 1.0;
+    /// Bin size of the distances between the ego and its neighbours (m).
+    double distance = 2.0;
+  };
+
+protected:
+
+  /// A neighbour vehicle is stored as its ID, distance bin, and speed bin.
+  using Neighbour = std::tuple<size_t, int32_t, int32_t>;
+
+protected:
+
+  /// Speed bin of the ego.
+  int32_t ego_speed_bin_ = 0;
+
+  /// Neighbour vehicles in the order of front, back, left front,
+  /// left back, right front, and right back.
+  std::array<boost::optional<Neighbour>, 6> neighbours_;
+
+public:
+
+  SnapshotSignature(const Snapshot& snapshot, const Resolution& resolution);
+
+  /// Quantize the snapshot with the default resolution.
+  explicit SnapshotSignature(const Snapshot& snapshot) :
+    SnapshotSignature(snapshot, Resolution()) {}
+
+  const int32_t egoSpeedBin() const { return ego_speed_bin_; }
+
+  bool operator==(const SnapshotSignature& other) const {
+    return ego_speed_bin_ == other.ego_speed_bin_ &&
+           neighbours_ == other.neighbours_;
+  }
+
+  bool operator!=(const SnapshotSignature& other) const {
+    return !(*this == other);
+  }
+
+  /// Compare the neighbour vehicles only, ignoring the ego speed.
+  bool sameNeighbours(const SnapshotSignature& other) const {
+    return neighbours_ == other.neighbours_;
+  }
+
+  std::string string(const std::string& prefix = "") const;
+
+protected:
+
+  /// Get the bin of a value given the bin size.
+  static const int32_t bin(const double value, const double size);
+
+}; // End class SnapshotSignature.
+
+} // End namespace planner.
@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <stdexcept>
 
+#include <planner/common/serialization.h>
 #include <planner/common/traffic_lattice.h>
 
 namespace planner {
@@ -35,7 +36,7 @@ TrafficLattice::TrafficLattice(
   this->router_ = router;
 
   // Find the waypoints each of the input vehicle.
-  std::unordered_map<size_t, VehicleWaypoints>
+  std::vector<VehicleWaypoints>
     vehicle_waypoints = vehicleWaypoints(vehicles);
 
   // Find the start waypoint and range of the lattice based
@@ -98,7 +99,7 @@ TrafficLattice::TrafficLattice(
   }
 
   // Find waypoints for each of the input vehicle.
-  std::unordered_map<size_t, VehicleWaypoints>
+  std::vector<VehicleWaypoints>
     vehicle_waypoints = vehicleWaypoints(vehicle_tuples);
 
   // Find the start waypoint and range of the lattice based
@@ -142,14 +143,65 @@ TrafficLattice::TrafficLattice(
   return;
 }
 
+TrafficLattice::TrafficLattice(
+    std::istream& is,
+    const WaypointResolver& resolver,
+    const boost::shared_ptr<CarlaMap>& map,
+    const boost::shared_ptr<utils::FastWaypointMap>& fast_map,
+    const boost::shared_ptr<router::Router>& router) :
+  map_(map), fast_map_(fast_map) {
+
+  this->router_ = router;
+
+  // Load the nodes.
+  std::unordered_map<size_t, size_t> waypoint_id_table;
+  this->deserialize(is, resolver, waypoint_id_table);
+
+  // Load the vehicles and register them onto the nodes.
+  const uint64_t vehicle_num = utils::readBinary<uint64_t>(is);
+  for (uint64_t i = 0; i < vehicle_num; ++i) {
+    const size_t vehicle = utils::readBinary<uint64_t>(is);
+    const uint64_t node_num = utils::readBinary<uint64_t>(is);
+
+    // The vehicles are indexed in the order they are written.
+    const size_t index = vehicle_ids_.size();
+    vehicle_ids_.push_back(vehicle);
+    vehicle_to_index_table_[vehicle] = index;
+    vehicle_nodes_.emplace_back();
+
+    std::vector<boost::weak_ptr<Node>>& nodes = vehicle_nodes_.back();
+    for (uint64_t j = 0; j < node_num; ++j) {
+      const size_t id = utils::readBinary<uint64_t>(is);
+      auto iter = waypoint_id_table.find(id);
+      if (iter == waypoint_id_table.end()) {
+        std::string error_msg = (boost::format(
+              "TrafficLattice::TrafficLattice(): "
+              "waypoint %1% occupied by vehicle %2% is not in the lattice.\n")
+            % id % vehicle).str();
+        throw std::runtime_error(error_msg);
+      }
+
+      boost::shared_ptr<Node> node = this->waypoint_to_node_table_[iter->second];
+      node->vehicle() = index;
+      nodes.push_back(node);
+    }
+  }
+
+  return;
+}
+
 TrafficLattice::TrafficLattice(const TrafficLattice& other) :
   Base(other) {
 
+  // The vehicles keep their indices in the copy.
+  vehicle_ids_ = other.vehicle_ids_;
+  vehicle_to_index_table_ = other.vehicle_to_index_table_;
+
   // Make sure the weak pointers point to the stuff within this object.
-  vehicle_to_nodes_table_ = other.vehicle_to_nodes_table_;
+  vehicle_nodes_ = other.vehicle_nodes_;
 
-  for (auto& vehicle : vehicle_to_nodes_table_) {
-    for (auto& node : vehicle.second) {
+  for (auto& vehicle : vehicle_nodes_) {
+    for (auto& node : vehicle) {
       const size_t id = node.lock()->waypoint()->GetId();
       node = this->waypoint_to_node_table_[id];
     }
@@ -166,62 +218,114 @@ TrafficLattice::TrafficLattice(const TrafficLattice& other) :
 void TrafficLattice::swap(TrafficLattice& other) {
 
   Base::swap(other);
-  std::swap(vehicle_to_nodes_table_, other.vehicle_to_nodes_table_);
+  std::swap(vehicle_ids_, other.vehicle_ids_);
+  std::swap(vehicle_nodes_, other.vehicle_nodes_);
+  std::swap(vehicle_to_index_table_, other.vehicle_to_index_table_);
   std::swap(map_, other.map_);
   std::swap(fast_map_, other.fast_map_);
 
   return;
 }
 
+void TrafficLattice::serialize(std::ostream& os) const {
+
+  Base::serialize(os);
+
+  // Sort the vehicles by ID so that the output does not depend on
+  // the order the vehicles are registered.
+  std::vector<size_t> indices(vehicle_ids_.size());
+  for (size_t i = 0; i < indices.size(); ++i) indices[i] = i;
+  std::sort(indices.begin(), indices.end(),
+      [this](const size_t i0, const size_t i1)->bool{
+        return vehicle_ids_[i0] < vehicle_ids_[i1];
+      });
+
+  utils::writeBinary(os, static_cast<uint64_t>(indices.size()));
+  for (const size_t index : indices) {
+    const std::vector<boost::weak_ptr<Node>>& nodes = vehicle_nodes_[index];
+
+    utils::writeBinary(os, static_cast<uint64_t>(vehicle_ids_[index]));
+    utils::writeBinary(os, static_cast<uint64_t>(nodes.size()));
+    for (const auto& node : nodes)
+      utils::writeBinary(os, static_cast<uint64_t>(node.lock()->id()));
+  }
+
+  return;
+}
+
 boost::optional<std::pair<size_t, double>>
   TrafficLattice::front(const size_t vehicle) const {
+  return vehicleIdOf(frontAt(indexOnLattice(vehicle, "TrafficLattice::front()")));
+}
 
-  if (vehicle_to_nodes_table_.count(vehicle) == 0) {
-    std::string error_msg = (boost::format(
-          "TrafficLattice::front(): "
-          "Input vehicle [%1%] is not on lattice.\n") % vehicle).str();
-    throw std::runtime_error(error_msg);
-  }
+boost::optional<std::pair<size_t, double>>
+  TrafficLattice::back(const size_t vehicle) const {
+  return vehicleIdOf(backAt(indexOnLattice(vehicle, "TrafficLattice::back()")));
+}
+
+boost::optional<std::pair<size_t, double>>
+  TrafficLattice::leftFront(const size_t vehicle) const {
+  return vehicleIdOf(leftFrontAt(indexOnLattice(vehicle, "TrafficLattice::leftFront()")));
+}
+
+boost::optional<std::pair<size_t, double>>
+  TrafficLattice::leftBack(const size_t vehicle) const {
+  return vehicleIdOf(leftBackAt(indexOnLattice(vehicle, "TrafficLattice::leftBack()")));
+}
+
+boost::optional<std::pair<size_t, double>>
+  TrafficLattice::rightFront(const size_t vehicle) const {
+  return vehicleIdOf(rightFrontAt(indexOnLattice(vehicle, "TrafficLattice::rightFront()")));
+}
+
+boost::optional<std::pair<size_t, double>>
+  TrafficLattice::rightBack(const size_t vehicle) const {
+  return vehicleIdOf(rightBackAt(indexOnLattice(vehicle, "TrafficLattice::rightBack()")));
+}
+
+double TrafficLattice::vehicleDistance(const size_t vehicle) const {
+  return vehicleDistanceAt(indexOnLattice(vehicle, "TrafficLattice::vehicleDistance()"));
+}
+
+boost::optional<std::pair<size_t, double>>
+  TrafficLattice::frontAt(const size_t index) const {
+
+  checkIndex(index, "TrafficLattice::frontAt()");
 
   // Find the node in the lattice which corresponds to the
   // head of the vehicle.
-  boost::shared_ptr<const Node> start = vehicleHeadNode(vehicle);
+  boost::shared_ptr<const Node> start = vehicleHeadNode(index);
   return frontVehicle(start);
 }
 
+double TrafficLattice::vehicleDistanceAt(const size_t index) const {
+  checkIndex(index, "TrafficLattice::vehicleDistanceAt()");
+  return vehicleHeadNode(index)->distance();
+}
+
 boost::optional<std::pair<size_t, double>>
-  TrafficLattice::back(const size_t vehicle) const {
+  TrafficLattice::backAt(const size_t index) const {
 
-  if (vehicle_to_nodes_table_.count(vehicle) == 0) {
-    std::string error_msg = (boost::format(
-          "TrafficLattice::back(): "
-          "Input vehicle [%1%] is not on lattice.\n") % vehicle).str();
-    throw std::runtime_error(error_msg);
-  }
+  checkIndex(index, "TrafficLattice::backAt()");
 
   // Find the node in the lattice which corresponds to the
   // back of the vehicle.
-  boost::shared_ptr<const Node> start = vehicleRearNode(vehicle);
+  boost::shared_ptr<const Node> start = vehicleRearNode(index);
   return backVehicle(start);
 }
 
 boost::optional<std::pair<size_t, double>>
-  TrafficLattice::leftFront(const size_t vehicle) const {
+  TrafficLattice::leftFrontAt(const size_t index) const {
 
-  if (vehicle_to_nodes_table_.count(vehicle) == 0) {
-    std::string error_msg = (boost::format(
-          "TrafficLattice::leftFront(): "
-          "Input vehicle [%1%] is not on lattice.\n") % vehicle).str();
-    throw std::runtime_error(error_msg);
-  }
+  checkIndex(index, "TrafficLattice::leftFrontAt()");
 
   // Find the node in the lattice which corresponds to the
   // head of the vehicle.
-  boost::shared_ptr<const Node> start = vehicleHeadNode(vehicle);
+  boost::shared_ptr<const Node> start = vehicleHeadNode(index);
   if (!start) {
     std::string error_msg = (boost::format(
-          "TrafficLattice::leftFront(): "
-          "head of vehicle [%1%] is not on lattice.\n") % vehicle).str();
+          "TrafficLattice::leftFrontAt(): "
+          "head of vehicle [%1%] is not on lattice.\n") % vehicle_ids_[index]).str();
     throw std::runtime_error(error_msg);
   }
 
@@ -246,22 +350,17 @@ boost::optional<std::pair<size_t, double>>
 }
 
 boost::optional<std::pair<size_t, double>>
-  TrafficLattice::leftBack(const size_t vehicle) const {
+  TrafficLattice::leftBackAt(const size_t index) const {
 
-  if (vehicle_to_nodes_table_.count(vehicle) == 0) {
-    std::string error_msg = (boost::format(
-          "TrafficLattice::leftBack(): "
-          "Input vehicle [%1%] is not on lattice.\n") % vehicle).str();
-    throw std::runtime_error(error_msg);
-  }
+  checkIndex(index, "TrafficLattice::leftBackAt()");
 
   // Find the node in the lattice which corresponds to the
   // rear of the vehicle.
-  boost::shared_ptr<const Node> start = vehicleRearNode(vehicle);
+  boost::shared_ptr<const Node> start = vehicleRearNode(index);
   if (!start) {
     std::string error_msg = (boost::format(
-          "TrafficLattice::leftBack(): "
-          "rear of vehicle [%1%] is not on lattice.\n") % vehicle).str();
+          "TrafficLattice::leftBackAt(): "
+          "rear of vehicle [%1%] is not on lattice.\n") % vehicle_ids_[index]).str();
     throw std::runtime_error(error_msg);
   }
 
@@ -286,22 +385,17 @@ boost::optional<std::pair<size_t, double>>
 }
 
 boost::optional<std::pair<size_t, double>>
-  TrafficLattice::rightFront(const size_t vehicle) const {
+  TrafficLattice::rightFrontAt(const size_t index) const {
 
-  if (vehicle_to_nodes_table_.count(vehicle) == 0) {
-    std::string error_msg = (boost::format(
-          "TrafficLattice::rightFront(): "
-          "Input vehicle [%1%] is not on lattice.\n") % vehicle).str();
-    throw std::runtime_error(error_msg);
-  }
+  checkIndex(index, "TrafficLattice::rightFrontAt()");
 
   // Find the node in the lattice which corresponds to the
   // head of the vehicle.
-  boost::shared_ptr<const Node> start = vehicleHeadNode(vehicle);
+  boost::shared_ptr<const Node> start = vehicleHeadNode(index);
   if (!start) {
     std::string error_msg = (boost::format(
-          "TrafficLattice::rightFront(): "
-          "head of vehicle [%1%] is not on lattice.\n") % vehicle).str();
+          "TrafficLattice::rightFrontAt(): "
+          "head of vehicle [%1%] is not on lattice.\n") % vehicle_ids_[index]).str();
     throw std::runtime_error(error_msg);
   }
 
@@ -326,22 +420,17 @@ boost::optional<std::pair<size_t, double>>
 }
 
 boost::optional<std::pair<size_t, double>>
-  TrafficLattice::rightBack(const size_t vehicle) const {
+  TrafficLattice::rightBackAt(const size_t index) const {
 
-  if (vehicle_to_nodes_table_.count(vehicle) == 0) {
-    std::string error_msg = (boost::format(
-          "TrafficLattice::rightBack(): "
-          "Input vehicle [%1%] is not on lattice.\n") % vehicle).str();
-    throw std::runtime_error(error_msg);
-  }
+  checkIndex(index, "TrafficLattice::rightBackAt()");
 
   // Find the node in the lattice which corresponds to the
   // rear of the vehicle.
-  boost::shared_ptr<const Node> start = vehicleRearNode(vehicle);
+  boost::shared_ptr<const Node> start = vehicleRearNode(index);
   if (!start) {
     std::string error_msg = (boost::format(
-          "TrafficLattice::rightBack(): "
-          "rear of vehicle [%1%] is not on lattice.\n") % vehicle).str();
+          "TrafficLattice::rightBackAt(): "
+          "rear of vehicle [%1%] is not on lattice.\n") % vehicle_ids_[index]).str();
     throw std::runtime_error(error_msg);
   }
 
@@ -366,24 +455,15 @@ boost::optional<std::pair<size_t, double>>
 }
 
 std::unordered_set<size_t> TrafficLattice::vehicles() const {
-  std::unordered_set<size_t> vehicles;
-  for (const auto& item : vehicle_to_nodes_table_)
-    vehicles.insert(item.first);
-
-  return vehicles;
+  return std::unordered_set<size_t>(vehicle_ids_.begin(), vehicle_ids_.end());
 }
 
 int32_t TrafficLattice::isChangingLane(const size_t vehicle) const {
-  if (vehicle_to_nodes_table_.count(vehicle) == 0) {
-    std::string error_msg = (boost::format(
-          "TrafficLattice::isChangingLane(): "
-          "Input vehicle [%1%] is not on lattice.\n") % vehicle).str();
-    throw std::runtime_error(error_msg);
-  }
+  const size_t index = indexOnLattice(vehicle, "TrafficLattice::isChangingLane()");
 
-  boost::shared_ptr<const Node> rear_node = vehicleRearNode(vehicle);
-  boost::shared_ptr<const Node> head_node = vehicleHeadNode(vehicle);
-  const int length = vehicle_to_nodes_table_.find(vehicle)->second.size();
+  boost::shared_ptr<const Node> rear_node = vehicleRearNode(index);
+  boost::shared_ptr<const Node> head_node = vehicleHeadNode(index);
+  const int length = vehicle_nodes_[index].size();
 
   // Find the \c front_node on the same lane of the \c read_node, which is
   // also at the same distance of the \c head_node.
@@ -418,14 +498,27 @@ int32_t TrafficLattice::isChangingLane(const size_t vehicle) const {
 
 int32_t TrafficLattice::deleteVehicle(const size_t vehicle) {
   // If the vehicle is not being tracked, there is nothing to be deleted.
-  if (vehicle_to_nodes_table_.count(vehicle) == 0) return 0;
+  boost::optional<size_t> index = vehicleIndex(vehicle);
+  if (!index) return 0;
 
   // Otherwise, we have to first unregister the vehicle at the
-  // corresponding nodes. Then remove the vehicle from the table.
-  for (auto& node : vehicle_to_nodes_table_[vehicle])
+  // corresponding nodes. Then remove the vehicle from the tables.
+  for (auto& node : vehicle_nodes_[*index])
     if (node.lock()) node.lock()->vehicle() = boost::none;
+  vehicle_to_index_table_.erase(vehicle);
+
+  // Move the last vehicle into the vacated index.
+  const size_t last = vehicle_ids_.size() - 1;
+  if (*index != last) {
+    vehicle_ids_[*index] = vehicle_ids_[last];
+    vehicle_nodes_[*index] = std::move(vehicle_nodes_[last]);
+    vehicle_to_index_table_[vehicle_ids_[*index]] = *index;
+    for (auto& node : vehicle_nodes_[*index])
+      if (node.lock()) node.lock()->vehicle() = *index;
+  }
 
-  vehicle_to_nodes_table_.erase(vehicle);
+  vehicle_ids_.pop_back();
+  vehicle_nodes_.pop_back();
   return 1;
 }
 
@@ -452,11 +545,14 @@ int32_t TrafficLattice::addVehicle(
   // If the vehicle is already on the lattice, the vehicle won't be
   // updated with the new position. The function API is provided to
   // add a new vehicle only.
-  if (vehicle_to_nodes_table_.count(id) != 0) {
+  if (vehicle_to_index_table_.count(id) != 0) {
     //std::printf("Already has this vehicle.\n");
     return 0;
   }
 
+  // The vehicle takes the next index if it can be added.
+  const size_t index = vehicle_ids_.size();
+
   // Find the waypoints (head and rear) of this vehicle.
   //boost::shared_ptr<const CarlaWaypoint> head_waypoint =
   //  vehicleHeadWaypoint(transform, bounding_box);
@@ -543,19 +639,21 @@ int32_t TrafficLattice::addVehicle(
       collision_flag = true;
       break;
     }
-    else node.lock()->vehicle() = id;
+    else node.lock()->vehicle() = index;
   }
 
   if (!collision_flag) {
     // If there is no collision, we can add the vehicle successfully.
-    vehicle_to_nodes_table_[id] = nodes;
+    vehicle_ids_.push_back(id);
+    vehicle_nodes_.push_back(std::move(nodes));
+    vehicle_to_index_table_[id] = index;
     return 1;
   } else {
     // If there is a collision, we should erase the vehicle on the touched nodes,
     // and leave the object in a valid state.
     for (auto& node : nodes) {
       if (!(node.lock()->vehicle())) continue;
-      if (*(node.lock()->vehicle()) != id) continue;
+      if (*(node.lock()->vehicle()) != index) continue;
       node.lock()->vehicle() = boost::none;
     }
     return -1;
@@ -567,16 +665,25 @@ bool TrafficLattice::moveTrafficForward(
     boost::optional<std::unordered_set<size_t>&> disappear_vehicles) {
 
   // We require there is an update for every vehicle that is
-  // currently being tracked, not more or less.
-  std::unordered_set<size_t> existing_vehicles;
-  for (const auto& item : vehicle_to_nodes_table_)
-    existing_vehicles.insert(item.first);
+  // currently being tracked, not more or less. With unique IDs in the
+  // input, matching sizes and lookups suffice, which avoids building
+  // the sets of IDs at every simulation step. The vehicles are usually
+  // given in the order of their indices, e.g. by \c Snapshot, in which
+  // case even the lookups are skipped.
+  bool matched = vehicles.size() == vehicle_ids_.size();
+  for (size_t i = 0; matched && i < vehicles.size(); ++i) {
+    if (std::get<0>(vehicles[i]) == vehicle_ids_[i]) continue;
+    matched = vehicle_to_index_table_.count(std::get<0>(vehicles[i])) != 0;
+  }
 
-  std::unordered_set<size_t> update_vehicles;
-  for (const auto& item : vehicles)
-    update_vehicles.insert(std::get<0>(item));
+  if (!matched) {
+    std::unordered_set<size_t> existing_vehicles(
+        vehicle_ids_.begin(), vehicle_ids_.end());
+
+    std::unordered_set<size_t> update_vehicles;
+    for (const auto& item : vehicles)
+      update_vehicles.insert(std::get<0>(item));
 
-  if (existing_vehicles != update_vehicles) {
     std::string error_msg(
         "TrafficLattice::moveTrafficForward(): "
         "update vehicles does not match existing vehicles.\n");
@@ -595,15 +702,10 @@ bool TrafficLattice::moveTrafficForward(
   }
 
   // Clear all vehicles for the moment, will add them back later.
-  for (auto& item : vehicle_to_nodes_table_) {
-    for (auto& node : item.second) {
-      if (node.lock()) node.lock()->vehicle() = boost::none;
-    }
-  }
-  vehicle_to_nodes_table_.clear();
+  clearVehicles();
 
   // Find waypoints for each of the input vehicle.
-  std::unordered_map<size_t, VehicleWaypoints>
+  std::vector<VehicleWaypoints>
     vehicle_waypoints = vehicleWaypoints(vehicles);
 
   // Re-search for the start and range of the lattice.
@@ -641,7 +743,7 @@ bool TrafficLattice::moveTrafficForward(
   // Register the vehicles onto the lattice.
   std::unordered_set<size_t> remove_vehicles;
   const bool valid = registerVehicles(vehicles, vehicle_waypoints, remove_vehicles);
-  if (disappear_vehicles) *disappear_vehicles = remove_vehicles;
+  if (disappear_vehicles) *disappear_vehicles = std::move(remove_vehicles);
 
   return valid;
 }
@@ -700,40 +802,17 @@ void TrafficLattice::baseConstructor(
 
 void TrafficLattice::latticeStartAndRange(
     const std::vector<VehicleTuple>& vehicles,
-    const std::unordered_map<size_t, VehicleWaypoints>& vehicle_waypoints,
+    const std::vector<VehicleWaypoints>& vehicle_waypoints,
     boost::shared_ptr<CarlaWaypoint>& start,
     double& range) const {
 
-  // Arrange the vehicles by id.
-  //std::printf("Arrange the vehicles by IDs.\n");
-  std::unordered_map<size_t, CarlaTransform> vehicle_transforms;
-  std::unordered_map<size_t, CarlaBoundingBox> vehicle_bounding_boxes;
-  for (const auto& vehicle : vehicles) {
-    size_t id; CarlaTransform transform; CarlaBoundingBox bounding_box;
-    std::tie(id, transform, bounding_box) = vehicle;
-
-    vehicle_transforms[id] = transform;
-    vehicle_bounding_boxes[id] = bounding_box;
-
-    // Check if we are missing any vehicle in \c vehicle_waypoints.
-    if (vehicle_waypoints.count(id) == 0) {
-      std::string error_msg(
+  // Check if we are missing any vehicle in \c vehicle_waypoints.
+  if (vehicle_waypoints.size() != vehicles.size()) {
+    std::string error_msg = (boost::format(
           "TrafficLattice::latticeStartAndRange(): "
-          "vehicle tuples and vehicle waypoints does not match.\n");
-
-      std::string vehicle_tuples_msg("vehicle tuples: ");
-      for (const auto& vehicle : vehicles)
-        vehicle_tuples_msg += std::to_string(std::get<0>(vehicle)) + " ";
-      vehicle_tuples_msg += "\n";
-
-      std::string vehicle_waypoints_msg("vehicle waypoints: ");
-      for (const auto& vehicle : vehicle_waypoints)
-        vehicle_waypoints_msg += std::to_string(vehicle.first) + " ";
-      vehicle_waypoints_msg += "\n";
-
-      throw std::runtime_error(
-          error_msg + vehicle_tuples_msg + vehicle_waypoints_msg);
-    }
+          "waypoints of %1% vehicles does not match %2% vehicle tuples.\n")
+        % vehicle_waypoints.size() % vehicles.size()).str();
+    throw std::runtime_error(error_msg);
   }
 
   // Arrange the critial waypoint according to roads.
@@ -743,10 +822,7 @@ void TrafficLattice::latticeStartAndRange(
     size_t,
     std::vector<boost::shared_ptr<CarlaWaypoint>>> road_to_waypoints_table;
 
-  for (const auto& vehicle : vehicle_transforms) {
-
-    VehicleWaypoints waypoints = vehicle_waypoints.find(vehicle.first)->second;
-
+  for (const auto& waypoints : vehicle_waypoints) {
     for (const auto& waypoint : waypoints) {
       const size_t road = waypoint->GetRoadId();
       if (!(this->router_->hasRoad(road))) continue;
@@ -841,44 +917,69 @@ void TrafficLattice::latticeStartAndRange(
 
 bool TrafficLattice::registerVehicles(
     const std::vector<VehicleTuple>& vehicles,
-    const std::unordered_map<size_t, VehicleWaypoints>& vehicle_waypoints,
+    const std::vector<VehicleWaypoints>& vehicle_waypoints,
     boost::optional<std::unordered_set<size_t>&> disappear_vehicles) {
 
-  // Clear the \c vehicle_to_node_table_.
-  vehicle_to_nodes_table_.clear();
+  if (vehicle_waypoints.size() != vehicles.size()) {
+    std::string error_msg = (boost::format(
+          "TrafficLattice::registerVehicles(): "
+          "waypoints of %1% vehicles does not match %2% vehicle tuples.\n")
+        % vehicle_waypoints.size() % vehicles.size()).str();
+    throw std::runtime_error(error_msg);
+  }
+
+  // Clear the vehicle tables.
+  vehicle_ids_.clear();
+  vehicle_nodes_.clear();
+  vehicle_to_index_table_.clear();
+  vehicle_ids_.reserve(vehicles.size());
+  vehicle_nodes_.reserve(vehicles.size());
+  vehicle_to_index_table_.reserve(vehicles.size());
 
   // Add vehicles onto the lattice, keep track of the disappearred/removed vehicles as well.
+  // The added vehicles are indexed in the order of the input.
   std::unordered_set<size_t> removed_vehicles;
-  for (const auto& vehicle : vehicles) {
-    size_t id;
-    std::tie(id, std::ignore, std::ignore) = vehicle;
-
-    if (vehicle_waypoints.count(id) == 0) {
-      std::string error_msg(
-          "TrafficLattice::registerVehicles(): "
-          "vehicle tuples and vehicle waypoints does not match.\n");
-
-      std::string vehicle_tuples_msg("vehicle tuples: ");
-      for (const auto& vehicle : vehicles)
-        vehicle_tuples_msg += std::to_string(std::get<0>(vehicle)) + " ";
-      vehicle_tuples_msg += "\n";
+  for (size_t i = 0; i < vehicles.size(); ++i) {
+    const int32_t valid = addVehicle(vehicles[i], vehicle_waypoints[i]);
+    if (valid == 0) removed_vehicles.insert(std::get<0>(vehicles[i]));
+    else if (valid == -1) return false;
+  }
 
-      std::string vehicle_waypoints_msg("vehicle waypoints: ");
-      for (const auto& vehicle : vehicle_waypoints)
-        vehicle_waypoints_msg += std::to_string(vehicle.first) + " ";
-      vehicle_waypoints_msg += "\n";
+  if (disappear_vehicles) *disappear_vehicles = removed_vehicles;
+  return true;
+}
 
-      throw std::runtime_error(
-          error_msg + vehicle_tuples_msg + vehicle_waypoints_msg);
+void TrafficLattice::clearVehicles() {
+  for (auto& nodes : vehicle_nodes_) {
+    for (auto& node : nodes) {
+      if (node.lock()) node.lock()->vehicle() = boost::none;
     }
+  }
 
-    const int32_t valid = addVehicle(vehicle, vehicle_waypoints.find(id)->second);
-    if (valid == 0) removed_vehicles.insert(std::get<0>(vehicle));
-    else if (valid == -1) return false;
+  vehicle_ids_.clear();
+  vehicle_nodes_.clear();
+  vehicle_to_index_table_.clear();
+  return;
+}
+
+size_t TrafficLattice::indexOnLattice(
+    const size_t vehicle, const std::string& caller) const {
+  boost::optional<size_t> index = vehicleIndex(vehicle);
+  if (!index) {
+    std::string error_msg = (boost::format(
+          "%1%: Input vehicle [%2%] is not on lattice.\n") % caller % vehicle).str();
+    throw std::runtime_error(error_msg);
   }
+  return *index;
+}
 
-  if (disappear_vehicles) *disappear_vehicles = removed_vehicles;
-  return true;
+void TrafficLattice::checkIndex(
+    const size_t index, const std::string& caller) const {
+  if (index < vehicle_ids_.size()) return;
+  std::string error_msg = (boost::format(
+        "%1%: index %2% is out of the range of %3% vehicles.\n")
+      % caller % index % vehicle_ids_.size()).str();
+  throw std::runtime_error(error_msg);
 }
 
 std::deque<size_t> TrafficLattice::sortRoads(
@@ -971,20 +1072,19 @@ boost::shared_ptr<typename TrafficLattice::CarlaWaypoint>
   return fast_map_->waypoint(waypoint_location);
 }
 
-std::unordered_map<size_t, typename TrafficLattice::VehicleWaypoints>
+std::vector<typename TrafficLattice::VehicleWaypoints>
   TrafficLattice::vehicleWaypoints(
     const std::vector<VehicleTuple>& vehicles) const {
 
-  std::unordered_map<size_t, VehicleWaypoints> vehicle_waypoints;
+  std::vector<VehicleWaypoints> vehicle_waypoints(vehicles.size());
 
-  for (const auto& vehicle : vehicles) {
-    size_t id; CarlaTransform transform; CarlaBoundingBox bounding_box;
-    std::tie(id, transform, bounding_box) = vehicle;
+  for (size_t i = 0; i < vehicles.size(); ++i) {
+    CarlaTransform transform; CarlaBoundingBox bounding_box;
+    std::tie(std::ignore, transform, bounding_box) = vehicles[i];
 
-    vehicle_waypoints[id] = VehicleWaypoints();
-    vehicle_waypoints[id][0] = vehicleRearWaypoint(transform, bounding_box);
-    vehicle_waypoints[id][1] = vehicleWaypoint(transform);
-    vehicle_waypoints[id][2] = vehicleHeadWaypoint(transform, bounding_box);
+    vehicle_waypoints[i][0] = vehicleRearWaypoint(transform, bounding_box);
+    vehicle_waypoints[i][1] = vehicleWaypoint(transform);
+    vehicle_waypoints[i][2] = vehicleHeadWaypoint(transform, bounding_box);
   }
 
   return vehicle_waypoints;
@@ -1066,9 +1166,9 @@ std::string TrafficLattice::string(const std::string& prefix) const {
   std::string lattice_msg = Base::string(prefix);
 
   std::string vehicles_msg;
-  for (const auto& vehicle : vehicle_to_nodes_table_) {
-    std::string vehicle_msg = (boost::format("vehicle %1%:\n") % vehicle.first).str();
-    for (const auto& node : vehicle.second)
+  for (size_t i = 0; i < vehicle_ids_.size(); ++i) {
+    std::string vehicle_msg = (boost::format("vehicle %1%:\n") % vehicle_ids_[i]).str();
+    for (const auto& node : vehicle_nodes_[i])
       vehicle_msg += node.lock()->string();
     vehicles_msg += vehicle_msg;
   }
@@ -18,6 +18,7 @@
 #include <tuple>
 #include <array>
 #include <string>
+#include <vector>
 
 #include <boost/format.hpp>
 #include <boost/optional.hpp>
@@ -36,7 +37,8 @@ namespace planner {
  * \brief WaypointNodeWithVehicle is similar to WaypointNode, but also keeps
  *        tracks of the vehicle at this node.
  *
- * Each node is at most associated with one vehicle.
+ * Each node is at most associated with one vehicle, which is identified
+ * by its index on the traffic lattice instead of its carla ID.
  */
 class WaypointNodeWithVehicle : public LatticeNode<WaypointNodeWithVehicle> {
 
@@ -51,7 +53,7 @@ protected:
 
 protected:
 
-  /// ID of the vehicle that occupies this node.
+  /// Index of the vehicle that occupies this node, \see TrafficLattice::vehicleId().
   boost::optional<size_t> vehicle_ = boost::none;
 
 public:
@@ -66,10 +68,10 @@ public:
   WaypointNodeWithVehicle(const boost::shared_ptr<const CarlaWaypoint>& waypoint) :
     Base(waypoint) {}
 
-  /// Get the vehicle ID registered at this node.
+  /// Get the vehicle index registered at this node.
   boost::optional<size_t> vehicle() const { return vehicle_; }
 
-  /// Get or set the vehicle ID at this node.
+  /// Get or set the vehicle index at this node.
   boost::optional<size_t>& vehicle() { return vehicle_; }
 
   // Get the string describing the node.
@@ -91,9 +93,9 @@ public:
 
     std::string vehicle_msg;
     if (!vehicle_)
-      vehicle_msg = "vehicle at this node: \n";
+      vehicle_msg = "vehicle index at this node: \n";
     else
-      vehicle_msg = (boost::format("vehicle at this node: %1%\n") % (*vehicle_)).str();
+      vehicle_msg = (boost::format("vehicle index at this node: %1%\n") % (*vehicle_)).str();
 
     return prefix + waypoint_msg + distance_msg + vehicle_msg;
     // TODO: Add the info for neighbor waypoints as well.
@@ -105,6 +107,14 @@ public:
  * \brief TrafficLattice is a helper class used to track local traffic,
  *        i.e. the vehicles within a finite range neighborhood.
  *
+ * The vehicles on the lattice are interned into dense indices 0..N-1, and
+ * all internal tables are arrays addressed by the indices. Carla IDs of
+ * the vehicles are only looked up at the interface. Vehicles registered in
+ * a batch, i.e. by the constructors and \c moveTrafficForward(), are
+ * indexed in the order they are given, skipping the ones that cannot be
+ * registered. This is how \c Snapshot keeps the vehicles indexed the same
+ * as in \c VehicleStates.
+ *
  * \note Have to change carla/road/Map.h to compile this class.
  *       Remove the guard of LIBCARLA_WITH_GETEST, and set the
  *       function prototype from
@@ -142,13 +152,17 @@ private:
 
 protected:
 
+  /// Carla IDs of the vehicles at each index.
+  std::vector<size_t> vehicle_ids_;
+
   /**
-   * A mapping from vehicle ID to its occupied nodes in the lattice.
-   *
-   * For each entry, the key is the vehicle ID, the value is the nodes
-   * occupied by the vehicle. The nodes are sorted from the vehicle rear to head.
+   * The nodes occupied by the vehicle at each index. The nodes are sorted
+   * from the vehicle rear to head.
    */
-  std::unordered_map<size_t, std::vector<boost::weak_ptr<Node>>> vehicle_to_nodes_table_;
+  std::vector<std::vector<boost::weak_ptr<Node>>> vehicle_nodes_;
+
+  /// A mapping from the carla ID of a vehicle to its index.
+  utils::FlatHashMap<size_t, size_t> vehicle_to_index_table_;
 
   /// Carla map, used to road and lanes.
   boost::shared_ptr<CarlaMap> map_;
@@ -192,6 +206,22 @@ public:
       const boost::shared_ptr<router::Router>& router,
       boost::optional<std::unordered_set<size_t>&> disappear_vehicles = boost::none);
 
+  /**
+   * \brief Construct the lattice from the data written by \c serialize().
+   *
+   * \param[in] is The input stream to read the lattice from.
+   * \param[in] resolver Used to find the carla waypoint of each node.
+   * \param[in] map The carla map used to find roads and lanes.
+   * \param[in] fast_map Fast waypoint map used to find waypoints based on locations.
+   * \param[in] router A router object used to find road sequences.
+   */
+  TrafficLattice(
+      std::istream& is,
+      const WaypointResolver& resolver,
+      const boost::shared_ptr<CarlaMap>& map,
+      const boost::shared_ptr<utils::FastWaypointMap>& fast_map,
+      const boost::shared_ptr<router::Router>& router);
+
   /// Copy constructor.
   TrafficLattice(const TrafficLattice& other);
 
@@ -226,9 +256,60 @@ public:
   boost::optional<std::pair<size_t, double>> rightBack(const size_t vehicle) const;
   /// @}
 
+  /**
+   * @name Indexed Vehicle Query
+   *
+   * Same as the vehicle queries above, except that the query vehicle and the
+   * returned vehicle are both given by their indices on the lattice. No hash
+   * lookup is involved, which makes these the preferred interface in the
+   * simulation loops.
+   *
+   * The functions throw \c std::runtime_error if the index is out of range.
+   */
+  /// @{
+  boost::optional<std::pair<size_t, double>> frontAt(const size_t index) const;
+
+  boost::optional<std::pair<size_t, double>> backAt(const size_t index) const;
+
+  boost::optional<std::pair<size_t, double>> leftFrontAt(const size_t index) const;
+
+  boost::optional<std::pair<size_t, double>> leftBackAt(const size_t index) const;
+
+  boost::optional<std::pair<size_t, double>> rightFrontAt(const size_t index) const;
+
+  boost::optional<std::pair<size_t, double>> rightBackAt(const size_t index) const;
+
+  double vehicleDistanceAt(const size_t index) const;
+  /// @}
+
   /// Return the IDs of the vehicles that are currently being tracked.
   std::unordered_set<size_t> vehicles() const;
 
+  /// Return the number of vehicles that are currently being tracked.
+  size_t vehicleNum() const { return vehicle_ids_.size(); }
+
+  /// Get the carla ID of the vehicle at the given index.
+  size_t vehicleId(const size_t index) const { return vehicle_ids_[index]; }
+
+  /// Get the index of a vehicle, \c boost::none if the vehicle is not on the lattice.
+  boost::optional<size_t> vehicleIndex(const size_t vehicle) const {
+    utils::FlatHashMap<size_t, size_t>::const_iterator iter =
+      vehicle_to_index_table_.find(vehicle);
+    if (iter == vehicle_to_index_table_.end()) return boost::none;
+    return iter->second;
+  }
+
+  /**
+   * \brief Get the distance of the vehicle head from the start of the lattice.
+   *
+   * In the case the input vehicle is not found on the lattice, the function
+   * throws \c std::runtime_error exception.
+   *
+   * \param[in] vehicle The ID of the query vehicle.
+   * \return The lattice distance of the node at the head of the vehicle.
+   */
+  double vehicleDistance(const size_t vehicle) const;
+
   /**
    * \brief Check if a vehicle is in the process of lane changing.
    *
@@ -246,6 +327,9 @@ public:
   /**
    * \brief Delete a vehicle on the lattice.
    *
+   * The last vehicle is moved into the index of the deleted vehicle,
+   * the same as \c VehicleStates::erase().
+   *
    * \param[in] vehicle The ID of the vehicle to be deleted.
    * \return
    *  - 1 If the given vehicle is deleted successfully.
@@ -256,6 +340,9 @@ public:
 
   /**
    * \brief Add a vehicle on the current lattice.
+   *
+   * The added vehicle takes the next index on the lattice.
+   *
    * \param[in] vehicle The vehicle to be added.
    * \return
    *  - 1 If the given vehicle is added successfully.
@@ -313,6 +400,16 @@ public:
       const std::vector<boost::shared_ptr<const CarlaVehicle>>& vehicles,
       boost::optional<std::unordered_set<size_t>&> disappear_vehicles = boost::none);
 
+  /**
+   * \brief Write the lattice into a compact binary format.
+   *
+   * On top of the nodes written by \c Lattice::serialize(), the nodes
+   * occupied by each vehicle are written as well.
+   *
+   * \param[out] os The output stream to write the lattice to.
+   */
+  void serialize(std::ostream& os) const override;
+
   /// Get the string describing the lattice.
   std::string string(const std::string& prefix="") const;
 
@@ -354,13 +451,14 @@ protected:
    *        the given vehicles.
    *
    * \param[in] vehicles The vehicles to be registered onto the lattice.
-   * \param[in] vehicle_waypoints The waypoints on each vehicle.
+   * \param[in] vehicle_waypoints The waypoints on each vehicle, in the same
+   *                              order as \c vehicles.
    * \param[out] start The start waypoint of the lattice.
    * \param[out] range The range of the lattice.
    */
   void latticeStartAndRange(
       const std::vector<VehicleTuple>& vehicles,
-      const std::unordered_map<size_t, VehicleWaypoints>& vehicle_waypoints,
+      const std::vector<VehicleWaypoints>& vehicle_waypoints,
       boost::shared_ptr<CarlaWaypoint>& start,
       double& range) const;
 
@@ -421,10 +519,10 @@ protected:
   /**
    * \brief Find the three waypoints for each of the input vehicle.
    * \param[in] vechiles The vehicles to find waypoints for.
-   * \return An unordered map with keys as vehicle IDs, and values as the
-   *         waypoints for the correspoinding vehicle from rear to head.
+   * \return The waypoints of each vehicle from rear to head, in the same
+   *         order as the input vehicles.
    */
-  std::unordered_map<size_t, VehicleWaypoints> vehicleWaypoints(
+  std::vector<VehicleWaypoints> vehicleWaypoints(
       const std::vector<VehicleTuple>& vehicles) const;
 
   /**
@@ -435,8 +533,10 @@ protected:
    * \note If this function returns false, it will leave the object
    *       at an invalid state. One should not use the object anymore.
    *
-   * \param[in] vehicles The vehicles to be registered.
-   * \param[in] vehicle_waypoints Waypoints for the vehicles.
+   * \param[in] vehicles The vehicles to be registered, which are indexed
+   *                     in this order.
+   * \param[in] vehicle_waypoints Waypoints for the vehicles, in the same
+   *                              order as \c vehicles.
    * \param[out] disappear_vehicles The vehicles which cannot be registered.
    *                                \see addVehicle() for when a vehicle cannot
    *                                be added.
@@ -444,9 +544,32 @@ protected:
    */
   bool registerVehicles(
       const std::vector<VehicleTuple>& vehicles,
-      const std::unordered_map<size_t, VehicleWaypoints>& vehicle_waypoints,
+      const std::vector<VehicleWaypoints>& vehicle_waypoints,
       boost::optional<std::unordered_set<size_t>&> disappear_vehicles);
 
+  /// Unregister all vehicles from the lattice nodes, and clear the vehicle tables.
+  void clearVehicles();
+
+  /**
+   * \brief Get the index of a vehicle on the lattice.
+   *
+   * \param[in] vehicle The carla ID of the query vehicle.
+   * \param[in] caller The caller function, used in the error message.
+   * \return The index of the vehicle. Throws \c std::runtime_error if the
+   *         vehicle is not on the lattice.
+   */
+  size_t indexOnLattice(const size_t vehicle, const std::string& caller) const;
+
+  /// Throw \c std::runtime_error if the index is out of the range of the vehicles.
+  void checkIndex(const size_t index, const std::string& caller) const;
+
+  /// Convert the vehicle index within the query result to the carla ID.
+  boost::optional<std::pair<size_t, double>> vehicleIdOf(
+      const boost::optional<std::pair<size_t, double>>& result) const {
+    if (!result) return boost::none;
+    return std::make_pair(vehicle_ids_[result->first], result->second);
+  }
+
   /**
    * \brief Compute the distance of the waypoint to the start of the road.
    *
@@ -487,7 +610,8 @@ protected:
   /**
    * \brief Find a front vehicle starting from a given node.
    * \param[in] start The query node
-   * \return \c nullptr if a front vehicle does not exist on the lattice.
+   * \return The index of and the distance to the front vehicle,
+   *         \c boost::none if a front vehicle does not exist on the lattice.
    */
   boost::optional<std::pair<size_t, double>>
     frontVehicle(const boost::shared_ptr<const Node>& start) const;
@@ -495,27 +619,28 @@ protected:
   /**
    * \brief Find a back vehicle starting from a given node.
    * \param[in] start The query node
-   * \return \c nullptr if a back vehicle does not exist on the lattice.
+   * \return The index of and the distance to the back vehicle,
+   *         \c boost::none if a back vehicle does not exist on the lattice.
    */
   boost::optional<std::pair<size_t, double>>
     backVehicle(const boost::shared_ptr<const Node>& start) const;
 
   /**
    * \brief Find the head node of a vehicle.
-   * \param[in] vehicle The query vehicle ID.
+   * \param[in] index The query vehicle index.
    * \return The node on the lattice corresponds to the head of the vehicle.
    */
-  boost::shared_ptr<const Node> vehicleHeadNode(const size_t vehicle) const {
-    return vehicle_to_nodes_table_.find(vehicle)->second.back().lock();
+  boost::shared_ptr<const Node> vehicleHeadNode(const size_t index) const {
+    return vehicle_nodes_[index].back().lock();
   }
 
   /**
    * \brief Find the rear node of a vehicle.
-   * \param[in] vehicle The query vehicle ID.
+   * \param[in] index The query vehicle index.
    * \return The node on the lattice corresponds to the rear of the vehicle.
    */
-  boost::shared_ptr<const Node> vehicleRearNode(const size_t vehicle) const {
-    return vehicle_to_nodes_table_.find(vehicle)->second.front().lock();
+  boost::shared_ptr<const Node> vehicleRearNode(const size_t index) const {
+    return vehicle_nodes_[index].front().lock();
   }
 
 }; // End class TrafficLattice.
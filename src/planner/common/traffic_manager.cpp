@@ -16,7 +16,6 @@
 
 #include <algorithm>
 #include <random>
-#include <chrono>
 
 #include <planner/common/traffic_manager.h>
 
@@ -27,7 +26,8 @@ TrafficManager::TrafficManager(
     const double range,
     const boost::shared_ptr<router::Router>& router,
     const boost::shared_ptr<CarlaMap>& map,
-    const boost::shared_ptr<utils::FastWaypointMap>& fast_map) {
+    const boost::shared_ptr<utils::FastWaypointMap>& fast_map,
+    const size_t seed) : rand_gen_(seed) {
   // The \c longitudinal_resolution_ is fixed to 1.0m.
   this->map_ = map;
   this->fast_map_ = fast_map;
@@ -42,9 +42,8 @@ bool TrafficManager::moveTrafficForward(
 
   // We require there is an update for every vehicle that is
   // currently being tracked, not more or less.
-  std::unordered_set<size_t> existing_vehicles;
-  for (const auto& item : this->vehicle_to_nodes_table_)
-    existing_vehicles.insert(item.first);
+  std::unordered_set<size_t> existing_vehicles(
+      this->vehicle_ids_.begin(), this->vehicle_ids_.end());
 
   std::unordered_set<size_t> update_vehicles;
   for (const auto& item : vehicles)
@@ -69,18 +68,13 @@ bool TrafficManager::moveTrafficForward(
   }
 
   // Clear all vehicles for the moment, will add them back later.
-  for (auto& item : this->vehicle_to_nodes_table_) {
-    for (auto& node : item.second) {
-      if (node.lock()) node.lock()->vehicle() = boost::none;
-    }
-  }
-  this->vehicle_to_nodes_table_.clear();
+  this->clearVehicles();
 
   // Shift the whole lattice forward by the given distance.
   this->shift(shift_distance);
 
   // Find waypoints for each of the input vehicle.
-  std::unordered_map<size_t, VehicleWaypoints>
+  std::vector<VehicleWaypoints>
     vehicle_waypoints = this->vehicleWaypoints(vehicles);
 
   // Register the vehicles onto the lattice.
@@ -116,17 +110,21 @@ boost::optional<std::pair<
   double,
   boost::shared_ptr<const typename TrafficManager::CarlaWaypoint>
   >>
-  TrafficManager::frontSpawnWaypoint(const double min_range) const {
+  TrafficManager::frontSpawnWaypoint(
+      const LaneOccupancy& occupancy,
+      const double min_range,
+      const boost::optional<size_t>& lane) const {
 
   // All lattice exits are candidates where we can spawn new vehicles.
-  std::vector<boost::shared_ptr<const Node>> candidates;
-  for (auto& exit : this->lattice_exits_)
-    candidates.push_back(exit.lock());
-
   // Collect candidates that meet the requirement.
   std::vector<std::pair<double, boost::shared_ptr<const CarlaWaypoint>>> valid_candidates;
-  for (const auto& candidate : candidates) {
-    boost::optional<std::pair<size_t, double>> back = this->backVehicle(candidate);
+  for (const auto& exit : this->lattice_exits_) {
+    boost::shared_ptr<const Node> candidate = exit.lock();
+    const size_t candidate_lane = laneIndex(candidate);
+    if (lane && candidate_lane != *lane) continue;
+
+    boost::optional<std::pair<size_t, double>> back =
+      occupancy.backVehicle(candidate_lane, candidate->distance());
     if (back && back->second < min_range) continue;
 
     if (!back) valid_candidates.push_back(
@@ -139,28 +137,29 @@ boost::optional<std::pair<
   if (valid_candidates.size() == 0) return boost::none;
 
   // Otherwise, return a random candidate.
-  size_t seed = std::chrono::system_clock::now().time_since_epoch().count();
-  std::shuffle(valid_candidates.begin(),
-               valid_candidates.end(),
-               std::default_random_engine(seed));
-  return valid_candidates.front();
+  std::uniform_int_distribution<size_t> uni(0, valid_candidates.size()-1);
+  return valid_candidates[uni(rand_gen_)];
 }
 
 boost::optional<std::pair<
   double,
   boost::shared_ptr<const typename TrafficManager::CarlaWaypoint>
   >>
-  TrafficManager::backSpawnWaypoint(const double min_range) const {
+  TrafficManager::backSpawnWaypoint(
+      const LaneOccupancy& occupancy,
+      const double min_range,
+      const boost::optional<size_t>& lane) const {
 
   // All lattice entries are candidates where we can spawn new vehicles.
-  std::vector<boost::shared_ptr<const Node>> candidates;
-  for (auto& entry : this->lattice_entries_)
-    candidates.push_back(entry.lock());
-
   // Collect candidates that meet the requirement.
   std::vector<std::pair<double, boost::shared_ptr<const CarlaWaypoint>>> valid_candidates;
-  for (const auto& candidate : candidates) {
-    boost::optional<std::pair<size_t, double>> front = this->frontVehicle(candidate);
+  for (const auto& entry : this->lattice_entries_) {
+    boost::shared_ptr<const Node> candidate = entry.lock();
+    const size_t candidate_lane = laneIndex(candidate);
+    if (lane && candidate_lane != *lane) continue;
+
+    boost::optional<std::pair<size_t, double>> front =
+      occupancy.frontVehicle(candidate_lane, candidate->distance());
     if (front && front->second < min_range) continue;
 
     if (!front) valid_candidates.push_back(
@@ -173,11 +172,65 @@ boost::optional<std::pair<
   if (valid_candidates.size() == 0) return boost::none;
 
   // Otherwise, return a random candidate.
-  size_t seed = std::chrono::system_clock::now().time_since_epoch().count();
-  std::shuffle(valid_candidates.begin(),
-               valid_candidates.end(),
-               std::default_random_engine(seed));
-  return valid_candidates.front();
+  std::uniform_int_distribution<size_t> uni(0, valid_candidates.size()-1);
+  return valid_candidates[uni(rand_gen_)];
+}
+
+size_t TrafficManager::laneIndex(const boost::shared_ptr<const Node>& node) const {
+  if (!node) {
+    throw std::runtime_error(
+        "TrafficManager::laneIndex(): "
+        "the input node does not exist on lattice.\n");
+  }
+
+  size_t index = 0;
+  for (boost::shared_ptr<const Node> left = node->left(); left; left = left->left())
+    ++index;
+  return index;
+}
+
+size_t TrafficManager::lanes() const {
+  size_t lanes = 0;
+  for (const auto& entry : this->lattice_entries_)
+    lanes = std::max(lanes, laneIndex(entry.lock())+1);
+  for (const auto& exit : this->lattice_exits_)
+    lanes = std::max(lanes, laneIndex(exit.lock())+1);
+  return lanes;
+}
+
+LaneOccupancy TrafficManager::laneOccupancy() const {
+
+  LaneOccupancy occupancy(lanes());
+
+  for (size_t i = 0; i < this->vehicle_ids_.size(); ++i) {
+    boost::shared_ptr<const Node> rear = vehicleRearNode(i);
+    boost::shared_ptr<const Node> head = vehicleHeadNode(i);
+    if (!rear || !head) continue;
+
+    const size_t rear_lane = laneIndex(rear);
+    const size_t head_lane = laneIndex(head);
+    const double rear_distance = std::min(rear->distance(), head->distance());
+    const double head_distance = std::max(rear->distance(), head->distance());
+
+    occupancy.add(rear_lane, rear_distance, head_distance, this->vehicle_ids_[i]);
+    if (head_lane != rear_lane)
+      occupancy.add(head_lane, rear_distance, head_distance, this->vehicle_ids_[i]);
+  }
+
+  return occupancy;
+}
+
+std::vector<double> TrafficManager::laneDensities(
+    const LaneOccupancy& occupancy) const {
+
+  const double range = this->range();
+
+  std::vector<double> densities(occupancy.lanes(), 0.0);
+  if (range <= 0.0) return densities;
+
+  for (size_t lane = 0; lane < densities.size(); ++lane)
+    densities[lane] = static_cast<double>(occupancy.count(lane)) / range * 1000.0;
+  return densities;
 }
 
 } // End namespace planner.
@@ -14,7 +14,9 @@
 
 #pragma once
 
+#include <random>
 #include <planner/common/traffic_lattice.h>
+#include <planner/common/lane_occupancy.h>
 
 namespace planner {
 
@@ -55,6 +57,11 @@ private:
 
   using Base = TrafficLattice;
 
+protected:
+
+  /// Random number generator used to select the spawn waypoints.
+  mutable std::default_random_engine rand_gen_;
+
 public:
 
   // Lift some protected functions in the base class into public.
@@ -76,12 +83,15 @@ public:
    * \param[in] router A router object giving the road sequences.
    * \param[in] map A carla map object used to query roads and lanes.
    * \param[in] fast_map The fast map is to find waypoints based on locations.
+   * \param[in] seed Seed of the random number generator selecting the spawn
+   *                 waypoints, so that the spawned traffic is reproducible.
    */
   TrafficManager(const boost::shared_ptr<CarlaWaypoint>& start,
                  const double range,
                  const boost::shared_ptr<router::Router>& router,
                  const boost::shared_ptr<CarlaMap>& map,
-                 const boost::shared_ptr<utils::FastWaypointMap>& fast_map);
+                 const boost::shared_ptr<utils::FastWaypointMap>& fast_map,
+                 const size_t seed = 0);
 
   /**
    * \brief Update the the vehcile postions in the lattice.
@@ -142,12 +152,29 @@ public:
    * requirement, the one with the farthest back vehicle is returned.
    *
    * \param[in] min_range The tolerate distance between the spawned waypoint and the back vehicle.
+   * \param[in] lane If given, only waypoints on this lane are considered.
    * \return If there is a waypoint found which meets the requirement, it will be returned
    *         together with the distance to the vehicle at its back. If there is no vehicle
    *         at its back, the returned distance will be the range of the lattice.
    */
   boost::optional<std::pair<double, boost::shared_ptr<const CarlaWaypoint>>>
-    frontSpawnWaypoint(const double min_range) const;
+    frontSpawnWaypoint(const double min_range,
+                       const boost::optional<size_t>& lane = boost::none) const {
+    return frontSpawnWaypoint(laneOccupancy(), min_range, lane);
+  }
+
+  /**
+   * \brief Suggest a waypoint to spawn a new vehicle at the front of the lattice.
+   *
+   * Same as above, with the lane occupancy given. Building the occupancy
+   * is linear in the number of vehicles, so the caller should build it
+   * once with \c laneOccupancy() if it queries several spawn waypoints
+   * on the same traffic.
+   */
+  boost::optional<std::pair<double, boost::shared_ptr<const CarlaWaypoint>>>
+    frontSpawnWaypoint(const LaneOccupancy& occupancy,
+                       const double min_range,
+                       const boost::optional<size_t>& lane = boost::none) const;
 
   /**
    * \brief Suggest a waypoint to spawn a new vehicle at the back of the lattice.
@@ -158,12 +185,54 @@ public:
    * requirement, the one with the farthest front vehicle is returned.
    *
    * \param[in] min_range The tolerate distance between the spawned waypoint and the front vehicle.
+   * \param[in] lane If given, only waypoints on this lane are considered.
    * \return If there is a waypoint found which meets the requirement, it will be returned
    *         together with the distance to the vehicle at its front. If there is no vehicle
    *         at its front, the returned distance will be the range of the lattice.
    */
   boost::optional<std::pair<double, boost::shared_ptr<const CarlaWaypoint>>>
-    backSpawnWaypoint(const double min_range) const;
+    backSpawnWaypoint(const double min_range,
+                      const boost::optional<size_t>& lane = boost::none) const {
+    return backSpawnWaypoint(laneOccupancy(), min_range, lane);
+  }
+
+  /**
+   * \brief Suggest a waypoint to spawn a new vehicle at the back of the lattice.
+   *
+   * Same as above, with the lane occupancy given.
+   */
+  boost::optional<std::pair<double, boost::shared_ptr<const CarlaWaypoint>>>
+    backSpawnWaypoint(const LaneOccupancy& occupancy,
+                      const double min_range,
+                      const boost::optional<size_t>& lane = boost::none) const;
+
+  /**
+   * \brief Get the index of the lane a node is on.
+   *
+   * Lanes are counted from the leftmost lane, which has index 0.
+   */
+  size_t laneIndex(const boost::shared_ptr<const Node>& node) const;
+
+  /// Number of lanes at the entries and exits of the lattice.
+  size_t lanes() const;
+
+  /**
+   * \brief Index the vehicles on the lattice by lane.
+   *
+   * A vehicle whose rear and head are on different lanes, i.e. a vehicle
+   * changing lanes, is added to both lanes.
+   */
+  LaneOccupancy laneOccupancy() const;
+
+  /**
+   * \brief Traffic density (vehicles/km) on each lane over the lattice range.
+   */
+  std::vector<double> laneDensities() const {
+    return laneDensities(laneOccupancy());
+  }
+
+  /// Traffic density on each lane, with the lane occupancy given.
+  std::vector<double> laneDensities(const LaneOccupancy& occupancy) const;
 
 }; // End class TrafficManager.
 
@@ -24,9 +24,9 @@ namespace planner {
 
 const std::tuple<size_t, typename TrafficSimulator::CarlaTransform, double, double, double>
   TrafficSimulator::updatedAgentTuple(
-      const size_t id, const double accel, const double dt) const {
+      const size_t index, const double accel, const double dt) const {
 
-    const Vehicle& agent = snapshot_.vehicle(id);
+    const ConstVehicleView agent = snapshot_.vehicles().view(index);
 
     // The updated speed.
     const double updated_speed = agent.speed() + accel*dt;
@@ -64,6 +64,9 @@ const std::tuple<size_t, typename TrafficSimulator::CarlaTransform, double, doub
       // Find the next waypoint candidates.
       std::vector<boost::shared_ptr<CarlaWaypoint>> next_waypoints;
 
+      // The movement varies continuously with the speed and acceleration, so
+      // the query would almost never hit the waypoint cache. Carla is queried
+      // directly instead of polluting the cache with one-off entries.
       if (movement == 0.0) next_waypoints.push_back(waypoint);
       else next_waypoints = waypoint->GetNext(movement);
 
@@ -115,7 +118,7 @@ const std::tuple<size_t, typename TrafficSimulator::CarlaTransform, double, doub
     update_transform = next_waypoint->GetTransform();
     update_curvature = utils::curvatureAtWaypoint(next_waypoint, map_);
 
-    return std::make_tuple(id, update_transform, updated_speed, accel, update_curvature);
+    return std::make_tuple(agent.id(), update_transform, updated_speed, accel, update_curvature);
 }
 
 const double TrafficSimulator::remainingTime(
@@ -166,7 +169,7 @@ const double TrafficSimulator::ttcCost(const double ttc) const {
 
 const double TrafficSimulator::ttcCost() const {
   boost::optional<std::pair<size_t, double>> ego_lead =
-    snapshot_.trafficLattice()->front(snapshot_.ego().id());
+    snapshot_.trafficLattice()->frontAt(0);
 
   if (!ego_lead) return ttcCost(10.0);
   else return ttcCost(ego_lead->second/snapshot_.ego().speed());
@@ -198,24 +201,26 @@ const double TrafficSimulator::accelCost(const double accel) const {
 const double TrafficSimulator::accelCost() const {
   // We consider four vehicles in computing the accel cost.
   // The ego and the followers of the ego vehicle.
+  // The ego is always at index 0, and the found vehicles are returned as indices.
   boost::optional<std::pair<size_t, double>> back =
-    snapshot_.trafficLattice()->back(snapshot_.ego().id());
+    snapshot_.trafficLattice()->backAt(0);
   boost::optional<std::pair<size_t, double>> left_back =
-    snapshot_.trafficLattice()->leftBack(snapshot_.ego().id());
+    snapshot_.trafficLattice()->leftBackAt(0);
   boost::optional<std::pair<size_t, double>> right_back =
-    snapshot_.trafficLattice()->rightBack(snapshot_.ego().id());
+    snapshot_.trafficLattice()->rightBackAt(0);
 
+  const std::vector<double>& accelerations = snapshot_.vehicles().accelerations();
   double ego_brake_cost = accelCost(snapshot_.ego().acceleration());
   double agent_brake_cost = 0.0;
-  if (back)       agent_brake_cost += accelCost(snapshot_.vehicle(back->first).acceleration());
-  if (left_back)  agent_brake_cost += accelCost(snapshot_.vehicle(left_back->first).acceleration());
-  if (right_back) agent_brake_cost += accelCost(snapshot_.vehicle(right_back->first).acceleration());
+  if (back)       agent_brake_cost += accelCost(accelerations[back->first]);
+  if (left_back)  agent_brake_cost += accelCost(accelerations[left_back->first]);
+  if (right_back) agent_brake_cost += accelCost(accelerations[right_back->first]);
 
   return ego_brake_cost + 0.5*agent_brake_cost;
 }
 
 const bool TrafficSimulator::simulate(
-    const ContinuousPath& path, const double default_dt, const double max_time,
+    const VehiclePath& path, const double default_dt, const double max_time,
     double& time, double& cost) {
 
   //std::printf("simulate(): \n");
@@ -230,13 +235,16 @@ const bool TrafficSimulator::simulate(
   double ego_distance = 0.0;
 
   // FIXME: This is just a trial for defining the stage costs.
-  std::vector<double> ttc_cost;
-  std::vector<double> brake_cost;
+  // The stage costs are accumulated as running sums.
+  double ttc_cost = 0.0;
+  double brake_cost = 0.0;
+  size_t stages = 0;
 
   while (time < max_time && dt >= default_dt) {
 
-    // Used to store the updated status of all vehicles.
-    std::vector<std::tuple<size_t, CarlaTransform, double, double, double>> updated_tuples;
+    // Used to store the updated status of all vehicles, indexed the same
+    // as the vehicles in the snapshot. The buffer is reused across steps.
+    update_.reset(snapshot_.vehicles().size());
 
     // The acceleration to be applied by the ego vehicle.
     const double ego_accel = egoAcceleration();
@@ -262,23 +270,28 @@ const bool TrafficSimulator::simulate(
 
     // Store the updated status of the ego.
     std::pair<CarlaTransform, double> ego_transform = path.transformAt(ego_distance);
-    updated_tuples.push_back(std::make_tuple(
-          snapshot_.ego().id(),
-          ego_transform.first,
-          snapshot_.ego().speed()+ego_accel*dt,
-          ego_accel,
-          ego_transform.second));
+    update_.set(0,
+                ego_transform.first,
+                snapshot_.ego().speed()+ego_accel*dt,
+                ego_accel,
+                ego_transform.second);
 
     // Take care of the agents.
-    for (const auto& item : snapshot_.agents()) {
-      const Vehicle& agent = item.second;
-      const double agent_accel = agentAcceleration(agent.id());
-      updated_tuples.push_back(updatedAgentTuple(agent.id(), agent_accel, dt));
-      //std::printf("agent %lu accel: %f\n", agent.id(), agent_accel);
+    // The agents are addressed by their indices, which avoids any ID lookup.
+    for (size_t i = 1; i < snapshot_.vehicles().size(); ++i) {
+      const double agent_accel = agentAcceleration(i);
+      const std::tuple<size_t, CarlaTransform, double, double, double>
+        agent_tuple = updatedAgentTuple(i, agent_accel, dt);
+      update_.set(i,
+                  std::get<1>(agent_tuple),
+                  std::get<2>(agent_tuple),
+                  std::get<3>(agent_tuple),
+                  std::get<4>(agent_tuple));
+      //std::printf("agent %lu accel: %f\n", std::get<0>(agent_tuple), agent_accel);
     }
 
     // Update the snapshot.
-    if (!snapshot_.updateTraffic(updated_tuples)) {
+    if (!snapshot_.updateTraffic(update_)) {
       //std::printf("Collision detected in the simulation.\n");
       return false;
     }
@@ -286,8 +299,9 @@ const bool TrafficSimulator::simulate(
     //std::cout << snapshot_.string("end simulation snapshot:\n");
 
     // TODO: Accumulate the cost.
-    ttc_cost.push_back(ttcCost());
-    brake_cost.push_back(accelCost());
+    ttc_cost += ttcCost();
+    brake_cost += accelCost();
+    ++stages;
 
     //std::printf("ttc cost: %f\n", ttcCost());
     //std::printf("brake cost: %f\n", accelCost());
@@ -297,13 +311,8 @@ const bool TrafficSimulator::simulate(
   }
 
   // TODO: Should I use mean or max?
-  double average_ttc_cost = 0.0;
-  for (const auto c : ttc_cost) average_ttc_cost += c;
-  average_ttc_cost /= ttc_cost.size();
-
-  double average_brake_cost = 0.0;
-  for (const auto c : brake_cost) average_brake_cost += c;
-  average_brake_cost /= brake_cost.size();
+  const double average_ttc_cost = ttc_cost / stages;
+  const double average_brake_cost = brake_cost / stages;
 
   //std::printf("average ttc cost: %f\n", average_ttc_cost);
   //std::printf("average brake cost: %f\n", average_brake_cost);
@@ -51,6 +51,9 @@ protected:
   /// The snapshot of the traffic scenario.
   Snapshot snapshot_;
 
+  /// Buffer of the vehicle updates at each simulation step.
+  TrafficUpdate update_;
+
   /// Router.
   boost::shared_ptr<router::Router> router_ = nullptr;
 
@@ -67,6 +70,7 @@ public:
                    const boost::shared_ptr<CarlaMap>& map,
                    const boost::shared_ptr<utils::FastWaypointMap>& fast_map) :
     snapshot_(snapshot),
+    update_(snapshot.vehicles().size()),
     router_(router),
     map_(map),
     fast_map_(fast_map) {}
@@ -75,6 +79,7 @@ public:
                    const boost::shared_ptr<CarlaMap>& map,
                    const boost::shared_ptr<utils::FastWaypointMap>& fast_map) :
     snapshot_(snapshot),
+    update_(snapshot.vehicles().size()),
     router_(boost::make_shared<router::LoopRouter>()),
     map_(map),
     fast_map_(fast_map) {}
@@ -104,7 +109,7 @@ public:
    * \return false If collision detected during the simulation.
    */
   virtual const bool simulate(
-      const ContinuousPath& path, const double default_dt, const double max_time,
+      const VehiclePath& path, const double default_dt, const double max_time,
       double& time, double& cost);
 
 protected:
@@ -113,10 +118,13 @@ protected:
   virtual const double egoAcceleration() const = 0;
 
   /// Compute the acceleration of the agent vehicle given the current traffic scenario.
-  virtual const double agentAcceleration(const size_t agent) const = 0;
+  /// The agent is given by its index in the vehicles of the snapshot.
+  virtual const double agentAcceleration(const size_t index) const = 0;
 
+  /// Compute the updated ID, transform, speed, acceleration, and curvature of the
+  /// agent at the given index in the vehicles of the snapshot.
   virtual const std::tuple<size_t, CarlaTransform, double, double, double>
-    updatedAgentTuple(const size_t id, const double accel, const double dt) const;
+    updatedAgentTuple(const size_t index, const double accel, const double dt) const;
 
   /// Compute the ttc cost based on the input ttc.
   virtual const double ttcCost(const double ttc) const;
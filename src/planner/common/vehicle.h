@@ -14,11 +14,14 @@
 
 #pragma once
 
+#include <cmath>
 #include <string>
 #include <boost/format.hpp>
 #include <carla/client/Vehicle.h>
 #include <carla/geom/Transform.h>
 
+#include <planner/common/collision_checker.h>
+
 namespace planner {
 
 /**
@@ -150,6 +153,32 @@ public:
     return;
   }
 
+  /**
+   * \brief Get the 2D footprint of a vehicle.
+   *
+   * The location of the bounding box is relative to the vehicle transform.
+   *
+   * \param[in] transform The transform of the vehicle.
+   * \param[in] bounding_box The bounding box of the vehicle.
+   * \return The oriented box covering the vehicle on the x-y plane.
+   */
+  static utils::OrientedBox footprint(
+      const CarlaTransform& transform,
+      const CarlaBoundingBox& bounding_box) {
+    const double yaw = transform.rotation.yaw / 180.0 * M_PI;
+    const double c = std::cos(yaw);
+    const double s = std::sin(yaw);
+    return utils::OrientedBox(
+        transform.location.x + c*bounding_box.location.x - s*bounding_box.location.y,
+        transform.location.y + s*bounding_box.location.x + c*bounding_box.location.y,
+        yaw, bounding_box.extent.x, bounding_box.extent.y);
+  }
+
+  /// Get the 2D footprint of this vehicle.
+  utils::OrientedBox footprint() const {
+    return footprint(transform_, bounding_box_);
+  }
+
   /**
    * \brief Get the vehicle ID, transform, and bounding box as a tuple.
    */
@@ -16,6 +16,7 @@
 #include <cmath>
 #include <stdexcept>
 #include <algorithm>
+#include <limits>
 #include <boost/format.hpp>
 
 #include <planner/common/vehicle_path.h>
@@ -200,6 +201,283 @@ std::string ContinuousPath::string(const std::string& prefix) const {
   return output;
 }
 
+FrenetPath::FrenetPath(
+    const std::vector<std::pair<CarlaTransform, double>>& reference,
+    const std::pair<CarlaTransform, double>& start,
+    const std::pair<CarlaTransform, double>& end,
+    const LaneChangeType& lane_change_type) :
+  Base  (lane_change_type),
+  start_(start),
+  end_  (end) {
+
+  // Convert the reference line to the right handed coordinate system,
+  // accumulating the distance between consecutive samples.
+  for (const auto& sample : reference) {
+    const NonHolonomicPath::State state = carlaTransformToPathState(sample);
+    ReferencePoint point;
+    point.x = state.x;
+    point.y = state.y;
+    point.theta = state.theta;
+    point.kappa = state.kappa;
+
+    if (!reference_.empty()) {
+      const double ds = std::hypot(point.x-reference_.back().x,
+                                   point.y-reference_.back().y);
+      // Skip the duplicate samples.
+      if (ds <= 0.0) continue;
+      point.s = reference_.back().s + ds;
+    }
+    reference_.push_back(point);
+  }
+
+  if (reference_.size() < 2) {
+    throw std::runtime_error((boost::format(
+            "FrenetPath::FrenetPath(): "
+            "at least 2 distinct reference samples are required, %1% provided.\n")
+            % reference_.size()).str());
+  }
+
+  // Get the boundary conditions of the lateral offset profile.
+  const std::pair<double, std::array<double, 3>> start_frenet =
+    frenetState(carlaTransformToPathState(start_));
+  const std::pair<double, std::array<double, 3>> end_frenet =
+    frenetState(carlaTransformToPathState(end_));
+
+  s0_ = start_frenet.first;
+  s1_ = end_frenet.first;
+  if (s1_ <= s0_) {
+    throw std::runtime_error((boost::format(
+            "FrenetPath::FrenetPath(): "
+            "the path end s=%1% is not ahead of the path start s=%2% "
+            "on the reference line.\n") % s1_ % s0_).str());
+  }
+
+  // Solve the quintic coefficients in closed form.
+  const double l = s1_ - s0_;
+  const double l2 = l * l;
+  const double l3 = l2 * l;
+  const double d0 = start_frenet.second[0];
+  const double dd0 = start_frenet.second[1];
+  const double ddd0 = start_frenet.second[2];
+  const double d1 = end_frenet.second[0];
+  const double dd1 = end_frenet.second[1];
+  const double ddd1 = end_frenet.second[2];
+  const double h = d1 - d0;
+
+  coeffs_[0] = d0;
+  coeffs_[1] = dd0;
+  coeffs_[2] = 0.5 * ddd0;
+  coeffs_[3] = (20.0*h - (8.0*dd1+12.0*dd0)*l - (3.0*ddd0-ddd1)*l2) / (2.0*l3);
+  coeffs_[4] = (-30.0*h + (14.0*dd1+16.0*dd0)*l + (3.0*ddd0-2.0*ddd1)*l2) / (2.0*l3*l);
+  coeffs_[5] = (12.0*h - 6.0*(dd1+dd0)*l + (ddd1-ddd0)*l2) / (2.0*l3*l2);
+
+  // Tabulate the distance on the path against the distance on the reference
+  // line, ds/du = sqrt((1-kappa_r*d)^2 + d'^2).
+  auto ds_du = [this](const double u)->double{
+    const std::array<double, 3> d = lateralAt(u);
+    const double a = 1.0 - referenceAt(s0_+u).kappa*d[0];
+    return std::sqrt(a*a + d[1]*d[1]);
+  };
+
+  arc_lengths_.emplace_back(0.0, 0.0);
+  double prev_u = 0.0;
+  double prev_ds_du = ds_du(0.0);
+  while (prev_u < l) {
+    const double u = std::min(prev_u+resolution_, l);
+    const double next_ds_du = ds_du(u);
+    const double s = arc_lengths_.back().first +
+                     0.5 * (prev_ds_du+next_ds_du) * (u-prev_u);
+    arc_lengths_.emplace_back(s, u);
+    prev_u = u;
+    prev_ds_du = next_ds_du;
+  }
+
+  return;
+}
+
+const std::pair<FrenetPath::CarlaTransform, double>
+FrenetPath::transformAt(const double s) const {
+
+  if (s < 0.0 || s > range()) {
+    throw std::runtime_error((boost::format(
+            "FrenetPath::transformAt(): "
+            "the input distance %1% is outside path range %2%.\n")
+            % s % range()).str());
+  }
+
+  // Map the distance on the path to the distance on the reference line.
+  auto iter = std::upper_bound(arc_lengths_.begin(), arc_lengths_.end(), s,
+      [](const double s, const std::pair<double, double>& sample)->bool{
+        return s < sample.first;
+      });
+  if (iter == arc_lengths_.begin()) ++iter;
+  if (iter == arc_lengths_.end()) --iter;
+  const auto& sample1 = *(iter-1);
+  const auto& sample2 = *iter;
+  const double w = (s-sample1.first) / (sample2.first-sample1.first);
+  const double u = sample1.second + w*(sample2.second-sample1.second);
+
+  const NonHolonomicPath::State state = stateAt(u);
+
+  // Generate a base transform by interpolating start and end.
+  const double ratio = s / range();
+  std::pair<CarlaTransform, double> base_transform =
+    interpolateTransform(start_, end_, 1.0-ratio);
+
+  return pathStateToCarlaTransform(state, base_transform.first);
+}
+
+const std::array<double, 3> FrenetPath::lateralOffset(const double s) const {
+
+  const double u = s - s0_;
+  if (u < 0.0 || u > s1_-s0_) {
+    throw std::runtime_error((boost::format(
+            "FrenetPath::lateralOffset(): "
+            "the input distance %1% is outside the reference range [%2%, %3%].\n")
+            % s % s0_ % s1_).str());
+  }
+
+  return lateralAt(u);
+}
+
+const std::array<double, 3> FrenetPath::lateralAt(const double u) const {
+  const std::array<double, 6>& c = coeffs_;
+  std::array<double, 3> d;
+  d[0] = c[0] + u*(c[1] + u*(c[2] + u*(c[3] + u*(c[4] + u*c[5]))));
+  d[1] = c[1] + u*(2.0*c[2] + u*(3.0*c[3] + u*(4.0*c[4] + u*5.0*c[5])));
+  d[2] = 2.0*c[2] + u*(6.0*c[3] + u*(12.0*c[4] + u*20.0*c[5]));
+  return d;
+}
+
+FrenetPath::ReferencePoint FrenetPath::referenceAt(const double s) const {
+
+  // Find the segment containing s. Distances outside the reference line
+  // are extrapolated with the first or the last segment.
+  auto iter = std::upper_bound(reference_.begin(), reference_.end(), s,
+      [](const double s, const ReferencePoint& point)->bool{
+        return s < point.s;
+      });
+  if (iter == reference_.begin()) ++iter;
+  if (iter == reference_.end()) --iter;
+  const ReferencePoint& p1 = *(iter-1);
+  const ReferencePoint& p2 = *iter;
+
+  const double w = (s-p1.s) / (p2.s-p1.s);
+  const double wc = std::max(0.0, std::min(1.0, w));
+
+  ReferencePoint point;
+  point.s = s;
+  point.x = p1.x + w*(p2.x-p1.x);
+  point.y = p1.y + w*(p2.y-p1.y);
+  point.theta = p1.theta + wc*std::remainder(p2.theta-p1.theta, 2.0*M_PI);
+  point.kappa = p1.kappa + wc*(p2.kappa-p1.kappa);
+  return point;
+}
+
+std::pair<double, double> FrenetPath::project(
+    const double x, const double y) const {
+
+  double min_distance = std::numeric_limits<double>::max();
+  std::pair<double, double> sd(0.0, 0.0);
+
+  for (size_t i = 1; i < reference_.size(); ++i) {
+    const ReferencePoint& p1 = reference_[i-1];
+    const ReferencePoint& p2 = reference_[i];
+    const double sx = p2.x - p1.x;
+    const double sy = p2.y - p1.y;
+    const double len = p2.s - p1.s;
+
+    // Allow the projection to go beyond the ends of the reference line.
+    double t = ((x-p1.x)*sx + (y-p1.y)*sy) / (len*len);
+    if (i > 1) t = std::max(t, 0.0);
+    if (i < reference_.size()-1) t = std::min(t, 1.0);
+
+    const double px = p1.x + t*sx;
+    const double py = p1.y + t*sy;
+    const double distance = std::hypot(x-px, y-py);
+    if (distance >= min_distance) continue;
+
+    min_distance = distance;
+    sd.first = p1.s + t*len;
+    // Positive lateral offsets are on the left of the reference line.
+    sd.second = (sx*(y-p1.y) - sy*(x-p1.x)) / len;
+  }
+
+  return sd;
+}
+
+std::pair<double, std::array<double, 3>> FrenetPath::frenetState(
+    const NonHolonomicPath::State& state) const {
+
+  const std::pair<double, double> sd = project(state.x, state.y);
+  const ReferencePoint ref = referenceAt(sd.first);
+  const double d = sd.second;
+
+  const double a = 1.0 - ref.kappa*d;
+  const double dtheta = std::remainder(state.theta-ref.theta, 2.0*M_PI);
+  if (a <= 0.0 || std::abs(dtheta) >= 0.5*M_PI) {
+    throw std::runtime_error((boost::format(
+            "FrenetPath::frenetState(): "
+            "cannot represent state x:%1% y:%2% theta:%3% "
+            "w.r.t. the reference line, d:%4% dtheta:%5%.\n")
+            % state.x % state.y % state.theta % d % dtheta).str());
+  }
+
+  const double tan_dtheta = std::tan(dtheta);
+  const double cos_dtheta = std::cos(dtheta);
+
+  std::array<double, 3> lateral;
+  lateral[0] = d;
+  lateral[1] = a * tan_dtheta;
+  lateral[2] = -ref.kappa*lateral[1]*tan_dtheta +
+               a / (cos_dtheta*cos_dtheta) *
+               (state.kappa*a/cos_dtheta - ref.kappa);
+
+  return std::make_pair(sd.first, lateral);
+}
+
+NonHolonomicPath::State FrenetPath::stateAt(const double u) const {
+
+  const double s = s0_ + u;
+  const ReferencePoint ref = referenceAt(s);
+  const std::array<double, 3> d = lateralAt(u);
+
+  const double a = 1.0 - ref.kappa*d[0];
+  const double dtheta = std::atan2(d[1], a);
+  const double tan_dtheta = std::tan(dtheta);
+  const double cos_dtheta = std::cos(dtheta);
+
+  NonHolonomicPath::State state;
+  state.x = ref.x - d[0]*std::sin(ref.theta);
+  state.y = ref.y + d[0]*std::cos(ref.theta);
+  state.theta = ref.theta + dtheta;
+  state.kappa = ((d[2]+ref.kappa*d[1]*tan_dtheta) * cos_dtheta*cos_dtheta / a +
+                 ref.kappa) * cos_dtheta / a;
+  return state;
+}
+
+std::string FrenetPath::string(const std::string& prefix) const {
+  boost::format transform_format("x:%1% y:%2% yaw:%3% curvature:%4%\n");
+  std::string output = prefix;
+  output += "start: ";
+  output += (transform_format % start_.first.location.x
+                              % start_.first.location.y
+                              % start_.first.rotation.yaw
+                              % start_.second).str();
+  output += "end: ";
+  output += (transform_format % end_.first.location.x
+                              % end_.first.location.y
+                              % end_.first.rotation.yaw
+                              % end_.second).str();
+
+  boost::format path_format("c0:%1% c1:%2% c2:%3% c3:%4% c4:%5% c5:%6% s0:%7% s1:%8% range:%9%\n");
+  output += "path: ";
+  output += (path_format % coeffs_[0] % coeffs_[1] % coeffs_[2]
+                         % coeffs_[3] % coeffs_[4] % coeffs_[5]
+                         % s0_ % s1_ % range()).str();
+  return output;
+}
+
 DiscretePath::DiscretePath(
     const std::pair<CarlaTransform, double>& start,
     const std::pair<CarlaTransform, double>& end,
@@ -285,6 +563,60 @@ DiscretePath::DiscretePath(const ContinuousPath& continuous_path) :
   return;
 }
 
+DiscretePath::DiscretePath(const FrenetPath& frenet_path) :
+  Base(frenet_path.laneChangeType()) {
+
+  double s = 0.0;
+  for (; s <= frenet_path.range(); s += resolution_)
+    samples_[s] = frenet_path.transformAt(s);
+
+  // The end of the path is added unless it is already sampled.
+  if (!samples_.empty() && samples_.rbegin()->first < frenet_path.range()) {
+    samples_[frenet_path.range()] =
+      frenet_path.transformAt(frenet_path.range());
+  }
+
+  if (samples_.empty()) {
+    throw std::runtime_error(
+        "DiscretePath::DiscretePath(): empty discrete path.\n");
+  }
+
+  return;
+}
+
+DiscretePath::DiscretePath(
+    const std::vector<std::pair<CarlaTransform, double>>& samples,
+    const LaneChangeType& lane_change_type) :
+  Base(lane_change_type) {
+
+  if (samples.size() < 2) {
+    throw std::runtime_error((boost::format(
+            "DiscretePath::DiscretePath(): "
+            "at least 2 samples are required, %1% provided.\n")
+            % samples.size()).str());
+  }
+
+  double s = 0.0;
+  samples_[s] = samples.front();
+
+  for (size_t i = 1; i < samples.size(); ++i) {
+    const double ds = (samples[i].first.location -
+                       samples[i-1].first.location).Length();
+    // Skip the duplicate samples, which would otherwise
+    // break the interpolation in \c transformAt().
+    if (ds <= 0.0) continue;
+    s += ds;
+    samples_[s] = samples[i];
+  }
+
+  if (samples_.size() < 2) {
+    throw std::runtime_error(
+        "DiscretePath::DiscretePath(): all input samples are at the same location.\n");
+  }
+
+  return;
+}
+
 const std::pair<DiscretePath::CarlaTransform, double>
 DiscretePath::transformAt(const double s) const {
 
@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <array>
 #include <vector>
 #include <map>
 #include <string>
@@ -24,6 +25,7 @@
 namespace planner {
 
 class ContinuousPath;
+class FrenetPath;
 class DiscretePath;
 
 class VehiclePath {
@@ -132,6 +134,122 @@ public:
 
 }; // End class ContinuousPath.
 
+/**
+ * \brief FrenetPath represents a path as a quintic lateral offset profile
+ *        d(s) over a lane reference line.
+ *
+ * The start and end transforms are projected onto the reference line to get
+ * the boundary conditions (s, d, d', d''), from which the quintic coefficients
+ * are solved in closed form. Evaluating the path, including its curvature,
+ * is closed form as well. Compared to \c ContinuousPath, there is no iterative
+ * optimization involved, which makes the class a cheap alternative on the
+ * straight and gently curved highway segments.
+ *
+ * The reference line is expected to be dense enough, e.g. waypoints sampled
+ * on the lane center every 1m, and the path should stay within the radius of
+ * curvature of the reference line.
+ */
+class FrenetPath : public VehiclePath {
+
+private:
+
+  using Base = VehiclePath;
+  using This = FrenetPath;
+
+protected:
+
+  /// A sample on the reference line in the right handed coordinate system.
+  struct ReferencePoint {
+    double s{0.0};
+    double x{0.0};
+    double y{0.0};
+    double theta{0.0};
+    double kappa{0.0};
+  };
+
+  std::pair<CarlaTransform, double> start_;
+  std::pair<CarlaTransform, double> end_;
+
+  /// Samples on the reference line.
+  std::vector<ReferencePoint> reference_;
+
+  /// Distance of the start and end of the path on the reference line.
+  double s0_ = 0.0;
+  double s1_ = 0.0;
+
+  /// Coefficients of the quintic d(u) = sum_i c_i u^i, where u = s - s0.
+  std::array<double, 6> coeffs_;
+
+  /// Pairs of (distance on the path, u) used to map the path distance
+  /// back onto the reference line.
+  std::vector<std::pair<double, double>> arc_lengths_;
+
+  double resolution_ = 0.5;
+
+public:
+
+  /**
+   * \brief Construct the path between the start and end transforms.
+   *
+   * \param[in] reference The transform and curvature of samples on the lane
+   *                      reference line, ordered along the driving direction.
+   * \param[in] start The start transform and curvature of the path.
+   * \param[in] end The end transform and curvature of the path.
+   * \param[in] lane_change_type The lane change type of the path.
+   */
+  FrenetPath(const std::vector<std::pair<CarlaTransform, double>>& reference,
+             const std::pair<CarlaTransform, double>& start,
+             const std::pair<CarlaTransform, double>& end,
+             const LaneChangeType& lane_change_type);
+
+  virtual ~FrenetPath() {}
+
+  virtual const std::pair<CarlaTransform, double>
+    startTransform() const override { return start_; }
+
+  virtual const std::pair<CarlaTransform, double>
+    endTransform() const override { return end_; }
+
+  virtual const double range() const override {
+    return arc_lengths_.back().first;
+  }
+
+  virtual const std::pair<CarlaTransform, double>
+    transformAt(const double s) const override;
+
+  /// Distance of the path start on the reference line.
+  const double referenceStart() const { return s0_; }
+
+  /// Distance of the path end on the reference line.
+  const double referenceEnd() const { return s1_; }
+
+  /// Lateral offset and its first and second derivatives w.r.t. \c s
+  /// at the given distance on the reference line.
+  const std::array<double, 3> lateralOffset(const double s) const;
+
+  std::string string(const std::string& prefix="") const;
+
+protected:
+
+  /// Interpolate the reference line at the given distance.
+  ReferencePoint referenceAt(const double s) const;
+
+  /// Project a location (right handed) onto the reference line.
+  /// Returns the (s, d) coordinates of the location.
+  std::pair<double, double> project(const double x, const double y) const;
+
+  /// Compute the (d, d', d'') of a state w.r.t. the reference line.
+  std::pair<double, std::array<double, 3>> frenetState(
+      const NonHolonomicPath::State& state) const;
+
+  /// Evaluate the lateral offset and its derivatives at u = s - s0.
+  const std::array<double, 3> lateralAt(const double u) const;
+
+  /// Evaluate the right handed state of the path at u = s - s0.
+  NonHolonomicPath::State stateAt(const double u) const;
+
+}; // End class FrenetPath.
+
 /**
  * TODO: Complete the implementation for this class later.
  */
@@ -157,6 +275,22 @@ public:
 
   DiscretePath(const ContinuousPath& continuous_path);
 
+  DiscretePath(const FrenetPath& frenet_path);
+
+  /**
+   * \brief Construct the path directly from a sequence of samples.
+   *
+   * The distance of each sample on the path is computed by accumulating
+   * the euclidean distance between consecutive samples. No path optimization
+   * is involved, therefore the input samples are expected to be dense enough
+   * to represent the actual path.
+   *
+   * \param[in] samples The transform and curvature of the samples on the path.
+   * \param[in] lane_change_type The lane change type of the path.
+   */
+  DiscretePath(const std::vector<std::pair<CarlaTransform, double>>& samples,
+               const LaneChangeType& lane_change_type);
+
   virtual ~DiscretePath() {}
 
   virtual const std::pair<CarlaTransform, double>
@@ -187,6 +321,12 @@ public:
     return;
   }
 
+  virtual void append(const FrenetPath& path) {
+    DiscretePath discrete_path(path);
+    append(discrete_path);
+    return;
+  }
+
   std::string string(const std::string& prefix="") const;
 
 }; // End class DiscretePath.
@@ -14,6 +14,9 @@
 
 #pragma once
 
+#include <string>
+#include <stdexcept>
+#include <boost/format.hpp>
 #include <boost/core/noncopyable.hpp>
 #include <boost/smart_ptr.hpp>
 
@@ -61,19 +64,26 @@ public:
    * \return The acceleration to be applied for the target vehicle.
    */
   virtual const double planSpeed(const size_t target, const Snapshot& snapshot) {
-    // Get the target vehicle.
-    const Vehicle target_vehicle = snapshot.vehicle(target);
+    // Get the target vehicle, the ID is only looked up once here.
+    boost::optional<size_t> index = snapshot.vehicles().index(target);
+    if (!index) {
+      std::string error_msg = (boost::format(
+            "VehicleSpeedPlanner::planSpeed(): "
+            "the target vehicle %1% does not exist in the snapshot.\n") % target).str();
+      throw std::runtime_error(error_msg);
+    }
+    const ConstVehicleView target_vehicle = snapshot.vehicles().view(*index);
 
-    // Get the lead vehicle of the target.
+    // Get the lead vehicle of the target, which is returned as an index.
     boost::optional<std::pair<size_t, double>> lead =
-      snapshot.trafficLattice()->front(target_vehicle.id());
+      snapshot.trafficLattice()->frontAt(*index);
 
     // Compute the acceleration to be applied by the target vehicle.
     if (lead) {
       return intelligent_driver_model_->idm(
           target_vehicle.speed(),
           target_vehicle.policySpeed(),
-          snapshot.vehicle(lead->first).speed(),
+          snapshot.vehicles().speeds()[lead->first],
           lead->second);
     } else {
       return intelligent_driver_model_->idm(
@@ -0,0 +1,628 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <tuple>
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_set>
+#include <boost/format.hpp>
+#include <boost/optional.hpp>
+#include <carla/geom/Location.h>
+#include <carla/geom/Rotation.h>
+#include <carla/geom/Transform.h>
+#include <carla/geom/BoundingBox.h>
+
+#include <planner/common/vehicle.h>
+#include <planner/common/flat_hash_map.h>
+
+namespace planner {
+
+template<bool IsConst> class BasicVehicleView;
+template<bool IsConst> class BasicVehicleRange;
+
+/// Mutable view of a vehicle stored in \c VehicleStates.
+using VehicleView = BasicVehicleView<false>;
+/// Read-only view of a vehicle stored in \c VehicleStates.
+using ConstVehicleView = BasicVehicleView<true>;
+
+/**
+ * \brief TrafficUpdate is a reusable buffer of the dynamic states of a group
+ *        of vehicles at the next simulation step.
+ *
+ * The updates are addressed by the dense index of the vehicles in
+ * \c VehicleStates, instead of the vehicle IDs. Once the buffer has grown to
+ * the number of vehicles, \c reset() and \c set() never allocate, so that
+ * the same buffer can be reused at every simulation step.
+ */
+class TrafficUpdate {
+
+public:
+
+  using CarlaTransform = carla::geom::Transform;
+
+protected:
+
+  std::vector<CarlaTransform> transforms_;
+  std::vector<double> speeds_;
+  std::vector<double> accelerations_;
+  std::vector<double> curvatures_;
+
+  /// Whether the vehicle at each index is updated since the last reset.
+  std::vector<uint8_t> updated_;
+
+public:
+
+  TrafficUpdate() = default;
+
+  explicit TrafficUpdate(const size_t capacity) { reserve(capacity); }
+
+  size_t size() const { return updated_.size(); }
+
+  void reserve(const size_t capacity) {
+    transforms_.reserve(capacity);
+    speeds_.reserve(capacity);
+    accelerations_.reserve(capacity);
+    curvatures_.reserve(capacity);
+    updated_.reserve(capacity);
+    return;
+  }
+
+  /// Prepare the buffer for the given number of vehicles, none of which
+  /// is updated yet. No allocation happens within the reserved capacity.
+  void reset(const size_t size) {
+    transforms_.resize(size);
+    speeds_.resize(size);
+    accelerations_.resize(size);
+    curvatures_.resize(size);
+    updated_.assign(size, 0);
+    return;
+  }
+
+  /// Set the update of the vehicle at the given index.
+  void set(const size_t index,
+           const CarlaTransform& transform,
+           const double speed,
+           const double acceleration,
+           const double curvature) {
+    if (index >= size()) {
+      std::string error_msg = (boost::format(
+            "TrafficUpdate::set(): "
+            "index %1% is out of the range of %2% vehicles.\n") % index % size()).str();
+      throw std::runtime_error(error_msg);
+    }
+    transforms_[index]    = transform;
+    speeds_[index]        = speed;
+    accelerations_[index] = acceleration;
+    curvatures_[index]    = curvature;
+    updated_[index]       = 1;
+    return;
+  }
+
+  bool updated(const size_t index) const { return updated_[index] != 0; }
+
+  const CarlaTransform& transform(const size_t index) const { return transforms_[index]; }
+  const double speed(const size_t index) const { return speeds_[index]; }
+  const double acceleration(const size_t index) const { return accelerations_[index]; }
+  const double curvature(const size_t index) const { return curvatures_[index]; }
+
+}; // End class TrafficUpdate.
+
+/**
+ * \brief VehicleStates stores the states of a group of vehicles as
+ *        structure of arrays.
+ *
+ * Each field of the vehicles is kept in its own dense array, and the
+ * vehicle at index \c i has its fields at index \c i of all arrays. The
+ * dynamic states (locations, rotations, speeds, accelerations, curvatures,
+ * lattice distances) are updated at every simulation step, while the static
+ * properties (bounding boxes, policy speeds) are left untouched by the
+ * simulation.
+ *
+ * Loops over all vehicles can therefore run over contiguous arrays of
+ * doubles, and copying the states amounts to copying a few vectors.
+ * Individual vehicles are accessed through \c VehicleView and
+ * \c ConstVehicleView, which provide the same interface as \c Vehicle.
+ *
+ * Erasing a vehicle moves the last vehicle into the vacated index, so that
+ * indices are invalidated by erasure.
+ */
+class VehicleStates {
+
+  template<bool> friend class BasicVehicleView;
+
+public:
+
+  using CarlaBoundingBox = carla::geom::BoundingBox;
+  using CarlaTransform   = carla::geom::Transform;
+  using CarlaLocation    = carla::geom::Location;
+  using CarlaRotation    = carla::geom::Rotation;
+
+protected:
+
+  /// IDs of the vehicles in the carla simulator.
+  std::vector<size_t> ids_;
+
+  /// Bounding boxes of the vehicles.
+  std::vector<CarlaBoundingBox> bounding_boxes_;
+
+  /// Policy speeds of the vehicles.
+  std::vector<double> policy_speeds_;
+
+  /// Locations of the vehicles, left handed to be compatible with carla.
+  std::vector<CarlaLocation> locations_;
+
+  /// Rotations (headings) of the vehicles.
+  std::vector<CarlaRotation> rotations_;
+
+  /// Speeds of the vehicles.
+  std::vector<double> speeds_;
+
+  /// Accelerations of the vehicles, brake should be negative.
+  std::vector<double> accelerations_;
+
+  /// Curvatures of the paths where the vehicles are currently at.
+  std::vector<double> curvatures_;
+
+  /// Distances of the vehicle heads on the traffic lattice.
+  std::vector<double> lattice_distances_;
+
+  /// Map from vehicle ID to its index in the arrays.
+  utils::FlatHashMap<size_t, size_t> id_to_index_table_;
+
+public:
+
+  VehicleStates() = default;
+
+  explicit VehicleStates(const size_t capacity) { reserve(capacity); }
+
+  size_t size() const { return ids_.size(); }
+
+  bool empty() const { return ids_.empty(); }
+
+  void reserve(const size_t capacity) {
+    ids_.reserve(capacity);
+    bounding_boxes_.reserve(capacity);
+    policy_speeds_.reserve(capacity);
+    locations_.reserve(capacity);
+    rotations_.reserve(capacity);
+    speeds_.reserve(capacity);
+    accelerations_.reserve(capacity);
+    curvatures_.reserve(capacity);
+    lattice_distances_.reserve(capacity);
+    id_to_index_table_.reserve(capacity);
+    return;
+  }
+
+  void clear() {
+    ids_.clear();
+    bounding_boxes_.clear();
+    policy_speeds_.clear();
+    locations_.clear();
+    rotations_.clear();
+    speeds_.clear();
+    accelerations_.clear();
+    curvatures_.clear();
+    lattice_distances_.clear();
+    id_to_index_table_.clear();
+    return;
+  }
+
+  /**
+   * \brief Append a vehicle to the end of the arrays.
+   *
+   * The function throws runtime error if the vehicle is already stored.
+   *
+   * \param[in] vehicle The vehicle to be added.
+   * \return The index of the added vehicle.
+   */
+  size_t push_back(const Vehicle& vehicle) {
+    if (id_to_index_table_.count(vehicle.id()) != 0) {
+      std::string error_msg = (boost::format(
+            "VehicleStates::push_back(): "
+            "vehicle %1% is already stored.\n") % vehicle.id()).str();
+      throw std::runtime_error(error_msg);
+    }
+
+    const size_t index = ids_.size();
+    ids_.push_back(vehicle.id());
+    bounding_boxes_.push_back(vehicle.boundingBox());
+    policy_speeds_.push_back(vehicle.policySpeed());
+    locations_.push_back(vehicle.transform().location);
+    rotations_.push_back(vehicle.transform().rotation);
+    speeds_.push_back(vehicle.speed());
+    accelerations_.push_back(vehicle.acceleration());
+    curvatures_.push_back(vehicle.curvature());
+    lattice_distances_.push_back(0.0);
+    id_to_index_table_[vehicle.id()] = index;
+    return index;
+  }
+
+  /**
+   * \brief Erase a vehicle by its ID.
+   *
+   * The last vehicle in the arrays is moved into the index of the
+   * erased vehicle.
+   *
+   * \param[in] id The ID of the vehicle to be erased.
+   * \return \c true if the vehicle is found and erased.
+   */
+  bool erase(const size_t id) {
+    utils::FlatHashMap<size_t, size_t>::const_iterator iter = id_to_index_table_.find(id);
+    if (iter == id_to_index_table_.end()) return false;
+
+    const size_t index = iter->second;
+    const size_t last = ids_.size() - 1;
+    id_to_index_table_.erase(id);
+
+    if (index != last) {
+      ids_[index]               = ids_[last];
+      bounding_boxes_[index]    = bounding_boxes_[last];
+      policy_speeds_[index]     = policy_speeds_[last];
+      locations_[index]         = locations_[last];
+      rotations_[index]         = rotations_[last];
+      speeds_[index]            = speeds_[last];
+      accelerations_[index]     = accelerations_[last];
+      curvatures_[index]        = curvatures_[last];
+      lattice_distances_[index] = lattice_distances_[last];
+      id_to_index_table_[ids_[index]] = index;
+    }
+
+    ids_.pop_back();
+    bounding_boxes_.pop_back();
+    policy_speeds_.pop_back();
+    locations_.pop_back();
+    rotations_.pop_back();
+    speeds_.pop_back();
+    accelerations_.pop_back();
+    curvatures_.pop_back();
+    lattice_distances_.pop_back();
+    return true;
+  }
+
+  /**
+   * \brief Erase a group of vehicles by their IDs.
+   *
+   * Different from \c erase() of a single vehicle, the remaining vehicles
+   * keep their relative order. This is the same as how \c TrafficLattice
+   * indexes the vehicles registered in a batch, so that the two agree on
+   * the index of every vehicle.
+   *
+   * \param[in] ids The IDs of the vehicles to be erased.
+   * \return The number of erased vehicles.
+   */
+  size_t erase(const std::unordered_set<size_t>& ids) {
+    if (ids.empty()) return 0;
+
+    size_t last = 0;
+    for (size_t i = 0; i < ids_.size(); ++i) {
+      if (ids.count(ids_[i]) != 0) {
+        id_to_index_table_.erase(ids_[i]);
+        continue;
+      }
+
+      if (last != i) {
+        ids_[last]               = ids_[i];
+        bounding_boxes_[last]    = bounding_boxes_[i];
+        policy_speeds_[last]     = policy_speeds_[i];
+        locations_[last]         = locations_[i];
+        rotations_[last]         = rotations_[i];
+        speeds_[last]            = speeds_[i];
+        accelerations_[last]     = accelerations_[i];
+        curvatures_[last]        = curvatures_[i];
+        lattice_distances_[last] = lattice_distances_[i];
+        id_to_index_table_[ids_[last]] = last;
+      }
+      ++last;
+    }
+
+    const size_t erased = ids_.size() - last;
+    ids_.erase(ids_.begin()+last, ids_.end());
+    bounding_boxes_.erase(bounding_boxes_.begin()+last, bounding_boxes_.end());
+    policy_speeds_.erase(policy_speeds_.begin()+last, policy_speeds_.end());
+    locations_.erase(locations_.begin()+last, locations_.end());
+    rotations_.erase(rotations_.begin()+last, rotations_.end());
+    speeds_.erase(speeds_.begin()+last, speeds_.end());
+    accelerations_.erase(accelerations_.begin()+last, accelerations_.end());
+    curvatures_.erase(curvatures_.begin()+last, curvatures_.end());
+    lattice_distances_.erase(lattice_distances_.begin()+last, lattice_distances_.end());
+    return erased;
+  }
+
+  /**
+   * \brief Apply the updates to the dynamic states of the vehicles in place.
+   *
+   * The update should be indexed the same as this object. Vehicles not set
+   * in the update are left untouched. No allocation is involved.
+   *
+   * \param[in] update The updated states of the vehicles.
+   */
+  void apply(const TrafficUpdate& update) {
+    if (update.size() != size()) {
+      std::string error_msg = (boost::format(
+            "VehicleStates::apply(): "
+            "the update of %1% vehicles does not match %2% vehicles.\n")
+          % update.size() % size()).str();
+      throw std::runtime_error(error_msg);
+    }
+
+    for (size_t i = 0; i < size(); ++i) {
+      if (!update.updated(i)) continue;
+      locations_[i]     = update.transform(i).location;
+      rotations_[i]     = update.transform(i).rotation;
+      speeds_[i]        = update.speed(i);
+      accelerations_[i] = update.acceleration(i);
+      curvatures_[i]    = update.curvature(i);
+    }
+    return;
+  }
+
+  bool contains(const size_t id) const { return id_to_index_table_.count(id) != 0; }
+
+  /// Get the index of a vehicle, \c boost::none if the vehicle is not stored.
+  boost::optional<size_t> index(const size_t id) const {
+    utils::FlatHashMap<size_t, size_t>::const_iterator iter = id_to_index_table_.find(id);
+    if (iter == id_to_index_table_.end()) return boost::none;
+    return iter->second;
+  }
+
+  /// Get the view of the vehicle at the given index.
+  /// @{
+  VehicleView view(const size_t index);
+  ConstVehicleView view(const size_t index) const;
+  /// @}
+
+  /// Get the views of the vehicles within the index range [first, last).
+  /// @{
+  BasicVehicleRange<false> range(const size_t first, const size_t last);
+  BasicVehicleRange<true> range(const size_t first, const size_t last) const;
+  /// @}
+
+  /**
+   * \name Array accessors
+   *
+   * The arrays can be modified in place, e.g. by a vectorized simulation
+   * step, but never resized. The IDs can only be changed through
+   * \c push_back() and \c erase().
+   */
+  /// @{
+  const std::vector<size_t>& ids() const { return ids_; }
+
+  const std::vector<CarlaBoundingBox>& boundingBoxes() const { return bounding_boxes_; }
+  std::vector<CarlaBoundingBox>& boundingBoxes() { return bounding_boxes_; }
+
+  const std::vector<double>& policySpeeds() const { return policy_speeds_; }
+  std::vector<double>& policySpeeds() { return policy_speeds_; }
+
+  const std::vector<CarlaLocation>& locations() const { return locations_; }
+  std::vector<CarlaLocation>& locations() { return locations_; }
+
+  const std::vector<CarlaRotation>& rotations() const { return rotations_; }
+  std::vector<CarlaRotation>& rotations() { return rotations_; }
+
+  const std::vector<double>& speeds() const { return speeds_; }
+  std::vector<double>& speeds() { return speeds_; }
+
+  const std::vector<double>& accelerations() const { return accelerations_; }
+  std::vector<double>& accelerations() { return accelerations_; }
+
+  const std::vector<double>& curvatures() const { return curvatures_; }
+  std::vector<double>& curvatures() { return curvatures_; }
+
+  const std::vector<double>& latticeDistances() const { return lattice_distances_; }
+  std::vector<double>& latticeDistances() { return lattice_distances_; }
+  /// @}
+
+}; // End class VehicleStates.
+
+/**
+ * \brief BasicVehicleView refers to one vehicle stored in \c VehicleStates.
+ *
+ * The view provides the same accessors as \c Vehicle, except that the
+ * transform is assembled from the location and rotation arrays and is
+ * therefore returned by value. The location and rotation can be modified
+ * through \c location() and \c rotation() instead.
+ *
+ * A view is invalidated once a vehicle is erased from the states.
+ */
+template<bool IsConst>
+class BasicVehicleView {
+
+  template<bool> friend class BasicVehicleView;
+
+protected:
+
+  using CarlaBoundingBox = VehicleStates::CarlaBoundingBox;
+  using CarlaTransform   = VehicleStates::CarlaTransform;
+  using CarlaLocation    = VehicleStates::CarlaLocation;
+  using CarlaRotation    = VehicleStates::CarlaRotation;
+  using CarlaVehicle     = carla::client::Vehicle;
+
+  template<typename T>
+  using Reference = typename std::conditional<IsConst, const T&, T&>::type;
+
+  using States = typename std::conditional<IsConst, const VehicleStates, VehicleStates>::type;
+
+protected:
+
+  /// The states this view refers to.
+  States* states_ = nullptr;
+
+  /// Index of the vehicle in the states.
+  size_t index_ = 0;
+
+public:
+
+  BasicVehicleView(States& states, const size_t index) :
+    states_(&states), index_(index) {}
+
+  /// A mutable view can be converted to a read-only view.
+  template<bool OtherConst,
+           typename = typename std::enable_if<IsConst && !OtherConst>::type>
+  BasicVehicleView(const BasicVehicleView<OtherConst>& other) :
+    states_(other.states_), index_(other.index_) {}
+
+  size_t index() const { return index_; }
+
+  size_t id() const { return states_->ids_[index_]; }
+
+  Reference<CarlaBoundingBox> boundingBox() const { return states_->bounding_boxes_[index_]; }
+
+  CarlaTransform transform() const {
+    return CarlaTransform(states_->locations_[index_], states_->rotations_[index_]);
+  }
+
+  Reference<CarlaLocation> location() const { return states_->locations_[index_]; }
+
+  Reference<CarlaRotation> rotation() const { return states_->rotations_[index_]; }
+
+  Reference<double> speed() const { return states_->speeds_[index_]; }
+
+  Reference<double> policySpeed() const { return states_->policy_speeds_[index_]; }
+
+  Reference<double> acceleration() const { return states_->accelerations_[index_]; }
+
+  Reference<double> curvature() const { return states_->curvatures_[index_]; }
+
+  Reference<double> latticeDistance() const { return states_->lattice_distances_[index_]; }
+
+  /// \see Vehicle::footprint().
+  utils::OrientedBox footprint() const {
+    return Vehicle::footprint(transform(), boundingBox());
+  }
+
+  /// Copy the vehicle out of the states.
+  Vehicle vehicle() const {
+    return Vehicle(id(), boundingBox(), transform(),
+        speed(), policySpeed(), acceleration(), curvature());
+  }
+
+  operator Vehicle() const { return vehicle(); }
+
+  /// \see Vehicle::updateCarlaVehicle().
+  void updateCarlaVehicle(const boost::shared_ptr<CarlaVehicle>& actor) const {
+    vehicle().updateCarlaVehicle(actor);
+  }
+
+  /// \see Vehicle::tuple().
+  std::tuple<size_t, CarlaTransform, CarlaBoundingBox> tuple() const {
+    return std::make_tuple(id(), transform(), boundingBox());
+  }
+
+  /// \see Vehicle::string().
+  std::string string(const std::string& prefix = "") const {
+    return vehicle().string(prefix);
+  }
+
+}; // End class BasicVehicleView.
+
+/**
+ * \brief BasicVehicleRange iterates through a range of vehicles stored in
+ *        \c VehicleStates.
+ *
+ * Dereferencing an iterator returns a pair of the vehicle ID and the view
+ * of the vehicle, mimicking the iteration through a map from vehicle ID
+ * to vehicle.
+ */
+template<bool IsConst>
+class BasicVehicleRange {
+
+protected:
+
+  using States = typename std::conditional<IsConst, const VehicleStates, VehicleStates>::type;
+
+public:
+
+  class Iterator {
+
+  public:
+
+    using iterator_category = std::input_iterator_tag;
+    using value_type        = std::pair<size_t, BasicVehicleView<IsConst>>;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const value_type*;
+    using reference         = value_type;
+
+  protected:
+
+    States* states_ = nullptr;
+    size_t index_ = 0;
+
+  public:
+
+    Iterator(States& states, const size_t index) :
+      states_(&states), index_(index) {}
+
+    value_type operator*() const {
+      return std::make_pair(states_->ids()[index_],
+                            BasicVehicleView<IsConst>(*states_, index_));
+    }
+
+    Iterator& operator++() { ++index_; return *this; }
+
+    Iterator operator++(int) { Iterator old = *this; ++index_; return old; }
+
+    bool operator==(const Iterator& other) const {
+      return states_ == other.states_ && index_ == other.index_;
+    }
+
+    bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+  }; // End class Iterator.
+
+protected:
+
+  States* states_ = nullptr;
+  size_t first_ = 0;
+  size_t last_ = 0;
+
+public:
+
+  BasicVehicleRange(States& states, const size_t first, const size_t last) :
+    states_(&states), first_(first), last_(last) {}
+
+  Iterator begin() const { return Iterator(*states_, first_); }
+  Iterator end() const { return Iterator(*states_, last_); }
+
+  size_t size() const { return last_ - first_; }
+  bool empty() const { return first_ == last_; }
+
+}; // End class BasicVehicleRange.
+
+inline VehicleView VehicleStates::view(const size_t index) {
+  return VehicleView(*this, index);
+}
+
+inline ConstVehicleView VehicleStates::view(const size_t index) const {
+  return ConstVehicleView(*this, index);
+}
+
+inline BasicVehicleRange<false> VehicleStates::range(
+    const size_t first, const size_t last) {
+  return BasicVehicleRange<false>(*this, first, last);
+}
+
+inline BasicVehicleRange<true> VehicleStates::range(
+    const size_t first, const size_t last) const {
+  return BasicVehicleRange<true>(*this, first, last);
+}
+
+} // End namespace planner.
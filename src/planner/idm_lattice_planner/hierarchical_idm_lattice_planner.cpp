@@ -0,0 +1,234 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <planner/idm_lattice_planner/hierarchical_idm_lattice_planner.h>
+
+namespace planner {
+namespace idm_lattice_planner {
+
+LaneCorridor::LaneCorridor(
+    const boost::shared_ptr<const WaypointLattice>& waypoint_lattice,
+    const std::vector<boost::shared_ptr<const WaypointNode>>& stations) :
+  waypoint_lattice_(waypoint_lattice) {
+
+  if (!waypoint_lattice_) {
+    throw std::runtime_error(
+        "LaneCorridor::LaneCorridor(): input waypoint lattice = nullptr.\n");
+  }
+  if (stations.empty()) {
+    throw std::runtime_error(
+        "LaneCorridor::LaneCorridor(): no station is given.\n");
+  }
+
+  nodes_.insert(stations.front()->id());
+  end_distance_ = stations.back()->distance();
+
+  for (size_t i = 1; i < stations.size(); ++i) {
+    const boost::shared_ptr<const WaypointNode>& start = stations[i-1];
+    const boost::shared_ptr<const WaypointNode>& end = stations[i];
+
+    // Nodes on the lane of the start station until the end station.
+    boost::shared_ptr<const WaypointNode> node = start;
+    while (node && node->distance() < end->distance()) {
+      nodes_.insert(node->id());
+      node = node->front();
+    }
+
+    // Nodes on the lane of the end station back to the start station,
+    // which are different from the above nodes for lane changes.
+    node = end;
+    while (node && node->distance() >= start->distance()) {
+      nodes_.insert(node->id());
+      node = node->back();
+    }
+  }
+
+  return;
+}
+
+const bool LaneCorridor::contains(
+    const boost::shared_ptr<const CarlaWaypoint>& waypoint) const {
+  // There is no constraint outside the waypoint lattice or beyond the coarse plan.
+  boost::shared_ptr<const WaypointNode> query = node(waypoint);
+  if (!query) return true;
+  if (query->distance() > end_distance_) return true;
+  return nodes_.count(query->id()) > 0;
+}
+
+DiscretePath HierarchicalIDMLatticePlanner::planPath(
+    const size_t ego, const Snapshot& snapshot) {
+
+  // Replan the coarse planner at the low rate, or if the ego has left the corridor.
+  if (coarsePlanRequired(snapshot)) updateCorridor(ego, snapshot);
+  ++cycles_since_coarse_plan_;
+
+  coarse_edge_hits_ = 0;
+  coarse_edge_misses_ = 0;
+
+  // Refine the path within the corridor.
+  return Base::planPath(ego, snapshot);
+}
+
+const bool HierarchicalIDMLatticePlanner::coarsePlanRequired(
+    const Snapshot& snapshot) const {
+  if (!corridor_) return true;
+  if (cycles_since_coarse_plan_ >= coarse_replan_period_) return true;
+  return !corridor_->contains(fast_map_->waypoint(snapshot.ego().transform().location));
+}
+
+void HierarchicalIDMLatticePlanner::updateCorridor(
+    const size_t ego, const Snapshot& snapshot) {
+
+  cycles_since_coarse_plan_ = 0;
+  corridor_ = nullptr;
+  coarse_edges_.clear();
+  coarse_station_distances_.clear();
+
+  // The coarse planner predicts the agents with the same driver models,
+  // and constructs its waypoint lattice and edges in the same way.
+  coarse_planner_->agentModels() = agent_models_;
+  coarse_planner_->lazyLattice() = lazy_lattice_;
+  coarse_planner_->frenetEdges() = frenet_edges_;
+
+  // The fine planner still works without the corridor if the coarse plan
+  // fails, e.g. no station can be reached with the long edges.
+  try {
+    coarse_planner_->planPath(ego, snapshot);
+  } catch (const std::exception& e) {
+    std::printf("HierarchicalIDMLatticePlanner::updateCorridor(): WARNING\n"
+                "%s", e.what());
+    return;
+  }
+
+  const std::vector<boost::shared_ptr<const Station>> stations =
+    coarse_planner_->optimalStations();
+
+  std::vector<boost::shared_ptr<const WaypointNode>> nodes;
+  nodes.reserve(stations.size());
+  coarse_station_distances_.reserve(stations.size());
+  for (const auto& station : stations) {
+    nodes.push_back(station->node());
+    coarse_station_distances_.push_back(station->node()->distance());
+  }
+
+  // Cache the simulated edges of the coarse plan to be reused by the fine planner.
+  for (size_t i = 1; i < stations.size(); ++i) {
+    const boost::shared_ptr<const Station>& parent_station = stations[i-1];
+    const boost::shared_ptr<const Station>& child_station = stations[i];
+    const auto& parent = *(child_station->optimalParent());
+
+    const double parent_cost_to_come =
+      parent_station->hasParent() ? parent_station->costToCome() : 0.0;
+    coarse_edges_.emplace(child_station->id(), CommittedEdge{
+        parent_station->id(),
+        SnapshotSignature(parent_station->snapshot(), signature_resolution_),
+        std::get<1>(parent) - parent_cost_to_come,
+        std::get<0>(parent)});
+  }
+
+  corridor_ = boost::make_shared<const LaneCorridor>(
+      coarse_planner_->waypointLattice(), nodes);
+  return;
+}
+
+boost::shared_ptr<const Snapshot> HierarchicalIDMLatticePlanner::simulateEdge(
+    const boost::shared_ptr<Station>& station,
+    const boost::shared_ptr<const WaypointNode>& target_node,
+    const VehiclePath& path,
+    double& stage_cost) const {
+
+  if (!corridor_) return Base::simulateEdge(station, target_node, path, stage_cost);
+
+  // Find the nodes of the edge on the waypoint lattice of the corridor.
+  boost::shared_ptr<const WaypointNode> coarse_start =
+    corridor_->node(station->node().lock()->waypoint());
+  boost::shared_ptr<const WaypointNode> coarse_target =
+    corridor_->node(target_node->waypoint());
+
+  // Reuse the coarse edge if the snapshot at its start is a near-duplicate.
+  if (coarse_start && coarse_target) {
+    utils::FlatHashMap<size_t, CommittedEdge>::const_iterator iter =
+      coarse_edges_.find(coarse_target->id());
+    if (iter != coarse_edges_.end() && iter->second.start == coarse_start->id()) {
+      if (iter->second.signature == SnapshotSignature(station->snapshot(), signature_resolution_)) {
+        ++coarse_edge_hits_;
+        stage_cost = iter->second.stage_cost;
+        return iter->second.snapshot;
+      }
+      ++coarse_edge_misses_;
+    }
+  }
+
+  return Base::simulateEdge(station, target_node, path, stage_cost);
+}
+
+const double HierarchicalIDMLatticePlanner::edgeLength(
+    const boost::shared_ptr<Station>& station,
+    const boost::optional<std::pair<size_t, double>>& front) const {
+
+  const double length = Base::edgeLength(station, front);
+  if (!corridor_ || !align_to_coarse_plan_) return length;
+
+  boost::shared_ptr<const WaypointNode> coarse_node =
+    corridor_->node(station->node().lock()->waypoint());
+  if (!coarse_node) return length;
+
+  // The next station of the coarse plan ahead of the station.
+  const double resolution = corridor_->waypointLattice()->longitudinalResolution();
+  const double distance = coarse_node->distance();
+  std::vector<double>::const_iterator next = std::upper_bound(
+      coarse_station_distances_.begin(), coarse_station_distances_.end(),
+      distance + 0.5*resolution);
+  if (next == coarse_station_distances_.end()) return length;
+
+  // Follow the coarse edge from a station of the coarse plan, as long as the
+  // edge stays within the spatial horizon and does not run into the front vehicle.
+  const bool at_coarse_station = next != coarse_station_distances_.begin() &&
+    std::fabs(*(next-1) - distance) <= 0.5*resolution;
+  const double distance_from_root = station->node().lock()->distance() -
+                                    root_.lock()->node().lock()->distance();
+  if (at_coarse_station &&
+      distance_from_root + *next - distance <= spatial_horizon_ &&
+      (!front || front->second >= *next - distance)) return *next - distance;
+
+  // Otherwise, stop at the next station of the coarse plan on the way.
+  if (*next - distance <= length && *next - distance >= 0.5*length) return *next - distance;
+  return length;
+}
+
+const bool HierarchicalIDMLatticePlanner::laneChangeAdmissible(
+    const boost::shared_ptr<Station>& station,
+    const boost::shared_ptr<const WaypointNode>& target_node) const {
+  if (!corridor_) return true;
+
+  // The lane change to the cached next station has been started already.
+  if (cached_next_station_.lock() &&
+      cached_next_station_.lock()->id() == target_node->id()) return true;
+
+  return corridor_->contains(target_node->waypoint());
+}
+
+const double HierarchicalIDMLatticePlanner::costFromRootToTerminal(
+    const boost::shared_ptr<Station>& terminal) const {
+  const double cost = Base::costFromRootToTerminal(terminal);
+  if (!corridor_ || corridor_->contains(terminal->node().lock()->waypoint())) return cost;
+  else return cost + corridor_deviation_cost_;
+}
+
+} // End namespace idm_lattice_planner
+} // End namespace planner.
@@ -0,0 +1,253 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include <vector>
+#include <unordered_set>
+#include <boost/smart_ptr.hpp>
+
+#include <planner/common/waypoint_lattice.h>
+#include <planner/idm_lattice_planner/idm_lattice_planner.h>
+
+namespace planner {
+namespace idm_lattice_planner {
+
+/**
+ * \brief LaneCorridor stores the lanes selected by a coarse plan.
+ *
+ * The corridor consists of the nodes on the waypoint lattice of the coarse
+ * planner which are covered by the coarse plan. A keep lane edge covers the
+ * nodes on its lane, while a lane change edge covers the nodes on both the
+ * source and target lanes over the span of the lane change. Beyond the end of
+ * the coarse plan, as well as outside the waypoint lattice, all lanes are
+ * considered to be in the corridor.
+ */
+class LaneCorridor {
+
+protected:
+
+  using CarlaWaypoint = carla::client::Waypoint;
+
+protected:
+
+  /// The waypoint lattice of the coarse planner.
+  boost::shared_ptr<const WaypointLattice> waypoint_lattice_ = nullptr;
+
+  /// IDs of the nodes on the waypoint lattice within the corridor.
+  std::unordered_set<size_t> nodes_;
+
+  /// The distance of the last node of the coarse plan on the waypoint lattice.
+  double end_distance_ = 0.0;
+
+public:
+
+  /**
+   * \param[in] waypoint_lattice The waypoint lattice of the coarse planner.
+   * \param[in] stations The nodes of the stations on the coarse plan,
+   *                     starting from the root station.
+   */
+  LaneCorridor(const boost::shared_ptr<const WaypointLattice>& waypoint_lattice,
+               const std::vector<boost::shared_ptr<const WaypointNode>>& stations);
+
+  /// Get the waypoint lattice the corridor is defined on.
+  boost::shared_ptr<const WaypointLattice> waypointLattice() const { return waypoint_lattice_; }
+
+  /// Get the number of nodes within the corridor.
+  const size_t size() const { return nodes_.size(); }
+
+  /// Find the node on the waypoint lattice of the corridor corresponding
+  /// to the given waypoint, \c nullptr if there is no such node.
+  boost::shared_ptr<const WaypointNode> node(
+      const boost::shared_ptr<const CarlaWaypoint>& waypoint) const {
+    return waypoint_lattice_->closestNode(
+        waypoint, waypoint_lattice_->longitudinalResolution());
+  }
+
+  /// Check whether the given waypoint is within the corridor.
+  const bool contains(const boost::shared_ptr<const CarlaWaypoint>& waypoint) const;
+
+}; // End class LaneCorridor.
+
+/**
+ * \brief HierarchicalIDMLatticePlanner plans at two rates with two horizons.
+ *
+ * A coarse IDM lattice planner with a long spatial horizon and long edges
+ * replans at a low rate, i.e. once every few planning cycles. The lanes
+ * selected by the coarse plan form a \c LaneCorridor, within which the
+ * planner itself, with a short horizon and short edges, refines the path at
+ * every planning cycle:
+ * - Lane changes leaving the corridor are not explored.
+ * - Terminal stations outside the corridor are penalized, which pulls the
+ *   ego towards the lane sequence of the coarse plan.
+ *
+ * The traffic simulated by the coarse planner along the edges of the coarse
+ * plan is cached. An edge of the fine planner between the same two nodes is
+ * not simulated again if the snapshot at its start is a near-duplicate of the
+ * one of the coarse edge (see \c SnapshotSignature). Since the two planners
+ * use different edge lengths, the edges of the fine planner are aligned to
+ * the stations of the coarse plan, by distance along the corridor, so that
+ * such edges exist (see \c alignToCoarsePlan()).
+ *
+ * The coarse planner is replanned earlier if the ego leaves the corridor,
+ * e.g. the fine planner cannot follow the coarse plan due to the traffic.
+ */
+class HierarchicalIDMLatticePlanner : public IDMLatticePlanner {
+
+private:
+
+  using Base = IDMLatticePlanner;
+  using This = HierarchicalIDMLatticePlanner;
+
+protected:
+
+  /// The coarse planner with the long spatial horizon.
+  boost::shared_ptr<IDMLatticePlanner> coarse_planner_ = nullptr;
+
+  /// The coarse planner is replanned once every this number of planning cycles.
+  size_t coarse_replan_period_;
+
+  /// Number of planning cycles since the coarse planner was last replanned.
+  size_t cycles_since_coarse_plan_ = 0;
+
+  /// The cost added to the terminal stations outside the corridor.
+  double corridor_deviation_cost_ = 10.0;
+
+  /// The corridor selected by the last coarse plan.
+  boost::shared_ptr<const LaneCorridor> corridor_ = nullptr;
+
+  /// The edges of the last coarse plan, indexed by the ID of the node they
+  /// end at on the waypoint lattice of the corridor. The start of an edge
+  /// is also the ID of a node on the waypoint lattice of the corridor.
+  utils::FlatHashMap<size_t, CommittedEdge> coarse_edges_;
+
+  /// Distances of the stations of the last coarse plan on the waypoint
+  /// lattice of the corridor, in the ascending order.
+  std::vector<double> coarse_station_distances_;
+
+  /// Whether the edges of the fine planner are aligned to the coarse plan.
+  bool align_to_coarse_plan_ = true;
+
+  /// Number of edges reusing a coarse edge in the last planning cycle.
+  mutable size_t coarse_edge_hits_ = 0;
+
+  /// Number of edges matching a coarse edge in the last planning cycle,
+  /// which are simulated again since the traffic at the start differs.
+  mutable size_t coarse_edge_misses_ = 0;
+
+public:
+
+  /**
+   * \param[in] sim_time_step The simulation time step of both planners.
+   * \param[in] spatial_horizon The spatial horizon of the fine planner.
+   * \param[in] coarse_spatial_horizon The spatial horizon of the coarse planner.
+   * \param[in] coarse_station_spacing The station spacing of the coarse planner.
+   * \param[in] coarse_replan_period The number of planning cycles between
+   *                                 two coarse plans.
+   */
+  HierarchicalIDMLatticePlanner(
+      const double sim_time_step,
+      const double spatial_horizon,
+      const double coarse_spatial_horizon,
+      const double coarse_station_spacing,
+      const size_t coarse_replan_period,
+      const boost::shared_ptr<router::Router>& router,
+      const boost::shared_ptr<CarlaMap>& map,
+      const boost::shared_ptr<utils::FastWaypointMap>& fast_map) :
+    Base(sim_time_step, spatial_horizon, router, map, fast_map),
+    coarse_planner_(boost::make_shared<IDMLatticePlanner>(
+          sim_time_step, coarse_spatial_horizon, router, map, fast_map)),
+    coarse_replan_period_(coarse_replan_period) {
+    coarse_planner_->edgeLengthPolicy() = EdgeLengthPolicy({coarse_station_spacing});
+  }
+
+  virtual ~HierarchicalIDMLatticePlanner() {}
+
+  /// Get the coarse planner.
+  boost::shared_ptr<const IDMLatticePlanner> coarsePlanner() const { return coarse_planner_; }
+
+  /// Get the corridor selected by the last coarse plan, \c nullptr if
+  /// the coarse plan is not available.
+  boost::shared_ptr<const LaneCorridor> corridor() const { return corridor_; }
+
+  /// Get or set the cost added to the terminal stations outside the corridor.
+  const double corridorDeviationCost() const { return corridor_deviation_cost_; }
+  double& corridorDeviationCost() { return corridor_deviation_cost_; }
+
+  /**
+   * \brief Get or set whether the edges of the fine planner are aligned to
+   *        the stations of the coarse plan.
+   *
+   * An edge starting from a station of the coarse plan follows the coarse
+   * edge if it fits within the spatial horizon, and the front gap if any.
+   * Other edges are shortened to end at the next station of the coarse plan
+   * if that is at least half of the selected edge length away.
+   */
+  const bool alignToCoarsePlan() const { return align_to_coarse_plan_; }
+  bool& alignToCoarsePlan() { return align_to_coarse_plan_; }
+
+  /// Number of edges reusing the traffic simulated by the coarse planner
+  /// in the last planning cycle.
+  const size_t coarseEdgeHits() const { return coarse_edge_hits_; }
+
+  /// Number of edges between the nodes of a coarse edge in the last planning
+  /// cycle, which are simulated again since the snapshot at the start differs.
+  const size_t coarseEdgeMisses() const { return coarse_edge_misses_; }
+
+  virtual DiscretePath planPath(const size_t ego, const Snapshot& snapshot) override;
+
+protected:
+
+  /// Check if the coarse planner should be replanned in this planning cycle.
+  const bool coarsePlanRequired(const Snapshot& snapshot) const;
+
+  /// Replan the coarse planner, and update the corridor with the new coarse plan.
+  void updateCorridor(const size_t ego, const Snapshot& snapshot);
+
+  /// Select the length of an edge leaving the station, which is aligned
+  /// to the coarse plan if \c alignToCoarsePlan() is set.
+  virtual const double edgeLength(
+      const boost::shared_ptr<Station>& station,
+      const boost::optional<std::pair<size_t, double>>& front) const override;
+
+  /**
+   * \brief Simulate the traffic with the ego following the path from the
+   *        station to the target node.
+   *
+   * If the station and the target node are at the start and end of an edge
+   * of the coarse plan, and the snapshot at the station has the same signature
+   * as the one at the start of the coarse edge, the simulated snapshot and
+   * stage cost of the coarse edge are reused. Otherwise, the edge is handled
+   * by the base class.
+   */
+  virtual boost::shared_ptr<const Snapshot> simulateEdge(
+      const boost::shared_ptr<Station>& station,
+      const boost::shared_ptr<const WaypointNode>& target_node,
+      const VehiclePath& path,
+      double& stage_cost) const override;
+
+  virtual const bool laneChangeAdmissible(
+      const boost::shared_ptr<Station>& station,
+      const boost::shared_ptr<const WaypointNode>& target_node) const override;
+
+  virtual const double costFromRootToTerminal(
+      const boost::shared_ptr<Station>& terminal) const override;
+
+}; // End class HierarchicalIDMLatticePlanner.
+
+} // End namespace idm_lattice_planner.
+
+using HierarchicalIDMLatticePlanner = idm_lattice_planner::HierarchicalIDMLatticePlanner;
+} // End namespace planner.
@@ -12,7 +12,6 @@
  * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-#include <list>
 #include <planner/idm_lattice_planner/idm_lattice_planner.h>
 
 namespace planner {
@@ -30,10 +29,10 @@ const double IDMTrafficSimulator::egoAcceleration() const {
 
   double accel = 0.0;
   boost::optional<std::pair<size_t, double>> lead =
-    snapshot_.trafficLattice()->front(snapshot_.ego().id());
+    snapshot_.trafficLattice()->frontAt(0);
 
   if (lead) {
-    const double lead_speed = snapshot_.vehicle(lead->first).speed();
+    const double lead_speed = snapshot_.vehicles().speeds()[lead->first];
     const double following_distance = lead->second;
     accel = idm_->idm(snapshot_.ego().speed(),
                       snapshot_.ego().policySpeed(),
@@ -47,23 +46,30 @@ const double IDMTrafficSimulator::egoAcceleration() const {
   return accel;
 }
 
-const double IDMTrafficSimulator::agentAcceleration(const size_t agent) const {
+const double IDMTrafficSimulator::agentAcceleration(const size_t index) const {
+
+  const ConstVehicleView agent = snapshot_.vehicles().view(index);
 
   // We assume all agent vehicles are lane followers for now.
+  // The driver model of an agent depends on its vehicle class.
+  boost::shared_ptr<const IntelligentDriverModel> idm = idm_;
+  if (agent_models_)
+    idm = agent_models_->model(2.0*agent.boundingBox().extent.x);
+
   double accel = 0.0;
   boost::optional<std::pair<size_t, double>> lead =
-    snapshot_.trafficLattice()->front(agent);
+    snapshot_.trafficLattice()->frontAt(index);
 
   if (lead) {
-    const double lead_speed = snapshot_.vehicle(lead->first).speed();
+    const double lead_speed = snapshot_.vehicles().speeds()[lead->first];
     const double following_distance = lead->second;
-    accel = idm_->idm(snapshot_.vehicle(agent).speed(),
-                      snapshot_.vehicle(agent).policySpeed(),
-                      lead_speed,
-                      following_distance);
+    accel = idm->idm(agent.speed(),
+                     agent.policySpeed(),
+                     lead_speed,
+                     following_distance);
   } else {
-    accel = idm_->idm(snapshot_.vehicle(agent).speed(),
-                      snapshot_.vehicle(agent).policySpeed());
+    accel = idm->idm(agent.speed(),
+                     agent.policySpeed());
   }
 
   return accel;
@@ -94,13 +100,14 @@ void Station::updateOptimalParent() {
     optimal_parent_ = back_parent_;
 
   // Update the snapshot at this station.
+  // The snapshot is shared with the optimal parent instead of being copied.
   snapshot_ = std::get<0>(*optimal_parent_);
 
   return;
 }
 
 void Station::updateLeftParent(
-    const Snapshot& snapshot,
+    const boost::shared_ptr<const Snapshot>& snapshot,
     const double cost_to_come,
     const boost::shared_ptr<Station>& parent_station) {
   left_parent_ = std::make_tuple(snapshot, cost_to_come, parent_station);
@@ -109,7 +116,7 @@ void Station::updateLeftParent(
 }
 
 void Station::updateBackParent(
-    const Snapshot& snapshot,
+    const boost::shared_ptr<const Snapshot>& snapshot,
     const double cost_to_come,
     const boost::shared_ptr<Station>& parent_station) {
   back_parent_ = std::make_tuple(snapshot, cost_to_come, parent_station);
@@ -118,7 +125,7 @@ void Station::updateBackParent(
 }
 
 void Station::updateRightParent(
-    const Snapshot& snapshot,
+    const boost::shared_ptr<const Snapshot>& snapshot,
     const double cost_to_come,
     const boost::shared_ptr<Station>& parent_station) {
   right_parent_ = std::make_tuple(snapshot, cost_to_come, parent_station);
@@ -127,7 +134,7 @@ void Station::updateRightParent(
 }
 
 void Station::updateLeftChild(
-    const ContinuousPath& path,
+    const EdgePath& path,
     const double stage_cost,
     const boost::shared_ptr<Station>& child_station) {
   left_child_ = std::make_tuple(path, stage_cost, child_station);
@@ -135,7 +142,7 @@ void Station::updateLeftChild(
 }
 
 void Station::updateFrontChild(
-    const ContinuousPath& path,
+    const EdgePath& path,
     const double stage_cost,
     const boost::shared_ptr<Station>& child_station) {
   front_child_ = std::make_tuple(path, stage_cost, child_station);
@@ -143,7 +150,7 @@ void Station::updateFrontChild(
 }
 
 void Station::updateRightChild(
-    const ContinuousPath& path,
+    const EdgePath& path,
     const double stage_cost,
     const boost::shared_ptr<Station>& child_station) {
   right_child_ = std::make_tuple(path, stage_cost, child_station);
@@ -153,7 +160,7 @@ void Station::updateRightChild(
 std::string Station::string(const std::string& prefix) const {
   std::string output = prefix;
   output += "id: " + std::to_string(id()) + "\n";
-  output += "snapshot: \n" + snapshot_.string();
+  output += "snapshot: \n" + snapshot_->string();
 
   boost::format parent_format("id:%1% cost to come:%2%\n");
 
@@ -186,21 +193,21 @@ std::string Station::string(const std::string& prefix) const {
   output += "front child: ";
   if (front_child_)
     output += ((child_format) % std::get<2>(*front_child_).lock()->id()
-                              % std::get<0>(*front_child_).range()
+                              % vehiclePath(std::get<0>(*front_child_)).range()
                               % std::get<1>(*front_child_)).str();
   else output += "\n";
 
   output += "left child: ";
   if (left_child_)
     output += ((child_format) % std::get<2>(*left_child_).lock()->id()
-                              % std::get<0>(*left_child_).range()
+                              % vehiclePath(std::get<0>(*left_child_)).range()
                               % std::get<1>(*left_child_)).str();
   else output += "\n";
 
   output += "right child: ";
   if (right_child_)
     output += ((child_format) % std::get<2>(*right_child_).lock()->id()
-                              % std::get<0>(*right_child_).range()
+                              % vehiclePath(std::get<0>(*right_child_)).range()
                               % std::get<1>(*right_child_)).str();
   else output += "\n";
 
@@ -217,9 +224,21 @@ std::vector<boost::shared_ptr<const WaypointNode>>
   return nodes;
 }
 
-std::vector<ContinuousPath> IDMLatticePlanner::edges() const {
+std::vector<boost::shared_ptr<const Station>>
+  IDMLatticePlanner::optimalStations() const {
+
+  std::vector<boost::shared_ptr<const Station>> stations;
+  for (const auto& station : optimal_station_sequence_) {
+    if (!station.lock()) continue;
+    stations.push_back(station.lock());
+  }
 
-  std::vector<ContinuousPath> paths;
+  return stations;
+}
+
+std::vector<EdgePath> IDMLatticePlanner::edges() const {
+
+  std::vector<EdgePath> paths;
   for (const auto& item : node_to_station_table_) {
     const boost::shared_ptr<const Station> station = item.second;
 
@@ -250,7 +269,19 @@ DiscretePath IDMLatticePlanner::planPath(
     throw std::runtime_error(error_msg + id_msg);
   }
 
-  // Update the waypoint lattice.
+  // Update the commitment before the station graph of the last planning
+  // cycle is pruned, and the waypoint lattice is shifted.
+  committed_next_node_ = boost::none;
+  if (cached_next_station_.lock()) {
+    if (immediateNextStationReached(snapshot)) commitment_.reached();
+    else if (commitment_.executing())
+      committed_next_node_ = cached_next_station_.lock()->id();
+  }
+
+  // Update the waypoint lattice. The construction time of the lattice
+  // in this planning cycle is counted from here.
+  lattice_construction_mark_ =
+    waypoint_lattice_ ? waypoint_lattice_->constructionTime() : 0.0;
   updateWaypointLattice(snapshot);
 
   // Prune the station graph.
@@ -277,15 +308,17 @@ DiscretePath IDMLatticePlanner::planPath(
   constructStationGraph(station_queue);
 
   // Select the optimal path sequence from the station graph.
-  std::list<ContinuousPath> optimal_path_seq;
-  std::list<boost::weak_ptr<Station>> optimal_station_seq;
-  selectOptimalPath(optimal_path_seq, optimal_station_seq);
+  std::list<EdgePath> optimal_path_seq;
+  selectOptimalPath(optimal_path_seq, optimal_station_sequence_);
+
+  // Commit to the selected path.
+  commitOptimalPath(optimal_path_seq);
 
   // Merge the path sequence into one discrete path.
   DiscretePath optimal_path = mergePaths(optimal_path_seq);
 
   // Update the cached next station.
-  cached_next_station_ = *(++optimal_station_seq.begin());
+  cached_next_station_ = *(++optimal_station_sequence_.begin());
 
   return optimal_path;
 }
@@ -325,7 +358,13 @@ void IDMLatticePlanner::updateWaypointLattice(const Snapshot& snapshot) {
     boost::shared_ptr<CarlaWaypoint> ego_waypoint =
       fast_map_->waypoint(snapshot.ego().transform().location);
     waypoint_lattice_ = boost::make_shared<WaypointLattice>(
-        ego_waypoint, spatial_horizon_+30.0, 1.0, router_);
+        ego_waypoint, spatial_horizon_+30.0, 1.0, router_, lazy_lattice_);
+
+    // Stations are at least the shortest edge length apart on each lane of the lattice.
+    // The table is sized by the horizon, since a lazy lattice only covers its start here.
+    const size_t lanes = waypoint_lattice_->latticeEntries().size();
+    node_to_station_table_.reserve(lanes * static_cast<size_t>(
+          waypoint_lattice_->horizon()/edge_length_policy_.shortest()) + 1);
     return;
   }
 
@@ -448,13 +487,26 @@ void IDMLatticePlanner::constructStationGraph(
     }
   };
 
+  expansions_ = 0;
+
   while (!station_queue.empty()) {
+    // Stop expanding once the expansion budget is used up. The stations
+    // left in the queue become terminals.
+    if (max_expansions_ > 0 && expansions_ >= max_expansions_) break;
+
     boost::shared_ptr<Station> station = station_queue.front();
     station_queue.pop_front();
+    ++expansions_;
+
+    const size_t ego = station->snapshot().ego().id();
+    const boost::shared_ptr<const TrafficLattice> traffic_lattice =
+      station->snapshot().trafficLattice();
 
     // Try to connect to the front node.
     boost::shared_ptr<const WaypointNode> front_node =
-      waypoint_lattice_->front(station->node().lock()->waypoint(), 50.0);
+      waypoint_lattice_->front(
+          station->node().lock()->waypoint(),
+          edgeLength(station, traffic_lattice->front(ego)));
     boost::shared_ptr<Station> front_station =
       connectStationToFrontNode(station, front_node);
 
@@ -462,7 +514,9 @@ void IDMLatticePlanner::constructStationGraph(
 
     // Try to connect to the left front node.
     boost::shared_ptr<const WaypointNode> left_front_node =
-      waypoint_lattice_->frontLeft(station->node().lock()->waypoint(), 50.0);
+      waypoint_lattice_->frontLeft(
+          station->node().lock()->waypoint(),
+          edgeLength(station, traffic_lattice->leftFront(ego)));
     boost::shared_ptr<Station> left_front_station =
       connectStationToLeftFrontNode(station, left_front_node);
 
@@ -470,7 +524,9 @@ void IDMLatticePlanner::constructStationGraph(
 
     // Try to connect to the right front node.
     boost::shared_ptr<const WaypointNode> right_front_node =
-      waypoint_lattice_->frontRight(station->node().lock()->waypoint(), 50.0);
+      waypoint_lattice_->frontRight(
+          station->node().lock()->waypoint(),
+          edgeLength(station, traffic_lattice->rightFront(ego)));
     boost::shared_ptr<Station> right_front_station =
       connectStationToRightFrontNode(station, right_front_node);
 
@@ -487,53 +543,144 @@ void IDMLatticePlanner::constructStationGraph(
   return;
 }
 
-boost::shared_ptr<Station> IDMLatticePlanner::connectStationToFrontNode(
+const double IDMLatticePlanner::edgeLength(
     const boost::shared_ptr<Station>& station,
-    const boost::shared_ptr<const WaypointNode>& target_node) {
+    const boost::optional<std::pair<size_t, double>>& front) const {
 
-  //std::printf("connectStationToFrontNode(): \n");
+  const double distance = station->node().lock()->distance() -
+                          root_.lock()->node().lock()->distance();
+  boost::optional<double> gap = boost::none;
+  if (front) gap = front->second;
 
-  // Return directly if the target node does not exist.
-  if (!target_node) return nullptr;
+  return edge_length_policy_.length(distance, station->snapshot().ego().speed(), gap);
+}
 
-  // Plan a path between the node at the current station to the target node.
-  //std::printf("Compute Kelly-Nagy path.\n");
-  boost::shared_ptr<ContinuousPath> path = nullptr;
-  try {
-    path = boost::make_shared<ContinuousPath>(
-        std::make_pair(station->snapshot().ego().transform(),
-                       station->snapshot().ego().curvature()),
-        std::make_pair(target_node->waypoint()->GetTransform(),
-                       target_node->curvature(map_)),
-        ContinuousPath::LaneChangeType::KeepLane);
-  } catch (std::exception& e) {
-    // If for whatever reason, the path cannot be created, the station
-    // cannot be created either.
-    std::printf("%s", e.what());
-    return nullptr;
+boost::shared_ptr<Station> IDMLatticePlanner::childStation(
+    const Snapshot& snapshot,
+    boost::shared_ptr<const Snapshot>& shared_snapshot) const {
+
+  shared_snapshot = boost::make_shared<const Snapshot>(snapshot);
+  boost::shared_ptr<Station> child_station =
+    boost::make_shared<Station>(shared_snapshot, waypoint_lattice_, fast_map_);
+
+  utils::FlatHashMap<size_t, boost::shared_ptr<Station>>::const_iterator iter =
+    node_to_station_table_.find(child_station->id());
+  if (iter == node_to_station_table_.end()) return child_station;
+
+  // Share the snapshot of the existing station if the simulated
+  // snapshot is a near-duplicate of it.
+  child_station = iter->second;
+  if (SnapshotSignature(snapshot, signature_resolution_) ==
+      SnapshotSignature(child_station->snapshot(), signature_resolution_))
+    shared_snapshot = child_station->sharedSnapshot();
+
+  return child_station;
+}
+
+boost::shared_ptr<const Snapshot> IDMLatticePlanner::simulateEdge(
+    const boost::shared_ptr<Station>& station,
+    const boost::shared_ptr<const WaypointNode>& target_node,
+    const VehiclePath& path,
+    double& stage_cost) const {
+
+  // Reuse the committed edge if the traffic at its start has not changed.
+  utils::FlatHashMap<size_t, CommittedEdge>::const_iterator iter =
+    committed_edges_.find(target_node->id());
+  if (iter != committed_edges_.end() && iter->second.start == station->id() &&
+      iter->second.signature == SnapshotSignature(station->snapshot(), signature_resolution_)) {
+    stage_cost = iter->second.stage_cost;
+    return iter->second.snapshot;
   }
 
-  // Now, simulate the traffic forward with ego following the created path.
-  //std::printf("Simulate the traffic.\n");
   IDMTrafficSimulator simulator(station->snapshot(), map_, fast_map_);
-  double simulation_time = 0.0; double stage_cost = 0.0;
+  simulator.agentModels() = agent_models_;
+  double simulation_time = 0.0;
   try {
     const bool no_collision = simulator.simulate(
-        *path, sim_time_step_, 5.0, simulation_time, stage_cost);
-    // There a collision is detected in the simulation, this option is ignored.
+        path, sim_time_step_,
+        maxSimulationTime(target_node->distance()-station->node().lock()->distance()),
+        simulation_time, stage_cost);
     if (!no_collision) return nullptr;
   } catch(std::exception& e) {
-    std::printf("IDMLatticePlanner::connectStationToFrontNode(): WARNING\n"
+    std::printf("IDMLatticePlanner::simulateEdge(): WARNING\n"
                 "%s", e.what());
     return nullptr;
   }
 
+  return boost::make_shared<const Snapshot>(simulator.snapshot());
+}
+
+boost::shared_ptr<const EdgePath> IDMLatticePlanner::edgePath(
+    const boost::shared_ptr<Station>& station,
+    const boost::shared_ptr<const WaypointNode>& target_node,
+    const VehiclePath::LaneChangeType lane_change_type) const {
+
+  const std::pair<CarlaTransform, double> start = std::make_pair(
+      station->snapshot().ego().transform(), station->snapshot().ego().curvature());
+  const std::pair<CarlaTransform, double> end = std::make_pair(
+      target_node->waypoint()->GetTransform(), target_node->curvature(map_));
+
+  if (frenet_edges_) {
+    // The reference line is the lane center of the target node, from
+    // alongside the station to the target node.
+    const double start_distance = station->node().lock()->distance();
+    std::vector<std::pair<CarlaTransform, double>> reference;
+    boost::shared_ptr<const WaypointNode> node = target_node;
+    while (node) {
+      reference.push_back(std::make_pair(
+            node->waypoint()->GetTransform(), node->curvature(map_)));
+      if (node->distance() <= start_distance) break;
+      node = node->back();
+    }
+    std::reverse(reference.begin(), reference.end());
+
+    try {
+      return boost::make_shared<const EdgePath>(
+          FrenetPath(reference, start, end, lane_change_type));
+    } catch (const std::exception&) {
+      // Fall back to the continuous path if the start of the ego
+      // cannot be represented w.r.t. the reference line.
+    }
+  }
+
+  try {
+    return boost::make_shared<const EdgePath>(
+        ContinuousPath(start, end, lane_change_type));
+  } catch (const std::exception& e) {
+    std::printf("%s", e.what());
+    return nullptr;
+  }
+}
+
+boost::shared_ptr<Station> IDMLatticePlanner::connectStationToFrontNode(
+    const boost::shared_ptr<Station>& station,
+    const boost::shared_ptr<const WaypointNode>& target_node) {
+
+  //std::printf("connectStationToFrontNode(): \n");
+
+  // Return directly if the target node does not exist.
+  if (!target_node) return nullptr;
+
+  // Plan a path between the node at the current station to the target node.
+  //std::printf("Compute Kelly-Nagy path.\n");
+  boost::shared_ptr<const EdgePath> path =
+    edgePath(station, target_node, VehiclePath::LaneChangeType::KeepLane);
+  // If for whatever reason, the path cannot be created, this option is ignored.
+  if (!path) return nullptr;
+
+  // Now, simulate the traffic forward with ego following the created path.
+  //std::printf("Simulate the traffic.\n");
+  double stage_cost = 0.0;
+  boost::shared_ptr<const Snapshot> simulated_snapshot =
+    simulateEdge(station, target_node, vehiclePath(*path), stage_cost);
+  // There a collision is detected in the simulation, this option is ignored.
+  if (!simulated_snapshot) return nullptr;
+
   // Either create a new station or used the one has been already created.
   //std::printf("Create child station.\n");
-  boost::shared_ptr<Station> next_station = boost::make_shared<Station>(
-      simulator.snapshot(), waypoint_lattice_, fast_map_);
-  if (node_to_station_table_.count(next_station->id()) != 0)
-    next_station = node_to_station_table_[next_station->id()];
+  boost::shared_ptr<const Snapshot> next_snapshot = nullptr;
+  boost::shared_ptr<Station> next_station =
+    childStation(*simulated_snapshot, next_snapshot);
 
   // Set the child station of the parent station.
   //std::printf("Update the child station of the input station.\n");
@@ -543,10 +690,10 @@ boost::shared_ptr<Station> IDMLatticePlanner::connectStationToFrontNode(
   //std::printf("Update the parent station of the new station.\n");
   if (station->hasParent()) {
     next_station->updateBackParent(
-        simulator.snapshot(), station->costToCome()+stage_cost, station);
+        next_snapshot, station->costToCome()+stage_cost, station);
   } else {
     next_station->updateBackParent(
-        simulator.snapshot(), stage_cost, station);
+        next_snapshot, stage_cost, station);
   }
 
   return next_station;
@@ -566,6 +713,10 @@ boost::shared_ptr<Station> IDMLatticePlanner::connectStationToLeftFrontNode(
   if (target_node->distance()-station->node().lock()->distance() < 20.0)
     return nullptr;
 
+  // Return directly if the lane change is not admissible, e.g. it leaves
+  // the corridor of a hierarchical planner.
+  if (!laneChangeAdmissible(station, target_node)) return nullptr;
+
   // If the ego is on the right of the lane center, connecting to the
   // left lane is forbidden.
   if (utils::distanceToLaneCenter(
@@ -590,42 +741,24 @@ boost::shared_ptr<Station> IDMLatticePlanner::connectStationToLeftFrontNode(
 
   // Plan a path between the node at the current station to the target node.
   //std::printf("Compute Kelly-Nagy path.\n");
-  boost::shared_ptr<ContinuousPath> path = nullptr;
-  try {
-    path = boost::make_shared<ContinuousPath>(
-        std::make_pair(station->snapshot().ego().transform(),
-                       station->snapshot().ego().curvature()),
-        std::make_pair(target_node->waypoint()->GetTransform(),
-                       target_node->curvature(map_)),
-        ContinuousPath::LaneChangeType::LeftLaneChange);
-  } catch (const std::exception& e) {
-    // If for whatever reason, the path cannot be created,
-    // just ignore this option.
-    std::printf("%s", e.what());
-    return nullptr;
-  }
+  boost::shared_ptr<const EdgePath> path =
+    edgePath(station, target_node, VehiclePath::LaneChangeType::LeftLaneChange);
+  // If for whatever reason, the path cannot be created, this option is ignored.
+  if (!path) return nullptr;
 
   // Now, simulate the traffic forward with ego following the created path.
   //std::printf("Simulate the traffic.\n");
-  IDMTrafficSimulator simulator(station->snapshot(), map_, fast_map_);
-  double simulation_time = 0.0; double stage_cost = 0.0;
-  try {
-    const bool no_collision = simulator.simulate(
-        *path, sim_time_step_, 5.0, simulation_time, stage_cost);
-    // There a collision is detected in the simulation, this option is ignored.
-    if (!no_collision) return nullptr;
-  } catch (std::exception& e) {
-    std::printf("IDMLatticePlanner::connectStationToLeftFrontNode(): WARNING\n"
-                "%s", e.what());
-    return nullptr;
-  }
+  double stage_cost = 0.0;
+  boost::shared_ptr<const Snapshot> simulated_snapshot =
+    simulateEdge(station, target_node, vehiclePath(*path), stage_cost);
+  // There a collision is detected in the simulation, this option is ignored.
+  if (!simulated_snapshot) return nullptr;
 
   // Either create a new station or used the one has been already created.
   //std::printf("Create child station.\n");
-  boost::shared_ptr<Station> next_station = boost::make_shared<Station>(
-      simulator.snapshot(), waypoint_lattice_, fast_map_);
-  if (node_to_station_table_.count(next_station->id()) != 0)
-    next_station = node_to_station_table_[next_station->id()];
+  boost::shared_ptr<const Snapshot> next_snapshot = nullptr;
+  boost::shared_ptr<Station> next_station =
+    childStation(*simulated_snapshot, next_snapshot);
 
   // Set the child station of the parent station.
   //std::printf("Update the child station of the input station.\n");
@@ -635,10 +768,10 @@ boost::shared_ptr<Station> IDMLatticePlanner::connectStationToLeftFrontNode(
   //std::printf("Update the parent station of the new station.\n");
   if (station->hasParent()) {
     next_station->updateRightParent(
-        simulator.snapshot(), station->costToCome()+stage_cost, station);
+        next_snapshot, station->costToCome()+stage_cost, station);
   } else {
     next_station->updateRightParent(
-        simulator.snapshot(), stage_cost, station);
+        next_snapshot, stage_cost, station);
   }
 
   return next_station;
@@ -658,6 +791,10 @@ boost::shared_ptr<Station> IDMLatticePlanner::connectStationToRightFrontNode(
   if (target_node->distance()-station->node().lock()->distance() < 20.0)
     return nullptr;
 
+  // Return directly if the lane change is not admissible, e.g. it leaves
+  // the corridor of a hierarchical planner.
+  if (!laneChangeAdmissible(station, target_node)) return nullptr;
+
   // If the ego is on the left of the lane center, connecting to the
   // right lane is forbidden.
   if (utils::distanceToLaneCenter(
@@ -682,42 +819,24 @@ boost::shared_ptr<Station> IDMLatticePlanner::connectStationToRightFrontNode(
 
   // Plan a path between the node at the current station to the target node.
   //std::printf("Compute Kelly-Nagy path.\n");
-  boost::shared_ptr<ContinuousPath> path = nullptr;
-  try {
-    path = boost::make_shared<ContinuousPath>(
-        std::make_pair(station->snapshot().ego().transform(),
-                       station->snapshot().ego().curvature()),
-        std::make_pair(target_node->waypoint()->GetTransform(),
-                       target_node->curvature(map_)),
-        ContinuousPath::LaneChangeType::RightLaneChange);
-  } catch (std::exception& e) {
-    // If for whatever reason, the path cannot be created,
-    // just ignore this option.
-    std::printf("%s", e.what());
-    return nullptr;
-  }
+  boost::shared_ptr<const EdgePath> path =
+    edgePath(station, target_node, VehiclePath::LaneChangeType::RightLaneChange);
+  // If for whatever reason, the path cannot be created, this option is ignored.
+  if (!path) return nullptr;
 
   // Now, simulate the traffic forward with the ego following the created path.
   //std::printf("Simulate the traffic.\n");
-  IDMTrafficSimulator simulator(station->snapshot(), map_, fast_map_);
-  double simulation_time = 0.0; double stage_cost = 0.0;
-  try {
-    const bool no_collision = simulator.simulate(
-        *path, sim_time_step_, 5.0, simulation_time, stage_cost);
-    // There a collision is detected in the simulation, this option is ignored.
-    if (!no_collision) return nullptr;
-  } catch (std::exception& e) {
-    std::printf("IDMLatticePlanner::connectStationToRightFrontNode(): WARNING\n"
-                "%s", e.what());
-    return nullptr;
-  }
+  double stage_cost = 0.0;
+  boost::shared_ptr<const Snapshot> simulated_snapshot =
+    simulateEdge(station, target_node, vehiclePath(*path), stage_cost);
+  // There a collision is detected in the simulation, this option is ignored.
+  if (!simulated_snapshot) return nullptr;
 
   // Either create a new station or used the one has been already created.
   //std::printf("Create child station.\n");
-  boost::shared_ptr<Station> next_station = boost::make_shared<Station>(
-      simulator.snapshot(), waypoint_lattice_, fast_map_);
-  if (node_to_station_table_.count(next_station->id()) != 0)
-    next_station = node_to_station_table_[next_station->id()];
+  boost::shared_ptr<const Snapshot> next_snapshot = nullptr;
+  boost::shared_ptr<Station> next_station =
+    childStation(*simulated_snapshot, next_snapshot);
 
   // Set the child station of the parent station.
   //std::printf("Update the child station of the input station.\n");
@@ -727,10 +846,10 @@ boost::shared_ptr<Station> IDMLatticePlanner::connectStationToRightFrontNode(
   //std::printf("Update the parent station of the new station.\n");
   if (station->hasParent()) {
     next_station->updateLeftParent(
-        simulator.snapshot(), station->costToCome()+stage_cost, station);
+        next_snapshot, station->costToCome()+stage_cost, station);
   } else {
     next_station->updateLeftParent(
-        simulator.snapshot(), stage_cost, station);
+        next_snapshot, stage_cost, station);
   }
 
   return next_station;
@@ -805,7 +924,7 @@ const double IDMLatticePlanner::terminalDistanceCost(
     root_child = std::get<2>(*(root_.lock()->rightChild())).lock();
 
   const double spatial_horizon =
-    spatial_horizon_ - 50.0 +
+    spatial_horizon_ - edge_length_policy_.longest() +
     root_child->node()->distance() -
     root_.lock()->node().lock()->distance();
 
@@ -840,8 +959,54 @@ const double IDMLatticePlanner::costFromRootToTerminal(
   return path_cost + terminal_speed_cost + terminal_distance_cost;
 }
 
+const PlanCommitment::Manoeuvre IDMLatticePlanner::manoeuvre(
+    const boost::shared_ptr<Station>& station) const {
+
+  // Trace back the optimal parents, so that the first lane change
+  // from the root is the last one found.
+  PlanCommitment::Manoeuvre manoeuvre = PlanCommitment::Manoeuvre::KeepLane;
+  boost::shared_ptr<Station> child_station = station;
+
+  while (child_station->hasParent()) {
+    boost::shared_ptr<Station> parent_station =
+      std::get<2>(*(child_station->optimalParent())).lock();
+    if (!parent_station) break;
+
+    if (parent_station->leftChild() &&
+        std::get<2>(*(parent_station->leftChild())).lock() == child_station)
+      manoeuvre = PlanCommitment::Manoeuvre::LeftLaneChange;
+    else if (parent_station->rightChild() &&
+             std::get<2>(*(parent_station->rightChild())).lock() == child_station)
+      manoeuvre = PlanCommitment::Manoeuvre::RightLaneChange;
+
+    child_station = parent_station;
+  }
+
+  return manoeuvre;
+}
+
+const bool IDMLatticePlanner::followsCommitment(
+    const boost::shared_ptr<Station>& station) const {
+
+  if (!committed_next_node_) return manoeuvre(station) == commitment_.committed();
+
+  // While the ego is executing the committed lane change, the path
+  // should still end its first edge at the same node.
+  boost::shared_ptr<Station> child_station = station;
+  while (child_station->hasParent()) {
+    boost::shared_ptr<Station> parent_station =
+      std::get<2>(*(child_station->optimalParent())).lock();
+    if (!parent_station) return false;
+    if (!parent_station->hasParent())
+      return child_station->id() == *committed_next_node_;
+    child_station = parent_station;
+  }
+
+  return false;
+}
+
 void IDMLatticePlanner::selectOptimalPath(
-    std::list<ContinuousPath>& path_sequence,
+    std::list<EdgePath>& path_sequence,
     std::list<boost::weak_ptr<Station>>& station_sequence) const {
 
   //std::printf("selectOptimalPath():\n");
@@ -851,6 +1016,10 @@ void IDMLatticePlanner::selectOptimalPath(
   // Set the initial cost to a large enough number.
   double optimal_cost = 1.0e10;
 
+  // The best terminal station following the committed manoeuvre.
+  boost::shared_ptr<Station> committed_station = nullptr;
+  double committed_cost = 1.0e10;
+
   for (const auto& item : node_to_station_table_) {
 
     boost::shared_ptr<Station> station = item.second;
@@ -867,6 +1036,19 @@ void IDMLatticePlanner::selectOptimalPath(
       optimal_station = station;
       optimal_cost = station_cost;
     }
+
+    if (commitment_.enabled() && station_cost < committed_cost &&
+        followsCommitment(station)) {
+      committed_station = station;
+      committed_cost = station_cost;
+    }
+  }
+
+  // Stick to the committed manoeuvre unless the optimal
+  // path is cheaper by more than the hysteresis.
+  if (committed_station && commitment_.keep(optimal_cost, committed_cost)) {
+    optimal_station = committed_station;
+    optimal_cost = committed_cost;
   }
 
   // The optimal station should be set no matter what.
@@ -949,16 +1131,51 @@ void IDMLatticePlanner::selectOptimalPath(
 }
 
 DiscretePath IDMLatticePlanner::mergePaths(
-    const std::list<ContinuousPath>& paths) const {
+    const std::list<EdgePath>& paths) const {
 
   //std::printf("mergePaths(): \n");
   //std::printf("path #: %lu\n", paths.size());
 
-  DiscretePath path(paths.front());
-  for (std::list<ContinuousPath>::const_iterator iter = ++(paths.begin());
-       iter != paths.end(); ++iter) path.append(*iter);
+  DiscretePath path = discretePath(paths.front());
+  for (std::list<EdgePath>::const_iterator iter = ++(paths.begin());
+       iter != paths.end(); ++iter) path.append(discretePath(*iter));
   return path;
 }
 
+void IDMLatticePlanner::commitOptimalPath(
+    const std::list<EdgePath>& path_sequence) {
+
+  boost::shared_ptr<Station> terminal = optimal_station_sequence_.back().lock();
+
+  // The lane change types of the paths have the same values as the manoeuvres.
+  manoeuvre_abandoned_ = commitment_.update(
+      followsCommitment(terminal), manoeuvre(terminal),
+      static_cast<PlanCommitment::Manoeuvre>(vehiclePath(path_sequence.front()).laneChangeType()));
+
+  // Cache the edges on the committed path to be reused in the next planning cycle.
+  committed_edges_.clear();
+  if (!commitment_.enabled()) return;
+
+  std::list<boost::weak_ptr<Station>>::const_iterator parent_iter =
+    optimal_station_sequence_.begin();
+  for (std::list<boost::weak_ptr<Station>>::const_iterator child_iter = std::next(parent_iter);
+       child_iter != optimal_station_sequence_.end(); ++parent_iter, ++child_iter) {
+
+    boost::shared_ptr<Station> parent_station = parent_iter->lock();
+    boost::shared_ptr<Station> child_station = child_iter->lock();
+    const auto& parent = *(child_station->optimalParent());
+
+    const double parent_cost_to_come =
+      parent_station->hasParent() ? parent_station->costToCome() : 0.0;
+    committed_edges_.emplace(child_station->id(), CommittedEdge{
+        parent_station->id(),
+        SnapshotSignature(parent_station->snapshot(), signature_resolution_),
+        std::get<1>(parent) - parent_cost_to_come,
+        std::get<0>(parent)});
+  }
+
+  return;
+}
+
 } // End namespace idm_lattice_planner
 } // End namespace planner.
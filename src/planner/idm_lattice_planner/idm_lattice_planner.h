@@ -14,26 +14,56 @@
 
 #pragma once
 
+#include <list>
 #include <tuple>
 #include <deque>
+#include <vector>
+#include <algorithm>
 #include <string>
 #include <unordered_map>
 #include <boost/optional.hpp>
+#include <boost/variant.hpp>
 #include <boost/core/noncopyable.hpp>
 
 #include <router/common/router.h>
 #include <router/loop_router/loop_router.h>
 #include <planner/common/traffic_lattice.h>
 #include <planner/common/snapshot.h>
+#include <planner/common/snapshot_signature.h>
+#include <planner/common/edge_length_policy.h>
+#include <planner/common/plan_commitment.h>
 #include <planner/common/vehicle_path.h>
 #include <planner/common/utils.h>
+#include <planner/common/flat_hash_map.h>
 #include <planner/common/vehicle_path_planner.h>
 #include <planner/common/traffic_simulator.h>
 #include <planner/common/intelligent_driver_model.h>
+#include <planner/common/driver_model_table.h>
 
 namespace planner {
 namespace idm_lattice_planner {
 
+/**
+ * \brief The path of an edge between two stations.
+ *
+ * The edges are \c ContinuousPath by default, or \c FrenetPath over the
+ * lane center of the target node if \c IDMLatticePlanner::frenetEdges() is set.
+ */
+using EdgePath = boost::variant<ContinuousPath, FrenetPath>;
+
+/// Get the edge path as a \c VehiclePath.
+inline const VehiclePath& vehiclePath(const EdgePath& path) {
+  if (const FrenetPath* frenet_path = boost::get<FrenetPath>(&path)) return *frenet_path;
+  return boost::get<ContinuousPath>(path);
+}
+
+/// Sample the edge path into a \c DiscretePath.
+inline DiscretePath discretePath(const EdgePath& path) {
+  if (const FrenetPath* frenet_path = boost::get<FrenetPath>(&path))
+    return DiscretePath(*frenet_path);
+  return DiscretePath(boost::get<ContinuousPath>(path));
+}
+
 /**
  * \brief IDMTrafficSimulator simulates the traffic forward by a given
  *        period of time.
@@ -54,6 +84,9 @@ protected:
   /// Intelligent driver model.
   boost::shared_ptr<IntelligentDriverModel> idm_ = nullptr;
 
+  /// Driver models of the agents by their vehicle classes, \c idm_ is used if not set.
+  boost::shared_ptr<const DriverModelTable> agent_models_ = nullptr;
+
 public:
 
   IDMTrafficSimulator(
@@ -66,11 +99,15 @@ public:
   const boost::shared_ptr<const IntelligentDriverModel> idm() const { return idm_; }
   boost::shared_ptr<IntelligentDriverModel>& idm() { return idm_; }
 
+  /// Get or set the driver models of the agents.
+  const boost::shared_ptr<const DriverModelTable>& agentModels() const { return agent_models_; }
+  boost::shared_ptr<const DriverModelTable>& agentModels() { return agent_models_; }
+
 protected:
 
   virtual const double egoAcceleration() const override;
 
-  virtual const double agentAcceleration(const size_t agent) const override;
+  virtual const double agentAcceleration(const size_t index) const override;
 
 }; // End class IDMTrafficSimulator.
 
@@ -89,8 +126,10 @@ protected:
    * \brief Stores a parent station of this station.
    *
    * The tuple stores the snapshot and the cost-to-come if come form this parent station.
+   * The snapshot may be shared with the station and other parents if they
+   * are near-duplicates.
    */
-  using Parent = std::tuple<Snapshot, double, boost::weak_ptr<Station>>;
+  using Parent = std::tuple<boost::shared_ptr<const Snapshot>, double, boost::weak_ptr<Station>>;
 
   /**
    * \brief Stores a child station of this station.
@@ -98,7 +137,7 @@ protected:
    * The tuple stores path to the child station, the cost of the path, and
    * the child station.
    */
-  using Child = std::tuple<ContinuousPath, double, boost::weak_ptr<Station>>;
+  using Child = std::tuple<EdgePath, double, boost::weak_ptr<Station>>;
 
 protected:
 
@@ -106,7 +145,8 @@ protected:
   boost::weak_ptr<const WaypointNode> node_;
 
   /// The snapshot of the traffic when the ego vehicle reaches this station.
-  Snapshot snapshot_;
+  /// This is shared with the optimal parent once the station has parents.
+  boost::shared_ptr<const Snapshot> snapshot_;
 
   /**
    * \name Parent stations of this station.
@@ -141,7 +181,7 @@ public:
 
   Station(const Snapshot& snapshot, const boost::shared_ptr<const WaypointNode>& node) :
     node_    (node),
-    snapshot_(snapshot) {
+    snapshot_(boost::make_shared<const Snapshot>(snapshot)) {
     if (!node) {
       throw std::runtime_error(
           "Station::Station(): input node = nullptr.\n");
@@ -152,9 +192,14 @@ public:
   Station(const Snapshot& snapshot,
           const boost::shared_ptr<const WaypointLattice>& waypoint_lattice,
           const boost::shared_ptr<utils::FastWaypointMap>& fast_map) :
+    Station(boost::make_shared<const Snapshot>(snapshot), waypoint_lattice, fast_map) {}
+
+  Station(const boost::shared_ptr<const Snapshot>& snapshot,
+          const boost::shared_ptr<const WaypointLattice>& waypoint_lattice,
+          const boost::shared_ptr<utils::FastWaypointMap>& fast_map) :
     snapshot_(snapshot) {
     boost::shared_ptr<const WaypointNode> node = waypoint_lattice->closestNode(
-        fast_map->waypoint(snapshot.ego().transform().location),
+        fast_map->waypoint(snapshot->ego().transform().location),
         waypoint_lattice->longitudinalResolution());
     if (!node) {
       std::string error_msg(
@@ -162,7 +207,7 @@ public:
           "cannot find a node on the waypoint lattice corresponding to the ego location.\n");
       throw std::runtime_error(
           error_msg +
-          snapshot.string("snapshot: \n") +
+          snapshot->string("snapshot: \n") +
           waypoint_lattice->string("waypoint lattice: \n"));
     }
     node_ = node;
@@ -181,9 +226,12 @@ public:
     return node_.lock()->id();
   }
 
-  const CarlaTransform transform() const { return snapshot_.ego().transform(); }
+  const CarlaTransform transform() const { return snapshot_->ego().transform(); }
 
-  const Snapshot& snapshot() const { return snapshot_; }
+  const Snapshot& snapshot() const { return *snapshot_; }
+
+  /// Get the shared snapshot of the station.
+  const boost::shared_ptr<const Snapshot>& sharedSnapshot() const { return snapshot_; }
 
   const double costToCome() const {
     if (!optimal_parent_) {
@@ -223,24 +271,24 @@ public:
 
   /// Update a parent station.
   /// The \c optimal_parent_ station will be updated if necessary.
-  void updateLeftParent(const Snapshot& snapshot,
+  void updateLeftParent(const boost::shared_ptr<const Snapshot>& snapshot,
                         const double cost_to_come,
                         const boost::shared_ptr<Station>& parent_station);
-  void updateBackParent(const Snapshot& snapshot,
+  void updateBackParent(const boost::shared_ptr<const Snapshot>& snapshot,
                         const double cost_to_come,
                         const boost::shared_ptr<Station>& parent_station);
-  void updateRightParent(const Snapshot& snapshot,
+  void updateRightParent(const boost::shared_ptr<const Snapshot>& snapshot,
                          const double cost_to_come,
                          const boost::shared_ptr<Station>& parent_station);
 
   /// Update a child station.
-  void updateLeftChild(const ContinuousPath& path,
+  void updateLeftChild(const EdgePath& path,
                        const double stage_cost,
                        const boost::shared_ptr<Station>& child_station);
-  void updateFrontChild(const ContinuousPath& path,
+  void updateFrontChild(const EdgePath& path,
                         const double stage_cost,
                         const boost::shared_ptr<Station>& child_station);
-  void updateRightChild(const ContinuousPath& path,
+  void updateRightChild(const EdgePath& path,
                         const double stage_cost,
                         const boost::shared_ptr<Station>& child_station);
 
@@ -283,15 +331,45 @@ protected:
   /// by the spatial horizion, and traffic scenario.
   double spatial_horizon_;
 
+  /// Selects the lengths of the edges leaving the stations.
+  EdgeLengthPolicy edge_length_policy_;
+
+  /// The maximum number of stations to be expanded in a planning cycle.
+  /// Stations left in the queue are treated as terminals. Zero means unlimited.
+  size_t max_expansions_ = 0;
+
+  /// Whether the waypoint lattice is constructed lazily, i.e. its nodes
+  /// are only created once the stations reach them.
+  bool lazy_lattice_ = false;
+
+  /// Whether the keep lane and lane change edges are \c FrenetPath
+  /// instead of \c ContinuousPath.
+  bool frenet_edges_ = false;
+
+  /// Construction time of the waypoint lattice at the start of the last
+  /// planning cycle, see \c latticeConstructionTime().
+  double lattice_construction_mark_ = 0.0;
+
+  /// The number of stations expanded in the last planning cycle.
+  size_t expansions_ = 0;
+
   /// The router to be used.
   boost::shared_ptr<router::Router> router_ = nullptr;
 
+  /// Driver models of the agents in the traffic simulation, the default
+  /// intelligent driver model is used for all agents if not set.
+  boost::shared_ptr<const DriverModelTable> agent_models_ = nullptr;
+
   /// The waypoint lattice used to find nodes for stations.
   boost::shared_ptr<WaypointLattice> waypoint_lattice_ = nullptr;
 
   /// Stores all the constructed stations indexed by the corresponding node
   /// ID on the waypoint lattice.
-  std::unordered_map<size_t, boost::shared_ptr<Station>> node_to_station_table_;
+  utils::FlatHashMap<size_t, boost::shared_ptr<Station>> node_to_station_table_;
+
+  /// Bin sizes of the snapshot signatures, which determines how different
+  /// two snapshots at the same station can be while still being shared.
+  SnapshotSignature::Resolution signature_resolution_;
 
   /**
    * \brief The root station in the station graph.
@@ -309,6 +387,36 @@ protected:
    */
   boost::weak_ptr<Station> cached_next_station_;
 
+  /// The stations on the optimal path selected in the last planning cycle,
+  /// starting from the root station.
+  std::list<boost::weak_ptr<Station>> optimal_station_sequence_;
+
+  /// The manoeuvre the ego committed to in the previous planning cycles.
+  PlanCommitment commitment_;
+
+  /// Whether a committed lane change is abandoned in the last planning cycle.
+  bool manoeuvre_abandoned_ = false;
+
+  /// The node at the end of the committed lane change, if the ego is executing it.
+  boost::optional<size_t> committed_next_node_ = boost::none;
+
+  /// An edge on the path selected in the last planning cycle.
+  struct CommittedEdge {
+    /// ID of the node the edge starts from.
+    size_t start;
+    /// Signature of the snapshot at the start of the edge.
+    SnapshotSignature signature;
+    /// Stage cost of the edge.
+    double stage_cost;
+    /// Simulated snapshot at the end of the edge.
+    boost::shared_ptr<const Snapshot> snapshot;
+  };
+
+  /// The edges on the committed path indexed by the ID of the node they end
+  /// at, which are reused instead of simulated again if the traffic at the
+  /// start of the edge has not changed (see \c SnapshotSignature).
+  utils::FlatHashMap<size_t, CommittedEdge> committed_edges_;
+
 public:
 
   /// Constructor of the class.
@@ -341,16 +449,87 @@ public:
   /// Get the router used by the planner.
   boost::shared_ptr<const router::Router> router() const { return router_; }
 
+  /// Get the bin sizes of the snapshot signatures.
+  const SnapshotSignature::Resolution& signatureResolution() const {
+    return signature_resolution_;
+  }
+  SnapshotSignature::Resolution& signatureResolution() { return signature_resolution_; }
+
+  /// Get or set the policy selecting the lengths of the edges.
+  const EdgeLengthPolicy& edgeLengthPolicy() const { return edge_length_policy_; }
+  EdgeLengthPolicy& edgeLengthPolicy() { return edge_length_policy_; }
+
+  /// Get or set the maximum number of stations expanded in a planning cycle.
+  const size_t maxExpansions() const { return max_expansions_; }
+  size_t& maxExpansions() { return max_expansions_; }
+
+  /// Get or set whether the waypoint lattice is constructed lazily.
+  /// This only takes effect when the waypoint lattice is created.
+  const bool lazyLattice() const { return lazy_lattice_; }
+  bool& lazyLattice() { return lazy_lattice_; }
+
+  /**
+   * \brief Get or set whether the edges are \c FrenetPath.
+   *
+   * A \c FrenetPath edge is a quintic lateral offset profile over the lane
+   * center of the target node, which is solved in closed form instead of
+   * being optimized as a \c ContinuousPath. This suits the parallel lanes
+   * of the highway. An edge falls back to \c ContinuousPath if the start
+   * of the ego cannot be represented w.r.t. the lane center.
+   */
+  const bool frenetEdges() const { return frenet_edges_; }
+  bool& frenetEdges() { return frenet_edges_; }
+
+  /// Get the wall time (s) spent on constructing the waypoint lattice in the
+  /// last planning cycle, which is part of the planning time.
+  const double latticeConstructionTime() const {
+    if (!waypoint_lattice_) return 0.0;
+    return waypoint_lattice_->constructionTime() - lattice_construction_mark_;
+  }
+
+  /// Get the number of stations expanded in the last planning cycle.
+  const size_t expansions() const { return expansions_; }
+
+  /// Get or set the driver models of the agents in the traffic simulation.
+  const boost::shared_ptr<const DriverModelTable>& agentModels() const { return agent_models_; }
+  boost::shared_ptr<const DriverModelTable>& agentModels() { return agent_models_; }
+
+  /// Get or set the commitment to the manoeuvre selected in the last planning cycle.
+  const PlanCommitment& planCommitment() const { return commitment_; }
+  PlanCommitment& planCommitment() { return commitment_; }
+
+  /// Whether a committed lane change is abandoned in the last planning cycle.
+  const bool manoeuvreAbandoned() const { return manoeuvre_abandoned_; }
+
+  /// Get the stations on the optimal path selected in the last planning
+  /// cycle, starting from the root station.
+  std::vector<boost::shared_ptr<const Station>> optimalStations() const;
+
   /// Get the nodes on the lattice, corresponding to the stations.
   std::vector<boost::shared_ptr<const WaypointNode>> nodes() const;
 
   /// Get the edges on the lattice, corresponding to the paths.
-  std::vector<ContinuousPath> edges() const;
+  std::vector<EdgePath> edges() const;
 
   virtual DiscretePath planPath(const size_t ego, const Snapshot& snapshot) override;
 
 protected:
 
+  /// The maximum duration to simulate the traffic along an edge, which
+  /// grows for edges longer than 50m.
+  const double maxSimulationTime(const double length) const {
+    return std::max(5.0, length/10.0);
+  }
+
+  /**
+   * \brief Select the length of an edge leaving the station.
+   * \param[in] station The station the edge starts from.
+   * \param[in] front The vehicle in front of the ego on the target lane, if any.
+   */
+  virtual const double edgeLength(
+      const boost::shared_ptr<Station>& station,
+      const boost::optional<std::pair<size_t, double>>& front) const;
+
   /// Check if the any of the child stations has been reached.
   bool immediateNextStationReached(const Snapshot& snapshot) const;
 
@@ -363,6 +542,54 @@ protected:
   /// Construct the station graph.
   void constructStationGraph(std::deque<boost::shared_ptr<Station>>& station_queue);
 
+  /**
+   * \brief Find the child station reached with the simulated snapshot.
+   *
+   * The existing station at the reached node is returned if there is one,
+   * otherwise a new station is created. If the simulated snapshot has the
+   * same signature as the snapshot of the existing station, the snapshot of
+   * the existing station is returned in \c shared_snapshot to be reused,
+   * instead of keeping another near-duplicate copy.
+   *
+   * \param[in] snapshot The snapshot at the end of the simulation.
+   * \param[out] shared_snapshot The snapshot to be stored with the new parent.
+   * \return The child station.
+   */
+  virtual boost::shared_ptr<Station> childStation(
+      const Snapshot& snapshot,
+      boost::shared_ptr<const Snapshot>& shared_snapshot) const;
+
+  /// Check if the ego is allowed to change lane from the station to the target node.
+  virtual const bool laneChangeAdmissible(
+      const boost::shared_ptr<Station>& station,
+      const boost::shared_ptr<const WaypointNode>& target_node) const { return true; }
+
+  /**
+   * \brief Simulate the traffic with the ego following the path from the
+   *        station to the target node.
+   *
+   * If the edge is on the committed path and the snapshot at the station has
+   * the same signature as the one in the last planning cycle, the simulated
+   * snapshot and stage cost of the committed edge are reused.
+   *
+   * \param[out] stage_cost The stage cost of the edge.
+   * \return The snapshot at the end of the edge, \c nullptr if the ego collides.
+   */
+  virtual boost::shared_ptr<const Snapshot> simulateEdge(
+      const boost::shared_ptr<Station>& station,
+      const boost::shared_ptr<const WaypointNode>& target_node,
+      const VehiclePath& path,
+      double& stage_cost) const;
+
+  /**
+   * \brief Create the path of the edge from the station to the target node.
+   * \return \c nullptr if the path cannot be created.
+   */
+  boost::shared_ptr<const EdgePath> edgePath(
+      const boost::shared_ptr<Station>& station,
+      const boost::shared_ptr<const WaypointNode>& target_node,
+      const VehiclePath::LaneChangeType lane_change_type) const;
+
   boost::shared_ptr<Station> connectStationToFrontNode(
       const boost::shared_ptr<Station>& station,
       const boost::shared_ptr<const WaypointNode>& target_node);
@@ -380,15 +607,30 @@ protected:
   const double terminalDistanceCost(const boost::shared_ptr<Station>& station) const;
 
   /// Compute the cost from root to this terminal, including the terminal costs.
-  const double costFromRootToTerminal(const boost::shared_ptr<Station>& terminal) const;
+  virtual const double costFromRootToTerminal(const boost::shared_ptr<Station>& terminal) const;
+
+  /// The manoeuvre of the optimal path from the root to the station, i.e.
+  /// the first lane change on the path, or keeping the lane if there is none.
+  const PlanCommitment::Manoeuvre manoeuvre(const boost::shared_ptr<Station>& station) const;
+
+  /// Check if the optimal path from the root to the station follows the committed manoeuvre.
+  const bool followsCommitment(const boost::shared_ptr<Station>& station) const;
 
-  /// Select the optimal path sequence based on the constructed station graph.
+  /**
+   * \brief Select the optimal path sequence based on the constructed station graph.
+   *
+   * The best path following the committed manoeuvre is selected instead of the
+   * optimal one if their costs are within the hysteresis of \c commitment_.
+   */
   void selectOptimalPath(
-      std::list<ContinuousPath>& path_sequence,
+      std::list<EdgePath>& path_sequence,
       std::list<boost::weak_ptr<Station>>& station_sequence) const;
 
   /// Merge the path segements from \c selectOptimalPath() into a single discrete path.
-  DiscretePath mergePaths(const std::list<ContinuousPath>& paths) const;
+  DiscretePath mergePaths(const std::list<EdgePath>& paths) const;
+
+  /// Commit to the path selected in this planning cycle.
+  void commitOptimalPath(const std::list<EdgePath>& path_sequence);
 
 }; // End class IDMLatticePlanner.
 
@@ -14,12 +14,16 @@
 
 #pragma once
 
+#include <cmath>
+#include <vector>
 #include <boost/core/noncopyable.hpp>
 #include <planner/common/waypoint_lattice.h>
 #include <planner/common/vehicle_path.h>
 #include <planner/common/vehicle_path_planner.h>
 #include <planner/common/utils.h>
+#include <planner/common/flat_hash_map.h>
 #include <router/common/router.h>
+#include <router/common/waypoint_cache.h>
 
 namespace planner {
 namespace lane_follower {
@@ -47,6 +51,42 @@ protected:
 
   boost::shared_ptr<router::Router> router_ = nullptr;
 
+  /// The transform and curvature of a lattice node. The node expires once
+  /// it is removed from the lattice, e.g. when the lattice is shifted.
+  struct NodeSample {
+    boost::weak_ptr<const WaypointNode> node;
+    std::pair<CarlaTransform, double> sample;
+  };
+
+  /**
+   * Cached transforms and curvatures of the lattice nodes, indexed by node ID.
+   *
+   * The lane center polylines are assembled from these samples. Vehicles on
+   * the same lane share the samples, so that each waypoint transform and
+   * curvature is only queried from carla once. The samples of the nodes
+   * removed from the lattice are evicted in \c shiftWaypointLattice().
+   */
+  utils::FlatHashMap<size_t, NodeSample> node_sample_table_;
+
+  /// The lattice the samples in \c node_sample_table_ are taken from.
+  boost::weak_ptr<const WaypointLattice> sampled_lattice_;
+
+  /// The range of the generated path.
+  static constexpr double kPathRange_ = 50.0;
+
+  /// The maximum lateral offset (m) for a vehicle to be aligned with the lane.
+  static constexpr double kAlignedOffsetTolerance_ = 0.3;
+
+  /// The maximum heading difference (deg) for a vehicle to be aligned with the lane.
+  static constexpr double kAlignedYawTolerance_ = 5.0;
+
+  /// The distance over which the lateral offset of the vehicle is removed.
+  static constexpr double kOffsetDecayRange_ = 10.0;
+
+  /// The spacing of the samples within \c kOffsetDecayRange_, which is the
+  /// longitudinal resolution of the lattices used by the lattice planners.
+  static constexpr double kOffsetDecaySpacing_ = 1.0;
+
 public:
 
   /**
@@ -74,10 +114,68 @@ public:
   }
 
   /// Get or set the waypoint lattice maintained in the object.
+  /// The lattice should be shifted with \c shiftWaypointLattice().
   boost::shared_ptr<WaypointLattice>& waypointLattice() {
     return waypoint_lattice_;
   }
 
+  /**
+   * \brief Shift the waypoint lattice forward, and evict the cached samples
+   *        of the nodes which are removed from the lattice.
+   * \param[in] movement How much distance to shift the lattice forward.
+   */
+  void shiftWaypointLattice(const double movement) {
+    if (!waypoint_lattice_) {
+      throw std::runtime_error(
+          "LaneFollower::shiftWaypointLattice(): the waypoint lattice is not set yet.\n");
+    }
+    waypoint_lattice_->shift(movement);
+
+    std::vector<size_t> expired_nodes;
+    for (const auto& item : node_sample_table_) {
+      if (item.second.node.expired()) expired_nodes.push_back(item.first);
+    }
+    for (const size_t id : expired_nodes) node_sample_table_.erase(id);
+    return;
+  }
+
+  /**
+   * \brief Keep the waypoint lattice starting right behind the given waypoint,
+   *        so that the lattice and the cached samples are reused across cycles.
+   *
+   * The lattice is shifted forward with \c shiftWaypointLattice() as the
+   * start waypoint moves, and extended if it does not cover the given range
+   * ahead of the start waypoint.
+   * A new lattice is created if the start waypoint is not on the lattice,
+   * e.g. the vehicle has changed to a lane not covered by the lattice.
+   *
+   * \param[in] start The waypoint the lattice should start from.
+   * \param[in] range The minimum range of the lattice ahead of the start waypoint.
+   */
+  void updateWaypointLattice(
+      const boost::shared_ptr<const CarlaWaypoint>& start,
+      const double range) {
+
+    boost::shared_ptr<const WaypointNode> start_node = nullptr;
+    if (waypoint_lattice_) {
+      const WaypointLattice& lattice = *waypoint_lattice_;
+      start_node = lattice.closestNode(start, lattice.longitudinalResolution());
+    }
+
+    if (!start_node) {
+      waypoint_lattice_ = boost::make_shared<WaypointLattice>(start, range, 5.0, router_);
+      return;
+    }
+
+    // One node is kept behind the start waypoint.
+    const double resolution = waypoint_lattice_->longitudinalResolution();
+    const double movement = start_node->distance() - resolution;
+    if (movement > 0.0) shiftWaypointLattice(movement);
+    if (waypoint_lattice_->range() < range+resolution)
+      waypoint_lattice_->extend(range+resolution);
+    return;
+  }
+
   virtual DiscretePath planPath(const size_t target, const Snapshot& snapshot) override {
 
     // Get the target vehicle and its waypoint.
@@ -91,9 +189,237 @@ public:
           "LaneFollower::plan(): the waypoint lattice is not set yet.\n");
     }
 
+    // If the target vehicle is well aligned with the lane, the lane center
+    // polyline is used directly as the path. No path optimization is required.
+    if (isAlignedWithLane(target_vehicle, target_waypoint)) {
+      std::vector<std::pair<CarlaTransform, double>> samples;
+      if (laneCenterPolyline(target_waypoint, kPathRange_, samples)) {
+        correctLateralOffset(target_vehicle, target_waypoint, samples);
+        return DiscretePath(samples, VehiclePath::LaneChangeType::KeepLane);
+      }
+    }
+
+    return optimizedPath(target_vehicle, target_waypoint, snapshot);
+  }
+
+protected:
+
+  /**
+   * \brief Check if the vehicle is aligned with the lane it is on.
+   *
+   * \param[in] vehicle The query vehicle.
+   * \param[in] waypoint The waypoint obtained by projecting the vehicle
+   *                     location to the closest lane.
+   * \return True if both the lateral offset and the heading difference of
+   *         the vehicle w.r.t. the lane center are within tolerance.
+   */
+  bool isAlignedWithLane(
+      const Vehicle& vehicle,
+      const boost::shared_ptr<const CarlaWaypoint>& waypoint) const {
+
+    const double offset = utils::distanceToLaneCenter(
+        vehicle.transform().location, waypoint);
+    const double yaw_diff = utils::shortestAngle(
+        vehicle.transform().rotation.yaw,
+        waypoint->GetTransform().rotation.yaw);
+
+    return std::fabs(offset) <= kAlignedOffsetTolerance_ &&
+           std::fabs(yaw_diff) <= kAlignedYawTolerance_;
+  }
+
+  /**
+   * \brief Collect the lane center polyline ahead of the given waypoint.
+   *
+   * The polyline starts at the given waypoint, and follows the nodes on
+   * the waypoint lattice, whose transforms and curvatures are cached in
+   * \c node_sample_table_ so that they are shared by all the vehicles on
+   * the same lane.
+   *
+   * \param[in] waypoint The start waypoint of the polyline.
+   * \param[in] range The minimum range of the polyline.
+   * \param[out] samples The transforms and curvatures on the polyline.
+   * \return False if the lattice cannot cover the polyline with the given range.
+   */
+  bool laneCenterPolyline(
+      const boost::shared_ptr<const CarlaWaypoint>& waypoint,
+      const double range,
+      std::vector<std::pair<CarlaTransform, double>>& samples) {
+
+    samples.clear();
+
+    // The cached samples are dropped if the lattice is replaced.
+    if (sampled_lattice_.lock() != waypoint_lattice_) {
+      node_sample_table_.clear();
+      sampled_lattice_ = waypoint_lattice_;
+    }
+
+    const WaypointLattice& lattice = *waypoint_lattice_;
+    boost::shared_ptr<const WaypointNode> node = lattice.closestNode(
+        waypoint, lattice.longitudinalResolution());
+    if (!node) return false;
+
+    const CarlaTransform start_transform = waypoint->GetTransform();
+    samples.push_back(std::make_pair(
+          start_transform, utils::curvatureAtWaypoint(waypoint, map_)));
+
+    // The closest node may be behind the start waypoint,
+    // in which case, the polyline starts from the front node.
+    const carla::geom::Vector3D heading = start_transform.GetForwardVector();
+    const carla::geom::Vector3D diff =
+      node->waypoint()->GetTransform().location - start_transform.location;
+    if (diff.x*heading.x + diff.y*heading.y <= 0.0) node = node->front();
+
+    if (!node) return false;
+    const double start_distance = node->distance();
+
+    while (node) {
+      samples.push_back(nodeSample(node));
+      if (node->distance()-start_distance >= range) return true;
+      node = node->front();
+    }
+
+    // The lattice ends before the desired range is reached.
+    return false;
+  }
+
+  /// Get the cached transform and curvature of a node on the lattice.
+  const std::pair<CarlaTransform, double>& nodeSample(
+      const boost::shared_ptr<const WaypointNode>& node) {
+    auto iter = node_sample_table_.find(node->id());
+    if (iter != node_sample_table_.end()) return iter->second.sample;
+
+    NodeSample& node_sample = node_sample_table_[node->id()];
+    node_sample.node = node;
+    node_sample.sample = std::make_pair(
+        node->waypoint()->GetTransform(), node->curvature(map_));
+    return node_sample.sample;
+  }
+
+  /**
+   * \brief Shift the lane center samples laterally so that the path starts
+   *        at where the vehicle is.
+   *
+   * The lane center samples are taken at the lattice nodes, which are too
+   * sparse for the offset decay. The decay region is resampled at
+   * \c kOffsetDecaySpacing_ before the offset is removed.
+   *
+   * \param[in] vehicle The vehicle to plan the path for.
+   * \param[in] waypoint The waypoint obtained by projecting the vehicle
+   *                     location to the closest lane.
+   * \param[in,out] samples The lane center samples to be corrected.
+   */
+  void correctLateralOffset(
+      const Vehicle& vehicle,
+      const boost::shared_ptr<const CarlaWaypoint>& waypoint,
+      std::vector<std::pair<CarlaTransform, double>>& samples) const {
+
+    const double offset = utils::distanceToLaneCenter(
+        vehicle.transform().location, waypoint);
+    if (offset == 0.0) return;
+
+    densifySamples(kOffsetDecayRange_, kOffsetDecaySpacing_, samples);
+    decayLateralOffset(offset, kOffsetDecayRange_, samples);
+    return;
+  }
+
+  /**
+   * \brief Interpolate the samples within the given range from the first
+   *        sample, so that they are at most \c spacing apart.
+   *
+   * The samples beyond the range are left as they are.
+   */
+  static void densifySamples(
+      const double range,
+      const double spacing,
+      std::vector<std::pair<CarlaTransform, double>>& samples) {
+
+    if (samples.size() < 2) return;
+
+    std::vector<std::pair<CarlaTransform, double>> dense_samples;
+    dense_samples.reserve(samples.size() + static_cast<size_t>(std::ceil(range/spacing)));
+    dense_samples.push_back(samples.front());
+
+    double s = 0.0;
+    for (size_t i = 1; i < samples.size(); ++i) {
+      const std::pair<CarlaTransform, double>& start = samples[i-1];
+      const std::pair<CarlaTransform, double>& end = samples[i];
+      const double length = (end.first.location-start.first.location).Length();
+
+      const size_t pieces = s < range ?
+        static_cast<size_t>(std::ceil(length/spacing)) : 1;
+      for (size_t j = 1; j < pieces; ++j) {
+        const double t = static_cast<double>(j) / static_cast<double>(pieces);
+
+        CarlaTransform transform = start.first;
+        transform.location.x += t * (end.first.location.x-start.first.location.x);
+        transform.location.y += t * (end.first.location.y-start.first.location.y);
+        transform.location.z += t * (end.first.location.z-start.first.location.z);
+        transform.rotation.yaw = utils::unrollAngle(
+            start.first.rotation.yaw -
+            t*utils::shortestAngle(start.first.rotation.yaw, end.first.rotation.yaw));
+
+        dense_samples.push_back(std::make_pair(
+              transform, start.second + t*(end.second-start.second)));
+      }
+
+      dense_samples.push_back(end);
+      s += length;
+    }
+
+    samples.swap(dense_samples);
+    return;
+  }
+
+  /**
+   * \brief Shift the samples laterally by the given offset, which decays
+   *        to 0 over \c range with a smoothstep profile.
+   *
+   * The offset is positive towards the right of the samples.
+   */
+  static void decayLateralOffset(
+      const double offset,
+      const double range,
+      std::vector<std::pair<CarlaTransform, double>>& samples) {
+
+    // The distance is measured along the lane center, i.e. before the
+    // samples are shifted.
+    double s = 0.0;
+    carla::geom::Location last_location;
+    for (size_t i = 0; i < samples.size(); ++i) {
+      if (i > 0) s += (samples[i].first.location-last_location).Length();
+      if (s >= range) break;
+      last_location = samples[i].first.location;
+
+      // Smoothstep decay of the lateral offset, and its derivative w.r.t. s.
+      const double r = s / range;
+      const double d = offset * (1.0 - r*r*(3.0-2.0*r));
+      const double dd = offset * (-6.0*r*(1.0-r)) / range;
+
+      CarlaTransform& transform = samples[i].first;
+      const double angle = (transform.rotation.yaw+90.0)/180.0*M_PI;
+      transform.location.x += d * std::cos(angle);
+      transform.location.y += d * std::sin(angle);
+      transform.rotation.yaw = utils::unrollAngle(
+          transform.rotation.yaw + std::atan(dd)/M_PI*180.0);
+    }
+
+    return;
+  }
+
+  /**
+   * \brief Generate the lane following path through path optimization.
+   *
+   * This is used in case the vehicle is not aligned with the lane,
+   * or the lattice does not cover the range ahead of the vehicle.
+   */
+  DiscretePath optimizedPath(
+      const Vehicle& target_vehicle,
+      const boost::shared_ptr<CarlaWaypoint>& target_waypoint,
+      const Snapshot& snapshot) const {
+
     // Find the waypoint 50m ahead of the current postion of the target vehicle.
     const boost::shared_ptr<const WaypointNode> front_node =
-      waypoint_lattice_->front(target_waypoint, 50.0);
+      waypoint_lattice_->front(target_waypoint, kPathRange_);
     boost::shared_ptr<const CarlaWaypoint> front_waypoint = nullptr;
 
     if (!front_node) {
@@ -103,12 +429,12 @@ public:
         std::string error_msg("LaneFollower::plan(): there is no node 50m ahead of ego.\n");
         std::string ego_msg = snapshot.ego().string();
         throw std::runtime_error(error_msg + ego_msg);
-      } else if (front_waypoint = router_->frontWaypoint(target_waypoint, 50.0)) {
+      } else if (front_waypoint = router_->frontWaypoint(target_waypoint, kPathRange_)) {
       } else {
         // If there is no front node for an agent vehicle. We may just find its next
         // accessible waypoint with some distance.
         std::vector<boost::shared_ptr<CarlaWaypoint>> front_waypoints =
-          target_waypoint->GetNext(10.0);
+          router::WaypointCache::instance().next(target_waypoint, 10.0);
 
         if (front_waypoints.size() <= 0) {
           std::string error_msg("LaneFollower::plan(): cannot find next waypoints for an agent.\n");
@@ -13,6 +13,7 @@
 */
 
 #include <set>
+#include <cmath>
 #include <list>
 #include <planner/common/utils.h>
 #include <planner/slc_lattice_planner/slc_lattice_planner.h>
@@ -32,10 +33,10 @@ const double SLCTrafficSimulator::egoAcceleration() const {
 
   double accel = 0.0;
   boost::optional<std::pair<size_t, double>> lead =
-    snapshot_.trafficLattice()->front(snapshot_.ego().id());
+    snapshot_.trafficLattice()->frontAt(0);
 
   if (lead) {
-    const double lead_speed = snapshot_.vehicle(lead->first).speed();
+    const double lead_speed = snapshot_.vehicles().speeds()[lead->first];
     const double following_distance = lead->second;
     accel = idm_->idm(snapshot_.ego().speed(),
                       snapshot_.ego().policySpeed(),
@@ -49,23 +50,30 @@ const double SLCTrafficSimulator::egoAcceleration() const {
   return accel;
 }
 
-const double SLCTrafficSimulator::agentAcceleration(const size_t agent) const {
+const double SLCTrafficSimulator::agentAcceleration(const size_t index) const {
+
+  const ConstVehicleView agent = snapshot_.vehicles().view(index);
 
   // We assume all agent vehicles are lane followers for now.
+  // The driver model of an agent depends on its vehicle class.
+  boost::shared_ptr<const IntelligentDriverModel> idm = idm_;
+  if (agent_models_)
+    idm = agent_models_->model(2.0*agent.boundingBox().extent.x);
+
   double accel = 0.0;
   boost::optional<std::pair<size_t, double>> lead =
-    snapshot_.trafficLattice()->front(agent);
+    snapshot_.trafficLattice()->frontAt(index);
 
   if (lead) {
-    const double lead_speed = snapshot_.vehicle(lead->first).speed();
+    const double lead_speed = snapshot_.vehicles().speeds()[lead->first];
     const double following_distance = lead->second;
-    accel = idm_->idm(snapshot_.vehicle(agent).speed(),
-                      snapshot_.vehicle(agent).policySpeed(),
-                      lead_speed,
-                      following_distance);
+    accel = idm->idm(agent.speed(),
+                     agent.policySpeed(),
+                     lead_speed,
+                     following_distance);
   } else {
-    accel = idm_->idm(snapshot_.vehicle(agent).speed(),
-                      snapshot_.vehicle(agent).policySpeed());
+    accel = idm->idm(agent.speed(),
+                     agent.policySpeed());
   }
 
   return accel;
@@ -256,7 +264,19 @@ DiscretePath SLCLatticePlanner::planPath(
     throw std::runtime_error(error_msg + id_msg);
   }
 
-  // Update the waypoint lattice.
+  // Update the commitment before the vertex graph of the last planning
+  // cycle is pruned, and the waypoint lattice is shifted.
+  committed_next_node_ = boost::none;
+  if (cached_next_vertex_.lock()) {
+    if (immediateNextVertexReached(snapshot)) commitment_.reached();
+    else if (commitment_.executing())
+      committed_next_node_ = cached_next_vertex_.lock()->node().lock()->id();
+  }
+
+  // Update the waypoint lattice. The construction time of the lattice
+  // in this planning cycle is counted from here.
+  lattice_construction_mark_ =
+    waypoint_lattice_ ? waypoint_lattice_->constructionTime() : 0.0;
   updateWaypointLattice(snapshot);
 
   // Prune the vertex graph from the last planning step.
@@ -286,6 +306,10 @@ DiscretePath SLCLatticePlanner::planPath(
   std::list<ContinuousPath> optimal_path_seq;
   std::list<boost::weak_ptr<Vertex>> optimal_vertex_seq;
   selectOptimalPath(optimal_path_seq, optimal_vertex_seq);
+  optimal_cost_ = costFromRootToTerminal(optimal_vertex_seq.back().lock());
+
+  // Commit to the selected path.
+  commitOptimalPath(optimal_path_seq, optimal_vertex_seq);
 
   // Merge the path sequence into one discrete path.
   DiscretePath optimal_path = mergePaths(optimal_path_seq);
@@ -331,7 +355,13 @@ void SLCLatticePlanner::updateWaypointLattice(const Snapshot& snapshot) {
     boost::shared_ptr<CarlaWaypoint> ego_waypoint =
       fast_map_->waypoint(snapshot.ego().transform().location);
     waypoint_lattice_ = boost::make_shared<WaypointLattice>(
-        ego_waypoint, spatial_horizon_+30.0, 1.0, router_);
+        ego_waypoint, spatial_horizon_+30.0, 1.0, router_, lazy_lattice_);
+
+    // Vertices are at least the shortest edge length apart on each lane of the lattice.
+    // The table is sized by the horizon, since a lazy lattice only covers its start here.
+    const size_t lanes = waypoint_lattice_->latticeEntries().size();
+    node_to_vertices_table_.reserve(lanes * static_cast<size_t>(
+          waypoint_lattice_->horizon()/edge_length_policy_.shortest()) + 1);
     return;
   }
 
@@ -365,12 +395,12 @@ std::deque<boost::shared_ptr<Vertex>>
   // 1) This is the first time the \c plan() interface is called.
   // 2) The ego reached one of the immediate child of the root vertex.
   if ((!root_.lock()) || immediateNextVertexReached(snapshot)) {
-    all_vertices_.clear();
+    clearVertexGraph();
 
     // Initialize the new root vertex.
     boost::shared_ptr<Vertex> root =
       boost::make_shared<Vertex>(snapshot, waypoint_lattice_, fast_map_);
-    all_vertices_.push_back(root);
+    registerVertex(root);
     root_ = root;
 
     vertex_queue.push_back(root);
@@ -401,7 +431,7 @@ std::deque<boost::shared_ptr<Vertex>>
 
   // Clear all old vertices.
   // We are good with the previously created nodes. All vertices will be newly created.
-  all_vertices_.clear();
+  clearVertexGraph();
 
   // Try to connect the new root with above nodes.
   boost::shared_ptr<Vertex> front_vertex =
@@ -413,24 +443,21 @@ std::deque<boost::shared_ptr<Vertex>>
 
   // Save the new root to the graph.
   root_ = new_root;
-  all_vertices_.push_back(new_root);
+  registerVertex(new_root);
 
   // Save the newly created vertices to the graph and queue
   // if they are successfully created.
-  if (front_vertex) {
-    all_vertices_.push_back(front_vertex);
+  if (front_vertex && registerVertex(front_vertex)) {
     if (front_vertex->node().lock()->id() == front_node->id())
       vertex_queue.push_back(front_vertex);
   }
 
-  if (left_front_vertex) {
-    all_vertices_.push_back(left_front_vertex);
+  if (left_front_vertex && registerVertex(left_front_vertex)) {
     if (left_front_vertex->node().lock()->id() == left_front_node->id())
       vertex_queue.push_back(left_front_vertex);
   }
 
-  if (right_front_vertex) {
-    all_vertices_.push_back(right_front_vertex);
+  if (right_front_vertex && registerVertex(right_front_vertex)) {
     if (right_front_vertex->node().lock()->id() == right_front_node->id())
       vertex_queue.push_back(right_front_vertex);
   }
@@ -448,18 +475,33 @@ void SLCLatticePlanner::constructVertexGraph(
       const boost::shared_ptr<const WaypointNode>& node)->void{
     if ((!vertex) || (!node)) return;
 
-    all_vertices_.push_back(vertex);
+    // The vertex may have been merged into an existing one, which is
+    // already in the graph and queue.
+    if (!registerVertex(vertex)) return;
     if (vertex->node().lock()->id() == node->id())
       vertex_queue.push_back(vertex);
   };
 
+  expansions_ = 0;
+
   while (!vertex_queue.empty()) {
+    // Stop expanding once the expansion budget is used up. The vertices
+    // left in the queue become terminals.
+    if (max_expansions_ > 0 && expansions_ >= max_expansions_) break;
+
     boost::shared_ptr<Vertex> vertex = vertex_queue.front();
     vertex_queue.pop_front();
+    ++expansions_;
+
+    const size_t ego = vertex->snapshot().ego().id();
+    const boost::shared_ptr<const TrafficLattice> traffic_lattice =
+      vertex->snapshot().trafficLattice();
 
     // Try to connect to the front node.
     boost::shared_ptr<const WaypointNode> front_node =
-      waypoint_lattice_->front(vertex->node().lock()->waypoint(), 50.0);
+      waypoint_lattice_->front(
+          vertex->node().lock()->waypoint(),
+          edgeLength(vertex, traffic_lattice->front(ego)));
     boost::shared_ptr<Vertex> front_vertex =
       connectVertexToFrontNode(vertex, front_node);
 
@@ -471,7 +513,9 @@ void SLCLatticePlanner::constructVertexGraph(
 
     // Try to connect to the left front node.
     boost::shared_ptr<const WaypointNode> left_front_node =
-      waypoint_lattice_->frontLeft(vertex->node().lock()->waypoint(), 50.0);
+      waypoint_lattice_->frontLeft(
+          vertex->node().lock()->waypoint(),
+          edgeLength(vertex, traffic_lattice->leftFront(ego)));
     boost::shared_ptr<Vertex> left_front_vertex =
       connectVertexToLeftFrontNode(vertex, left_front_node);
 
@@ -479,7 +523,9 @@ void SLCLatticePlanner::constructVertexGraph(
 
     // Try to connect to the right front node.
     boost::shared_ptr<const WaypointNode> right_front_node =
-      waypoint_lattice_->frontRight(vertex->node().lock()->waypoint(), 50.0);
+      waypoint_lattice_->frontRight(
+          vertex->node().lock()->waypoint(),
+          edgeLength(vertex, traffic_lattice->rightFront(ego)));
     boost::shared_ptr<Vertex> right_front_vertex =
       connectVertexToRightFrontNode(vertex, right_front_node);
 
@@ -489,6 +535,105 @@ void SLCLatticePlanner::constructVertexGraph(
   return;
 }
 
+const double SLCLatticePlanner::edgeLength(
+    const boost::shared_ptr<Vertex>& vertex,
+    const boost::optional<std::pair<size_t, double>>& front) const {
+
+  const double distance = vertex->node().lock()->distance() -
+                          root_.lock()->node().lock()->distance();
+  boost::optional<double> gap = boost::none;
+  if (front) gap = front->second;
+
+  return edge_length_policy_.length(distance, vertex->snapshot().ego().speed(), gap);
+}
+
+void SLCLatticePlanner::clearVertexGraph() {
+  all_vertices_.clear();
+  node_to_vertices_table_.clear();
+  return;
+}
+
+bool SLCLatticePlanner::registerVertex(const boost::shared_ptr<Vertex>& vertex) {
+
+  std::vector<std::pair<SnapshotSignature, boost::shared_ptr<Vertex>>>& vertices =
+    node_to_vertices_table_[vertex->node().lock()->id()];
+
+  for (const auto& item : vertices) {
+    if (item.second == vertex) return false;
+  }
+
+  vertices.emplace_back(SnapshotSignature(vertex->snapshot(), signature_resolution_), vertex);
+  all_vertices_.push_back(vertex);
+  return true;
+}
+
+boost::shared_ptr<Vertex> SLCLatticePlanner::childVertex(
+    const boost::shared_ptr<Vertex>& vertex,
+    const Snapshot& snapshot,
+    const double stage_cost) {
+
+  boost::shared_ptr<Vertex> child_vertex =
+    boost::make_shared<Vertex>(snapshot, waypoint_lattice_, fast_map_);
+  const double cost_to_come = vertex->costToCome() + stage_cost;
+
+  // Look for a near-duplicate vertex at the same node. Only the vertices
+  // that have not been expanded are considered, since the children of an
+  // expanded vertex are simulated from its current snapshot.
+  utils::FlatHashMap<size_t,
+    std::vector<std::pair<SnapshotSignature, boost::shared_ptr<Vertex>>>>::const_iterator
+      iter = node_to_vertices_table_.find(child_vertex->node().lock()->id());
+
+  if (state_merging_ && iter != node_to_vertices_table_.end()) {
+    const SnapshotSignature signature(snapshot, signature_resolution_);
+    for (const auto& item : iter->second) {
+      if (item.second->hasChild() || item.first != signature) continue;
+      if (std::fabs(cost_to_come-item.second->costToCome()) >
+          merge_cost_tolerance_*std::fabs(item.second->costToCome())) continue;
+      // Keep the parent with the lower cost-to-come.
+      if (cost_to_come < item.second->costToCome())
+        item.second->updateParent(snapshot, cost_to_come, vertex);
+      return item.second;
+    }
+  }
+
+  child_vertex->updateParent(snapshot, cost_to_come, vertex);
+  return child_vertex;
+}
+
+boost::shared_ptr<const Snapshot> SLCLatticePlanner::simulateEdge(
+    const boost::shared_ptr<Vertex>& vertex,
+    const boost::shared_ptr<const WaypointNode>& target_node,
+    const ContinuousPath& path,
+    double& stage_cost) const {
+
+  // Reuse the committed edge if the traffic at its start has not changed.
+  utils::FlatHashMap<size_t, CommittedEdge>::const_iterator iter =
+    committed_edges_.find(target_node->id());
+  if (iter != committed_edges_.end() &&
+      iter->second.start == vertex->node().lock()->id() &&
+      iter->second.signature == SnapshotSignature(vertex->snapshot(), signature_resolution_)) {
+    stage_cost = iter->second.stage_cost;
+    return iter->second.snapshot;
+  }
+
+  SLCTrafficSimulator simulator(vertex->snapshot(), map_, fast_map_);
+  simulator.agentModels() = agent_models_;
+  double simulation_time = 0.0;
+  try {
+    const bool no_collision = simulator.simulate(
+        path, sim_time_step_,
+        maxSimulationTime(target_node->distance()-vertex->node().lock()->distance()),
+        simulation_time, stage_cost);
+    if (!no_collision) return nullptr;
+  } catch(std::exception& e) {
+    std::printf("SLCLatticePlanner::simulateEdge(): WARNING\n"
+                "%s", e.what());
+    return nullptr;
+  }
+
+  return boost::make_shared<const Snapshot>(simulator.snapshot());
+}
+
 boost::shared_ptr<Vertex> SLCLatticePlanner::connectVertexToFrontNode(
     const boost::shared_ptr<Vertex>& vertex,
     const boost::shared_ptr<const WaypointNode>& target_node) {
@@ -517,33 +662,21 @@ boost::shared_ptr<Vertex> SLCLatticePlanner::connectVertexToFrontNode(
 
   // Now, simulate the traffic forward with ego following the created path.
   //std::printf("Simulate the traffic.\n");
-  SLCTrafficSimulator simulator(vertex->snapshot(), map_, fast_map_);
-  double simulation_time = 0.0; double stage_cost = 0.0;
-  try {
-    const bool no_collision = simulator.simulate(
-        *path, sim_time_step_, 5.0, simulation_time, stage_cost);
-    // There a collision is detected in the simulation, this option is ignored.
-    if (!no_collision) return nullptr;
-  } catch(std::exception& e) {
-    std::printf("SLCLatticePlanner::connectVertexToFrontNode(): WARNING\n"
-                "%s", e.what());
-    return nullptr;
-  }
+  double stage_cost = 0.0;
+  boost::shared_ptr<const Snapshot> simulated_snapshot =
+    simulateEdge(vertex, target_node, *path, stage_cost);
+  // There a collision is detected in the simulation, this option is ignored.
+  if (!simulated_snapshot) return nullptr;
 
-  // A new vertex should be created.
+  // Either create a new vertex or merge into an equivalent one.
   //std::printf("Create child vertex.\n");
-  boost::shared_ptr<Vertex> next_vertex = boost::make_shared<Vertex>(
-      simulator.snapshot(), waypoint_lattice_, fast_map_);
+  boost::shared_ptr<Vertex> next_vertex =
+    childVertex(vertex, *simulated_snapshot, stage_cost);
 
   // Set the child vertex of the parent vertex.
   //std::printf("Update the child vertex of the input vertex.\n");
   vertex->updateFrontChild(*path, stage_cost, next_vertex);
 
-  // Set the parent vertex of the child vertex.
-  //std::printf("Update the parent vertex of the new vertex.\n");
-  next_vertex->updateParent(
-      simulator.snapshot(), vertex->costToCome()+stage_cost, vertex);
-
   return next_vertex;
 }
 
@@ -602,33 +735,21 @@ boost::shared_ptr<Vertex> SLCLatticePlanner::connectVertexToLeftFrontNode(
 
   // Now, simulate the traffic forward with ego following the created path.
   //std::printf("Simulate the traffic.\n");
-  SLCTrafficSimulator simulator(vertex->snapshot(), map_, fast_map_);
-  double simulation_time = 0.0; double stage_cost = 0.0;
-  try {
-    const bool no_collision = simulator.simulate(
-        *path, sim_time_step_, 5.0, simulation_time, stage_cost);
-    // There a collision is detected in the simulation, this option is ignored.
-    if (!no_collision) return nullptr;
-  } catch (std::exception& e) {
-    std::printf("SLCLatticePlanner::connectVertexToLeftFrontNode(): WARNING\n"
-                "%s", e.what());
-    return nullptr;
-  }
+  double stage_cost = 0.0;
+  boost::shared_ptr<const Snapshot> simulated_snapshot =
+    simulateEdge(vertex, target_node, *path, stage_cost);
+  // There a collision is detected in the simulation, this option is ignored.
+  if (!simulated_snapshot) return nullptr;
 
-  // Create a new vertex.
+  // Either create a new vertex or merge into an equivalent one.
   //std::printf("Create child vertex.\n");
-  boost::shared_ptr<Vertex> next_vertex = boost::make_shared<Vertex>(
-      simulator.snapshot(), waypoint_lattice_, fast_map_);
+  boost::shared_ptr<Vertex> next_vertex =
+    childVertex(vertex, *simulated_snapshot, stage_cost);
 
   // Set the child vertex of the parent vertex.
   //std::printf("Update the child vertex of the input vertex.\n");
   vertex->updateLeftChild(*path, stage_cost, next_vertex);
 
-  // Set the parent vertex of the child vertex.
-  //std::printf("Update the parent vertex of the new vertex.\n");
-  next_vertex->updateParent(
-      simulator.snapshot(), vertex->costToCome()+stage_cost, vertex);
-
   return next_vertex;
 }
 
@@ -687,33 +808,21 @@ boost::shared_ptr<Vertex> SLCLatticePlanner::connectVertexToRightFrontNode(
 
   // Now, simulate the traffic forward with the ego following the created path.
   //std::printf("Simulate the traffic.\n");
-  SLCTrafficSimulator simulator(vertex->snapshot(), map_, fast_map_);
-  double simulation_time = 0.0; double stage_cost = 0.0;
-  try {
-    const bool no_collision = simulator.simulate(
-        *path, sim_time_step_, 5.0, simulation_time, stage_cost);
-    // There a collision is detected in the simulation, this option is ignored.
-    if (!no_collision) return nullptr;
-  } catch (std::exception& e) {
-    std::printf("SLCLatticePlanner::connectVertexToRightFrontNode(): WARNING\n"
-                "%s", e.what());
-    return nullptr;
-  }
+  double stage_cost = 0.0;
+  boost::shared_ptr<const Snapshot> simulated_snapshot =
+    simulateEdge(vertex, target_node, *path, stage_cost);
+  // There a collision is detected in the simulation, this option is ignored.
+  if (!simulated_snapshot) return nullptr;
 
-  // Create a new vertex.
+  // Either create a new vertex or merge into an equivalent one.
   //std::printf("Create child vertex.\n");
-  boost::shared_ptr<Vertex> next_vertex = boost::make_shared<Vertex>(
-      simulator.snapshot(), waypoint_lattice_, fast_map_);
+  boost::shared_ptr<Vertex> next_vertex =
+    childVertex(vertex, *simulated_snapshot, stage_cost);
 
   // Set the child vertex of the parent vertex.
   //std::printf("Update the child vertex of the input vertex.\n");
   vertex->updateRightChild(*path, stage_cost, next_vertex);
 
-  // Set the parent vertex of the child vertex.
-  //std::printf("Update the parent vertex of the new vertex.\n");
-  next_vertex->updateParent(
-      simulator.snapshot(), vertex->costToCome()+stage_cost, vertex);
-
   return next_vertex;
 }
 
@@ -782,7 +891,7 @@ const double SLCLatticePlanner::terminalDistanceCost(
     root_child = std::get<2>(*(root_.lock()->rightChild())).lock();
 
   const double spatial_horizon =
-    spatial_horizon_ - 50.0 +
+    spatial_horizon_ - edge_length_policy_.longest() +
     root_child->node()->distance() -
     root_.lock()->node().lock()->distance();
 
@@ -817,6 +926,52 @@ const double SLCLatticePlanner::costFromRootToTerminal(
   return path_cost + terminal_speed_cost + terminal_distance_cost;
 }
 
+const PlanCommitment::Manoeuvre SLCLatticePlanner::manoeuvre(
+    const boost::shared_ptr<Vertex>& vertex) const {
+
+  // Trace back the parents, so that the first lane change
+  // from the root is the last one found.
+  PlanCommitment::Manoeuvre manoeuvre = PlanCommitment::Manoeuvre::KeepLane;
+  boost::shared_ptr<Vertex> child_vertex = vertex;
+
+  while (child_vertex->hasParent()) {
+    boost::shared_ptr<Vertex> parent_vertex =
+      std::get<2>(*(child_vertex->parent())).lock();
+    if (!parent_vertex) break;
+
+    if (parent_vertex->leftChild() &&
+        std::get<2>(*(parent_vertex->leftChild())).lock() == child_vertex)
+      manoeuvre = PlanCommitment::Manoeuvre::LeftLaneChange;
+    else if (parent_vertex->rightChild() &&
+             std::get<2>(*(parent_vertex->rightChild())).lock() == child_vertex)
+      manoeuvre = PlanCommitment::Manoeuvre::RightLaneChange;
+
+    child_vertex = parent_vertex;
+  }
+
+  return manoeuvre;
+}
+
+const bool SLCLatticePlanner::followsCommitment(
+    const boost::shared_ptr<Vertex>& vertex) const {
+
+  if (!committed_next_node_) return manoeuvre(vertex) == commitment_.committed();
+
+  // While the ego is executing the committed lane change, the path
+  // should still end its first edge at the same node.
+  boost::shared_ptr<Vertex> child_vertex = vertex;
+  while (child_vertex->hasParent()) {
+    boost::shared_ptr<Vertex> parent_vertex =
+      std::get<2>(*(child_vertex->parent())).lock();
+    if (!parent_vertex) return false;
+    if (!parent_vertex->hasParent())
+      return child_vertex->node().lock()->id() == *committed_next_node_;
+    child_vertex = parent_vertex;
+  }
+
+  return false;
+}
+
 void SLCLatticePlanner::selectOptimalPath(
     std::list<ContinuousPath>& path_sequence,
     std::list<boost::weak_ptr<Vertex>>& vertex_sequence) const {
@@ -828,6 +983,10 @@ void SLCLatticePlanner::selectOptimalPath(
   boost::shared_ptr<Vertex> optimal_vertex = nullptr;
   double optimal_cost = 1.0e10;
 
+  // The best terminal vertex following the committed manoeuvre.
+  boost::shared_ptr<Vertex> committed_vertex = nullptr;
+  double committed_cost = 1.0e10;
+
   for (const auto& vertex : all_vertices_) {
     if (vertex->hasChild()) continue;
     const double vertex_cost = costFromRootToTerminal(vertex);
@@ -837,6 +996,19 @@ void SLCLatticePlanner::selectOptimalPath(
       optimal_vertex = vertex;
       optimal_cost = vertex_cost;
     }
+
+    if (commitment_.enabled() && vertex_cost < committed_cost &&
+        followsCommitment(vertex)) {
+      committed_vertex = vertex;
+      committed_cost = vertex_cost;
+    }
+  }
+
+  // Stick to the committed manoeuvre unless the optimal
+  // path is cheaper by more than the hysteresis.
+  if (committed_vertex && commitment_.keep(optimal_cost, committed_cost)) {
+    optimal_vertex = committed_vertex;
+    optimal_cost = committed_cost;
   }
 
   // The optimal vertex should be set no matter what.
@@ -925,5 +1097,37 @@ DiscretePath SLCLatticePlanner::mergePaths(
   return path;
 }
 
+void SLCLatticePlanner::commitOptimalPath(
+    const std::list<ContinuousPath>& path_sequence,
+    const std::list<boost::weak_ptr<Vertex>>& vertex_sequence) {
+
+  boost::shared_ptr<Vertex> terminal = vertex_sequence.back().lock();
+
+  // The lane change types of the paths have the same values as the manoeuvres.
+  manoeuvre_abandoned_ = commitment_.update(
+      followsCommitment(terminal), manoeuvre(terminal),
+      static_cast<PlanCommitment::Manoeuvre>(path_sequence.front().laneChangeType()));
+
+  // Cache the edges on the committed path to be reused in the next planning cycle.
+  committed_edges_.clear();
+  if (!commitment_.enabled()) return;
+
+  std::list<boost::weak_ptr<Vertex>>::const_iterator parent_iter = vertex_sequence.begin();
+  for (std::list<boost::weak_ptr<Vertex>>::const_iterator child_iter = std::next(parent_iter);
+       child_iter != vertex_sequence.end(); ++parent_iter, ++child_iter) {
+
+    boost::shared_ptr<Vertex> parent_vertex = parent_iter->lock();
+    boost::shared_ptr<Vertex> child_vertex = child_iter->lock();
+
+    committed_edges_.emplace(child_vertex->node().lock()->id(), CommittedEdge{
+        parent_vertex->node().lock()->id(),
+        SnapshotSignature(parent_vertex->snapshot(), signature_resolution_),
+        child_vertex->costToCome() - parent_vertex->costToCome(),
+        boost::make_shared<const Snapshot>(child_vertex->snapshot())});
+  }
+
+  return;
+}
+
 } // End namespace slc_lattice_planner.
 } // End namespace planner.
@@ -15,8 +15,10 @@
 #pragma once
 
 #include <tuple>
+#include <vector>
 #include <deque>
 #include <string>
+#include <algorithm>
 #include <unordered_map>
 #include <boost/optional.hpp>
 #include <boost/core/noncopyable.hpp>
@@ -25,11 +27,16 @@
 #include <router/loop_router/loop_router.h>
 #include <planner/common/traffic_lattice.h>
 #include <planner/common/snapshot.h>
+#include <planner/common/snapshot_signature.h>
+#include <planner/common/edge_length_policy.h>
+#include <planner/common/plan_commitment.h>
 #include <planner/common/vehicle_path.h>
 #include <planner/common/utils.h>
+#include <planner/common/flat_hash_map.h>
 #include <planner/common/vehicle_path_planner.h>
 #include <planner/common/traffic_simulator.h>
 #include <planner/common/intelligent_driver_model.h>
+#include <planner/common/driver_model_table.h>
 
 namespace planner {
 namespace slc_lattice_planner {
@@ -54,6 +61,9 @@ protected:
   /// Intelligent driver model.
   boost::shared_ptr<IntelligentDriverModel> idm_ = nullptr;
 
+  /// Driver models of the agents by their vehicle classes, \c idm_ is used if not set.
+  boost::shared_ptr<const DriverModelTable> agent_models_ = nullptr;
+
 public:
 
   SLCTrafficSimulator(
@@ -66,11 +76,15 @@ public:
   const boost::shared_ptr<const IntelligentDriverModel> idm() const { return idm_; }
   boost::shared_ptr<IntelligentDriverModel>& idm() { return idm_; }
 
+  /// Get or set the driver models of the agents.
+  const boost::shared_ptr<const DriverModelTable>& agentModels() const { return agent_models_; }
+  boost::shared_ptr<const DriverModelTable>& agentModels() { return agent_models_; }
+
 protected:
 
   virtual const double egoAcceleration() const override;
 
-  virtual const double agentAcceleration(const size_t agent) const override;
+  virtual const double agentAcceleration(const size_t index) const override;
 
 }; // End class IDMTrafficSimulator.
 
@@ -250,12 +264,53 @@ protected:
   /// The router to be used.
   boost::shared_ptr<router::Router> router_ = nullptr;
 
+  /// Driver models of the agents in the traffic simulation, the default
+  /// intelligent driver model is used for all agents if not set.
+  boost::shared_ptr<const DriverModelTable> agent_models_ = nullptr;
+
   /// The waypoint lattice used to find nodes for stations.
   boost::shared_ptr<WaypointLattice> waypoint_lattice_ = nullptr;
 
   /// Stores all the constructed vertices.
   std::vector<boost::shared_ptr<Vertex>> all_vertices_;
 
+  /// Stores the constructed vertices together with the signatures of their
+  /// snapshots, indexed by the corresponding node ID on the waypoint lattice.
+  utils::FlatHashMap<size_t,
+    std::vector<std::pair<SnapshotSignature, boost::shared_ptr<Vertex>>>> node_to_vertices_table_;
+
+  /// Bin sizes of the snapshot signatures, which determines how different
+  /// two vertices at the same node can be while still being merged.
+  SnapshotSignature::Resolution signature_resolution_;
+
+  /// Whether near-duplicate vertices at the same node are merged.
+  bool state_merging_ = true;
+
+  /// The maximum difference of the cost-to-come of two near-duplicate
+  /// vertices to be merged, relative to the cost-to-come of the existing one.
+  double merge_cost_tolerance_ = 0.1;
+
+  /// Selects the lengths of the edges leaving the vertices.
+  EdgeLengthPolicy edge_length_policy_;
+
+  /// The maximum number of vertices to be expanded in a planning cycle.
+  /// Vertices left in the queue are treated as terminals. Zero means unlimited.
+  size_t max_expansions_ = 0;
+
+  /// Whether the waypoint lattice is constructed lazily, i.e. its nodes
+  /// are only created once the vertices reach them.
+  bool lazy_lattice_ = false;
+
+  /// Construction time of the waypoint lattice at the start of the last
+  /// planning cycle, see \c latticeConstructionTime().
+  double lattice_construction_mark_ = 0.0;
+
+  /// The number of vertices expanded in the last planning cycle.
+  size_t expansions_ = 0;
+
+  /// The cost of the path selected in the last planning cycle.
+  double optimal_cost_ = 0.0;
+
   /**
    * \brief The root vertex in the vertex graph.
    *
@@ -272,6 +327,32 @@ protected:
    */
   boost::weak_ptr<Vertex> cached_next_vertex_;
 
+  /// The manoeuvre the ego committed to in the previous planning cycles.
+  PlanCommitment commitment_;
+
+  /// Whether a committed lane change is abandoned in the last planning cycle.
+  bool manoeuvre_abandoned_ = false;
+
+  /// The node at the end of the committed lane change, if the ego is executing it.
+  boost::optional<size_t> committed_next_node_ = boost::none;
+
+  /// An edge on the path selected in the last planning cycle.
+  struct CommittedEdge {
+    /// ID of the node the edge starts from.
+    size_t start;
+    /// Signature of the snapshot at the start of the edge.
+    SnapshotSignature signature;
+    /// Stage cost of the edge.
+    double stage_cost;
+    /// Simulated snapshot at the end of the edge.
+    boost::shared_ptr<const Snapshot> snapshot;
+  };
+
+  /// The edges on the committed path indexed by the ID of the node they end
+  /// at, which are reused instead of simulated again if the traffic at the
+  /// start of the edge has not changed (see \c SnapshotSignature).
+  utils::FlatHashMap<size_t, CommittedEdge> committed_edges_;
+
 public:
 
   /// Constructor of the class.
@@ -300,6 +381,66 @@ public:
   /// Get the router used by the planner.
   boost::shared_ptr<const router::Router> router() const { return router_; }
 
+  /// Get the bin sizes of the snapshot signatures.
+  const SnapshotSignature::Resolution& signatureResolution() const {
+    return signature_resolution_;
+  }
+  SnapshotSignature::Resolution& signatureResolution() { return signature_resolution_; }
+
+  /// Get or set whether near-duplicate vertices at the same node are merged.
+  const bool stateMerging() const { return state_merging_; }
+  bool& stateMerging() { return state_merging_; }
+
+  /**
+   * \brief Get or set the relative cost tolerance of the state merging.
+   *
+   * Near-duplicate vertices are only merged if their costs-to-come differ
+   * by at most this fraction of the cost-to-come of the existing vertex.
+   * This bounds the cost-to-come given up by each merge, but not the cost
+   * of the selected path, which also depends on the costs after the merged
+   * vertex. The latter is only checked empirically by test_state_merging.
+   */
+  const double mergeCostTolerance() const { return merge_cost_tolerance_; }
+  double& mergeCostTolerance() { return merge_cost_tolerance_; }
+
+  /// Get or set the policy selecting the lengths of the edges.
+  const EdgeLengthPolicy& edgeLengthPolicy() const { return edge_length_policy_; }
+  EdgeLengthPolicy& edgeLengthPolicy() { return edge_length_policy_; }
+
+  /// Get or set the maximum number of vertices expanded in a planning cycle.
+  const size_t maxExpansions() const { return max_expansions_; }
+  size_t& maxExpansions() { return max_expansions_; }
+
+  /// Get or set whether the waypoint lattice is constructed lazily.
+  /// This only takes effect when the waypoint lattice is created.
+  const bool lazyLattice() const { return lazy_lattice_; }
+  bool& lazyLattice() { return lazy_lattice_; }
+
+  /// Get the wall time (s) spent on constructing the waypoint lattice in the
+  /// last planning cycle, which is part of the planning time.
+  const double latticeConstructionTime() const {
+    if (!waypoint_lattice_) return 0.0;
+    return waypoint_lattice_->constructionTime() - lattice_construction_mark_;
+  }
+
+  /// Get the number of vertices expanded in the last planning cycle.
+  const size_t expansions() const { return expansions_; }
+
+  /// Get the cost of the path selected in the last planning cycle,
+  /// including the terminal costs.
+  const double optimalCost() const { return optimal_cost_; }
+
+  /// Get or set the driver models of the agents in the traffic simulation.
+  const boost::shared_ptr<const DriverModelTable>& agentModels() const { return agent_models_; }
+  boost::shared_ptr<const DriverModelTable>& agentModels() { return agent_models_; }
+
+  /// Get or set the commitment to the manoeuvre selected in the last planning cycle.
+  const PlanCommitment& planCommitment() const { return commitment_; }
+  PlanCommitment& planCommitment() { return commitment_; }
+
+  /// Whether a committed lane change is abandoned in the last planning cycle.
+  const bool manoeuvreAbandoned() const { return manoeuvre_abandoned_; }
+
   /// Get the waypoint nodes used in the planner.
   std::vector<boost::shared_ptr<const WaypointNode>> nodes() const;
 
@@ -310,6 +451,21 @@ public:
 
 protected:
 
+  /// The maximum duration to simulate the traffic along an edge, which
+  /// grows for edges longer than 50m.
+  const double maxSimulationTime(const double length) const {
+    return std::max(5.0, length/10.0);
+  }
+
+  /**
+   * \brief Select the length of an edge leaving the vertex.
+   * \param[in] vertex The vertex the edge starts from.
+   * \param[in] front The vehicle in front of the ego on the target lane, if any.
+   */
+  const double edgeLength(
+      const boost::shared_ptr<Vertex>& vertex,
+      const boost::optional<std::pair<size_t, double>>& front) const;
+
   /// Check if the any of the child vertices has been reached.
   bool immediateNextVertexReached(const Snapshot& snapshot) const;
 
@@ -322,6 +478,51 @@ protected:
   /// Construct the vertex graph.
   void constructVertexGraph(std::deque<boost::shared_ptr<Vertex>>& vertex_queue);
 
+  /// Remove all vertices from the graph.
+  void clearVertexGraph();
+
+  /**
+   * \brief Add a vertex to the graph.
+   * \return \c false if the vertex has already been added before.
+   */
+  bool registerVertex(const boost::shared_ptr<Vertex>& vertex);
+
+  /**
+   * \brief Create the child vertex with the simulated snapshot.
+   *
+   * If there is already a vertex at the same node, which has the same snapshot
+   * signature and has not been expanded yet, and whose cost-to-come is within
+   * \c mergeCostTolerance() of the child's, the child is merged into that
+   * vertex instead of creating a new one, unless \c stateMerging() is disabled.
+   * The merged vertex keeps the parent with the lower cost-to-come.
+   *
+   * \param[in] vertex The parent vertex.
+   * \param[in] snapshot The snapshot at the end of the simulation.
+   * \param[in] stage_cost The cost from the parent to the child.
+   * \return The created or merged child vertex.
+   */
+  boost::shared_ptr<Vertex> childVertex(
+      const boost::shared_ptr<Vertex>& vertex,
+      const Snapshot& snapshot,
+      const double stage_cost);
+
+  /**
+   * \brief Simulate the traffic with the ego following the path from the
+   *        vertex to the target node.
+   *
+   * If the edge is on the committed path and the snapshot at the vertex has
+   * the same signature as the one in the last planning cycle, the simulated
+   * snapshot and stage cost of the committed edge are reused.
+   *
+   * \param[out] stage_cost The stage cost of the edge.
+   * \return The snapshot at the end of the edge, \c nullptr if the ego collides.
+   */
+  boost::shared_ptr<const Snapshot> simulateEdge(
+      const boost::shared_ptr<Vertex>& vertex,
+      const boost::shared_ptr<const WaypointNode>& target_node,
+      const ContinuousPath& path,
+      double& stage_cost) const;
+
   boost::shared_ptr<Vertex> connectVertexToFrontNode(
       const boost::shared_ptr<Vertex>& vertex,
       const boost::shared_ptr<const WaypointNode>& target_node);
@@ -341,7 +542,19 @@ protected:
   /// Compute the cost from root to this terminal, including the terminal costs.
   const double costFromRootToTerminal(const boost::shared_ptr<Vertex>& terminal) const;
 
-  /// Select the optimal path sequence based on the constructed vertex graph.
+  /// The manoeuvre of the path from the root to the vertex, i.e. the first
+  /// lane change on the path, or keeping the lane if there is none.
+  const PlanCommitment::Manoeuvre manoeuvre(const boost::shared_ptr<Vertex>& vertex) const;
+
+  /// Check if the path from the root to the vertex follows the committed manoeuvre.
+  const bool followsCommitment(const boost::shared_ptr<Vertex>& vertex) const;
+
+  /**
+   * \brief Select the optimal path sequence based on the constructed vertex graph.
+   *
+   * The best path following the committed manoeuvre is selected instead of the
+   * optimal one if their costs are within the hysteresis of \c commitment_.
+   */
   void selectOptimalPath(
       std::list<ContinuousPath>& path_sequence,
       std::list<boost::weak_ptr<Vertex>>& vertex_sequence) const;
@@ -349,6 +562,11 @@ protected:
   /// Merge the path segements from \c selectOptimalPath() into a single discrete path.
   DiscretePath mergePaths(const std::list<ContinuousPath>& paths) const;
 
+  /// Commit to the path selected in this planning cycle.
+  void commitOptimalPath(
+      const std::list<ContinuousPath>& path_sequence,
+      const std::list<boost::weak_ptr<Vertex>>& vertex_sequence);
+
 }; // End class SLCLatticePlanner.
 
 } // End namespace slc_lattice_planner.
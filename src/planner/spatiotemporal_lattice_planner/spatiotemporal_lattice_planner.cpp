@@ -13,15 +13,34 @@
 */
 
 #include <set>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
 #include <planner/common/utils.h>
 #include <planner/spatiotemporal_lattice_planner/spatiotemporal_lattice_planner.h>
 
 namespace planner {
 namespace spatiotemporal_lattice_planner {
 
-constexpr std::array<std::pair<double, double>, 3> Vertex::kSpeedIntervalsPerStation_;
 constexpr std::array<double, 6> SpatiotemporalLatticePlanner::kAccelerationOptions_;
 
+const double ConstAccelTrafficSimulator::agentAcceleration(const size_t index) const {
+
+  if (!agent_models_) return snapshot_.vehicles().accelerations()[index];
+
+  // The driver model of an agent depends on its vehicle class.
+  const ConstVehicleView agent = snapshot_.vehicles().view(index);
+  boost::shared_ptr<const IntelligentDriverModel> idm =
+    agent_models_->model(2.0*agent.boundingBox().extent.x);
+
+  boost::optional<std::pair<size_t, double>> lead =
+    snapshot_.trafficLattice()->frontAt(index);
+  if (!lead) return idm->idm(agent.speed(), agent.policySpeed());
+
+  const double lead_speed = snapshot_.vehicles().speeds()[lead->first];
+  return idm->idm(agent.speed(), agent.policySpeed(), lead_speed, lead->second);
+}
+
 const double ConstAccelTrafficSimulator::accelCost(
     const double accel, const double speed, const double policy_speed) const {
   // The cost map for brake.
@@ -57,35 +76,39 @@ const double ConstAccelTrafficSimulator::accelCost(
 const double ConstAccelTrafficSimulator::accelCost() const {
   // We consider four vehicles in computing the accel cost.
   // The ego and the followers of the ego vehicle.
+  // The ego is always at index 0, and the found vehicles are returned as indices.
   boost::optional<std::pair<size_t, double>> back =
-    snapshot_.trafficLattice()->back(snapshot_.ego().id());
+    snapshot_.trafficLattice()->backAt(0);
   boost::optional<std::pair<size_t, double>> left_back =
-    snapshot_.trafficLattice()->leftBack(snapshot_.ego().id());
+    snapshot_.trafficLattice()->leftBackAt(0);
   boost::optional<std::pair<size_t, double>> right_back =
-    snapshot_.trafficLattice()->rightBack(snapshot_.ego().id());
+    snapshot_.trafficLattice()->rightBackAt(0);
 
   double ego_brake_cost = accelCost(
       snapshot_.ego().acceleration(),
       snapshot_.ego().speed(),
       snapshot_.ego().policySpeed());
 
+  const std::vector<double>& accelerations = snapshot_.vehicles().accelerations();
+  const std::vector<double>& speeds = snapshot_.vehicles().speeds();
+
   double agent_brake_cost = 0.0;
   // We don't really care if other agents can accelerate or not.
   if (back)
     agent_brake_cost += accelCost(
-        snapshot_.vehicle(back->first).acceleration(),
-        snapshot_.vehicle(back->first).speed(),
-        snapshot_.vehicle(back->first).speed());
+        accelerations[back->first],
+        speeds[back->first],
+        speeds[back->first]);
   if (left_back)
     agent_brake_cost += accelCost(
-        snapshot_.vehicle(left_back->first).acceleration(),
-        snapshot_.vehicle(left_back->first).speed(),
-        snapshot_.vehicle(left_back->first).speed());
+        accelerations[left_back->first],
+        speeds[left_back->first],
+        speeds[left_back->first]);
   if (right_back)
     agent_brake_cost += accelCost(
-        snapshot_.vehicle(right_back->first).acceleration(),
-        snapshot_.vehicle(right_back->first).speed(),
-        snapshot_.vehicle(right_back->first).speed());
+        accelerations[right_back->first],
+        speeds[right_back->first],
+        speeds[right_back->first]);
 
   return ego_brake_cost + 0.5*agent_brake_cost;
 }
@@ -93,29 +116,14 @@ const double ConstAccelTrafficSimulator::accelCost() const {
 void Vertex::updateOptimalParent() {
   // Set the \c optimal_parent_ to an existing parent vertex.
   // It does not matter which parent is used for now.
-  if (!optimal_parent_) {
-    for (const auto& parent : left_parents_) {
-      if (!parent) continue;
-      optimal_parent_ = parent;
-      break;
-    }
-  }
+  if (!optimal_parent_ && !left_parents_.empty())
+    optimal_parent_ = left_parents_.begin()->second;
 
-  if (!optimal_parent_) {
-    for (const auto& parent : back_parents_) {
-      if (!parent) continue;
-      optimal_parent_ = parent;
-      break;
-    }
-  }
+  if (!optimal_parent_ && !back_parents_.empty())
+    optimal_parent_ = back_parents_.begin()->second;
 
-  if (!optimal_parent_) {
-    for (const auto& parent : right_parents_) {
-      if (!parent) continue;
-      optimal_parent_ = parent;
-      break;
-    }
-  }
+  if (!optimal_parent_ && !right_parents_.empty())
+    optimal_parent_ = right_parents_.begin()->second;
 
   if (!optimal_parent_) {
     throw std::runtime_error(
@@ -126,21 +134,18 @@ void Vertex::updateOptimalParent() {
   // Set the \c optimal_parent_ to the existing parent with the minimum cost-to-come.
   // With the same cost-to-come, the back parent is preferred.
   for (const auto& parent : left_parents_) {
-    if (!parent) continue;
-    if (std::get<1>(*parent) <= std::get<1>(*optimal_parent_))
-      optimal_parent_ = parent;
+    if (std::get<1>(parent.second) <= std::get<1>(*optimal_parent_))
+      optimal_parent_ = parent.second;
   }
 
   for (const auto& parent : right_parents_) {
-    if (!parent) continue;
-    if (std::get<1>(*parent) <= std::get<1>(*optimal_parent_))
-      optimal_parent_ = parent;
+    if (std::get<1>(parent.second) <= std::get<1>(*optimal_parent_))
+      optimal_parent_ = parent.second;
   }
 
   for (const auto& parent : back_parents_) {
-    if (!parent) continue;
-    if (std::get<1>(*parent) <= std::get<1>(*optimal_parent_))
-      optimal_parent_ = parent;
+    if (std::get<1>(parent.second) <= std::get<1>(*optimal_parent_))
+      optimal_parent_ = parent.second;
   }
 
   // Update the snapshot at this vertex to the one reached
@@ -153,12 +158,13 @@ void Vertex::updateOptimalParent() {
 void Vertex::updateLeftParent(
     const Snapshot& snapshot,
     const double cost_to_come,
+    const double time,
     const boost::shared_ptr<Vertex>& parent_vertex) {
   // Figure out which speed interval this vertex belongs to.
-  boost::optional<size_t> idx = speedIntervalIdx(parent_vertex->speed());
+  boost::optional<size_t> idx = parent_vertex->bin();
   if (!idx) return;
 
-  left_parents_[*idx] = std::make_tuple(snapshot, cost_to_come, parent_vertex);
+  left_parents_.set(*idx, std::make_tuple(snapshot, cost_to_come, parent_vertex, time));
   updateOptimalParent();
   return;
 }
@@ -166,12 +172,13 @@ void Vertex::updateLeftParent(
 void Vertex::updateBackParent(
     const Snapshot& snapshot,
     const double cost_to_come,
+    const double time,
     const boost::shared_ptr<Vertex>& parent_vertex) {
   // Figure out which speed interval this vertex belongs to.
-  boost::optional<size_t> idx = speedIntervalIdx(parent_vertex->speed());
+  boost::optional<size_t> idx = parent_vertex->bin();
   if (!idx) return;
 
-  back_parents_[*idx] = std::make_tuple(snapshot, cost_to_come, parent_vertex);
+  back_parents_.set(*idx, std::make_tuple(snapshot, cost_to_come, parent_vertex, time));
   updateOptimalParent();
   return;
 }
@@ -179,12 +186,13 @@ void Vertex::updateBackParent(
 void Vertex::updateRightParent(
     const Snapshot& snapshot,
     const double cost_to_come,
+    const double time,
     const boost::shared_ptr<Vertex>& parent_vertex) {
   // Figure out which speed interval this vertex belongs to.
-  boost::optional<size_t> idx = speedIntervalIdx(parent_vertex->speed());
+  boost::optional<size_t> idx = parent_vertex->bin();
   if (!idx) return;
 
-  right_parents_[*idx] = std::make_tuple(snapshot, cost_to_come, parent_vertex);
+  right_parents_.set(*idx, std::make_tuple(snapshot, cost_to_come, parent_vertex, time));
   updateOptimalParent();
   return;
 }
@@ -195,12 +203,12 @@ void Vertex::updateLeftChild(
     const double stage_cost,
     const boost::shared_ptr<Vertex>& child_vertex) {
   // Figure out which speed interval this vertex belongs to.
-  boost::optional<size_t> idx = speedIntervalIdx(child_vertex->speed());
+  boost::optional<size_t> idx = child_vertex->bin();
   if (!idx) return;
 
-  if (!(left_children_[*idx]) ||
-      std::get<2>(*(left_children_[*idx])) > stage_cost)
-    left_children_[*idx] = std::make_tuple(path, acceleration, stage_cost, child_vertex);
+  const Child* child = left_children_.find(*idx);
+  if (!child || std::get<2>(*child) > stage_cost)
+    left_children_.set(*idx, std::make_tuple(path, acceleration, stage_cost, child_vertex));
 
   return;
 }
@@ -211,12 +219,12 @@ void Vertex::updateFrontChild(
     const double stage_cost,
     const boost::shared_ptr<Vertex>& child_vertex) {
   // Figure out which speed interval this vertex belongs to.
-  boost::optional<size_t> idx = speedIntervalIdx(child_vertex->speed());
+  boost::optional<size_t> idx = child_vertex->bin();
   if (!idx) return;
 
-  if (!(front_children_[*idx]) ||
-      std::get<2>(*(front_children_[*idx])) > stage_cost)
-    front_children_[*idx] = std::make_tuple(path, acceleration, stage_cost, child_vertex);
+  const Child* child = front_children_.find(*idx);
+  if (!child || std::get<2>(*child) > stage_cost)
+    front_children_.set(*idx, std::make_tuple(path, acceleration, stage_cost, child_vertex));
   return;
 }
 
@@ -226,12 +234,12 @@ void Vertex::updateRightChild(
     const double stage_cost,
     const boost::shared_ptr<Vertex>& child_vertex) {
   // Figure out which speed interval this vertex belongs to.
-  boost::optional<size_t> idx = speedIntervalIdx(child_vertex->speed());
+  boost::optional<size_t> idx = child_vertex->bin();
   if (!idx) return;
 
-  if (!(right_children_[*idx]) ||
-      std::get<2>(*(right_children_[*idx])) > stage_cost)
-    right_children_[*idx] = std::make_tuple(path, acceleration, stage_cost, child_vertex);
+  const Child* child = right_children_.find(*idx);
+  if (!child || std::get<2>(*child) > stage_cost)
+    right_children_.set(*idx, std::make_tuple(path, acceleration, stage_cost, child_vertex));
   return;
 }
 
@@ -245,29 +253,29 @@ std::string Vertex::string(const std::string& prefix) const {
 
   //std::printf("Get left parents.\n");
   output += std::string("left parents #: ") + std::to_string(leftParentsSize()) + "\n";
-  for (const auto& parent : left_parents_) {
-    if (!parent) continue;
-    output += (parent_format % std::get<2>(*parent).lock()->node().lock()->id()
-                             % std::get<2>(*parent).lock()->speed()
-                             % std::get<1>(*parent)).str();
+  for (const auto& item : left_parents_) {
+    const Parent& parent = item.second;
+    output += (parent_format % std::get<2>(parent).lock()->node().lock()->id()
+                             % std::get<2>(parent).lock()->speed()
+                             % std::get<1>(parent)).str();
   }
 
   //std::printf("Get back parents.\n");
   output += std::string("back parents #: ") + std::to_string(backParentsSize()) + "\n";
-  for (const auto& parent : back_parents_) {
-    if (!parent) continue;
-    output += (parent_format % std::get<2>(*parent).lock()->node().lock()->id()
-                             % std::get<2>(*parent).lock()->speed()
-                             % std::get<1>(*parent)).str();
+  for (const auto& item : back_parents_) {
+    const Parent& parent = item.second;
+    output += (parent_format % std::get<2>(parent).lock()->node().lock()->id()
+                             % std::get<2>(parent).lock()->speed()
+                             % std::get<1>(parent)).str();
   }
 
   //std::printf("Get right parents.\n");
   output += std::string("right parents #: ") + std::to_string(rightParentsSize()) + "\n";
-  for (const auto& parent : right_parents_) {
-    if (!parent) continue;
-    output += (parent_format % std::get<2>(*parent).lock()->node().lock()->id()
-                             % std::get<2>(*parent).lock()->speed()
-                             % std::get<1>(*parent)).str();
+  for (const auto& item : right_parents_) {
+    const Parent& parent = item.second;
+    output += (parent_format % std::get<2>(parent).lock()->node().lock()->id()
+                             % std::get<2>(parent).lock()->speed()
+                             % std::get<1>(parent)).str();
   }
 
   //std::printf("Get the optimal parent.\n");
@@ -284,35 +292,35 @@ std::string Vertex::string(const std::string& prefix) const {
 
   //std::printf("Get left children.\n");
   output += std::string("left children #: ") + std::to_string(leftChildrenSize()) + "\n";
-  for (const auto& child : left_children_) {
-    if (!child) continue;
-    output += (child_format % std::get<3>(*child).lock()->node().lock()->id()
-                           % std::get<3>(*child).lock()->speed()
-                           % std::get<1>(*child)
-                           % std::get<0>(*child).range()
-                           % std::get<2>(*child)).str();
+  for (const auto& item : left_children_) {
+    const Child& child = item.second;
+    output += (child_format % std::get<3>(child).lock()->node().lock()->id()
+                           % std::get<3>(child).lock()->speed()
+                           % std::get<1>(child)
+                           % std::get<0>(child).range()
+                           % std::get<2>(child)).str();
   }
 
   //std::printf("Get front children.\n");
   output += std::string("front children #: ") + std::to_string(frontChildrenSize()) + "\n";
-  for (const auto& child : front_children_) {
-    if (!child) continue;
-    output += (child_format % std::get<3>(*child).lock()->node().lock()->id()
-                           % std::get<3>(*child).lock()->speed()
-                           % std::get<1>(*child)
-                           % std::get<0>(*child).range()
-                           % std::get<2>(*child)).str();
+  for (const auto& item : front_children_) {
+    const Child& child = item.second;
+    output += (child_format % std::get<3>(child).lock()->node().lock()->id()
+                           % std::get<3>(child).lock()->speed()
+                           % std::get<1>(child)
+                           % std::get<0>(child).range()
+                           % std::get<2>(child)).str();
   }
 
   //std::printf("Get right children.\n");
   output += std::string("right children #: ") + std::to_string(rightChildrenSize()) + "\n";
-  for (const auto& child : right_children_) {
-    if (!child) continue;
-    output += (child_format % std::get<3>(*child).lock()->node().lock()->id()
-                           % std::get<3>(*child).lock()->speed()
-                           % std::get<1>(*child)
-                           % std::get<0>(*child).range()
-                           % std::get<2>(*child)).str();
+  for (const auto& item : right_children_) {
+    const Child& child = item.second;
+    output += (child_format % std::get<3>(child).lock()->node().lock()->id()
+                           % std::get<3>(child).lock()->speed()
+                           % std::get<1>(child)
+                           % std::get<0>(child).range()
+                           % std::get<2>(child)).str();
   }
 
   return output;
@@ -325,8 +333,8 @@ std::vector<boost::shared_ptr<const WaypointNode>>
   std::vector<boost::shared_ptr<const WaypointNode>> nodes_in_graph;
 
   for (const auto& item : node_to_vertices_table_) {
-    for (const auto& vertex : item.second) {
-      if (!vertex) continue;
+    for (const auto& bin : item.second) {
+      const boost::shared_ptr<Vertex>& vertex = bin.second;
       boost::shared_ptr<const WaypointNode> node = vertex->node().lock();
       if (visited_nodes.count(node->id()) > 0) continue;
 
@@ -343,8 +351,8 @@ std::vector<ContinuousPath> SpatiotemporalLatticePlanner::edges() const {
   std::vector<ContinuousPath> paths_in_graph;
 
   for (const auto& item : node_to_vertices_table_) {
-    for (const auto& vertex : item.second) {
-      if (!vertex) continue;
+    for (const auto& bin : item.second) {
+      const boost::shared_ptr<Vertex>& vertex = bin.second;
       boost::shared_ptr<const WaypointNode> node = vertex->node().lock();
 
       // Paths to left children.
@@ -423,7 +431,13 @@ void SpatiotemporalLatticePlanner::updateWaypointLattice(const Snapshot& snapsho
     boost::shared_ptr<CarlaWaypoint> ego_waypoint =
       fast_map_->waypoint(snapshot.ego().transform().location);
     waypoint_lattice_ = boost::make_shared<WaypointLattice>(
-        ego_waypoint, spatial_horizon_+30.0, 1.0, router_);
+        ego_waypoint, spatial_horizon_+30.0, 1.0, router_, lazy_lattice_);
+
+    // Vertices are roughly 50m apart on each lane of the lattice.
+    // The table is sized by the horizon, since a lazy lattice only covers its start here.
+    const size_t lanes = waypoint_lattice_->latticeEntries().size();
+    node_to_vertices_table_.reserve(
+        lanes * static_cast<size_t>(waypoint_lattice_->horizon()/50.0) + 1);
     return;
   }
 
@@ -462,7 +476,13 @@ std::list<std::pair<ContinuousPath, double>>
     throw std::runtime_error(error_msg + id_msg);
   }
 
-  // Update the waypoint lattice.
+  // Reset the pruning statistics of this planning cycle.
+  pruning_stats_ = PruningStats();
+
+  // Update the waypoint lattice. The construction time of the lattice
+  // in this planning cycle is counted from here.
+  lattice_construction_mark_ =
+    waypoint_lattice_ ? waypoint_lattice_->constructionTime() : 0.0;
   updateWaypointLattice(snapshot);
 
   // Prune the vertex graph.
@@ -532,7 +552,7 @@ std::deque<boost::shared_ptr<Vertex>>
 
     // Initialize the new root station.
     boost::shared_ptr<Vertex> root =
-      boost::make_shared<Vertex>(snapshot, waypoint_lattice_, fast_map_);
+      boost::make_shared<Vertex>(snapshot, waypoint_lattice_, fast_map_, speed_bins_, time_bins_);
     addVertexToTable(root);
     root_ = root;
 
@@ -546,7 +566,7 @@ std::deque<boost::shared_ptr<Vertex>>
 
   // Create the new root station.
   boost::shared_ptr<Vertex> new_root =
-    boost::make_shared<Vertex>(snapshot, waypoint_lattice_, fast_map_);
+    boost::make_shared<Vertex>(snapshot, waypoint_lattice_, fast_map_, speed_bins_, time_bins_);
 
   // Find the immedidate waypoint nodes.
   boost::shared_ptr<const WaypointNode> next_node = cached_next_vertex_.lock()->node().lock();
@@ -604,6 +624,12 @@ void SpatiotemporalLatticePlanner::constructVertexGraph(
 
   //std::printf("SpatiotemporalLatticePlanner::constructVertexGraph()\n");
 
+  // Snapshot signatures of the vertices that are pushed into the queue,
+  // including the ones that are pruned later.
+  signatures_.clear();
+  for (const auto& vertex : vertex_queue)
+    signatures_.emplace(vertex.get(), vertex->snapshot(), signature_resolution_);
+
   auto addVerticesToTableAndQueue = [this, &vertex_queue](
       const std::vector<boost::shared_ptr<Vertex>>& vertices,
       const boost::shared_ptr<const WaypointNode>& node)->void{
@@ -614,24 +640,67 @@ void SpatiotemporalLatticePlanner::constructVertexGraph(
     for (const auto& vertex : vertices) {
       // The vertex already exists in the table.
       // Therefore, we don't have to add it to the table or the queue.
-      if(findVertexInTable(vertex)) continue;
+      // Its snapshot may have been replaced by the one from a new optimal
+      // parent though, in which case its signature is updated.
+      if(findVertexInTable(vertex)) {
+        auto signature = signatures_.find(vertex.get());
+        if (signature != signatures_.end())
+          signature->second = SnapshotSignature(vertex->snapshot(), signature_resolution_);
+        continue;
+      }
 
       // If the vertex reaches the target node,
       // add the vertex to the queue and table in order to expand later.
       addVertexToTable(vertex);
-      if (vertex->node().lock()->id() == node->id())
+      if (vertex->node().lock()->id() == node->id()) {
         vertex_queue.push_back(vertex);
+        signatures_.emplace(vertex.get(), vertex->snapshot(), signature_resolution_);
+      }
     }
   };
 
+  const std::chrono::steady_clock::time_point start_time =
+    std::chrono::steady_clock::now();
+
   while (!vertex_queue.empty()) {
+    // Stop expanding if the time budget is used up. The root vertex is
+    // always expanded so that there is at least one trajectory option.
+    const std::chrono::duration<double> elapsed_time =
+      std::chrono::steady_clock::now() - start_time;
+    const bool time_budget_used_up =
+      time_budget_ > 0.0 && elapsed_time.count() > time_budget_;
+    const bool expansions_used_up =
+      max_expansions_ > 0 && pruning_stats_.expanded >= max_expansions_;
+    if (pruning_stats_.expanded > 0 &&
+        (time_budget_used_up || expansions_used_up)) {
+      pruning_stats_.unexpanded += vertex_queue.size();
+      vertex_queue.clear();
+      break;
+    }
+
     // Get the next vertex to expand.
     boost::shared_ptr<Vertex> vertex = vertex_queue.front();
     vertex_queue.pop_front();
 
+    // Skip the vertex if there is a better one at the same node.
+    // The check is done right before the expansion, so that the latest
+    // cost-to-come of the vertices are used.
+    if (dominance_pruning_ && dominated(vertex)) {
+      vertex->pruned() = true;
+      ++pruning_stats_.pruned;
+      continue;
+    }
+    ++pruning_stats_.expanded;
+
+    const size_t ego = vertex->snapshot().ego().id();
+    const boost::shared_ptr<const TrafficLattice> traffic_lattice =
+      vertex->snapshot().trafficLattice();
+
     // Try to connect to the front node.
     boost::shared_ptr<const WaypointNode> front_node =
-      waypoint_lattice_->front(vertex->node().lock()->waypoint(), 50.0);
+      waypoint_lattice_->front(
+          vertex->node().lock()->waypoint(),
+          edgeLength(vertex, traffic_lattice->front(ego)));
     std::vector<boost::shared_ptr<Vertex>> front_vertices =
       connectVertexToFrontNode(vertex, front_node);
 
@@ -639,7 +708,9 @@ void SpatiotemporalLatticePlanner::constructVertexGraph(
 
     // Try to connect to the left front node.
     boost::shared_ptr<const WaypointNode> left_front_node =
-      waypoint_lattice_->leftFront(vertex->node().lock()->waypoint(), 50.0);
+      waypoint_lattice_->leftFront(
+          vertex->node().lock()->waypoint(),
+          edgeLength(vertex, traffic_lattice->leftFront(ego)));
     std::vector<boost::shared_ptr<Vertex>> left_front_vertices =
       connectVertexToLeftFrontNode(vertex, left_front_node);
 
@@ -647,7 +718,9 @@ void SpatiotemporalLatticePlanner::constructVertexGraph(
 
     // Try to connect to the right front node.
     boost::shared_ptr<const WaypointNode> right_front_node =
-      waypoint_lattice_->rightFront(vertex->node().lock()->waypoint(), 50.0);
+      waypoint_lattice_->rightFront(
+          vertex->node().lock()->waypoint(),
+          edgeLength(vertex, traffic_lattice->rightFront(ego)));
     std::vector<boost::shared_ptr<Vertex>> right_front_vertices =
       connectVertexToRightFrontNode(vertex, right_front_node);
 
@@ -657,6 +730,18 @@ void SpatiotemporalLatticePlanner::constructVertexGraph(
   return;
 }
 
+const double SpatiotemporalLatticePlanner::edgeLength(
+    const boost::shared_ptr<Vertex>& vertex,
+    const boost::optional<std::pair<size_t, double>>& front) const {
+
+  const double distance = vertex->node().lock()->distance() -
+                          root_.lock()->node().lock()->distance();
+  boost::optional<double> gap = boost::none;
+  if (front) gap = front->second;
+
+  return edge_length_policy_.length(distance, vertex->snapshot().ego().speed(), gap);
+}
+
 std::vector<boost::shared_ptr<Vertex>>
   SpatiotemporalLatticePlanner::connectVertexToFrontNode(
       const boost::shared_ptr<Vertex>& vertex,
@@ -665,12 +750,17 @@ std::vector<boost::shared_ptr<Vertex>>
   //std::printf("SpatiotemporalLatticePlanner::connectVertexToFrontNode()\n");
 
   // Stores the expanded front children of the input vertex.
-  std::array<boost::shared_ptr<Vertex>, Vertex::kSpeedIntervalsPerStation_.size()>
-    front_children;
+  utils::SparseBinArray<boost::shared_ptr<Vertex>> front_children;
 
   // Return directly if the target node does not exist.
   if (!target_node) return std::vector<boost::shared_ptr<Vertex>>();
 
+  // The simulation is limited by the remaining temporal horizon.
+  const double max_time = std::min(
+      maxSimulationTime(target_node->distance()-vertex->node().lock()->distance()),
+      temporalHorizon()-vertex->time());
+  if (max_time <= 0.0) return std::vector<boost::shared_ptr<Vertex>>();
+
   // Plan a path between the node at the current vertex to the target node.
   boost::shared_ptr<ContinuousPath> path = nullptr;
   try {
@@ -696,11 +786,12 @@ std::vector<boost::shared_ptr<Vertex>>
     snapshot.ego().acceleration() = accel;
 
     ConstAccelTrafficSimulator simulator(snapshot, map_, fast_map_);
+    simulator.agentModels() = agent_models_;
     double simulation_time = 0.0; double stage_cost = 0.0;
 
     try {
       const bool no_collision = simulator.simulate(
-          *path, sim_time_step_, 5.0, simulation_time, stage_cost);
+          *path, sim_time_step_, max_time, simulation_time, stage_cost);
       // Continue if this acceleration option leads to collision.
       if (!no_collision) continue;
     } catch (std::exception& e) {
@@ -711,9 +802,14 @@ std::vector<boost::shared_ptr<Vertex>>
 
     // Create a new vertex using the end snapshot of the simulation.
     boost::shared_ptr<Vertex> next_vertex = boost::make_shared<Vertex>(
-        simulator.snapshot(), waypoint_lattice_, fast_map_);
+        simulator.snapshot(), waypoint_lattice_, fast_map_,
+        speed_bins_, time_bins_, vertex->time()+simulation_time);
+
+    // Ignore this option if the ego speed or the arrival time is out of range,
+    // e.g. the station is reached beyond the temporal horizon.
+    if (!next_vertex->bin()) continue;
 
-    // Check if a similar vertex (close in ego velocity) has already been created.
+    // Check if a similar vertex (close in ego velocity and time) has already been created.
     // If so, the \c next_vertex is replaced with the existing one in the table.
     boost::shared_ptr<Vertex> similar_vertex = findVertexInTable(next_vertex);
     if (similar_vertex) next_vertex = similar_vertex;
@@ -729,27 +825,23 @@ std::vector<boost::shared_ptr<Vertex>>
     // Update the parent vertex of the child.
     if (vertex->hasParents()) {
       next_vertex->updateBackParent(
-          simulator.snapshot(), vertex->costToCome()+stage_cost, vertex);
+          simulator.snapshot(), vertex->costToCome()+stage_cost,
+          vertex->time()+simulation_time, vertex);
     } else {
       next_vertex->updateBackParent(
-          simulator.snapshot(), stage_cost, vertex);
+          simulator.snapshot(), stage_cost, simulation_time, vertex);
     }
 
     // Set the front vertices that are connected with this vertex.
-    auto children = vertex->frontChildren();
-    for (size_t i = 0; i < Vertex::kSpeedIntervalsPerStation_.size(); ++i) {
-      if (!(children[i])) continue;
-      front_children[i] = std::get<3>(*(children[i])).lock();
-    }
+    for (const auto& child : vertex->frontChildren())
+      front_children[child.first] = std::get<3>(child.second).lock();
 
   } // End for loop for different acceleration options.
 
   // Collect all the front child vertices of the input vertex.
   std::vector<boost::shared_ptr<Vertex>> output_vertices;
-  for (const auto& child : front_children) {
-    if (!child) continue;
-    output_vertices.push_back(child);
-  }
+  output_vertices.reserve(front_children.size());
+  for (const auto& child : front_children) output_vertices.push_back(child.second);
 
   return output_vertices;
 }
@@ -762,8 +854,7 @@ std::vector<boost::shared_ptr<Vertex>>
   //std::printf("SpatiotemporalLatticePlanner::connectVertexToLeftFrontNode()\n");
 
   // Stores the expanded left front children of the input vertex.
-  std::array<boost::shared_ptr<Vertex>, Vertex::kSpeedIntervalsPerStation_.size()>
-    left_children;
+  utils::SparseBinArray<boost::shared_ptr<Vertex>> left_children;
 
   // Return directly if the target node does not exist.
   if (!target_node) return std::vector<boost::shared_ptr<Vertex>>();
@@ -797,6 +888,12 @@ std::vector<boost::shared_ptr<Vertex>>
   if (left_back && left_back->second <= 0.0)
     return std::vector<boost::shared_ptr<Vertex>>();
 
+  // The simulation is limited by the remaining temporal horizon.
+  const double max_time = std::min(
+      maxSimulationTime(target_node->distance()-vertex->node().lock()->distance()),
+      temporalHorizon()-vertex->time());
+  if (max_time <= 0.0) return std::vector<boost::shared_ptr<Vertex>>();
+
   // Plan a path between the node at the current vertex to the target node.
   boost::shared_ptr<ContinuousPath> path = nullptr;
   try {
@@ -822,11 +919,12 @@ std::vector<boost::shared_ptr<Vertex>>
     snapshot.ego().acceleration() = accel;
 
     ConstAccelTrafficSimulator simulator(snapshot, map_, fast_map_);
+    simulator.agentModels() = agent_models_;
     double simulation_time = 0.0; double stage_cost = 0.0;
 
     try {
       const bool no_collision = simulator.simulate(
-          *path, sim_time_step_, 5.0, simulation_time, stage_cost);
+          *path, sim_time_step_, max_time, simulation_time, stage_cost);
       // Continue if this acceleration option leads to collision.
       if (!no_collision) continue;
     } catch (std::exception& e) {
@@ -837,9 +935,14 @@ std::vector<boost::shared_ptr<Vertex>>
 
     // Create a new vertex using the end snapshot of the simulation.
     boost::shared_ptr<Vertex> next_vertex = boost::make_shared<Vertex>(
-        simulator.snapshot(), waypoint_lattice_, fast_map_);
+        simulator.snapshot(), waypoint_lattice_, fast_map_,
+        speed_bins_, time_bins_, vertex->time()+simulation_time);
+
+    // Ignore this option if the ego speed or the arrival time is out of range,
+    // e.g. the station is reached beyond the temporal horizon.
+    if (!next_vertex->bin()) continue;
 
-    // Check if a similar vertex (close in ego velocity) has already been created.
+    // Check if a similar vertex (close in ego velocity and time) has already been created.
     // If so, the \c next_vertex is replaced with the existing one in the table.
     boost::shared_ptr<Vertex> similar_vertex = findVertexInTable(next_vertex);
     if (similar_vertex) next_vertex = similar_vertex;
@@ -855,26 +958,22 @@ std::vector<boost::shared_ptr<Vertex>>
     // Update the parent vertex of the child.
     if (vertex->hasParents()) {
       next_vertex->updateRightParent(
-          simulator.snapshot(), vertex->costToCome()+stage_cost, vertex);
+          simulator.snapshot(), vertex->costToCome()+stage_cost,
+          vertex->time()+simulation_time, vertex);
     } else {
       next_vertex->updateRightParent(
-          simulator.snapshot(), stage_cost, vertex);
+          simulator.snapshot(), stage_cost, simulation_time, vertex);
     }
 
     // Set the left front vertices that are connected with this vertex.
-    auto children = vertex->leftChildren();
-    for (size_t i = 0; i < Vertex::kSpeedIntervalsPerStation_.size(); ++i) {
-      if (!(children[i])) continue;
-      left_children[i] = std::get<3>(*(children[i])).lock();
-    }
+    for (const auto& child : vertex->leftChildren())
+      left_children[child.first] = std::get<3>(child.second).lock();
   } // End for loop for different acceleration options.
 
   // Collect all the left child vertices of the input vertex.
   std::vector<boost::shared_ptr<Vertex>> output_vertices;
-  for (const auto& child : left_children) {
-    if (!child) continue;
-    output_vertices.push_back(child);
-  }
+  output_vertices.reserve(left_children.size());
+  for (const auto& child : left_children) output_vertices.push_back(child.second);
 
   return output_vertices;
 }
@@ -887,8 +986,7 @@ std::vector<boost::shared_ptr<Vertex>>
   //std::printf("SpatiotemporalLatticePlanner::connectVertexToRightFrontNode()\n");
 
   // Stores the expanded right front children of the input vertex.
-  std::array<boost::shared_ptr<Vertex>, Vertex::kSpeedIntervalsPerStation_.size()>
-    right_children;
+  utils::SparseBinArray<boost::shared_ptr<Vertex>> right_children;
 
   // Return directly if the target node does not exist.
   if (!target_node) return std::vector<boost::shared_ptr<Vertex>>();
@@ -922,6 +1020,12 @@ std::vector<boost::shared_ptr<Vertex>>
   if (right_back && right_back->second <= 0.0)
     return std::vector<boost::shared_ptr<Vertex>>();
 
+  // The simulation is limited by the remaining temporal horizon.
+  const double max_time = std::min(
+      maxSimulationTime(target_node->distance()-vertex->node().lock()->distance()),
+      temporalHorizon()-vertex->time());
+  if (max_time <= 0.0) return std::vector<boost::shared_ptr<Vertex>>();
+
   // Plan a path between the node at the current vertex to the target node.
   boost::shared_ptr<ContinuousPath> path = nullptr;
   try {
@@ -947,11 +1051,12 @@ std::vector<boost::shared_ptr<Vertex>>
     snapshot.ego().acceleration() = accel;
 
     ConstAccelTrafficSimulator simulator(snapshot, map_, fast_map_);
+    simulator.agentModels() = agent_models_;
     double simulation_time = 0.0; double stage_cost = 0.0;
 
     try {
       const bool no_collision = simulator.simulate(
-          *path, sim_time_step_, 5.0, simulation_time, stage_cost);
+          *path, sim_time_step_, max_time, simulation_time, stage_cost);
       // Continue if this acceleration option leads to collision.
       if (!no_collision) continue;
     } catch (std::exception& e) {
@@ -962,9 +1067,14 @@ std::vector<boost::shared_ptr<Vertex>>
 
     // Create a new vertex using the end snapshot of the simulation.
     boost::shared_ptr<Vertex> next_vertex = boost::make_shared<Vertex>(
-        simulator.snapshot(), waypoint_lattice_, fast_map_);
+        simulator.snapshot(), waypoint_lattice_, fast_map_,
+        speed_bins_, time_bins_, vertex->time()+simulation_time);
 
-    // Check if a similar vertex (close in ego velocity) has already been created.
+    // Ignore this option if the ego speed or the arrival time is out of range,
+    // e.g. the station is reached beyond the temporal horizon.
+    if (!next_vertex->bin()) continue;
+
+    // Check if a similar vertex (close in ego velocity and time) has already been created.
     // If so, the \c next_vertex is replaced with the existing one in the table.
     boost::shared_ptr<Vertex> similar_vertex = findVertexInTable(next_vertex);
     if (similar_vertex) next_vertex = similar_vertex;
@@ -980,47 +1090,86 @@ std::vector<boost::shared_ptr<Vertex>>
     // Update the parent vertex of the child.
     if (vertex->hasParents()) {
       next_vertex->updateLeftParent(
-          simulator.snapshot(), vertex->costToCome()+stage_cost, vertex);
+          simulator.snapshot(), vertex->costToCome()+stage_cost,
+          vertex->time()+simulation_time, vertex);
     } else {
       next_vertex->updateLeftParent(
-          simulator.snapshot(), stage_cost, vertex);
+          simulator.snapshot(), stage_cost, simulation_time, vertex);
     }
 
     // Set the right front vertices that are connected with this vertex.
-    auto children = vertex->rightChildren();
-    for (size_t i = 0; i < Vertex::kSpeedIntervalsPerStation_.size(); ++i) {
-      if (!(children[i])) continue;
-      right_children[i] = std::get<3>(*(children[i])).lock();
-    }
+    for (const auto& child : vertex->rightChildren())
+      right_children[child.first] = std::get<3>(child.second).lock();
   } // End for loop for different acceleration options.
 
   // Collect all the right child vertices of the input vertex.
   std::vector<boost::shared_ptr<Vertex>> output_vertices;
-  for (const auto& child : right_children) {
-    if (!child) continue;
-    output_vertices.push_back(child);
-  }
+  output_vertices.reserve(right_children.size());
+  for (const auto& child : right_children) output_vertices.push_back(child.second);
 
   return output_vertices;
 }
 
+bool SpatiotemporalLatticePlanner::dominated(
+    const boost::shared_ptr<Vertex>& vertex) const {
+
+  // The root vertex is never dominated.
+  if (!vertex->hasParents()) return false;
+
+  auto iter = node_to_vertices_table_.find(vertex->node().lock()->id());
+  if (iter == node_to_vertices_table_.end()) return false;
+
+  auto signature = signatures_.find(vertex.get());
+  if (signature == signatures_.end()) return false;
+  const boost::optional<size_t> bin = vertex->bin();
+
+  for (const auto& item : iter->second) {
+    const boost::shared_ptr<Vertex>& other = item.second;
+    if (other == vertex || !other->hasParents() || other->pruned()) continue;
+
+    // Vertices that are never queued in this cycle are not considered.
+    auto other_signature = signatures_.find(other.get());
+    if (other_signature == signatures_.end()) continue;
+
+    // The vertices should reach the same traffic scenario at the same speed.
+    if (signature->second != other_signature->second) continue;
+
+    // The terminal speed cost decreases with the ego speed. The other vertex
+    // should be no slower, so that it is no worse as a terminal either.
+    if (other->time() > vertex->time() ||
+        other->speed() < vertex->speed() ||
+        other->costToCome() > vertex->costToCome()) continue;
+
+    if (other->time() < vertex->time() ||
+        other->speed() > vertex->speed() ||
+        other->costToCome() < vertex->costToCome()) return true;
+
+    // Break the tie with the state bin.
+    if (bin && item.first < *bin) return true;
+  }
+
+  return false;
+}
+
 boost::shared_ptr<Vertex> SpatiotemporalLatticePlanner::findVertexInTable(
     const boost::shared_ptr<Vertex>& vertex) {
 
   //std::printf("SpatiotemporalLatticePlanner::findVertexInTable()\n");
 
-  boost::optional<size_t> idx = Vertex::speedIntervalIdx(vertex->speed());
+  boost::optional<size_t> idx = vertex->bin();
   if (!idx) {
     std::string error_msg(
         "SpatiotemporalLattice::findVertexInTable(): "
-        "invalid ego speed in input vertex.\n");
+        "invalid ego speed or time in input vertex.\n");
     error_msg + vertex->string();
     throw std::runtime_error(error_msg);
   }
 
   auto iter = node_to_vertices_table_.find(vertex->node().lock()->id());
   if (iter == node_to_vertices_table_.end()) return nullptr;
-  return (iter->second)[*idx];
+
+  const boost::shared_ptr<Vertex>* similar_vertex = iter->second.find(*idx);
+  return similar_vertex ? *similar_vertex : nullptr;
 }
 
 const double SpatiotemporalLatticePlanner::terminalSpeedCost(
@@ -1088,7 +1237,7 @@ const double SpatiotemporalLatticePlanner::terminalDistanceCost(
     root_child = std::get<3>(root_.lock()->validRightChildren().front()).lock();
 
   const double spatial_horizon =
-    spatial_horizon_ - 50.0 +
+    spatial_horizon_ - edge_length_policy_.longest() +
     root_child->node()->distance() -
     root_.lock()->node().lock()->distance();
 
@@ -1131,11 +1280,12 @@ void SpatiotemporalLatticePlanner::selectOptimalTraj(
 
   // Find the optimal terminal vertex.
   for (const auto& item : node_to_vertices_table_) {
-    for (const auto& vertex : item.second) {
+    for (const auto& bin : item.second) {
 
-      if (!vertex) continue;
+      const boost::shared_ptr<Vertex>& vertex = bin.second;
       // Only terminal stations are considered, i.e. stations without children.
-      if (vertex->hasChildren()) continue;
+      // Pruned vertices are childless as well, but are never expanded.
+      if (vertex->hasChildren() || vertex->pruned()) continue;
 
       const double vertex_cost = costFromRootToTerminal(vertex);
 
@@ -1228,14 +1378,14 @@ boost::optional<std::pair<ContinuousPath, double>>
   const auto& left_children = parent->leftChildren();
 
   for (const auto& candidate : left_children) {
-    if (!candidate) continue;
     // Stop if the left children does not share the same node with the input child.
-    boost::shared_ptr<const Vertex> candidate_vertex = std::get<3>(*candidate).lock();
+    boost::shared_ptr<const Vertex> candidate_vertex = std::get<3>(candidate.second).lock();
     if (candidate_vertex->node()->id() != child->node().lock()->id()) continue;
 
     // Figure out the which child the input child actually is.
-    boost::optional<size_t> idx = Vertex::speedIntervalIdx(child->speed());
-    if (!idx) {
+    boost::optional<size_t> idx = child->bin();
+    const auto* traj = idx ? left_children.find(*idx) : nullptr;
+    if (!traj) {
       std::string error_msg(
           "SpatiotemporalLatticePlanner::findTrajFromParentToChild(): "
           "The desired left child is missing.\n");
@@ -1243,22 +1393,21 @@ boost::optional<std::pair<ContinuousPath, double>>
       throw std::runtime_error(error_msg);
     }
 
-    return std::make_pair(std::get<0>(*(left_children[*idx])),
-                          std::get<1>(*(left_children[*idx])));
+    return std::make_pair(std::get<0>(*traj), std::get<1>(*traj));
   }
 
   // Check if the input child is a front child.
   const auto& front_children = parent->frontChildren();
 
   for (const auto& candidate : front_children) {
-    if (!candidate) continue;
     // Stop if the left children does not share the same node with the input child.
-    boost::shared_ptr<const Vertex> candidate_vertex = std::get<3>(*candidate).lock();
+    boost::shared_ptr<const Vertex> candidate_vertex = std::get<3>(candidate.second).lock();
     if (candidate_vertex->node()->id() != child->node().lock()->id()) continue;
 
     // Figure out the which child the input child actually is.
-    boost::optional<size_t> idx = Vertex::speedIntervalIdx(child->speed());
-    if (!idx) {
+    boost::optional<size_t> idx = child->bin();
+    const auto* traj = idx ? front_children.find(*idx) : nullptr;
+    if (!traj) {
       std::string error_msg(
           "SpatiotemporalLatticePlanner::findTrajFromParentToChild(): "
           "The desired front child is missing.\n");
@@ -1266,22 +1415,21 @@ boost::optional<std::pair<ContinuousPath, double>>
       throw std::runtime_error(error_msg);
     }
 
-    return std::make_pair(std::get<0>(*(front_children[*idx])),
-                          std::get<1>(*(front_children[*idx])));
+    return std::make_pair(std::get<0>(*traj), std::get<1>(*traj));
   }
 
   // Check if the input child is a right child.
   const auto& right_children = parent->rightChildren();
 
   for (const auto& candidate : right_children) {
-    if (!candidate) continue;
     // Stop if the left children does not share the same node with the input child.
-    boost::shared_ptr<const Vertex> candidate_vertex = std::get<3>(*candidate).lock();
+    boost::shared_ptr<const Vertex> candidate_vertex = std::get<3>(candidate.second).lock();
     if (candidate_vertex->node()->id() != child->node().lock()->id()) continue;
 
     // Figure out the which child the input child actually is.
-    boost::optional<size_t> idx = Vertex::speedIntervalIdx(child->speed());
-    if (!idx) {
+    boost::optional<size_t> idx = child->bin();
+    const auto* traj = idx ? right_children.find(*idx) : nullptr;
+    if (!traj) {
       std::string error_msg(
           "SpatiotemporalLatticePlanner::findTrajFromParentToChild(): "
           "The desired right child is missing.\n");
@@ -1289,8 +1437,7 @@ boost::optional<std::pair<ContinuousPath, double>>
       throw std::runtime_error(error_msg);
     }
 
-    return std::make_pair(std::get<0>(*(right_children[*idx])),
-                          std::get<1>(*(right_children[*idx])));
+    return std::make_pair(std::get<0>(*traj), std::get<1>(*traj));
   }
 
   // If the \c child vertex is not found, return \c boost::none.
@@ -19,7 +19,9 @@
 #include <list>
 #include <array>
 #include <string>
+#include <algorithm>
 #include <unordered_map>
+#include <boost/format.hpp>
 #include <boost/optional.hpp>
 #include <boost/core/noncopyable.hpp>
 
@@ -27,16 +29,28 @@
 #include <router/loop_router/loop_router.h>
 #include <planner/common/traffic_lattice.h>
 #include <planner/common/snapshot.h>
+#include <planner/common/snapshot_signature.h>
+#include <planner/common/edge_length_policy.h>
 #include <planner/common/vehicle_path.h>
 #include <planner/common/utils.h>
+#include <planner/common/flat_hash_map.h>
+#include <planner/common/bins.h>
 #include <planner/common/vehicle_path_planner.h>
 #include <planner/common/traffic_simulator.h>
 #include <planner/common/intelligent_driver_model.h>
+#include <planner/common/driver_model_table.h>
 
 namespace planner {
 namespace spatiotemporal_lattice_planner {
 
-
+/**
+ * \brief ConstAccelTrafficSimulator simulates the traffic with the ego
+ *        keeping its acceleration.
+ *
+ * The agents keep their accelerations as well, unless the driver models of
+ * the agents are set, in which case the agents follow the intelligent driver
+ * model of their vehicle classes.
+ */
 class ConstAccelTrafficSimulator : public TrafficSimulator {
 
 private:
@@ -44,6 +58,12 @@ private:
   using Base = TrafficSimulator;
   using This = ConstAccelTrafficSimulator;
 
+protected:
+
+  /// Driver models of the agents by their vehicle classes, the agents keep
+  /// their accelerations if not set.
+  boost::shared_ptr<const DriverModelTable> agent_models_ = nullptr;
+
 public:
 
   ConstAccelTrafficSimulator(
@@ -52,15 +72,17 @@ public:
       const boost::shared_ptr<utils::FastWaypointMap>& fast_map) :
     Base(snapshot, map, fast_map) {}
 
+  /// Get or set the driver models of the agents.
+  const boost::shared_ptr<const DriverModelTable>& agentModels() const { return agent_models_; }
+  boost::shared_ptr<const DriverModelTable>& agentModels() { return agent_models_; }
+
 protected:
 
   virtual const double egoAcceleration() const override {
     return snapshot_.ego().acceleration();
   }
 
-  virtual const double agentAcceleration(const size_t agent) const override {
-    return snapshot_.agent(agent).acceleration();
-  }
+  virtual const double agentAcceleration(const size_t index) const override;
 
   const double accelCost(
       const double accel, const double speed, const double policy_speed) const;
@@ -80,9 +102,10 @@ protected:
   /**
    * \brief Stores a parent vertex of this vertex.
    *
-   * The tuple stores the snapshot and the cost-to-come if come form this parent vertex.
+   * The tuple stores the snapshot, the cost-to-come, the parent vertex, and
+   * the time to reach this vertex from the root if come from this parent vertex.
    */
-  using Parent = std::tuple<Snapshot, double, boost::weak_ptr<Vertex>>;
+  using Parent = std::tuple<Snapshot, double, boost::weak_ptr<Vertex>, double>;
 
   /**
    * \brief Stores a child vertex of this vertex.
@@ -92,59 +115,62 @@ protected:
    */
   using Child = std::tuple<ContinuousPath, double, double, boost::weak_ptr<Vertex>>;
 
-public:
+protected:
+
+  /// The node that the vertex is most close to on the waypoint lattice.
+  boost::weak_ptr<const WaypointNode> node_;
+
+  /// The snapshot of the traffic when the ego vehicle reaches this vertex.
+  Snapshot snapshot_;
 
   /**
-   * \brief The hard-coded interval of velocities at a station.
+   * \brief The intervals of velocities at a station.
    *
    * At reaching the station, if the ego velocity is outside all the intervals,
    * it will be considered as an invalid trajectory option.
    *
-   * Each interval is left-closed and right-open, i.e. [a, b).
+   * The bins are shared by all vertices of a planner, see \c defaultSpeedBins().
+   */
+  boost::shared_ptr<const utils::Bins> speed_bins_;
+
+  /**
+   * \brief The intervals of the arrival time at a station.
+   *
+   * Following M. McNaughton, et al, "Motion Planning for Autonomous Driving with
+   * a Conformal Spatiotemporal Lattice", the arrival time at each station is
+   * discretized as well. Two trajectories reaching the same station with similar
+   * speeds but at very different time (e.g. before or after a gap at a merge)
+   * are therefore kept as different vertices.
    *
-   * In the paper, M. McNaughton, et al, "Motion Planning for Autonomous Driving with
-   * a Conformal Spatiotemporal Lattice", there is also discretizetion of time at each
-   * station. In this implementation, we assume there is just one interval for the time.
+   * The upper bound of the last bin is the temporal planning horizon. Reaching a
+   * station beyond the horizon is considered as an invalid trajectory option.
    *
-   * This is subject to discussion. What should be recorded at each station/vertex
-   * reprents some sort of the "state" of the ego. Having time as a variable in the
-   * state might indicates a flawed design of an algorithm. Time is often not a part
-   * of the state vector.
+   * The bins are shared by all vertices of a planner, see \c defaultTimeBins().
    */
-  static constexpr std::array<std::pair<double, double>, 3>
-    kSpeedIntervalsPerStation_ {{
-      { 0.0,    13.4112},
-      {13.4112, 26.8224},
-      {26.8224, 40.2336} }};
+  boost::shared_ptr<const utils::Bins> time_bins_;
 
-protected:
-
-  /// The node that the vertex is most close to on the waypoint lattice.
-  boost::weak_ptr<const WaypointNode> node_;
+  /// The time to reach this vertex from the root when the vertex is created.
+  double time_ = 0.0;
 
-  /// The snapshot of the traffic when the ego vehicle reaches this vertex.
-  Snapshot snapshot_;
+  /// Whether the vertex is dominated by another vertex at the same node,
+  /// and therefore not expanded, see \c SpatiotemporalLatticePlanner::dominated().
+  bool pruned_ = false;
 
   /**
    * \name Parent vertices of this vertex.
    *
    * Each vertex may have more than one parents from the same lane, left lane,
-   * or the right lane. The maximum number of parents from each lane depends on
-   * the size of \c kSpeedIntervalsPerStation_.
+   * or the right lane. There is at most one parent from each lane in each speed
+   * bin. Only the populated speed bins are stored.
    *
    * The \c optimal_parent is a copy of the parent which has the
    * minimum cost-to-come. This is mainly used to backtrace the optimal
    * path/trajectory.
    */
   /// @{
-  std::array<boost::optional<Parent>, kSpeedIntervalsPerStation_.size()>
-    left_parents_ {boost::none};
-
-  std::array<boost::optional<Parent>, kSpeedIntervalsPerStation_.size()>
-    back_parents_ {boost::none};
-
-  std::array<boost::optional<Parent>, kSpeedIntervalsPerStation_.size()>
-    right_parents_ {boost::none};
+  utils::SparseBinArray<Parent> left_parents_;
+  utils::SparseBinArray<Parent> back_parents_;
+  utils::SparseBinArray<Parent> right_parents_;
 
   boost::optional<Parent> optimal_parent_ = boost::none;
   /// @}
@@ -153,35 +179,47 @@ protected:
    * \name Child vertices if this vertex.
    *
    * Each vertex may have more than one child vertices from the same lane, left lane,
-   * or the right lane. The maximum number of children from each lane depends on the
-   * size of \c kSpeedIntervalsPerStation_.
+   * or the right lane. There is at most one child from each lane in each speed bin.
+   * Only the populated speed bins are stored.
    */
   /// @{
-  std::array<boost::optional<Child>, kSpeedIntervalsPerStation_.size()>
-    left_children_ {boost::none};
-
-  std::array<boost::optional<Child>, kSpeedIntervalsPerStation_.size()>
-    front_children_ {boost::none};
-
-  std::array<boost::optional<Child>, kSpeedIntervalsPerStation_.size()>
-    right_children_ {boost::none};
+  utils::SparseBinArray<Child> left_children_;
+  utils::SparseBinArray<Child> front_children_;
+  utils::SparseBinArray<Child> right_children_;
   /// @}
 
 public:
 
-  Vertex(const Snapshot& snapshot, const boost::shared_ptr<const WaypointNode>& node) :
-    node_(node), snapshot_(snapshot) {
+  Vertex(const Snapshot& snapshot,
+         const boost::shared_ptr<const WaypointNode>& node,
+         const boost::shared_ptr<const utils::Bins>& speed_bins,
+         const boost::shared_ptr<const utils::Bins>& time_bins,
+         const double time = 0.0) :
+    node_(node), snapshot_(snapshot),
+    speed_bins_(speed_bins), time_bins_(time_bins), time_(time) {
     if (!node) {
       throw std::runtime_error(
           "Vertex::Vertex(): input node = nullptr.\n");
     }
+    if (!speed_bins || !time_bins) {
+      throw std::runtime_error(
+          "Vertex::Vertex(): input speed or time bins = nullptr.\n");
+    }
     return;
   }
 
   Vertex(const Snapshot& snapshot,
          const boost::shared_ptr<const WaypointLattice>& waypoint_lattice,
-         const boost::shared_ptr<utils::FastWaypointMap>& fast_map) :
-    snapshot_(snapshot) {
+         const boost::shared_ptr<utils::FastWaypointMap>& fast_map,
+         const boost::shared_ptr<const utils::Bins>& speed_bins,
+         const boost::shared_ptr<const utils::Bins>& time_bins,
+         const double time = 0.0) :
+    snapshot_(snapshot),
+    speed_bins_(speed_bins), time_bins_(time_bins), time_(time) {
+    if (!speed_bins || !time_bins) {
+      throw std::runtime_error(
+          "Vertex::Vertex(): input speed or time bins = nullptr.\n");
+    }
     boost::shared_ptr<const WaypointNode> node = waypoint_lattice->closestNode(
         fast_map->waypoint(snapshot.ego().transform().location),
         waypoint_lattice->longitudinalResolution());
@@ -207,6 +245,52 @@ public:
 
   const Snapshot& snapshot() const { return snapshot_; }
 
+  const boost::shared_ptr<const utils::Bins>& speedBins() const { return speed_bins_; }
+
+  const boost::shared_ptr<const utils::Bins>& timeBins() const { return time_bins_; }
+
+  /// The speed bin of the ego at this vertex, \c boost::none if the speed is out of range.
+  boost::optional<size_t> speedBin() const { return speed_bins_->index(speed()); }
+
+  /// The time bin of this vertex, \c boost::none if the time is beyond the horizon.
+  boost::optional<size_t> timeBin() const { return time_bins_->index(time()); }
+
+  /**
+   * \brief The state bin of this vertex, combining the speed and time bins.
+   *
+   * Vertices at the same node are distinguished by the state bin.
+   * \return \c boost::none if either the speed or the time is out of range.
+   */
+  boost::optional<size_t> bin() const {
+    const boost::optional<size_t> speed_bin = speedBin();
+    const boost::optional<size_t> time_bin = timeBin();
+    if (!speed_bin || !time_bin) return boost::none;
+    return (*speed_bin)*time_bins_->size() + (*time_bin);
+  }
+
+  /**
+   * \brief The default speed bins.
+   *
+   * Three bins of 30mph covering [0mph, 90mph), i.e. [0m/s, 40.2336m/s).
+   */
+  static boost::shared_ptr<const utils::Bins> defaultSpeedBins() {
+    static const boost::shared_ptr<const utils::Bins> bins =
+      boost::make_shared<const utils::Bins>(
+          std::vector<double>{0.0, 13.4112, 26.8224, 40.2336});
+    return bins;
+  }
+
+  /**
+   * \brief The default time bins.
+   *
+   * Four bins of 5s covering [0s, 20s).
+   */
+  static boost::shared_ptr<const utils::Bins> defaultTimeBins() {
+    static const boost::shared_ptr<const utils::Bins> bins =
+      boost::make_shared<const utils::Bins>(utils::Bins::uniform(0.0, 20.0, 4));
+    return bins;
+  }
+
   const double costToCome() const {
     if (!optimal_parent_) {
       throw std::runtime_error(
@@ -216,15 +300,22 @@ public:
     return std::get<1>(*optimal_parent_);
   }
 
-  /// Accessors for the parent vertices.
-  const std::array<boost::optional<Parent>, kSpeedIntervalsPerStation_.size()>&
-    leftParents() const { return left_parents_; }
+  /// Get or set whether the vertex is pruned by the dominance check.
+  /// A pruned vertex has no children, but it is not a terminal either.
+  const bool pruned() const { return pruned_; }
+  bool& pruned() { return pruned_; }
 
-  const std::array<boost::optional<Parent>, kSpeedIntervalsPerStation_.size()>&
-    backParents() const { return back_parents_; }
+  /// The time to reach this vertex from the root through the optimal parent.
+  /// The time is 0 for the root vertex.
+  const double time() const {
+    if (!optimal_parent_) return time_;
+    return std::get<3>(*optimal_parent_);
+  }
 
-  const std::array<boost::optional<Parent>, kSpeedIntervalsPerStation_.size()>&
-    rightParents() const { return right_parents_; }
+  /// Accessors for the parent vertices.
+  const utils::SparseBinArray<Parent>& leftParents() const { return left_parents_; }
+  const utils::SparseBinArray<Parent>& backParents() const { return back_parents_; }
+  const utils::SparseBinArray<Parent>& rightParents() const { return right_parents_; }
 
   const boost::optional<Parent>& optimalParent() const {
     return optimal_parent_;
@@ -235,11 +326,9 @@ public:
   std::vector<Parent> validRightParents() const { return validParents(right_parents_); };
 
   /// Check the number of parents.
-  /// FIXME: There is some unnecessary copying (not much) going on here.
-  ///        Should be easy to get rid of this by counting the valid parents directly.
-  const size_t leftParentsSize() const { return validLeftParents().size(); }
-  const size_t backParentsSize() const { return validBackParents().size(); }
-  const size_t rightParentsSize() const { return validRightParents().size(); }
+  const size_t leftParentsSize() const { return left_parents_.size(); }
+  const size_t backParentsSize() const { return back_parents_.size(); }
+  const size_t rightParentsSize() const { return right_parents_.size(); }
   const size_t parentsSize() const {
     return leftParentsSize() + backParentsSize() + rightParentsSize();
   }
@@ -251,25 +340,18 @@ public:
   const bool hasParents() const { return parentsSize() > 0; }
 
   /// Accessors for the child vertices.
-  const std::array<boost::optional<Child>, kSpeedIntervalsPerStation_.size()>&
-    leftChildren() const { return left_children_; }
-
-  const std::array<boost::optional<Child>, kSpeedIntervalsPerStation_.size()>&
-    frontChildren() const { return front_children_; }
-
-  const std::array<boost::optional<Child>, kSpeedIntervalsPerStation_.size()>&
-    rightChildren() const { return right_children_; }
+  const utils::SparseBinArray<Child>& leftChildren() const { return left_children_; }
+  const utils::SparseBinArray<Child>& frontChildren() const { return front_children_; }
+  const utils::SparseBinArray<Child>& rightChildren() const { return right_children_; }
 
   std::vector<Child> validLeftChildren() const { return validChildren(left_children_); }
   std::vector<Child> validFrontChildren() const { return validChildren(front_children_); }
   std::vector<Child> validRightChildren() const { return validChildren(right_children_); }
 
   /// Check the number of children.
-  /// FIXME: There is some unnecessary copying (not much) going on here.
-  ///        Should be easy to get rid of this by counting the valid parents directly.
-  const size_t leftChildrenSize() const { return validLeftChildren().size(); }
-  const size_t frontChildrenSize() const { return validFrontChildren().size(); }
-  const size_t rightChildrenSize() const { return validRightChildren().size(); }
+  const size_t leftChildrenSize() const { return left_children_.size(); }
+  const size_t frontChildrenSize() const { return front_children_.size(); }
+  const size_t rightChildrenSize() const { return right_children_.size(); }
   const size_t childrenSize() const {
     return leftChildrenSize() + frontChildrenSize() + rightChildrenSize();
   }
@@ -283,14 +365,17 @@ public:
   /// Update parent vertices.
   void updateLeftParent(const Snapshot& snapshot,
                         const double cost_to_come,
+                        const double time,
                         const boost::shared_ptr<Vertex>& parent_vertex);
 
   void updateBackParent(const Snapshot& snapshot,
                         const double cost_to_come,
+                        const double time,
                         const boost::shared_ptr<Vertex>& parent_vertex);
 
   void updateRightParent(const Snapshot& snapshot,
                          const double cost_to_come,
+                         const double time,
                          const boost::shared_ptr<Vertex>& parent_vertex);
 
   /// Update child vertices.
@@ -311,48 +396,44 @@ public:
 
   std::string string(const std::string& prefix = "") const;
 
-  /// Figure out the speed interval index for the given speed.
-  static boost::optional<size_t> speedIntervalIdx(const double speed) {
-    // Return \c boost::none if the input speed is less than 0.
-    if (speed < 0.0) return boost::none;
-
-    for (size_t i = 0; i < kSpeedIntervalsPerStation_.size(); ++i) {
-      if (speed < kSpeedIntervalsPerStation_[i].second) return i;
-    }
-
-    // Return \c boost::none if the speed is too large.
-    return boost::none;
-  }
-
 protected:
 
   /// Update the optimal parent vertex, which has the minimum cost-to-come.
   void updateOptimalParent();
 
-  std::vector<Parent> validParents(
-      const std::array<boost::optional<Parent>,
-                       kSpeedIntervalsPerStation_.size()>& parents) const {
+  std::vector<Parent> validParents(const utils::SparseBinArray<Parent>& parents) const {
     std::vector<Parent> valid_parents;
-    for (const auto& parent : parents) {
-      if (!parent) continue;
-      valid_parents.push_back(*parent);
-    }
+    valid_parents.reserve(parents.size());
+    for (const auto& parent : parents) valid_parents.push_back(parent.second);
     return valid_parents;
   }
 
-  std::vector<Child> validChildren(
-      const std::array<boost::optional<Child>,
-                       kSpeedIntervalsPerStation_.size()>& children) const {
+  std::vector<Child> validChildren(const utils::SparseBinArray<Child>& children) const {
     std::vector<Child> valid_children;
-    for (const auto& child : children) {
-      if (!child) continue;
-      valid_children.push_back(*child);
-    }
+    valid_children.reserve(children.size());
+    for (const auto& child : children) valid_children.push_back(child.second);
     return valid_children;
   }
 
 }; // End class Vertex.
 
+/**
+ * \brief Statistics of the dominance pruning in one planning cycle.
+ */
+struct PruningStats {
+  /// Number of vertices that are expanded.
+  size_t expanded = 0;
+  /// Number of vertices that are dominated, and therefore not expanded.
+  size_t pruned = 0;
+  /// Number of vertices left unexpanded since the planning time or expansion budget is used up.
+  size_t unexpanded = 0;
+
+  std::string string(const std::string& prefix = "") const {
+    return prefix + (boost::format("expanded:%1% pruned:%2% unexpanded:%3%\n")
+        % expanded % pruned % unexpanded).str();
+  }
+}; // End struct PruningStats.
+
 class SpatiotemporalLatticePlanner : public VehiclePathPlanner,
                                      private boost::noncopyable{
 
@@ -385,12 +466,44 @@ protected:
   /// The waypoint lattice used to find nodes for stations.
   boost::shared_ptr<WaypointLattice> waypoint_lattice_ = nullptr;
 
+  /// The speed bins of the vertices.
+  boost::shared_ptr<const utils::Bins> speed_bins_;
+
+  /// The time bins of the vertices, which also define the temporal planning horizon.
+  boost::shared_ptr<const utils::Bins> time_bins_;
+
+  /**
+   * \brief The wall-clock time budget (s) of constructing the vertex graph.
+   *
+   * Once the budget is used up, the remaining vertices in the queue are left
+   * unexpanded, and treated as terminals. A non-positive budget means unlimited.
+   */
+  double time_budget_ = 0.0;
+
+  /// The maximum number of vertices to be expanded in a planning cycle,
+  /// similar to \c time_budget_. Zero means unlimited.
+  size_t max_expansions_ = 0;
+
+  /// Whether the waypoint lattice is constructed lazily, i.e. its nodes
+  /// are only created once the vertices reach them.
+  bool lazy_lattice_ = false;
+
+  /// Driver models of the agents in the traffic simulation, the agents
+  /// keep their accelerations if not set.
+  boost::shared_ptr<const DriverModelTable> agent_models_ = nullptr;
+
+  /// Construction time of the waypoint lattice at the start of the last
+  /// planning cycle, see \c latticeConstructionTime().
+  double lattice_construction_mark_ = 0.0;
+
+  /// Selects the lengths of the edges leaving the vertices.
+  EdgeLengthPolicy edge_length_policy_;
+
   /// Stores all the constructed vertices.
-  /// The vetices are indexed by the node ID. Each node may link upto three vertices.
-  std::unordered_map<
-    size_t,
-    std::array<boost::shared_ptr<Vertex>, Vertex::kSpeedIntervalsPerStation_.size()>>
-      node_to_vertices_table_;
+  /// The vetices are indexed by the node ID. Each node may link upto one vertex
+  /// in each state (speed and time) bin, see \c Vertex::bin().
+  utils::FlatHashMap<size_t, utils::SparseBinArray<boost::shared_ptr<Vertex>>>
+    node_to_vertices_table_;
 
   /**
    * \brief The root vertex in the station graph.
@@ -404,6 +517,19 @@ protected:
   /// The next vertex to be reached.
   boost::weak_ptr<Vertex> cached_next_vertex_;
 
+  /// Whether the dominated vertices are pruned while constructing the graph.
+  bool dominance_pruning_ = true;
+
+  /// Resolution of the snapshot signatures used in the dominance check.
+  SnapshotSignature::Resolution signature_resolution_;
+
+  /// Snapshot signatures of the vertices pushed into the queue in the
+  /// current planning cycle. Kept as a member so that its slots are reused.
+  utils::FlatHashMap<const Vertex*, SnapshotSignature> signatures_;
+
+  /// Pruning statistics of the latest planning cycle.
+  PruningStats pruning_stats_;
+
 public:
 
   /// Constructor of the class.
@@ -412,11 +538,22 @@ public:
       const double spatial_horizon,
       const boost::shared_ptr<router::Router>& router,
       const boost::shared_ptr<CarlaMap>& map,
-      const boost::shared_ptr<utils::FastWaypointMap>& fast_map) :
+      const boost::shared_ptr<utils::FastWaypointMap>& fast_map,
+      const boost::shared_ptr<const utils::Bins>& speed_bins = Vertex::defaultSpeedBins(),
+      const boost::shared_ptr<const utils::Bins>& time_bins = Vertex::defaultTimeBins()) :
     Base(map, fast_map),
     sim_time_step_(sim_time_step),
     spatial_horizon_(spatial_horizon),
-    router_(router) {}
+    router_(router),
+    speed_bins_(speed_bins),
+    time_bins_(time_bins) {
+    if (!speed_bins_ || !time_bins_) {
+      throw std::runtime_error(
+          "SpatiotemporalLatticePlanner::SpatiotemporalLatticePlanner(): "
+          "input speed or time bins = nullptr.\n");
+    }
+    return;
+  }
 
   /// Destructor of the class.
   virtual ~SpatiotemporalLatticePlanner() {}
@@ -432,15 +569,63 @@ public:
   /// Get the router used by the planner.
   boost::shared_ptr<const router::Router> router() const { return router_; }
 
+  /// Get the speed bins of the vertices.
+  boost::shared_ptr<const utils::Bins> speedBins() const { return speed_bins_; }
+
+  /// Get the time bins of the vertices.
+  boost::shared_ptr<const utils::Bins> timeBins() const { return time_bins_; }
+
+  /// The temporal planning horizon (s), i.e. the upper bound of the last time bin.
+  const double temporalHorizon() const { return time_bins_->upper(time_bins_->size()-1); }
+
+  /// Get or set the wall-clock time budget (s) of constructing the vertex graph.
+  const double timeBudget() const { return time_budget_; }
+  double& timeBudget() { return time_budget_; }
+
+  /// Get or set the maximum number of vertices expanded in a planning cycle.
+  const size_t maxExpansions() const { return max_expansions_; }
+  size_t& maxExpansions() { return max_expansions_; }
+
+  /// Get or set whether the waypoint lattice is constructed lazily.
+  /// This only takes effect when the waypoint lattice is created.
+  const bool lazyLattice() const { return lazy_lattice_; }
+  bool& lazyLattice() { return lazy_lattice_; }
+
+  /// Get or set the driver models of the agents in the traffic simulation.
+  const boost::shared_ptr<const DriverModelTable>& agentModels() const { return agent_models_; }
+  boost::shared_ptr<const DriverModelTable>& agentModels() { return agent_models_; }
+
+  /// Get the wall time (s) spent on constructing the waypoint lattice in the
+  /// last planning cycle, which is part of the planning time.
+  const double latticeConstructionTime() const {
+    if (!waypoint_lattice_) return 0.0;
+    return waypoint_lattice_->constructionTime() - lattice_construction_mark_;
+  }
+
+  /// Get or set the policy selecting the lengths of the edges.
+  const EdgeLengthPolicy& edgeLengthPolicy() const { return edge_length_policy_; }
+  EdgeLengthPolicy& edgeLengthPolicy() { return edge_length_policy_; }
+
+  /// Get or set whether the dominated vertices are pruned.
+  const bool dominancePruning() const { return dominance_pruning_; }
+  bool& dominancePruning() { return dominance_pruning_; }
+
+  /// Get or set the resolution of the snapshot signatures in the dominance check.
+  const SnapshotSignature::Resolution& signatureResolution() const {
+    return signature_resolution_;
+  }
+  SnapshotSignature::Resolution& signatureResolution() { return signature_resolution_; }
+
+  /// Get the pruning statistics of the latest planning cycle.
+  const PruningStats& pruningStats() const { return pruning_stats_; }
+
   ///// Get all vertices in the graph.
   //std::vector<boost::shared_ptr<const Vertex>> vertices() const {
   //  std::vector<boost::shared_ptr<const Vertex>> valid_vertices;
 
   //  for (const auto& item: node_to_vertices_table_) {
-  //    for (const auto& vertex : item.second) {
-  //      if (!vertex) continue;
-  //      valid_vertices.push_back(vertex);
-  //    }
+  //    for (const auto& vertex : item.second)
+  //      valid_vertices.push_back(vertex.second);
   //  }
   //  return valid_vertices;
   //}
@@ -458,6 +643,21 @@ public:
 
 protected:
 
+  /// The maximum duration to simulate the traffic along an edge, which
+  /// grows for edges longer than 50m.
+  const double maxSimulationTime(const double length) const {
+    return std::max(5.0, length/10.0);
+  }
+
+  /**
+   * \brief Select the length of an edge leaving the vertex.
+   * \param[in] vertex The vertex the edge starts from.
+   * \param[in] front The vehicle in front of the ego on the target lane, if any.
+   */
+  const double edgeLength(
+      const boost::shared_ptr<Vertex>& vertex,
+      const boost::optional<std::pair<size_t, double>>& front) const;
+
   /// Check if the any of the child vertices has been reached.
   bool immediateNextVertexReached(const Snapshot& snapshot) const;
 
@@ -470,6 +670,34 @@ protected:
   /// Construct the vertex graph.
   void constructVertexGraph(std::deque<boost::shared_ptr<Vertex>>& vertex_queue);
 
+  /**
+   * \brief Check if a vertex is dominated by another vertex at the same node.
+   *
+   * Vertex A dominates vertex B at the same node if both have the same snapshot
+   * signature, i.e. the same neighbour vehicles and the same ego speed bin,
+   * and A is no worse than B in all of the following, while being better
+   * in at least one of them:
+   * - the time to reach the node,
+   * - the ego speed, which is higher the better since the terminal speed
+   *   cost decreases with it,
+   * - the cost-to-come.
+   * If the two are equal in all of the above, the one in the lower state bin dominates.
+   *
+   * A dominated vertex does not need to be expanded, since the dominating one
+   * reaches the same traffic scenario earlier, faster and with less cost,
+   * and is no worse as a terminal either.
+   *
+   * Only vertices in \c signatures_ which are not pruned can dominate others.
+   * These are either expanded or still in the queue, so that every pruned
+   * vertex is dominated by a vertex which is expanded or left as a terminal.
+   * The signatures are updated whenever the optimal parent of a vertex, and
+   * therefore its snapshot, changes.
+   *
+   * \param[in] vertex The query vertex.
+   * \return True if the vertex is dominated.
+   */
+  bool dominated(const boost::shared_ptr<Vertex>& vertex) const;
+
   std::vector<boost::shared_ptr<Vertex>> connectVertexToFrontNode(
         const boost::shared_ptr<Vertex>& vertex,
         const boost::shared_ptr<const WaypointNode>& target_node);
@@ -501,11 +729,11 @@ protected:
 
   /**
    * \brief Try to find a vertex in the table that shared the same station and
-   *        the same speed interval with the given vertex.
+   *        the same state (speed and time) bin with the given vertex.
    *
-   * The function throws runtime error if the ego speed within the input vertex
-   * is not within the valid range. The valid range is defined by
-   * \c Vertex::kSpeedIntervalsPerStation_.
+   * The function throws runtime error if the ego speed or the time within the
+   * input vertex is not within the valid range. The valid range is defined by
+   * the speed and time bins of the planner.
    *
    * \param[in] vertex The query vertex.
    * \return \c nullptr if no vertex satisfying the requirement is found. Otherwise,
@@ -524,11 +752,11 @@ protected:
    * \param[in] vertex The vertex to be added to the table.
    */
   void addVertexToTable(const boost::shared_ptr<Vertex>& vertex) {
-    boost::optional<size_t> idx = Vertex::speedIntervalIdx(vertex->speed());
+    boost::optional<size_t> idx = vertex->bin();
     if (!idx) {
       std::string error_msg(
-          "SpatiotemporalLatticePlanner::addVertexToTable(): ",
-          "The speed of the input vertex is invalid.\n");
+          "SpatiotemporalLatticePlanner::addVertexToTable(): "
+          "The speed or time of the input vertex is invalid.\n");
       error_msg += vertex->string();
       throw std::runtime_error(error_msg);
     }
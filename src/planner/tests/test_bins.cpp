@@ -0,0 +1,68 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include <planner/common/bins.h>
+
+using namespace utils;
+
+TEST(Bins, index) {
+  Bins bins({0.0, 10.0, 20.0, 40.0});
+  EXPECT_EQ(bins.size(), 3);
+
+  EXPECT_FALSE(bins.index(-0.1));
+  EXPECT_EQ(*bins.index(0.0), 0);
+  EXPECT_EQ(*bins.index(9.99), 0);
+  EXPECT_EQ(*bins.index(10.0), 1);
+  EXPECT_EQ(*bins.index(39.9), 2);
+  EXPECT_FALSE(bins.index(40.0));
+
+  Bins uniform = Bins::uniform(0.0, 40.0, 80);
+  EXPECT_EQ(uniform.size(), 80);
+  for (size_t i = 0; i < uniform.size(); ++i) {
+    const double center = 0.5 * (uniform.lower(i)+uniform.upper(i));
+    EXPECT_EQ(*uniform.index(center), i);
+  }
+
+  EXPECT_THROW(Bins({1.0}), std::runtime_error);
+  EXPECT_THROW(Bins({0.0, 1.0, 1.0}), std::runtime_error);
+  EXPECT_THROW(Bins::uniform(1.0, 0.0, 3), std::runtime_error);
+}
+
+TEST(SparseBinArray, access) {
+  SparseBinArray<std::string> array;
+  EXPECT_TRUE(array.empty());
+  EXPECT_EQ(array.find(3), nullptr);
+
+  array.set(5, "five");
+  array.set(1, "one");
+  array[3] = "three";
+  array.set(5, "FIVE");
+  EXPECT_EQ(array.size(), 3);
+  EXPECT_EQ(*array.find(5), "FIVE");
+
+  // Bins are visited in the order of the bin index.
+  std::vector<size_t> indices;
+  for (const auto& item : array) indices.push_back(item.first);
+  EXPECT_EQ(indices, std::vector<size_t>({1, 3, 5}));
+
+  array.erase(3);
+  array.erase(4);
+  EXPECT_EQ(array.size(), 2);
+  EXPECT_EQ(array.find(3), nullptr);
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include <utility>
+#include <gtest/gtest.h>
+#include <planner/common/collision_checker.h>
+
+using namespace utils;
+
+TEST(CollisionChecker, overlap) {
+  // Two axis-aligned boxes.
+  const OrientedBox box1(0.0, 0.0, 0.0, 2.0, 1.0);
+  EXPECT_TRUE(CollisionChecker::overlap(box1, OrientedBox(3.5, 0.0, 0.0, 2.0, 1.0)));
+  EXPECT_FALSE(CollisionChecker::overlap(box1, OrientedBox(4.5, 0.0, 0.0, 2.0, 1.0)));
+  EXPECT_TRUE(CollisionChecker::overlap(box1, OrientedBox(0.0, 1.5, 0.0, 2.0, 1.0)));
+  EXPECT_FALSE(CollisionChecker::overlap(box1, OrientedBox(0.0, 2.5, 0.0, 2.0, 1.0)));
+
+  // A rotated box whose axis-aligned bounds overlap with the first box,
+  // while the box itself does not.
+  const OrientedBox box2(3.2, 2.2, -M_PI/4.0, 2.0, 0.2);
+  EXPECT_FALSE(CollisionChecker::overlap(box1, box2));
+  EXPECT_FALSE(CollisionChecker::overlap(box2, box1));
+
+  // A vehicle changing lanes next to another vehicle.
+  const OrientedBox box3(1.0, 2.2, 20.0/180.0*M_PI, 2.0, 1.0);
+  EXPECT_TRUE(CollisionChecker::overlap(box1, box3));
+  EXPECT_TRUE(CollisionChecker::overlap(box3, box1));
+}
+
+TEST(CollisionChecker, collisions) {
+  CollisionChecker checker(5.0);
+  EXPECT_TRUE(checker.collisionFree());
+
+  EXPECT_EQ(checker.add(OrientedBox(0.0, 0.0, 0.0, 2.0, 1.0)), 0);
+  EXPECT_EQ(checker.add(OrientedBox(10.0, 0.0, 0.0, 2.0, 1.0)), 1);
+  EXPECT_EQ(checker.add(OrientedBox(0.0, 3.5, 0.0, 2.0, 1.0)), 2);
+  EXPECT_TRUE(checker.collisionFree());
+
+  // A box spanning several cells overlapping with two boxes.
+  EXPECT_EQ(checker.add(OrientedBox(5.0, 0.0, 0.0, 4.0, 1.0)), 3);
+  const std::vector<std::pair<size_t, size_t>> collisions = checker.collisions();
+  ASSERT_EQ(collisions.size(), 2);
+  EXPECT_EQ(collisions[0].first, 0);
+  EXPECT_EQ(collisions[0].second, 3);
+  EXPECT_EQ(collisions[1].first, 1);
+  EXPECT_EQ(collisions[1].second, 3);
+
+  checker.clear();
+  EXPECT_TRUE(checker.empty());
+  EXPECT_TRUE(checker.collisionFree());
+}
+
+TEST(CollisionChecker, bruteForce) {
+  std::default_random_engine rand_gen(0);
+  std::uniform_real_distribution<double> position_dist(-30.0, 30.0);
+  std::uniform_real_distribution<double> yaw_dist(-M_PI, M_PI);
+  std::uniform_real_distribution<double> length_dist(1.5, 3.0);
+  std::uniform_real_distribution<double> width_dist(0.8, 1.2);
+
+  for (size_t trial = 0; trial < 20; ++trial) {
+    std::vector<OrientedBox> boxes;
+    CollisionChecker checker(4.0);
+    for (size_t i = 0; i < 50; ++i) {
+      boxes.emplace_back(position_dist(rand_gen), position_dist(rand_gen),
+          yaw_dist(rand_gen), length_dist(rand_gen), width_dist(rand_gen));
+      checker.add(boxes.back());
+    }
+
+    std::vector<std::pair<size_t, size_t>> expected;
+    for (size_t i = 0; i < boxes.size(); ++i) {
+      for (size_t j = i+1; j < boxes.size(); ++j) {
+        if (CollisionChecker::overlap(boxes[i], boxes[j])) expected.emplace_back(i, j);
+      }
+    }
+
+    EXPECT_EQ(checker.collisions(), expected);
+  }
+}
+
+TEST(CollisionChecker, firstCollision) {
+  // Two vehicles approaching each other on the same lane.
+  std::vector<std::vector<OrientedBox>> frames;
+  for (size_t i = 0; i < 10; ++i) {
+    frames.push_back({
+        OrientedBox(static_cast<double>(i), 0.0, 0.0, 2.0, 1.0),
+        OrientedBox(20.0-static_cast<double>(i), 0.0, M_PI, 2.0, 1.0)});
+  }
+
+  CollisionChecker checker;
+  const boost::optional<size_t> step = checker.firstCollision(frames);
+  ASSERT_TRUE(static_cast<bool>(step));
+  EXPECT_EQ(*step, 8);
+
+  frames.resize(8);
+  EXPECT_FALSE(static_cast<bool>(checker.firstCollision(frames)));
+}
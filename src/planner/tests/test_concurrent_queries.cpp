@@ -0,0 +1,102 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <gtest/gtest.h>
+#include <boost/smart_ptr.hpp>
+
+#include <planner/common/fast_waypoint_map.h>
+#include <planner/common/waypoint_lattice.h>
+#include <planner/tests/town04_map.h>
+
+using namespace planner;
+
+/**
+ * The test requires the Town04 map, see \c Town04Map for how the map is
+ * loaded. The test is skipped if the map is not available.
+ *
+ * Build with -DENABLE_TSAN=ON to run the test under ThreadSanitizer.
+ */
+class ConcurrentQueries : public Town04Map {
+
+protected:
+
+  static constexpr size_t kThreadNum_ = 8;
+  static constexpr size_t kQueryRounds_ = 20;
+
+  boost::shared_ptr<const utils::FastWaypointMap> fast_map_ = nullptr;
+  boost::shared_ptr<const WaypointLattice> lattice_ = nullptr;
+
+  virtual void SetUp() override {
+    Town04Map::SetUp();
+    if (!map_ || HasFatalFailure()) return;
+
+    fast_map_ = boost::make_shared<const utils::FastWaypointMap>(map_);
+    lattice_ = boost::make_shared<const WaypointLattice>(queries_.front(), 150.0, 1.0, router_);
+    return;
+  }
+};
+
+TEST_F(ConcurrentQueries, readers) {
+  REQUIRE_TOWN04_MAP();
+
+  // Results of the queries computed with a single thread.
+  std::vector<uint64_t> fast_map_results;
+  std::vector<uint64_t> router_results;
+  std::vector<size_t> lattice_results;
+
+  auto query = [this](const boost::shared_ptr<CarlaWaypoint>& waypoint,
+                      uint64_t& fast_map_result,
+                      uint64_t& router_result,
+                      size_t& lattice_result)->void {
+    fast_map_result = fast_map_->waypoint(waypoint->GetTransform().location)->GetId();
+
+    boost::shared_ptr<CarlaWaypoint> front = router_->frontWaypoint(waypoint, 10.0);
+    router_result = front ? front->GetId() : 0;
+
+    boost::shared_ptr<const WaypointNode> node = lattice_->closestNode(waypoint, 1.0);
+    if (node) node = lattice_->front(node->waypoint(), 20.0);
+    lattice_result = node ? node->id() : 0;
+  };
+
+  fast_map_results.resize(queries_.size());
+  router_results.resize(queries_.size());
+  lattice_results.resize(queries_.size());
+  for (size_t i = 0; i < queries_.size(); ++i)
+    query(queries_[i], fast_map_results[i], router_results[i], lattice_results[i]);
+
+  // Run the same queries with many threads, each starting at a different offset.
+  std::atomic<size_t> mismatches(0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreadNum_; ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t round = 0; round < kQueryRounds_; ++round) {
+        for (size_t k = 0; k < queries_.size(); ++k) {
+          const size_t i = (k + t*queries_.size()/kThreadNum_) % queries_.size();
+          uint64_t fast_map_result = 0; uint64_t router_result = 0; size_t lattice_result = 0;
+          query(queries_[i], fast_map_result, router_result, lattice_result);
+          if (fast_map_result != fast_map_results[i] ||
+              router_result   != router_results[i] ||
+              lattice_result  != lattice_results[i]) ++mismatches;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  EXPECT_EQ(mismatches.load(), 0);
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <list>
+#include <vector>
+#include <utility>
+#include <gtest/gtest.h>
+#include <boost/smart_ptr.hpp>
+
+#include <planner/spatiotemporal_lattice_planner/spatiotemporal_lattice_planner.h>
+#include <planner/tests/town04_snapshot.h>
+
+using namespace planner;
+using namespace planner::spatiotemporal_lattice_planner;
+
+/// Exposes the vertex graph of \c SpatiotemporalLatticePlanner to the tests.
+class PlannerProbe : public SpatiotemporalLatticePlanner {
+public:
+  using SpatiotemporalLatticePlanner::SpatiotemporalLatticePlanner;
+  using SpatiotemporalLatticePlanner::signatures_;
+  using SpatiotemporalLatticePlanner::node_to_vertices_table_;
+};
+
+/**
+ * The test requires the Town04 map, see \c Town04Map for how the map is
+ * loaded. The test is skipped if the map is not available.
+ *
+ * A pruned vertex is dominated by another vertex reaching the same traffic
+ * scenario at the same node, which is no worse in time, speed, and cost.
+ * Pruning should therefore shrink the vertex graph without changing the
+ * selected trajectory.
+ */
+class DominancePruning : public Town04Snapshot {
+
+protected:
+
+  using Trajectory = std::list<std::pair<ContinuousPath, double>>;
+
+  /// Plan on the snapshot with a new planner.
+  Trajectory plan(const Snapshot& snapshot,
+                  const bool dominance_pruning,
+                  boost::shared_ptr<PlannerProbe>& planner) const {
+    planner = boost::make_shared<PlannerProbe>(0.1, 150.0, router_, map_, fast_map_);
+    planner->dominancePruning() = dominance_pruning;
+    return planner->planTraj(snapshot.ego().id(), snapshot);
+  }
+
+  /// Check the trajectories are the same.
+  static void expectSameTrajectory(const Trajectory& traj1, const Trajectory& traj2) {
+    ASSERT_FALSE(traj1.empty());
+    ASSERT_EQ(traj1.size(), traj2.size());
+
+    for (auto piece1 = traj1.begin(), piece2 = traj2.begin();
+         piece1 != traj1.end(); ++piece1, ++piece2) {
+      EXPECT_DOUBLE_EQ(piece1->second, piece2->second);
+      EXPECT_NEAR(piece1->first.range(), piece2->first.range(), 1e-3);
+
+      const carla::geom::Location end1 =
+        piece1->first.transformAt(piece1->first.range()).first.location;
+      const carla::geom::Location end2 =
+        piece2->first.transformAt(piece2->first.range()).first.location;
+      EXPECT_NEAR(end1.Distance(end2), 0.0, 1e-3);
+    }
+  }
+
+  /// Number of vertices reached from more than one parent, i.e. the vertices
+  /// whose snapshots may have been replaced after they were queued.
+  static size_t reparentedVertices(const PlannerProbe& planner) {
+    size_t num = 0;
+    for (const auto& node : planner.node_to_vertices_table_) {
+      for (const auto& item : node.second)
+        if (item.second->parentsSize() > 1) ++num;
+    }
+    return num;
+  }
+};
+
+TEST_F(DominancePruning, sameTrajectory) {
+  REQUIRE_TOWN04_MAP();
+
+  // Free road, traffic slower than the ego, and a slow ego behind traffic,
+  // at two different locations on the route.
+  const boost::shared_ptr<CarlaWaypoint> start = queries_.front();
+  const boost::shared_ptr<CarlaWaypoint> middle = queries_[queries_.size()/2];
+  std::vector<boost::shared_ptr<Snapshot>> snapshots;
+  ASSERT_NO_THROW(snapshots = std::vector<boost::shared_ptr<Snapshot>>({
+        snapshot_,
+        createSnapshot(middle, 10.0, {}),
+        createSnapshot(middle, 28.0, {{20.0, 10.0, 10.0}, {45.0, 12.0, 15.0}}),
+        createSnapshot(start, 5.0, {{15.0, 20.0, 20.0}, {60.0, 8.0, 10.0}}),
+  }));
+
+  size_t reparented = 0;
+  for (const auto& snapshot : snapshots) {
+    boost::shared_ptr<PlannerProbe> pruned_planner, full_planner;
+    Trajectory pruned_traj, full_traj;
+    ASSERT_NO_THROW(pruned_traj = plan(*snapshot, true, pruned_planner));
+    ASSERT_NO_THROW(full_traj = plan(*snapshot, false, full_planner));
+
+    // Nothing is pruned if pruning is disabled.
+    EXPECT_EQ(full_planner->pruningStats().pruned, 0);
+    expectSameTrajectory(pruned_traj, full_traj);
+
+    // The signatures follow the snapshots of the vertices,
+    // which change as new optimal parents are found.
+    reparented += reparentedVertices(*pruned_planner);
+    for (const auto& item : pruned_planner->signatures_) {
+      EXPECT_TRUE(item.second == SnapshotSignature(
+            item.first->snapshot(), pruned_planner->signatureResolution()));
+    }
+  }
+
+  // The parents of some vertices are updated in the scenarios.
+  EXPECT_GT(reparented, 0);
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#include <limits>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include <planner/common/driver_model_table.h>
+
+using namespace planner;
+
+TEST(DriverModelTable, vehicleClasses) {
+  DriverModelTable table;
+  EXPECT_TRUE(table.classes().empty());
+  EXPECT_DOUBLE_EQ(table.model(4.0)->timeGap(), 1.0);
+
+  // The classes are sorted by their maximum lengths.
+  table.add("truck", std::numeric_limits<double>::infinity(),
+            boost::make_shared<const IntelligentDriverModel>(2.0, 10.0));
+  table.add("two_wheeler", 2.5,
+            boost::make_shared<const IntelligentDriverModel>(0.8, 3.0));
+  table.add("car", 5.5,
+            boost::make_shared<const IntelligentDriverModel>(1.2, 5.0));
+  ASSERT_EQ(table.classes().size(), 3u);
+  EXPECT_EQ(table.classes()[0].name, "two_wheeler");
+  EXPECT_EQ(table.classes()[1].name, "car");
+  EXPECT_EQ(table.classes()[2].name, "truck");
+
+  EXPECT_DOUBLE_EQ(table.model(2.0)->timeGap(), 0.8);
+  EXPECT_DOUBLE_EQ(table.model(2.5)->timeGap(), 0.8);
+  EXPECT_DOUBLE_EQ(table.model(4.5)->timeGap(), 1.2);
+  EXPECT_DOUBLE_EQ(table.model(12.0)->distanceGap(), 10.0);
+
+  EXPECT_THROW(table.add("bus", 0.0, table.defaultModel()), std::runtime_error);
+  EXPECT_THROW(table.add("bus", 12.0, nullptr), std::runtime_error);
+}
+
+TEST(DriverModelTable, defaultModel) {
+  // Vehicles longer than all classes use the default model.
+  DriverModelTable table(boost::make_shared<const IntelligentDriverModel>(1.5));
+  table.add("car", 5.5, boost::make_shared<const IntelligentDriverModel>(1.2));
+  EXPECT_DOUBLE_EQ(table.model(4.5)->timeGap(), 1.2);
+  EXPECT_DOUBLE_EQ(table.model(8.0)->timeGap(), 1.5);
+
+  EXPECT_THROW(DriverModelTable(nullptr), std::runtime_error);
+}
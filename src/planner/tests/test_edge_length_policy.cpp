@@ -0,0 +1,67 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <vector>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include <planner/common/edge_length_policy.h>
+
+using namespace planner;
+
+TEST(EdgeLengthPolicy, defaultLength) {
+  // The default policy always uses 50m edges.
+  EdgeLengthPolicy policy;
+  EXPECT_DOUBLE_EQ(policy.length(0.0, 30.0), 50.0);
+  EXPECT_DOUBLE_EQ(policy.length(0.0, 0.0, 5.0), 50.0);
+  EXPECT_DOUBLE_EQ(policy.length(120.0, 10.0), 50.0);
+
+  EXPECT_THROW(EdgeLengthPolicy(std::vector<double>()), std::runtime_error);
+  EXPECT_THROW(EdgeLengthPolicy({50.0, 0.0}), std::runtime_error);
+}
+
+TEST(EdgeLengthPolicy, adaptiveLength) {
+  EdgeLengthPolicy policy({80.0, 30.0, 50.0, 50.0}, 100.0, 3.0);
+  EXPECT_EQ(policy.lengths(), std::vector<double>({30.0, 50.0, 80.0}));
+
+  // Close to the root, the edge covers the distance travelled in 3s.
+  EXPECT_DOUBLE_EQ(policy.length(0.0, 5.0), 30.0);
+  EXPECT_DOUBLE_EQ(policy.length(0.0, 15.0), 50.0);
+  EXPECT_DOUBLE_EQ(policy.length(50.0, 20.0), 80.0);
+  EXPECT_DOUBLE_EQ(policy.length(0.0, 40.0), 80.0);
+
+  // The edge does not go beyond the gap to the front vehicle.
+  EXPECT_DOUBLE_EQ(policy.length(0.0, 20.0, 35.0), 50.0);
+  EXPECT_DOUBLE_EQ(policy.length(0.0, 20.0, 20.0), 30.0);
+  EXPECT_DOUBLE_EQ(policy.length(0.0, 20.0, -5.0), 30.0);
+
+  // Further out, the longest edges are used.
+  EXPECT_DOUBLE_EQ(policy.length(100.0, 5.0, 10.0), 80.0);
+}
+
+TEST(EdgeLengthPolicy, alignedLength) {
+  EdgeLengthPolicy policy({30.0, 50.0, 80.0}, 100.0, 3.0, 10.0);
+
+  // Edges from aligned vertices are not extended.
+  EXPECT_DOUBLE_EQ(policy.length(0.0, 5.0), 30.0);
+  EXPECT_DOUBLE_EQ(policy.length(30.0, 15.0), 50.0);
+
+  // Edges from other vertices end at the next multiple of the alignment.
+  EXPECT_DOUBLE_EQ(policy.length(37.0, 5.0), 33.0);
+  EXPECT_DOUBLE_EQ(policy.length(104.0, 5.0), 86.0);
+
+  // Edges of different lengths from different vertices end at the same distance.
+  EXPECT_DOUBLE_EQ(37.0+policy.length(37.0, 5.0), 40.0+policy.length(40.0, 5.0));
+  EXPECT_DOUBLE_EQ(20.0+policy.length(20.0, 15.0), 40.0+policy.length(40.0, 5.0));
+}
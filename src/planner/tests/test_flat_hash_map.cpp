@@ -0,0 +1,93 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string>
+#include <random>
+#include <unordered_map>
+#include <gtest/gtest.h>
+#include <planner/common/flat_hash_map.h>
+
+using namespace utils;
+
+TEST(FlatHashMap, accessors) {
+  FlatHashMap<size_t, std::string> map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.count(1), 0);
+  EXPECT_TRUE(map.find(1) == map.end());
+
+  map[1] = "one";
+  EXPECT_TRUE(map.insert(std::make_pair(2, std::string("two"))).second);
+  EXPECT_FALSE(map.insert(std::make_pair(2, std::string("deux"))).second);
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_EQ(map.at(1), "one");
+  EXPECT_EQ(map.find(2)->second, "two");
+  EXPECT_THROW(map.at(3), std::out_of_range);
+
+  EXPECT_EQ(map.erase(1), 1);
+  EXPECT_EQ(map.erase(1), 0);
+  EXPECT_EQ(map.size(), 1);
+
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.begin() == map.end());
+}
+
+TEST(FlatHashMap, reserve) {
+  FlatHashMap<size_t, int> map;
+  map.reserve(100);
+  const size_t capacity = map.capacity();
+  EXPECT_GE(capacity, 100);
+
+  for (size_t i = 0; i < 100; ++i) map[i] = i;
+  EXPECT_EQ(map.capacity(), capacity);
+}
+
+TEST(FlatHashMap, randomOperations) {
+  // Compare against std::unordered_map with a random sequence of operations.
+  FlatHashMap<size_t, int> map;
+  std::unordered_map<size_t, int> reference;
+
+  std::mt19937 rand_gen(0);
+  for (int i = 0; i < 100000; ++i) {
+    const size_t key = rand_gen() % 1000;
+    switch (rand_gen() % 3) {
+      case 0:
+        map[key] = i;
+        reference[key] = i;
+        break;
+      case 1:
+        EXPECT_EQ(map.erase(key), reference.erase(key));
+        break;
+      default:
+        ASSERT_EQ(map.count(key), reference.count(key));
+        if (reference.count(key)) {
+          EXPECT_EQ(map.find(key)->second, reference[key]);
+        }
+    }
+    ASSERT_EQ(map.size(), reference.size());
+  }
+
+  // Every element should be visited exactly once in iteration.
+  size_t visited = 0;
+  for (const auto& item : map) {
+    EXPECT_EQ(item.second, reference[item.first]);
+    ++visited;
+  }
+  EXPECT_EQ(visited, reference.size());
+
+  // Copies are independent of the original.
+  const FlatHashMap<size_t, int> copy = map;
+  map.clear();
+  EXPECT_EQ(copy.size(), reference.size());
+}
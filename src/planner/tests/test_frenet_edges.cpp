@@ -0,0 +1,92 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cmath>
+#include <vector>
+#include <gtest/gtest.h>
+#include <boost/optional.hpp>
+#include <boost/smart_ptr.hpp>
+
+#include <planner/idm_lattice_planner/idm_lattice_planner.h>
+#include <planner/tests/town04_snapshot.h>
+
+using namespace planner;
+using namespace planner::idm_lattice_planner;
+
+/**
+ * The test requires the Town04 map, see \c Town04Map for how the map is
+ * loaded. The test is skipped if the map is not available.
+ *
+ * With \c IDMLatticePlanner::frenetEdges() set, the keep lane and lane
+ * change edges on the highway are \c FrenetPath, and the planned path
+ * is continuous across the edges.
+ */
+class FrenetEdges : public Town04Snapshot {
+
+protected:
+
+  boost::shared_ptr<IDMLatticePlanner> planner_ = nullptr;
+
+  virtual void SetUp() override {
+    Town04Snapshot::SetUp();
+    if (!map_ || HasFatalFailure()) return;
+    planner_ = boost::make_shared<IDMLatticePlanner>(
+        0.1, 150.0, router_, map_, fast_map_);
+    return;
+  }
+
+  /// Count the edges of each lane change type which are \c FrenetPath.
+  std::vector<size_t> frenetEdges() const {
+    std::vector<size_t> counts(3, 0);
+    for (const EdgePath& edge : planner_->edges()) {
+      if (!boost::get<FrenetPath>(&edge)) continue;
+      ++counts[vehiclePath(edge).laneChangeType()];
+    }
+    return counts;
+  }
+};
+
+TEST_F(FrenetEdges, continuousPathByDefault) {
+  REQUIRE_TOWN04_MAP();
+
+  ASSERT_NO_THROW(planner_->planPath(snapshot_->ego().id(), *snapshot_));
+  ASSERT_FALSE(planner_->edges().empty());
+  const std::vector<size_t> counts = frenetEdges();
+  EXPECT_EQ(counts[VehiclePath::KeepLane], 0);
+  EXPECT_EQ(counts[VehiclePath::LeftLaneChange], 0);
+  EXPECT_EQ(counts[VehiclePath::RightLaneChange], 0);
+}
+
+TEST_F(FrenetEdges, keepLaneAndLaneChange) {
+  REQUIRE_TOWN04_MAP();
+
+  planner_->frenetEdges() = true;
+  boost::optional<DiscretePath> path = boost::none;
+  ASSERT_NO_THROW(path = planner_->planPath(snapshot_->ego().id(), *snapshot_));
+
+  const std::vector<size_t> counts = frenetEdges();
+  EXPECT_GT(counts[VehiclePath::KeepLane], 0);
+  EXPECT_GT(counts[VehiclePath::LeftLaneChange] + counts[VehiclePath::RightLaneChange], 0);
+
+  // The planned path starts at the ego, and has no gaps between the edges.
+  auto distance = [](const carla::geom::Location& l1, const carla::geom::Location& l2)->double{
+    return std::hypot(l1.x-l2.x, l1.y-l2.y);
+  };
+  EXPECT_NEAR(distance(path->startTransform().first.location,
+                       snapshot_->ego().transform().location), 0.0, 0.1);
+  for (double s = 0.5; s <= path->range(); s += 0.5) {
+    EXPECT_LT(distance(path->transformAt(s).first.location,
+                       path->transformAt(s-0.5).first.location), 0.6);
+  }
+}
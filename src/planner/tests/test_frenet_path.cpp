@@ -0,0 +1,208 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <cmath>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include <carla/geom/Transform.h>
+#include <planner/common/vehicle_path.h>
+
+using namespace planner;
+using CarlaTransform = carla::geom::Transform;
+
+namespace {
+
+/// Create a carla (left handed) transform from a right handed pose.
+std::pair<CarlaTransform, double> carlaTransform(
+    const double x, const double y, const double theta, const double kappa) {
+  CarlaTransform transform(carla::geom::Location(x, -y, 0.0),
+                           carla::geom::Rotation(0.0, -theta/M_PI*180.0, 0.0));
+  return std::make_pair(transform, -kappa);
+}
+
+/// Samples on a counterclockwise arc (right handed) starting from the origin
+/// with heading 0. A zero curvature gives a straight line along x.
+std::vector<std::pair<CarlaTransform, double>> arcReference(
+    const double kappa, const double length, const double resolution=1.0) {
+  std::vector<std::pair<CarlaTransform, double>> reference;
+  for (double s = 0.0; s <= length+1e-6; s += resolution) {
+    if (kappa == 0.0) {
+      reference.push_back(carlaTransform(s, 0.0, 0.0, 0.0));
+    } else {
+      const double phi = s * kappa;
+      reference.push_back(carlaTransform(
+            std::sin(phi)/kappa, (1.0-std::cos(phi))/kappa, phi, kappa));
+    }
+  }
+  return reference;
+}
+
+} // End anonymous namespace.
+
+TEST(FrenetPath, straightKeepLane) {
+  const auto reference = arcReference(0.0, 100.0);
+  FrenetPath path(reference,
+                  carlaTransform(10.0, 0.0, 0.0, 0.0),
+                  carlaTransform(60.0, 0.0, 0.0, 0.0),
+                  VehiclePath::KeepLane);
+
+  EXPECT_NEAR(path.referenceStart(), 10.0, 1e-6);
+  EXPECT_NEAR(path.referenceEnd(), 60.0, 1e-6);
+  EXPECT_NEAR(path.range(), 50.0, 1e-6);
+
+  for (double s = 0.0; s <= path.range(); s += 5.0) {
+    const auto transform = path.transformAt(s);
+    EXPECT_NEAR(transform.first.location.x, 10.0+s, 1e-6);
+    EXPECT_NEAR(transform.first.location.y, 0.0, 1e-6);
+    EXPECT_NEAR(transform.second, 0.0, 1e-9);
+  }
+}
+
+TEST(FrenetPath, straightLaneChange) {
+  const auto reference = arcReference(0.0, 100.0);
+  // Carla is left handed, a left lane change moves towards -y.
+  FrenetPath path(reference,
+                  carlaTransform(0.0, 0.0, 0.0, 0.0),
+                  carlaTransform(50.0, 3.5, 0.0, 0.0),
+                  VehiclePath::LeftLaneChange);
+
+  // Boundary conditions are matched exactly.
+  const auto d0 = path.lateralOffset(path.referenceStart());
+  const auto d1 = path.lateralOffset(path.referenceEnd());
+  EXPECT_NEAR(d0[0], 0.0, 1e-9);
+  EXPECT_NEAR(d0[1], 0.0, 1e-9);
+  EXPECT_NEAR(d0[2], 0.0, 1e-9);
+  EXPECT_NEAR(d1[0], 3.5, 1e-9);
+  EXPECT_NEAR(d1[1], 0.0, 1e-9);
+  EXPECT_NEAR(d1[2], 0.0, 1e-9);
+
+  // The path is longer than the reference, but only slightly.
+  EXPECT_GT(path.range(), 50.0);
+  EXPECT_LT(path.range(), 50.5);
+
+  const auto start = path.transformAt(0.0);
+  const auto end = path.transformAt(path.range());
+  EXPECT_NEAR(start.first.location.x, 0.0, 1e-6);
+  EXPECT_NEAR(start.first.location.y, 0.0, 1e-6);
+  EXPECT_NEAR(end.first.location.x, 50.0, 1e-6);
+  EXPECT_NEAR(end.first.location.y, -3.5, 1e-6);
+  EXPECT_NEAR(end.second, 0.0, 1e-9);
+
+  // The path is symmetric around the middle, where the heading peaks.
+  const auto mid = path.transformAt(0.5*path.range());
+  EXPECT_NEAR(mid.first.location.x, 25.0, 1e-3);
+  EXPECT_NEAR(mid.first.location.y, -1.75, 1e-3);
+  EXPECT_LT(mid.first.rotation.yaw, 0.0);
+  EXPECT_NEAR(mid.second, 0.0, 1e-6);
+
+  // Consecutive samples are spaced by the distance on the path.
+  const auto s1 = path.transformAt(20.0);
+  const auto s2 = path.transformAt(20.5);
+  EXPECT_NEAR((s1.first.location-s2.first.location).Length(), 0.5, 1e-3);
+
+  // The conversion to discrete path keeps the geometry.
+  DiscretePath discrete_path(path);
+  EXPECT_EQ(discrete_path.laneChangeType(), VehiclePath::LeftLaneChange);
+  const auto discrete_mid = discrete_path.transformAt(0.5*path.range());
+  EXPECT_NEAR(discrete_mid.first.location.x, mid.first.location.x, 1e-2);
+  EXPECT_NEAR(discrete_mid.first.location.y, mid.first.location.y, 1e-2);
+}
+
+TEST(FrenetPath, discretePathKeepsEnd) {
+  const auto reference = arcReference(0.0, 100.0);
+  // The range is not a multiple of the resolution of the discrete path.
+  FrenetPath path(reference,
+                  carlaTransform(0.0, 0.0, 0.0, 0.0),
+                  carlaTransform(50.0, 3.5, 0.0, 0.0),
+                  VehiclePath::LeftLaneChange);
+
+  DiscretePath discrete_path(path);
+  EXPECT_NEAR(discrete_path.range(), path.range(), 1e-9);
+  EXPECT_NEAR(discrete_path.endTransform().first.location.x, 50.0, 1e-6);
+  EXPECT_NEAR(discrete_path.endTransform().first.location.y, -3.5, 1e-6);
+}
+
+TEST(FrenetPath, curvedKeepLane) {
+  const double kappa = 1.0 / 500.0;
+  const auto reference = arcReference(kappa, 200.0);
+
+  // Follow a lane 3.5m to the left of the reference, i.e. the inner lane.
+  const double d = 3.5;
+  const double r = 1.0/kappa - d;
+  auto offsetTransform = [&](const double s) {
+    const double phi = s * kappa;
+    return carlaTransform(std::sin(phi)*r, 1.0/kappa-std::cos(phi)*r, phi, 1.0/r);
+  };
+
+  FrenetPath path(reference, offsetTransform(20.0), offsetTransform(120.0),
+                  VehiclePath::KeepLane);
+
+  EXPECT_NEAR(path.referenceStart(), 20.0, 1e-2);
+  EXPECT_NEAR(path.referenceEnd(), 120.0, 1e-2);
+  EXPECT_NEAR(path.range(), 100.0*r*kappa, 1e-2);
+
+  for (double s = 0.0; s <= path.range(); s += 10.0) {
+    const auto transform = path.transformAt(s);
+    const double radius = std::hypot(transform.first.location.x,
+                                     transform.first.location.y+1.0/kappa);
+    EXPECT_NEAR(radius, r, 1e-2);
+    EXPECT_NEAR(transform.second, -1.0/r, 1e-5);
+  }
+}
+
+TEST(FrenetPath, curvatureMatchesHeadingRate) {
+  const double kappa = 1.0 / 300.0;
+  const auto reference = arcReference(kappa, 200.0);
+  const auto start = reference[10];
+  const auto end = std::make_pair(
+      CarlaTransform(reference[70].first.location +
+                     carla::geom::Location(0.0, 3.0, 0.0),
+                     reference[70].first.rotation),
+      reference[70].second);
+
+  FrenetPath path(reference, start, end, VehiclePath::RightLaneChange);
+
+  const double ds = 0.01;
+  for (double s = 1.0; s < path.range()-1.0; s += 7.0) {
+    const auto t1 = path.transformAt(s-ds);
+    const auto t2 = path.transformAt(s+ds);
+    const double dyaw = std::remainder(
+        t2.first.rotation.yaw-t1.first.rotation.yaw, 360.0) / 180.0 * M_PI;
+    EXPECT_NEAR(path.transformAt(s).second, dyaw/(2.0*ds), 2e-4);
+  }
+}
+
+TEST(FrenetPath, invalidInputs) {
+  const auto reference = arcReference(0.0, 100.0);
+
+  EXPECT_THROW(FrenetPath(std::vector<std::pair<CarlaTransform, double>>(
+          1, reference.front()), reference[0], reference[1],
+        VehiclePath::KeepLane), std::runtime_error);
+
+  // The end is behind the start.
+  EXPECT_THROW(FrenetPath(reference, reference[50], reference[10],
+        VehiclePath::KeepLane), std::runtime_error);
+
+  // The start is heading against the reference line.
+  EXPECT_THROW(FrenetPath(reference, carlaTransform(10.0, 0.0, M_PI, 0.0),
+        reference[50], VehiclePath::KeepLane), std::runtime_error);
+
+  FrenetPath path(reference, reference[10], reference[50], VehiclePath::KeepLane);
+  EXPECT_THROW(path.transformAt(-0.1), std::runtime_error);
+  EXPECT_THROW(path.transformAt(path.range()+0.1), std::runtime_error);
+  EXPECT_THROW(path.lateralOffset(5.0), std::runtime_error);
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <gtest/gtest.h>
+#include <boost/smart_ptr.hpp>
+
+#include <planner/idm_lattice_planner/hierarchical_idm_lattice_planner.h>
+#include <planner/tests/town04_snapshot.h>
+
+using namespace planner;
+using namespace planner::idm_lattice_planner;
+
+/**
+ * The test requires the Town04 map, see \c Town04Map for how the map is
+ * loaded. The test is skipped if the map is not available.
+ *
+ * In the first planning cycle after a coarse plan, the root stations of both
+ * planners have the same snapshot. With the edges of the fine planner aligned
+ * to the coarse plan, the first coarse edge is reused by the fine planner.
+ * Without the alignment, the 50m edges of the fine planner never span the
+ * 100m edges of the coarse plan.
+ */
+class HierarchicalPlanning : public Town04Snapshot {
+
+protected:
+
+  boost::shared_ptr<HierarchicalIDMLatticePlanner> planner_ = nullptr;
+
+  virtual void SetUp() override {
+    Town04Snapshot::SetUp();
+    if (!map_ || HasFatalFailure()) return;
+
+    // No traffic in front of the ego, so that the edges are not
+    // shortened by the front gap.
+    ASSERT_NO_THROW(snapshot_ = createSnapshot(queries_.front(), 20.0, {}));
+    planner_ = boost::make_shared<HierarchicalIDMLatticePlanner>(
+        0.1, 150.0, 300.0, 100.0, 10, router_, map_, fast_map_);
+    return;
+  }
+};
+
+TEST_F(HierarchicalPlanning, coarseEdgeReused) {
+  REQUIRE_TOWN04_MAP();
+
+  ASSERT_NO_THROW(planner_->planPath(snapshot_->ego().id(), *snapshot_));
+  ASSERT_TRUE(planner_->corridor());
+  EXPECT_GT(planner_->coarseEdgeHits(), 0);
+}
+
+TEST_F(HierarchicalPlanning, coarseEdgeNotAligned) {
+  REQUIRE_TOWN04_MAP();
+
+  planner_->alignToCoarsePlan() = false;
+  ASSERT_NO_THROW(planner_->planPath(snapshot_->ego().id(), *snapshot_));
+  ASSERT_TRUE(planner_->corridor());
+  EXPECT_EQ(planner_->coarseEdgeHits(), 0);
+  EXPECT_EQ(planner_->coarseEdgeMisses(), 0);
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cmath>
+#include <vector>
+#include <utility>
+#include <gtest/gtest.h>
+#include <boost/smart_ptr.hpp>
+
+#include <planner/lane_follower/lane_follower.h>
+#include <planner/tests/town04_snapshot.h>
+
+using namespace planner;
+
+using CarlaTransform = carla::geom::Transform;
+using Samples = std::vector<std::pair<CarlaTransform, double>>;
+
+/// Exposes the internals of \c LaneFollower to the tests.
+class LaneFollowerProbe : public lane_follower::LaneFollower {
+public:
+  using LaneFollower::LaneFollower;
+  using LaneFollower::densifySamples;
+  using LaneFollower::decayLateralOffset;
+  using LaneFollower::node_sample_table_;
+};
+
+namespace {
+
+/// Lane center samples along the x axis, 5m apart as the lattice nodes.
+Samples straightSamples(const size_t num) {
+  Samples samples;
+  for (size_t i = 0; i < num; ++i) {
+    samples.push_back(std::make_pair(
+          CarlaTransform(carla::geom::Location(5.0*i, 0.0, 0.0),
+                         carla::geom::Rotation(0.0, 0.0, 0.0)),
+          0.0));
+  }
+  return samples;
+}
+
+} // End anonymous namespace.
+
+TEST(OffsetDecay, densify) {
+  Samples samples = straightSamples(5);
+  LaneFollowerProbe::densifySamples(10.0, 1.0, samples);
+
+  // The first 10m are sampled at 1m, the rest is left as it is.
+  ASSERT_EQ(samples.size(), 13);
+  for (size_t i = 0; i <= 10; ++i)
+    EXPECT_NEAR(samples[i].first.location.x, static_cast<double>(i), 1e-4);
+  EXPECT_NEAR(samples[11].first.location.x, 15.0, 1e-4);
+  EXPECT_NEAR(samples[12].first.location.x, 20.0, 1e-4);
+}
+
+TEST(OffsetDecay, densifyHeading) {
+  // The heading is interpolated through the shortest angle.
+  Samples samples = straightSamples(2);
+  samples[0].first.rotation.yaw = 350.0;
+  samples[1].first.rotation.yaw = 10.0;
+  samples[0].second = 0.0;
+  samples[1].second = 0.1;
+  LaneFollowerProbe::densifySamples(10.0, 1.0, samples);
+
+  ASSERT_EQ(samples.size(), 6);
+  EXPECT_NEAR(utils::shortestAngle(samples[2].first.rotation.yaw, 358.0), 0.0, 1e-4);
+  EXPECT_NEAR(samples[2].second, 0.04, 1e-6);
+}
+
+TEST(OffsetDecay, smoothstep) {
+  const double offset = 0.5;
+  const double range = 10.0;
+  Samples samples = straightSamples(5);
+  LaneFollowerProbe::densifySamples(range, 1.0, samples);
+  LaneFollowerProbe::decayLateralOffset(offset, range, samples);
+
+  // The path starts at the vehicle, on the right of the lane center,
+  // with the heading of the lane.
+  EXPECT_NEAR(samples.front().first.location.y, offset, 1e-4);
+  EXPECT_NEAR(utils::shortestAngle(samples.front().first.rotation.yaw, 0.0), 0.0, 1e-4);
+
+  // Halfway, half of the offset is removed, with the steepest heading change.
+  EXPECT_NEAR(samples[5].first.location.y, 0.5*offset, 1e-4);
+  EXPECT_NEAR(utils::shortestAngle(samples[5].first.rotation.yaw, 0.0),
+              std::atan(-1.5*offset/range)/M_PI*180.0, 1e-3);
+
+  // The offset decreases monotonically, and is removed beyond the range.
+  for (size_t i = 1; i < samples.size(); ++i)
+    EXPECT_LE(samples[i].first.location.y, samples[i-1].first.location.y+1e-6);
+  for (size_t i = 10; i < samples.size(); ++i) {
+    EXPECT_NEAR(samples[i].first.location.y, 0.0, 1e-6);
+    EXPECT_NEAR(utils::shortestAngle(samples[i].first.rotation.yaw, 0.0), 0.0, 1e-6);
+  }
+}
+
+/**
+ * The test requires the Town04 map, see \c Town04Map for how the map is
+ * loaded. The test is skipped if the map is not available.
+ */
+class NodeSampleTable : public Town04Snapshot {};
+
+TEST_F(NodeSampleTable, evictOnShift) {
+  REQUIRE_TOWN04_MAP();
+
+  LaneFollowerProbe lane_follower(map_, fast_map_, queries_.front(), 150.0, router_);
+  ASSERT_NO_THROW(lane_follower.planPath(snapshot_->ego().id(), *snapshot_));
+
+  const size_t size = lane_follower.node_sample_table_.size();
+  EXPECT_GT(size, 0);
+
+  // The samples behind the shifted lattice are evicted.
+  lane_follower.shiftWaypointLattice(30.0);
+  EXPECT_LT(lane_follower.node_sample_table_.size(), size);
+  for (const auto& item : lane_follower.node_sample_table_)
+    EXPECT_FALSE(item.second.node.expired());
+
+  // The samples are dropped with a new lattice.
+  lane_follower.waypointLattice() = boost::make_shared<WaypointLattice>(
+      queries_.front(), 150.0, 5.0, router_);
+  ASSERT_NO_THROW(lane_follower.planPath(snapshot_->ego().id(), *snapshot_));
+  EXPECT_EQ(lane_follower.node_sample_table_.size(), size);
+}
+
+TEST_F(NodeSampleTable, reuseAcrossCycles) {
+  REQUIRE_TOWN04_MAP();
+
+  LaneFollowerProbe lane_follower(map_, fast_map_, queries_.front(), 55.0, router_);
+  ASSERT_NO_THROW(lane_follower.planPath(snapshot_->ego().id(), *snapshot_));
+  const boost::shared_ptr<const WaypointLattice> lattice = lane_follower.waypointLattice();
+
+  // The lattice is shifted, instead of created, as the ego moves along the lane.
+  boost::shared_ptr<planner::Snapshot> snapshot = nullptr;
+  const boost::shared_ptr<CarlaWaypoint> waypoint =
+    router_->frontWaypoint(queries_.front(), 20.0);
+  ASSERT_TRUE(waypoint);
+  ASSERT_NO_THROW(snapshot = createSnapshot(waypoint, 20.0, {}));
+
+  lane_follower.updateWaypointLattice(waypoint, 55.0);
+  EXPECT_EQ(lane_follower.waypointLattice(), lattice);
+  EXPECT_GE(lane_follower.waypointLattice()->range(), 55.0);
+  EXPECT_GT(lane_follower.node_sample_table_.size(), 0);
+  for (const auto& item : lane_follower.node_sample_table_)
+    EXPECT_FALSE(item.second.node.expired());
+  ASSERT_NO_THROW(lane_follower.planPath(snapshot->ego().id(), *snapshot));
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <vector>
+#include <stdexcept>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include <planner/common/lane_occupancy.h>
+
+using namespace planner;
+
+TEST(LaneOccupancy, addVehicles) {
+  LaneOccupancy occupancy(2);
+  EXPECT_EQ(occupancy.lanes(), 2);
+
+  occupancy.add(0, 50.0, 55.0, 2);
+  occupancy.add(0, 10.0, 15.0, 1);
+  occupancy.add(2, 30.0, 35.0, 3);
+
+  // Lanes are expanded on demand, and intervals are sorted by their rear.
+  EXPECT_EQ(occupancy.lanes(), 3);
+  EXPECT_EQ(occupancy.count(0), 2);
+  EXPECT_EQ(occupancy.count(1), 0);
+  EXPECT_EQ(occupancy.count(2), 1);
+  EXPECT_EQ(occupancy.count(5), 0);
+  EXPECT_EQ(occupancy.intervals(0).front().vehicle, 1);
+  EXPECT_EQ(occupancy.intervals(0).back().vehicle, 2);
+
+  EXPECT_THROW(occupancy.intervals(3), std::runtime_error);
+  EXPECT_THROW(occupancy.add(0, 20.0, 10.0, 4), std::runtime_error);
+}
+
+TEST(LaneOccupancy, frontBackVehicles) {
+  LaneOccupancy occupancy;
+  occupancy.add(0, 10.0, 15.0, 1);
+  occupancy.add(0, 50.0, 55.0, 2);
+
+  // Between the two vehicles.
+  boost::optional<std::pair<size_t, double>> front = occupancy.frontVehicle(0, 30.0);
+  boost::optional<std::pair<size_t, double>> back = occupancy.backVehicle(0, 30.0);
+  ASSERT_TRUE(front && back);
+  EXPECT_EQ(front->first, 2);
+  EXPECT_DOUBLE_EQ(front->second, 20.0);
+  EXPECT_EQ(back->first, 1);
+  EXPECT_DOUBLE_EQ(back->second, 15.0);
+
+  // Beyond the end vehicles.
+  EXPECT_FALSE(occupancy.frontVehicle(0, 60.0));
+  EXPECT_FALSE(occupancy.backVehicle(0, 5.0));
+  EXPECT_EQ(occupancy.backVehicle(0, 60.0)->first, 2);
+  EXPECT_EQ(occupancy.frontVehicle(0, 5.0)->first, 1);
+
+  // A vehicle overlapping the location gives a negative gap.
+  front = occupancy.frontVehicle(0, 12.0);
+  back = occupancy.backVehicle(0, 12.0);
+  EXPECT_EQ(front->first, 1);
+  EXPECT_DOUBLE_EQ(front->second, -2.0);
+  EXPECT_EQ(back->first, 1);
+  EXPECT_DOUBLE_EQ(back->second, -3.0);
+
+  // Lanes without vehicles.
+  EXPECT_FALSE(occupancy.frontVehicle(1, 0.0));
+  EXPECT_FALSE(occupancy.backVehicle(1, 100.0));
+}
+
+TEST(LaneOccupancy, overlappingVehicles) {
+  // A long vehicle changing into the lane overlaps a shorter one,
+  // so the heads on the lane are not sorted.
+  LaneOccupancy occupancy;
+  occupancy.add(0, 50.0, 55.0, 3);
+  occupancy.add(0, 15.0, 20.0, 2);
+  occupancy.add(0, 10.0, 40.0, 1);
+
+  boost::optional<std::pair<size_t, double>> front = occupancy.frontVehicle(0, 25.0);
+  ASSERT_TRUE(front);
+  EXPECT_EQ(front->first, 1);
+  EXPECT_DOUBLE_EQ(front->second, -15.0);
+
+  front = occupancy.frontVehicle(0, 45.0);
+  ASSERT_TRUE(front);
+  EXPECT_EQ(front->first, 3);
+  EXPECT_DOUBLE_EQ(front->second, 5.0);
+
+  EXPECT_EQ(occupancy.frontVehicle(0, 5.0)->first, 1);
+  EXPECT_FALSE(occupancy.frontVehicle(0, 55.0));
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <vector>
+#include <tuple>
+#include <algorithm>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include <boost/smart_ptr.hpp>
+
+#include <planner/common/fast_waypoint_map.h>
+#include <planner/common/waypoint_lattice.h>
+#include <planner/common/traffic_lattice.h>
+#include <planner/tests/town04_map.h>
+
+using namespace planner;
+
+/**
+ * The test requires the Town04 map, see \c Town04Map for how the map is
+ * loaded. The test is skipped if the map is not available.
+ */
+class LatticeSerialization : public Town04Map {
+
+protected:
+
+  using CarlaTransform   = carla::geom::Transform;
+  using CarlaBoundingBox = carla::geom::BoundingBox;
+
+protected:
+
+  static constexpr double kRange_ = 150.0;
+
+  boost::shared_ptr<utils::FastWaypointMap> fast_map_ = nullptr;
+  boost::shared_ptr<WaypointLattice> waypoint_lattice_ = nullptr;
+  boost::shared_ptr<TrafficLattice> traffic_lattice_ = nullptr;
+
+  virtual void SetUp() override {
+    Town04Map::SetUp();
+    if (!map_ || HasFatalFailure()) return;
+
+    fast_map_ = boost::make_shared<utils::FastWaypointMap>(map_);
+    waypoint_lattice_ = boost::make_shared<WaypointLattice>(
+        queries_.front(), kRange_, 1.0, router_);
+
+    // Three vehicles 30m apart along the route.
+    std::vector<std::tuple<size_t, CarlaTransform, CarlaBoundingBox>> vehicles;
+    const CarlaBoundingBox bounding_box(
+        carla::geom::Location(0.0, 0.0, 0.0), carla::geom::Vector3D(2.5, 1.0, 0.8));
+    for (size_t i = 0; i < 3; ++i) {
+      boost::shared_ptr<CarlaWaypoint> waypoint = router_->frontWaypoint(queries_.front(), 30.0*i+10.0);
+      ASSERT_TRUE(waypoint);
+      CarlaTransform transform = waypoint->GetTransform();
+      transform.location.z += 0.5;
+      vehicles.push_back(std::make_tuple(100+i, transform, bounding_box));
+    }
+    traffic_lattice_ = boost::make_shared<TrafficLattice>(vehicles, map_, fast_map_, router_);
+    return;
+  }
+
+  template<typename Lattice>
+  static std::string serialize(const Lattice& lattice) {
+    std::ostringstream os;
+    lattice.serialize(os);
+    return os.str();
+  }
+
+  /// IDs of the nodes found by the forward queries from every node of the lattice.
+  template<typename Node>
+  static std::vector<size_t> forwardQueries(const Lattice<Node>& lattice) {
+    std::vector<size_t> results;
+    for (const auto& item : lattice.nodes()) {
+      const boost::shared_ptr<const CarlaWaypoint> query = item.second->waypoint();
+      for (const auto& node : {lattice.front(query, 20.0),
+                               lattice.back(query, 20.0),
+                               lattice.leftFront(query, 20.0),
+                               lattice.rightFront(query, 20.0)}) {
+        results.push_back(node ? node->id() : 0);
+      }
+    }
+    std::sort(results.begin(), results.end());
+    return results;
+  }
+};
+
+constexpr double LatticeSerialization::kRange_;
+
+TEST_F(LatticeSerialization, waypointLattice) {
+  REQUIRE_TOWN04_MAP();
+
+  const std::string data = serialize(*waypoint_lattice_);
+  std::istringstream is(data);
+  const WaypointLattice lattice(is, WaypointLattice::mapWaypointResolver(map_), router_);
+
+  // The loaded lattice writes the same data, and answers the queries the same.
+  EXPECT_EQ(serialize(lattice), data);
+  EXPECT_EQ(lattice.size(), waypoint_lattice_->size());
+  EXPECT_DOUBLE_EQ(lattice.range(), waypoint_lattice_->range());
+  EXPECT_DOUBLE_EQ(lattice.longitudinalResolution(), waypoint_lattice_->longitudinalResolution());
+  EXPECT_EQ(forwardQueries(lattice), forwardQueries(*waypoint_lattice_));
+}
+
+TEST_F(LatticeSerialization, trafficLattice) {
+  REQUIRE_TOWN04_MAP();
+
+  const std::string data = serialize(*traffic_lattice_);
+  std::istringstream is(data);
+  const TrafficLattice lattice(
+      is, TrafficLattice::mapWaypointResolver(map_), map_, fast_map_, router_);
+
+  EXPECT_EQ(serialize(lattice), data);
+  EXPECT_EQ(lattice.size(), traffic_lattice_->size());
+  EXPECT_EQ(forwardQueries(lattice), forwardQueries(*traffic_lattice_));
+
+  // The vehicles are registered on the same nodes.
+  ASSERT_EQ(lattice.vehicleNum(), 3);
+  for (size_t id = 100; id < 103; ++id) {
+    EXPECT_TRUE(lattice.front(id) == traffic_lattice_->front(id));
+    EXPECT_TRUE(lattice.back(id) == traffic_lattice_->back(id));
+  }
+}
+
+TEST_F(LatticeSerialization, throughBase) {
+  REQUIRE_TOWN04_MAP();
+
+  // The vehicles are written even if the lattice is serialized as its base class.
+  const Lattice<WaypointNodeWithVehicle>& base = *traffic_lattice_;
+  EXPECT_EQ(serialize(base), serialize(*traffic_lattice_));
+
+  std::ostringstream os;
+  base.Lattice<WaypointNodeWithVehicle>::serialize(os);
+  EXPECT_LT(os.str().size(), serialize(base).size());
+}
+
+TEST_F(LatticeSerialization, invalidData) {
+  REQUIRE_TOWN04_MAP();
+
+  // Data not written by serialize() is rejected.
+  std::string data = serialize(*waypoint_lattice_);
+  data[0] = ~data[0];
+  std::istringstream is(data);
+  EXPECT_THROW(WaypointLattice(is, WaypointLattice::mapWaypointResolver(map_), router_),
+               std::runtime_error);
+}
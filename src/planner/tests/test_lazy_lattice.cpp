@@ -0,0 +1,136 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#include <vector>
+#include <gtest/gtest.h>
+#include <boost/smart_ptr.hpp>
+
+#include <planner/common/waypoint_lattice.h>
+#include <planner/tests/town04_map.h>
+
+using namespace planner;
+
+/**
+ * The test requires the Town04 map, see \c Town04Map for how the map is
+ * loaded. The test is skipped if the map is not available.
+ *
+ * The ego planners build their lattices lazily by default, i.e. the
+ * \c lazy_lattice parameter of the ego planning launch files. The test
+ * checks the lazy lattice answers the queries the same as an eager one.
+ */
+class LazyLattice : public Town04Map {
+
+protected:
+
+  static constexpr double kRange_ = 150.0;
+
+  /// IDs of the nodes found by the forward queries from every node of the eager lattice.
+  std::vector<size_t> forwardQueries(
+      const boost::shared_ptr<const WaypointLattice>& eager,
+      const boost::shared_ptr<WaypointLattice>& lattice) const {
+    std::vector<size_t> results;
+    for (const auto& item : eager->nodes()) {
+      for (const double range : {5.0, 30.0, 80.0}) {
+        const boost::shared_ptr<const CarlaWaypoint> query = item.second->waypoint();
+        for (const auto& node : {lattice->front(query, range),
+                                 lattice->frontLeft(query, range),
+                                 lattice->frontRight(query, range),
+                                 lattice->leftFront(query, range),
+                                 lattice->rightFront(query, range)}) {
+          results.push_back(node ? node->id() : 0);
+        }
+      }
+    }
+    return results;
+  }
+};
+
+constexpr double LazyLattice::kRange_;
+
+TEST_F(LazyLattice, sameQueries) {
+  REQUIRE_TOWN04_MAP();
+
+  const boost::shared_ptr<WaypointLattice> eager =
+    boost::make_shared<WaypointLattice>(queries_.front(), kRange_, 1.0, router_);
+  const boost::shared_ptr<WaypointLattice> lazy =
+    boost::make_shared<WaypointLattice>(queries_.front(), kRange_, 1.0, router_, true);
+
+  // Only the start of the lazy lattice is constructed.
+  EXPECT_TRUE(lazy->lazy());
+  EXPECT_DOUBLE_EQ(lazy->horizon(), eager->horizon());
+  EXPECT_LT(lazy->size(), eager->size());
+
+  // The queries create the nodes on the lazy lattice as required.
+  EXPECT_EQ(forwardQueries(eager, lazy), forwardQueries(eager, eager));
+  EXPECT_LE(lazy->range(), kRange_);
+
+  // Nothing is created beyond the horizon.
+  lazy->materialize(2.0*kRange_);
+  EXPECT_EQ(lazy->size(), eager->size());
+  EXPECT_GT(eager->constructionTime(), 0.0);
+}
+
+TEST_F(LazyLattice, shift) {
+  REQUIRE_TOWN04_MAP();
+
+  const boost::shared_ptr<WaypointLattice> eager =
+    boost::make_shared<WaypointLattice>(queries_.front(), kRange_, 1.0, router_);
+  const boost::shared_ptr<WaypointLattice> lazy =
+    boost::make_shared<WaypointLattice>(queries_.front(), kRange_, 1.0, router_, true);
+
+  // Shifting a lazy lattice does not create nodes ahead.
+  lazy->materialize(kRange_);
+  const size_t size = lazy->size();
+  eager->shift(50.0);
+  lazy->shift(50.0);
+  EXPECT_LT(lazy->size(), size);
+  EXPECT_DOUBLE_EQ(lazy->horizon(), kRange_);
+
+  EXPECT_EQ(forwardQueries(eager, lazy), forwardQueries(eager, eager));
+}
+
+TEST_F(LazyLattice, plannerUpdates) {
+  REQUIRE_TOWN04_MAP();
+
+  // Replay the lattice updates of the ego planners while driving along the route.
+  // At each step, the planning queries create the nodes ahead on the lazy lattice.
+  // The ego is then located on the lattice, which is shifted to 5m behind the ego.
+  const boost::shared_ptr<WaypointLattice> eager =
+    boost::make_shared<WaypointLattice>(queries_.front(), kRange_+30.0, 1.0, router_);
+  const boost::shared_ptr<WaypointLattice> lazy =
+    boost::make_shared<WaypointLattice>(queries_.front(), kRange_+30.0, 1.0, router_, true);
+
+  boost::shared_ptr<CarlaWaypoint> ego = queries_.front();
+  for (size_t step = 0; step < 10; ++step) {
+    EXPECT_EQ(forwardQueries(eager, lazy), forwardQueries(eager, eager));
+
+    ego = router_->frontWaypoint(ego, 20.0);
+    ASSERT_TRUE(ego);
+
+    const boost::shared_ptr<const WaypointNode> eager_node =
+      boost::const_pointer_cast<const WaypointLattice>(eager)->closestNode(ego, 1.0);
+    const boost::shared_ptr<const WaypointNode> lazy_node =
+      boost::const_pointer_cast<const WaypointLattice>(lazy)->closestNode(ego, 1.0);
+    ASSERT_TRUE(eager_node);
+    ASSERT_TRUE(lazy_node);
+    EXPECT_EQ(lazy_node->id(), eager_node->id());
+    EXPECT_DOUBLE_EQ(lazy_node->distance(), eager_node->distance());
+
+    eager->shift(eager_node->distance()-5.0);
+    lazy->shift(lazy_node->distance()-5.0);
+    EXPECT_DOUBLE_EQ(lazy->horizon(), eager->horizon());
+  }
+}
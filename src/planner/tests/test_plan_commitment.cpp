@@ -0,0 +1,79 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include <planner/common/plan_commitment.h>
+
+using namespace planner;
+using Manoeuvre = PlanCommitment::Manoeuvre;
+
+TEST(PlanCommitment, hysteresis) {
+  // Without hysteresis, the cheapest plan is always selected.
+  PlanCommitment commitment;
+  EXPECT_FALSE(commitment.enabled());
+  EXPECT_TRUE(commitment.keep(10.0, 10.0));
+  EXPECT_FALSE(commitment.keep(10.0, 10.1));
+
+  commitment = PlanCommitment(1.0);
+  EXPECT_TRUE(commitment.enabled());
+  EXPECT_TRUE(commitment.keep(10.0, 10.9));
+  EXPECT_FALSE(commitment.keep(10.0, 11.1));
+
+  EXPECT_THROW(PlanCommitment(-1.0), std::runtime_error);
+}
+
+TEST(PlanCommitment, abandonedManoeuvres) {
+  PlanCommitment commitment(1.0);
+
+  // Switching from keeping the lane is not an abandoned manoeuvre.
+  EXPECT_FALSE(commitment.update(false, Manoeuvre::LeftLaneChange, Manoeuvre::KeepLane));
+  EXPECT_FALSE(commitment.update(true, Manoeuvre::LeftLaneChange, Manoeuvre::KeepLane));
+  EXPECT_EQ(commitment.committed(), Manoeuvre::LeftLaneChange);
+  EXPECT_EQ(commitment.cycles(), 2u);
+  EXPECT_FALSE(commitment.executing());
+
+  // The left lane change is abandoned before it is started.
+  EXPECT_TRUE(commitment.update(false, Manoeuvre::RightLaneChange, Manoeuvre::RightLaneChange));
+  EXPECT_EQ(commitment.abandoned(), 1u);
+  EXPECT_EQ(commitment.cycles(), 1u);
+  EXPECT_TRUE(commitment.executing());
+
+  // Following the right lane change halfway through keeps the commitment.
+  EXPECT_FALSE(commitment.update(true, Manoeuvre::KeepLane, Manoeuvre::KeepLane));
+  EXPECT_EQ(commitment.committed(), Manoeuvre::RightLaneChange);
+  EXPECT_TRUE(commitment.executing());
+
+  // The right lane change is completed once the end of the first edge is reached.
+  commitment.reached();
+  EXPECT_EQ(commitment.committed(), Manoeuvre::KeepLane);
+  EXPECT_FALSE(commitment.executing());
+  EXPECT_FALSE(commitment.update(true, Manoeuvre::KeepLane, Manoeuvre::KeepLane));
+  EXPECT_EQ(commitment.abandoned(), 1u);
+
+  // Reaching a keep-lane edge does not complete a later lane change.
+  commitment.update(false, Manoeuvre::LeftLaneChange, Manoeuvre::KeepLane);
+  commitment.reached();
+  EXPECT_EQ(commitment.committed(), Manoeuvre::LeftLaneChange);
+  EXPECT_TRUE(commitment.update(false, Manoeuvre::KeepLane, Manoeuvre::KeepLane));
+  EXPECT_EQ(commitment.abandoned(), 2u);
+
+  // Reset does not count as abandoning.
+  commitment.update(false, Manoeuvre::RightLaneChange, Manoeuvre::KeepLane);
+  commitment.reset();
+  EXPECT_EQ(commitment.committed(), Manoeuvre::KeepLane);
+  EXPECT_EQ(commitment.abandoned(), 2u);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <list>
+#include <utility>
+#include <gtest/gtest.h>
+#include <boost/smart_ptr.hpp>
+
+#include <planner/spatiotemporal_lattice_planner/spatiotemporal_lattice_planner.h>
+#include <planner/tests/town04_snapshot.h>
+
+using namespace planner;
+using namespace planner::spatiotemporal_lattice_planner;
+
+/**
+ * The test requires the Town04 map, see \c Town04Map for how the map is
+ * loaded. The test is skipped if the map is not available.
+ *
+ * The spatiotemporal lattice planner stops expanding vertices once the
+ * planning time budget or the expansion budget is used up. The root vertex
+ * is always expanded, so that there is still a trajectory to return.
+ */
+class PlanningBudget : public Town04Snapshot {
+
+protected:
+
+  using Trajectory = std::list<std::pair<ContinuousPath, double>>;
+
+  boost::shared_ptr<SpatiotemporalLatticePlanner> planner_ = nullptr;
+
+  virtual void SetUp() override {
+    Town04Snapshot::SetUp();
+    if (!map_ || HasFatalFailure()) return;
+    planner_ = boost::make_shared<SpatiotemporalLatticePlanner>(
+        0.1, 150.0, router_, map_, fast_map_);
+    return;
+  }
+
+  Trajectory plan() {
+    return planner_->planTraj(snapshot_->ego().id(), *snapshot_);
+  }
+};
+
+TEST_F(PlanningBudget, unlimited) {
+  REQUIRE_TOWN04_MAP();
+
+  ASSERT_NO_THROW(plan());
+  EXPECT_GT(planner_->pruningStats().expanded, 1);
+  EXPECT_EQ(planner_->pruningStats().unexpanded, 0);
+}
+
+TEST_F(PlanningBudget, timeBudget) {
+  REQUIRE_TOWN04_MAP();
+
+  // The budget is used up by the expansion of the root vertex.
+  planner_->timeBudget() = 1e-9;
+  Trajectory traj;
+  ASSERT_NO_THROW(traj = plan());
+  EXPECT_FALSE(traj.empty());
+  EXPECT_EQ(planner_->pruningStats().expanded, 1);
+  EXPECT_GT(planner_->pruningStats().unexpanded, 0);
+}
+
+TEST_F(PlanningBudget, maxExpansions) {
+  REQUIRE_TOWN04_MAP();
+
+  planner_->maxExpansions() = 3;
+  Trajectory traj;
+  ASSERT_NO_THROW(traj = plan());
+  EXPECT_FALSE(traj.empty());
+  EXPECT_LE(planner_->pruningStats().expanded, 3);
+
+  // The budget applies to every planning cycle.
+  ASSERT_NO_THROW(traj = plan());
+  EXPECT_LE(planner_->pruningStats().expanded, 3);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cmath>
+#include <gtest/gtest.h>
+#include <boost/smart_ptr.hpp>
+
+#include <planner/slc_lattice_planner/slc_lattice_planner.h>
+#include <planner/tests/town04_snapshot.h>
+
+using namespace planner;
+
+/**
+ * The test requires the Town04 map, see \c Town04Map for how the map is
+ * loaded. The test is skipped if the map is not available.
+ *
+ * Merging the near-duplicate vertices at the same node (see
+ * \c SnapshotSignature) shrinks the vertex graph of the SLC lattice planner,
+ * while the cost of the selected path should stay close to the one
+ * planned without merging.
+ */
+class StateMerging : public Town04Snapshot {
+
+protected:
+
+  /// Plan on the fixed snapshot with a new planner.
+  boost::shared_ptr<SLCLatticePlanner> plan(const bool state_merging) const {
+    boost::shared_ptr<SLCLatticePlanner> planner =
+      boost::make_shared<SLCLatticePlanner>(0.1, 150.0, router_, map_, fast_map_);
+    planner->stateMerging() = state_merging;
+    planner->planPath(snapshot_->ego().id(), *snapshot_);
+    return planner;
+  }
+};
+
+TEST_F(StateMerging, costWithinTolerance) {
+  REQUIRE_TOWN04_MAP();
+
+  boost::shared_ptr<SLCLatticePlanner> merged, unmerged;
+  ASSERT_NO_THROW(merged = plan(true));
+  ASSERT_NO_THROW(unmerged = plan(false));
+
+  // Merging never expands more vertices.
+  EXPECT_LE(merged->expansions(), unmerged->expansions());
+
+  // The merge tolerance only bounds the cost-to-come given up by each merge.
+  // The cost of the selected path is expected to stay within the same
+  // relative tolerance on this snapshot.
+  EXPECT_NEAR(merged->optimalCost(), unmerged->optimalCost(),
+              merged->mergeCostTolerance() * std::fabs(unmerged->optimalCost()));
+}
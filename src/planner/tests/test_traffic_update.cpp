@@ -0,0 +1,164 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#include <new>
+#include <cstdlib>
+#include <vector>
+#include <stdexcept>
+#include <unordered_set>
+#include <gtest/gtest.h>
+#include <carla/geom/Transform.h>
+#include <carla/geom/BoundingBox.h>
+#include <planner/common/vehicle.h>
+#include <planner/common/vehicle_states.h>
+#include <planner/common/collision_checker.h>
+
+using namespace planner;
+using CarlaTransform   = carla::geom::Transform;
+using CarlaBoundingBox = carla::geom::BoundingBox;
+
+namespace {
+
+/// Number of calls to the global operator new.
+size_t allocations = 0;
+
+VehicleStates makeStates(const size_t num) {
+  VehicleStates states;
+  for (size_t i = 0; i < num; ++i) {
+    CarlaTransform transform(carla::geom::Location(10.0*i, 0.0, 0.0),
+                             carla::geom::Rotation(0.0, 0.0, 0.0));
+    CarlaBoundingBox bounding_box(carla::geom::Location(0.0, 0.0, 0.0),
+                                  carla::geom::Vector3D(2.0, 1.0, 1.0));
+    states.push_back(Vehicle(100+i, bounding_box, transform, 20.0, 25.0, 0.0, 0.0));
+  }
+  return states;
+}
+
+} // End anonymous namespace.
+
+void* operator new(std::size_t size) {
+  ++allocations;
+  if (void* ptr = std::malloc(size)) return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+TEST(TrafficUpdate, apply) {
+  VehicleStates states = makeStates(3);
+  TrafficUpdate update(states.size());
+  update.reset(states.size());
+  EXPECT_EQ(update.size(), 3);
+  EXPECT_FALSE(update.updated(1));
+
+  CarlaTransform transform(carla::geom::Location(15.0, 1.0, 0.0),
+                           carla::geom::Rotation(0.0, 5.0, 0.0));
+  update.set(1, transform, 21.0, 1.0, 0.01);
+  EXPECT_TRUE(update.updated(1));
+  EXPECT_THROW(update.set(3, transform, 21.0, 1.0, 0.01), std::runtime_error);
+
+  states.apply(update);
+
+  // The updated vehicle takes the new states.
+  EXPECT_DOUBLE_EQ(states.view(1).transform().location.x, 15.0);
+  EXPECT_DOUBLE_EQ(states.view(1).transform().rotation.yaw, 5.0);
+  EXPECT_DOUBLE_EQ(states.view(1).speed(), 21.0);
+  EXPECT_DOUBLE_EQ(states.view(1).acceleration(), 1.0);
+  EXPECT_DOUBLE_EQ(states.view(1).curvature(), 0.01);
+  // Other vehicles are left untouched.
+  EXPECT_DOUBLE_EQ(states.view(0).transform().location.x, 0.0);
+  EXPECT_DOUBLE_EQ(states.view(2).speed(), 20.0);
+  // Static properties are not changed.
+  EXPECT_EQ(states.view(1).id(), 101);
+  EXPECT_DOUBLE_EQ(states.view(1).policySpeed(), 25.0);
+
+  // The size of the update must match the vehicles.
+  update.reset(2);
+  EXPECT_THROW(states.apply(update), std::runtime_error);
+}
+
+TEST(TrafficUpdate, steadyStateAllocations) {
+  VehicleStates states = makeStates(50);
+  TrafficUpdate update(states.size());
+
+  const size_t start_allocations = allocations;
+  for (size_t step = 0; step < 100; ++step) {
+    update.reset(states.size());
+    for (size_t i = 0; i < states.size(); ++i) {
+      const ConstVehicleView vehicle = states.view(i);
+      CarlaTransform transform = vehicle.transform();
+      transform.location.x += vehicle.speed() * 0.1;
+      update.set(i, transform, vehicle.speed(), 0.0, 0.0);
+    }
+    states.apply(update);
+  }
+  EXPECT_EQ(allocations, start_allocations);
+  EXPECT_NEAR(states.view(0).transform().location.x, 200.0, 1e-6);
+
+  // Fewer vehicles, e.g. after some vehicles disappear, fit in the buffer.
+  states.erase(100);
+  update.reset(states.size());
+  EXPECT_EQ(allocations, start_allocations);
+}
+
+TEST(CollisionChecker, steadyStateAllocations) {
+  using utils::CollisionChecker;
+  using utils::OrientedBox;
+
+  // A platoon of vehicles on two lanes, where each pair of vehicles
+  // in the middle of the platoon overlaps.
+  std::vector<OrientedBox> boxes;
+  for (size_t i = 0; i < 50; ++i) {
+    const double x = i < 20 || i >= 30 ? 10.0*i : 10.0*20 + 3.0*(i-20);
+    boxes.push_back(OrientedBox{x, 0.0, 0.0, 2.5, 1.0});
+    boxes.push_back(OrientedBox{x, 3.5, 0.0, 2.5, 1.0});
+  }
+
+  CollisionChecker checker(5.0);
+  checker.reserve(boxes.size());
+  for (const OrientedBox& box : boxes) checker.add(box);
+  const size_t num_collisions = checker.collisions().size();
+  EXPECT_GT(num_collisions, 0);
+
+  // Move the platoon forward by whole cells so that the checker sees the
+  // same configuration at every step.
+  const size_t start_allocations = allocations;
+  for (size_t step = 0; step < 100; ++step) {
+    checker.clear();
+    for (OrientedBox& box : boxes) box.x += 5.0;
+    for (const OrientedBox& box : boxes) checker.add(box);
+    EXPECT_FALSE(checker.collisionFree());
+  }
+  EXPECT_EQ(allocations, start_allocations);
+  EXPECT_EQ(checker.collisions().size(), num_collisions);
+}
+
+TEST(VehicleStates, eraseGroup) {
+  VehicleStates states = makeStates(5);
+  EXPECT_EQ(states.erase(std::unordered_set<size_t>({101, 103, 200})), 2);
+
+  // The remaining vehicles keep their order.
+  ASSERT_EQ(states.size(), 3);
+  EXPECT_EQ(states.ids(), std::vector<size_t>({100, 102, 104}));
+  EXPECT_DOUBLE_EQ(states.view(1).transform().location.x, 20.0);
+  EXPECT_DOUBLE_EQ(states.view(2).transform().location.x, 40.0);
+  EXPECT_EQ(*states.index(104), 2);
+  EXPECT_FALSE(states.contains(103));
+
+  EXPECT_EQ(states.erase(std::unordered_set<size_t>()), 0);
+  EXPECT_EQ(states.size(), 3);
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <boost/smart_ptr.hpp>
+
+#include <router/common/waypoint_cache.h>
+#include <planner/tests/town04_map.h>
+
+using namespace router;
+
+/**
+ * The test requires the Town04 map for the carla waypoints, see \c Town04Map
+ * for how the map is loaded. The test is skipped if the map is not available.
+ */
+class WaypointCacheTest : public Town04Map {
+
+protected:
+
+  /// IDs of the given waypoints.
+  static std::vector<uint64_t> ids(const WaypointCache::Waypoints& waypoints) {
+    std::vector<uint64_t> output;
+    for (const auto& waypoint : waypoints) output.push_back(waypoint->GetId());
+    return output;
+  }
+};
+
+TEST_F(WaypointCacheTest, hits) {
+  REQUIRE_TOWN04_MAP();
+
+  WaypointCache cache(16, 1);
+  const boost::shared_ptr<const CarlaWaypoint> waypoint = queries_.front();
+
+  // The first query misses, and the same query hits afterwards.
+  const WaypointCache::Waypoints next = cache.next(waypoint, 10.0);
+  EXPECT_EQ(ids(next), ids(waypoint->GetNext(10.0)));
+  EXPECT_EQ(ids(cache.next(waypoint, 10.0)), ids(next));
+  EXPECT_EQ(cache.stats().misses, 1);
+  EXPECT_EQ(cache.stats().hits, 1);
+
+  // Different query types and distances are different queries.
+  EXPECT_EQ(ids(cache.previous(waypoint, 10.0)), ids(waypoint->GetPrevious(10.0)));
+  cache.next(waypoint, 10.5);
+  cache.left(waypoint);
+  cache.right(waypoint);
+  EXPECT_EQ(cache.stats().misses, 5);
+  EXPECT_EQ(cache.stats().size, 5);
+
+  // Distances are quantized to 1mm.
+  cache.next(waypoint, 10.0001);
+  EXPECT_EQ(cache.stats().hits, 2);
+
+  cache.resetStats();
+  EXPECT_EQ(cache.stats().hits, 0);
+  EXPECT_EQ(cache.stats().size, 5);
+
+  cache.clear();
+  EXPECT_EQ(cache.stats().size, 0);
+  cache.next(waypoint, 10.0);
+  EXPECT_EQ(cache.stats().misses, 1);
+}
+
+TEST_F(WaypointCacheTest, leastRecentlyUsed) {
+  REQUIRE_TOWN04_MAP();
+
+  WaypointCache cache(2, 1);
+  const boost::shared_ptr<const CarlaWaypoint> waypoint = queries_.front();
+
+  // Query a, b, then a again, so that b is the least recently used.
+  cache.next(waypoint, 1.0);
+  cache.next(waypoint, 2.0);
+  cache.next(waypoint, 1.0);
+  EXPECT_EQ(cache.stats().hits, 1);
+
+  // Query c evicts b.
+  cache.next(waypoint, 3.0);
+  EXPECT_EQ(cache.stats().evictions, 1);
+  EXPECT_EQ(cache.stats().size, 2);
+
+  cache.next(waypoint, 1.0);
+  EXPECT_EQ(cache.stats().hits, 2);
+  cache.next(waypoint, 2.0);
+  EXPECT_EQ(cache.stats().misses, 4);
+
+  // Shrinking the capacity evicts the least recently used queries.
+  cache.setCapacity(1);
+  EXPECT_EQ(cache.stats().size, 1);
+  cache.next(waypoint, 2.0);
+  EXPECT_EQ(cache.stats().hits, 3);
+
+  EXPECT_THROW(cache.setCapacity(0), std::runtime_error);
+  EXPECT_THROW(WaypointCache(0), std::runtime_error);
+  EXPECT_THROW(WaypointCache(16, 0), std::runtime_error);
+}
+
+TEST_F(WaypointCacheTest, shards) {
+  REQUIRE_TOWN04_MAP();
+
+  WaypointCache cache(10, 4);
+  EXPECT_EQ(cache.shards(), 4);
+  const boost::shared_ptr<const CarlaWaypoint> waypoint = queries_.front();
+
+  // The cache never holds more queries than its capacity,
+  // even though the capacity is not a multiple of the shards.
+  for (size_t i = 0; i < 100; ++i) cache.next(waypoint, 0.5*(i+1));
+  const WaypointCache::Stats stats = cache.stats();
+  EXPECT_LE(stats.size, 10);
+  EXPECT_EQ(stats.misses, 100);
+  EXPECT_EQ(stats.evictions, 100-stats.size);
+
+  // Concurrent queries on all shards return the same answers as carla.
+  std::vector<std::vector<uint64_t>> expected;
+  for (size_t i = 0; i < 20; ++i) expected.push_back(ids(waypoint->GetNext(1.0*(i+1))));
+
+  std::vector<size_t> mismatches(4, 0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < mismatches.size(); ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t round = 0; round < 50; ++round) {
+        for (size_t i = 0; i < expected.size(); ++i) {
+          if (ids(cache.next(waypoint, 1.0*(i+1))) != expected[i]) ++mismatches[t];
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  for (const size_t count : mismatches) EXPECT_EQ(count, 0);
+  EXPECT_LE(cache.stats().size, 10);
+}
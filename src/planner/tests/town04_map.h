@@ -0,0 +1,156 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include <boost/format.hpp>
+#include <boost/smart_ptr.hpp>
+
+#include <carla/client/Client.h>
+#include <carla/client/World.h>
+#include <carla/client/Map.h>
+#include <carla/client/Waypoint.h>
+#include <carla/rpc/MapInfo.h>
+
+#include <router/loop_router/loop_router.h>
+
+/**
+ * \brief Skip the current test, e.g. if the Town04 map is not available.
+ *
+ * googletest 1.10 and newer report the test as skipped. Older versions,
+ * e.g. the one shipped with ROS melodic, do not support skipping, in which
+ * case the message is printed in the same format and the test returns.
+ */
+#ifdef GTEST_SKIP
+#define SKIP_TEST(message) GTEST_SKIP() << (message)
+#else
+#define SKIP_TEST(message)                                          \
+  do {                                                              \
+    std::printf("[  SKIPPED ] %s\n", std::string(message).c_str()); \
+    return;                                                         \
+  } while (false)
+#endif
+
+/// Skip the current test if the fixture has no Town04 map.
+#define REQUIRE_TOWN04_MAP()                        \
+  do {                                              \
+    if (!this->map_) SKIP_TEST(this->skip_reason_); \
+  } while (false)
+
+/**
+ * \brief Town04Map is the base fixture of the tests requiring the Town04 map,
+ *        on which the \c LoopRouter is defined.
+ *
+ * The map is loaded from the first available source of:
+ * - The OpenDRIVE file given by the \c TOWN04_OPENDRIVE environment variable.
+ * - The OpenDRIVE file given by the \c TOWN04_OPENDRIVE CMake variable,
+ *   which defaults to the Town04.xodr in \c $Carla_DIST if it exists.
+ * - A carla server with the Town04 map loaded, located with the
+ *   \c CARLA_HOST and \c CARLA_PORT environment variables, which default
+ *   to localhost:2000.
+ *
+ * Loading from an OpenDRIVE file does not require a carla server. If an
+ * OpenDRIVE file is given, the map is required and failing to load it fails
+ * the test. Otherwise, the tests are skipped if the server is not available.
+ * The tests should start with \c REQUIRE_TOWN04_MAP().
+ */
+class Town04Map : public ::testing::Test {
+
+protected:
+
+  using CarlaClient   = carla::client::Client;
+  using CarlaMap      = carla::client::Map;
+  using CarlaWaypoint = carla::client::Waypoint;
+
+protected:
+
+  boost::shared_ptr<CarlaMap> map_ = nullptr;
+  boost::shared_ptr<router::LoopRouter> router_ = nullptr;
+
+  /// Waypoints on the route, 5m apart.
+  std::vector<boost::shared_ptr<CarlaWaypoint>> queries_;
+
+  /// Why the map is not available.
+  std::string skip_reason_;
+
+protected:
+
+  virtual void SetUp() override {
+    const std::string opendrive_file = openDriveFile();
+
+    if (!opendrive_file.empty()) {
+      // The map is required if its OpenDRIVE file is given.
+      ASSERT_NO_THROW(map_ = loadOpenDrive(opendrive_file));
+    } else {
+      const char* host = std::getenv("CARLA_HOST");
+      const char* port = std::getenv("CARLA_PORT");
+
+      try {
+        CarlaClient client(host ? host : "localhost", port ? std::atoi(port) : 2000);
+        client.SetTimeout(std::chrono::seconds(10));
+        map_ = client.GetWorld().GetMap();
+      } catch (const std::exception& e) {
+        skip_reason_ = (boost::format(
+              "Neither TOWN04_OPENDRIVE nor a carla server is available: %1%") % e.what()).str();
+        map_ = nullptr;
+        return;
+      }
+    }
+
+    router_ = boost::make_shared<router::LoopRouter>();
+    for (const auto& waypoint : map_->GenerateWaypoints(5.0)) {
+      if (router_->hasRoad(waypoint->GetRoadId())) queries_.push_back(waypoint);
+    }
+    ASSERT_FALSE(queries_.empty());
+    return;
+  }
+
+  /// The OpenDRIVE file of the map, empty if not given.
+  static std::string openDriveFile() {
+    if (const char* file = std::getenv("TOWN04_OPENDRIVE")) return file;
+#ifdef TOWN04_OPENDRIVE
+    return TOWN04_OPENDRIVE;
+#else
+    return std::string();
+#endif
+  }
+
+  /// Create the carla map from the OpenDRIVE data directly.
+  static boost::shared_ptr<CarlaMap> loadOpenDrive(const std::string& file) {
+    std::ifstream fin(file);
+    if (!fin) {
+      throw std::runtime_error((boost::format(
+            "Town04Map::loadOpenDrive(): "
+            "cannot open the OpenDRIVE file %1%.\n") % file).str());
+    }
+    std::stringstream opendrive;
+    opendrive << fin.rdbuf();
+
+    carla::rpc::MapInfo map_info;
+    map_info.name = "Town04";
+    map_info.open_drive_file = opendrive.str();
+    return boost::make_shared<CarlaMap>(map_info);
+  }
+
+}; // End class Town04Map.
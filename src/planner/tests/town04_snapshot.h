@@ -0,0 +1,116 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <vector>
+#include <stdexcept>
+#include <unordered_map>
+#include <gtest/gtest.h>
+#include <boost/smart_ptr.hpp>
+
+#include <carla/geom/BoundingBox.h>
+#include <carla/geom/Transform.h>
+
+#include <planner/common/vehicle.h>
+#include <planner/common/snapshot.h>
+#include <planner/common/fast_waypoint_map.h>
+#include <planner/tests/town04_map.h>
+
+/**
+ * \brief Town04Snapshot is the base fixture of the tests planning on a fixed
+ *        snapshot of the Town04 map.
+ *
+ * By default, the ego starts at the first route waypoint, followed by two
+ * slower agents ahead on the same lane. Other snapshots can be created
+ * with \c createSnapshot(). The snapshot is only created if the map is
+ * available, see \c Town04Map.
+ */
+class Town04Snapshot : public Town04Map {
+
+protected:
+
+  using CarlaBoundingBox = carla::geom::BoundingBox;
+  using CarlaTransform   = carla::geom::Transform;
+
+protected:
+
+  boost::shared_ptr<utils::FastWaypointMap> fast_map_ = nullptr;
+  boost::shared_ptr<planner::Snapshot> snapshot_ = nullptr;
+
+protected:
+
+  /// An agent ahead of the ego on the same lane.
+  struct AgentPlacement {
+    /// Distance (m) ahead of the ego.
+    double distance;
+    /// Speed (m/s) of the agent.
+    double speed;
+    /// Policy speed (m/s) of the agent.
+    double policy_speed;
+  };
+
+  virtual void SetUp() override {
+    Town04Map::SetUp();
+    if (!map_ || HasFatalFailure()) return;
+
+    fast_map_ = boost::make_shared<utils::FastWaypointMap>(map_);
+    ASSERT_NO_THROW(snapshot_ = createSnapshot(
+          queries_.front(), 20.0, {{30.0, 15.0, 15.0}, {70.0, 18.0, 20.0}}));
+    return;
+  }
+
+  /**
+   * \brief Create a snapshot with the ego at the given waypoint.
+   *
+   * The policy speed of the ego is 25m/s. The agents are numbered from 1
+   * in the given order.
+   */
+  boost::shared_ptr<planner::Snapshot> createSnapshot(
+      const boost::shared_ptr<CarlaWaypoint>& ego_waypoint,
+      const double ego_speed,
+      const std::vector<AgentPlacement>& placements) const {
+
+    const planner::Vehicle ego = vehicle(0, ego_waypoint, ego_speed, 25.0);
+
+    std::unordered_map<size_t, planner::Vehicle> agents;
+    for (size_t i = 0; i < placements.size(); ++i) {
+      const boost::shared_ptr<CarlaWaypoint> waypoint =
+        router_->frontWaypoint(ego_waypoint, placements[i].distance);
+      if (!waypoint) {
+        throw std::runtime_error(
+            "Town04Snapshot::createSnapshot(): "
+            "cannot find the waypoint of an agent.\n");
+      }
+      agents[i+1] = vehicle(
+          i+1, waypoint, placements[i].speed, placements[i].policy_speed);
+    }
+
+    return boost::make_shared<planner::Snapshot>(ego, agents, router_, map_, fast_map_);
+  }
+
+  /// Create a vehicle at the given waypoint.
+  static planner::Vehicle vehicle(const size_t id,
+                                  const boost::shared_ptr<CarlaWaypoint>& waypoint,
+                                  const double speed,
+                                  const double policy_speed) {
+    CarlaTransform transform = waypoint->GetTransform();
+    transform.location.z += 0.5;
+    const CarlaBoundingBox bounding_box(
+        carla::geom::Location(0.0, 0.0, 0.0),
+        carla::geom::Vector3D(2.4, 1.0, 0.8));
+    return planner::Vehicle(id, bounding_box, transform, speed, policy_speed, 0.0, 0.0);
+  }
+
+}; // End class Town04Snapshot.
@@ -0,0 +1,430 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <boost/format.hpp>
+
+#include <python/lattice_planners.h>
+
+namespace bp = boost::python;
+namespace np = boost::python::numpy;
+
+namespace bindings {
+
+namespace {
+
+/// Convert an array of vehicle states into a 2D C-contiguous double array.
+np::ndarray vehicleArray(const np::ndarray& array, const std::string& name) {
+
+  np::ndarray output = array.astype(np::dtype::get_builtin<double>());
+  if (output.get_nd() == 1) output = output.reshape(bp::make_tuple(1, -1));
+
+  if (output.get_nd() != 2 || output.shape(1) != kVehicleColumns) {
+    throw std::runtime_error((boost::format(
+          "bindings::Snapshot::Snapshot(): "
+          "%1% should have %2% columns.\n") % name % kVehicleColumns).str());
+  }
+
+  if (!(output.get_flags() & np::ndarray::C_CONTIGUOUS)) output = output.copy();
+  return output;
+}
+
+/// Create a vehicle from a row of the array returned by \c vehicleArray().
+planner::Vehicle vehicleFromRow(const double* row) {
+  return planner::Vehicle(
+      static_cast<size_t>(row[kId]),
+      carla::geom::BoundingBox(
+        carla::geom::Location(0.0, 0.0, 0.0),
+        carla::geom::Vector3D(row[kExtentX], row[kExtentY], row[kExtentZ])),
+      carla::geom::Transform(
+        carla::geom::Location(row[kX], row[kY], row[kZ]),
+        carla::geom::Rotation(row[kPitch], row[kYaw], row[kRoll])),
+      row[kSpeed],
+      row[kPolicySpeed],
+      row[kAcceleration],
+      row[kCurvature]);
+}
+
+/// Convert the samples of a path into an array of \c kPathColumns.
+np::ndarray pathArray(const planner::VehiclePath& path) {
+
+  const std::vector<std::pair<carla::geom::Transform, double>> samples = path.samples();
+  np::ndarray output = np::zeros(
+      bp::make_tuple(samples.size(), static_cast<int>(kPathColumns)),
+      np::dtype::get_builtin<double>());
+
+  double* data = reinterpret_cast<double*>(output.get_data());
+  for (size_t i = 0; i < samples.size(); ++i) {
+    double* row = data + i*kPathColumns;
+    row[kPathX] = samples[i].first.location.x;
+    row[kPathY] = samples[i].first.location.y;
+    row[kPathZ] = samples[i].first.location.z;
+    row[kPathYaw] = samples[i].first.rotation.yaw;
+    row[kPathCurvature] = samples[i].second;
+  }
+
+  return output;
+}
+
+/// Convert an array of samples into a 1D C-contiguous double array.
+np::ndarray sampleArray(const np::ndarray& array, const std::string& name) {
+
+  np::ndarray output = array.astype(np::dtype::get_builtin<double>());
+  if (output.get_nd() != 1) {
+    throw std::runtime_error((boost::format(
+          "bindings::driverModelAccelerations(): "
+          "%1% should be a 1D array.\n") % name).str());
+  }
+
+  if (!(output.get_flags() & np::ndarray::C_CONTIGUOUS)) output = output.copy();
+  return output;
+}
+
+/// Get an optional model parameter from a dict.
+boost::optional<double> modelParam(const bp::dict& params, const std::string& name) {
+  if (!params.has_key(name)) return boost::none;
+  return bp::extract<double>(params[name])();
+}
+
+std::string laneChangeString(const planner::VehiclePath::LaneChangeType type) {
+  switch (type) {
+    case planner::VehiclePath::LaneChangeType::KeepLane:        return "keep_lane";
+    case planner::VehiclePath::LaneChangeType::LeftLaneChange:  return "left_lane_change";
+    case planner::VehiclePath::LaneChangeType::RightLaneChange: return "right_lane_change";
+    default:                                                    return "none";
+  }
+}
+
+} // End anonymous namespace.
+
+World::World(const std::string& opendrive_file, const std::string& name) {
+
+  std::ifstream fin(opendrive_file);
+  if (!fin) {
+    throw std::runtime_error((boost::format(
+          "bindings::World::World(): "
+          "cannot open the OpenDRIVE file %1%.\n") % opendrive_file).str());
+  }
+  std::stringstream opendrive;
+  opendrive << fin.rdbuf();
+
+  // The carla map is created from the OpenDRIVE data directly,
+  // which does not require a connection to the carla server.
+  carla::rpc::MapInfo map_info;
+  map_info.name = name;
+  map_info.open_drive_file = opendrive.str();
+
+  map_ = boost::make_shared<CarlaMap>(map_info);
+  fast_map_ = boost::make_shared<utils::FastWaypointMap>(map_);
+  router_ = boost::make_shared<router::LoopRouter>();
+  return;
+}
+
+np::ndarray World::routeWaypoints(const double distance) const {
+
+  if (distance <= 0.0) {
+    throw std::runtime_error(
+        "bindings::World::routeWaypoints(): "
+        "the distance between the waypoints should be positive.\n");
+  }
+
+  std::vector<boost::shared_ptr<carla::client::Waypoint>> waypoints;
+  for (const auto& waypoint : map_->GenerateWaypoints(distance)) {
+    if (router_->hasRoad(waypoint->GetRoadId())) waypoints.push_back(waypoint);
+  }
+
+  np::ndarray output = np::zeros(
+      bp::make_tuple(waypoints.size(), static_cast<int>(kPathColumns)),
+      np::dtype::get_builtin<double>());
+
+  double* data = reinterpret_cast<double*>(output.get_data());
+  for (size_t i = 0; i < waypoints.size(); ++i) {
+    const carla::geom::Transform transform = waypoints[i]->GetTransform();
+    double* row = data + i*kPathColumns;
+    row[kPathX] = transform.location.x;
+    row[kPathY] = transform.location.y;
+    row[kPathZ] = transform.location.z;
+    row[kPathYaw] = transform.rotation.yaw;
+    row[kPathCurvature] = utils::curvatureAtWaypoint(waypoints[i], map_);
+  }
+
+  return output;
+}
+
+Snapshot::Snapshot(const boost::shared_ptr<World>& world,
+                   const np::ndarray& ego,
+                   const np::ndarray& agents) {
+
+  // Read the vehicles with the GIL held.
+  const np::ndarray ego_array = vehicleArray(ego, "ego");
+  const np::ndarray agents_array = vehicleArray(agents, "agents");
+
+  if (ego_array.shape(0) != 1) {
+    throw std::runtime_error(
+        "bindings::Snapshot::Snapshot(): ego should have exactly one row.\n");
+  }
+
+  const planner::Vehicle ego_vehicle = vehicleFromRow(
+      reinterpret_cast<const double*>(ego_array.get_data()));
+
+  std::unordered_map<size_t, planner::Vehicle> agent_vehicles;
+  const double* agents_data = reinterpret_cast<const double*>(agents_array.get_data());
+  for (long i = 0; i < agents_array.shape(0); ++i) {
+    const double* row = agents_data + i*kVehicleColumns;
+    if (std::isnan(row[kId])) continue;
+    const planner::Vehicle agent = vehicleFromRow(row);
+    agent_vehicles[agent.id()] = agent;
+  }
+
+  // Constructing the traffic lattice is the expensive part.
+  ScopedGILRelease release;
+  snapshot_ = boost::make_shared<planner::Snapshot>(
+      ego_vehicle, agent_vehicles, world->router(), world->map(), world->fastMap());
+  return;
+}
+
+bp::list Snapshot::agentIds() const {
+  bp::list ids;
+  for (const auto& agent : snapshot_->agents()) ids.append(agent.first);
+  return ids;
+}
+
+np::ndarray Snapshot::vehicles() const {
+
+  const planner::VehicleStates& states = snapshot_->vehicles();
+  np::ndarray output = np::zeros(
+      bp::make_tuple(states.size(), static_cast<int>(kVehicleColumns)),
+      np::dtype::get_builtin<double>());
+
+  double* data = reinterpret_cast<double*>(output.get_data());
+  for (size_t i = 0; i < states.size(); ++i) {
+    double* row = data + i*kVehicleColumns;
+    row[kId] = states.ids()[i];
+    row[kX] = states.locations()[i].x;
+    row[kY] = states.locations()[i].y;
+    row[kZ] = states.locations()[i].z;
+    row[kRoll] = states.rotations()[i].roll;
+    row[kPitch] = states.rotations()[i].pitch;
+    row[kYaw] = states.rotations()[i].yaw;
+    row[kSpeed] = states.speeds()[i];
+    row[kPolicySpeed] = states.policySpeeds()[i];
+    row[kAcceleration] = states.accelerations()[i];
+    row[kCurvature] = states.curvatures()[i];
+    row[kExtentX] = states.boundingBoxes()[i].extent.x;
+    row[kExtentY] = states.boundingBoxes()[i].extent.y;
+    row[kExtentZ] = states.boundingBoxes()[i].extent.z;
+  }
+
+  return output;
+}
+
+bp::object Snapshot::front(const size_t vehicle) const {
+  const boost::optional<std::pair<size_t, double>> front =
+    snapshot_->trafficLattice()->front(vehicle);
+  if (!front) return bp::object();
+  return bp::make_tuple(front->first, front->second);
+}
+
+np::ndarray driverModelAccelerations(
+    const bp::dict& params,
+    const np::ndarray& speeds,
+    const np::ndarray& policy_speeds,
+    const np::ndarray& lead_speeds,
+    const np::ndarray& gaps) {
+
+  const planner::IntelligentDriverModel idm(
+      modelParam(params, "time_gap"),
+      modelParam(params, "distance_gap"),
+      modelParam(params, "accel_exp"),
+      modelParam(params, "comfort_accel"),
+      modelParam(params, "comfort_decel"),
+      modelParam(params, "max_accel"),
+      modelParam(params, "max_decel"),
+      modelParam(params, "coolness_factor"));
+
+  const np::ndarray v_array = sampleArray(speeds, "speeds");
+  const np::ndarray v0_array = sampleArray(policy_speeds, "policy_speeds");
+  const np::ndarray lead_v_array = sampleArray(lead_speeds, "lead_speeds");
+  const np::ndarray s_array = sampleArray(gaps, "gaps");
+
+  const long samples = v_array.shape(0);
+  if (v0_array.shape(0) != samples ||
+      lead_v_array.shape(0) != samples ||
+      s_array.shape(0) != samples) {
+    throw std::runtime_error(
+        "bindings::driverModelAccelerations(): "
+        "the sample arrays should have the same size.\n");
+  }
+
+  const double* v = reinterpret_cast<const double*>(v_array.get_data());
+  const double* v0 = reinterpret_cast<const double*>(v0_array.get_data());
+  const double* lead_v = reinterpret_cast<const double*>(lead_v_array.get_data());
+  const double* s = reinterpret_cast<const double*>(s_array.get_data());
+
+  np::ndarray output = np::zeros(
+      bp::make_tuple(samples), np::dtype::get_builtin<double>());
+  double* accels = reinterpret_cast<double*>(output.get_data());
+
+  for (long i = 0; i < samples; ++i) {
+    if (std::isnan(lead_v[i]) || std::isnan(s[i])) {
+      accels[i] = idm.idm(v[i], v0[i]);
+    } else {
+      accels[i] = idm.idm(v[i], v0[i], lead_v[i], s[i]);
+    }
+  }
+
+  return output;
+}
+
+bp::dict Planner::planPath(const Snapshot& snapshot, const bool reset) {
+
+  boost::shared_ptr<planner::DiscretePath> path = nullptr;
+  double acceleration = 0.0;
+  {
+    ScopedGILRelease release;
+    std::pair<planner::DiscretePath, double> result = plan(snapshot.snapshot(), reset);
+    path = boost::make_shared<planner::DiscretePath>(result.first);
+    acceleration = result.second;
+  }
+
+  bp::dict output;
+  output["path"] = pathArray(*path);
+  output["lane_change"] = laneChangeString(path->laneChangeType());
+  output["acceleration"] = acceleration;
+  return output;
+}
+
+void SpatiotemporalLatticePlanner::resetPlanner(const bool reset) {
+  if (!reset && planner_) return;
+  planner_ = boost::make_shared<planner::SpatiotemporalLatticePlanner>(
+      sim_time_step_, spatial_horizon_,
+      world_->router(), world_->map(), world_->fastMap());
+  return;
+}
+
+std::pair<planner::DiscretePath, double> SpatiotemporalLatticePlanner::plan(
+    const planner::Snapshot& snapshot, const bool reset) {
+
+  resetPlanner(reset);
+  const std::list<std::pair<planner::ContinuousPath, double>> traj =
+    planner_->planTraj(snapshot.ego().id(), snapshot);
+
+  if (traj.empty()) {
+    throw std::runtime_error(
+        "bindings::SpatiotemporalLatticePlanner::plan(): "
+        "the planner returns an empty trajectory.\n");
+  }
+
+  // Merge the trajectory into one path, the same as the ego planning node.
+  planner::DiscretePath path(traj.front().first);
+  for (auto iter = ++(traj.begin()); iter != traj.end(); ++iter)
+    path.append(iter->first);
+
+  return std::make_pair(path, traj.front().second);
+}
+
+bp::list SpatiotemporalLatticePlanner::planTraj(const Snapshot& snapshot, const bool reset) {
+
+  std::list<std::pair<planner::ContinuousPath, double>> traj;
+  {
+    ScopedGILRelease release;
+    resetPlanner(reset);
+    traj = planner_->planTraj(snapshot.snapshot().ego().id(), snapshot.snapshot());
+  }
+
+  bp::list output;
+  for (const auto& piece : traj)
+    output.append(bp::make_tuple(pathArray(piece.first), piece.second));
+  return output;
+}
+
+std::pair<planner::DiscretePath, double> LaneFollower::plan(
+    const planner::Snapshot& snapshot, const bool reset) {
+
+  // The lattice just covers the path of the ego, which is the same as
+  // the ego lane following node.
+  const boost::shared_ptr<const carla::client::Waypoint> ego_waypoint =
+    world_->fastMap()->waypoint(snapshot.ego().transform().location);
+  planner::lane_follower::LaneFollower path_planner(
+      world_->map(), world_->fastMap(), ego_waypoint, lattice_range_, world_->router());
+
+  const planner::DiscretePath path = path_planner.planPath(snapshot.ego().id(), snapshot);
+  planner::VehicleSpeedPlanner speed_planner;
+  const double acceleration = speed_planner.planSpeed(snapshot.ego().id(), snapshot);
+  return std::make_pair(path, acceleration);
+}
+
+} // End namespace bindings.
+
+BOOST_PYTHON_MODULE(lattice_planners) {
+
+  using namespace bindings;
+
+#if PY_VERSION_HEX < 0x03070000
+  // Make sure the GIL exists, so that it can be released by the planners.
+  PyEval_InitThreads();
+#endif
+  np::initialize();
+
+  bp::scope().attr("VEHICLE_COLUMNS") = bp::make_tuple(
+      "id", "x", "y", "z", "roll", "pitch", "yaw",
+      "speed", "policy_speed", "acceleration", "curvature",
+      "extent_x", "extent_y", "extent_z");
+  bp::scope().attr("PATH_COLUMNS") = bp::make_tuple(
+      "x", "y", "z", "yaw", "curvature");
+
+  bp::class_<World, boost::shared_ptr<World>, boost::noncopyable>(
+      "World", bp::init<std::string, bp::optional<std::string>>(
+        (bp::arg("opendrive_file"), bp::arg("name")="Town04")))
+    .def("route_waypoints", &World::routeWaypoints, (bp::arg("distance")=5.0));
+
+  bp::class_<Snapshot>(
+      "Snapshot", bp::init<boost::shared_ptr<World>, np::ndarray, np::ndarray>(
+        (bp::arg("world"), bp::arg("ego"), bp::arg("agents"))))
+    .add_property("ego_id", &Snapshot::egoId)
+    .def("agent_ids", &Snapshot::agentIds)
+    .def("vehicles", &Snapshot::vehicles)
+    .def("front", &Snapshot::front, (bp::arg("vehicle")));
+
+  bp::def("driver_model_accelerations", &driverModelAccelerations,
+      (bp::arg("params"), bp::arg("speeds"), bp::arg("policy_speeds"),
+       bp::arg("lead_speeds"), bp::arg("gaps")));
+
+  bp::class_<Planner, boost::noncopyable>("Planner", bp::no_init)
+    .def("plan_path", &Planner::planPath,
+        (bp::arg("snapshot"), bp::arg("reset")=true));
+
+  bp::class_<IDMLatticePlanner, bp::bases<Planner>, boost::noncopyable>(
+      "IDMLatticePlanner", bp::init<boost::shared_ptr<World>, bp::optional<double, double>>(
+        (bp::arg("world"), bp::arg("sim_time_step")=0.1, bp::arg("spatial_horizon")=150.0)));
+
+  bp::class_<SLCLatticePlanner, bp::bases<Planner>, boost::noncopyable>(
+      "SLCLatticePlanner", bp::init<boost::shared_ptr<World>, bp::optional<double, double>>(
+        (bp::arg("world"), bp::arg("sim_time_step")=0.1, bp::arg("spatial_horizon")=150.0)));
+
+  bp::class_<SpatiotemporalLatticePlanner, bp::bases<Planner>, boost::noncopyable>(
+      "SpatiotemporalLatticePlanner", bp::init<boost::shared_ptr<World>, bp::optional<double, double>>(
+        (bp::arg("world"), bp::arg("sim_time_step")=0.1, bp::arg("spatial_horizon")=150.0)))
+    .def("plan_traj", &SpatiotemporalLatticePlanner::planTraj,
+        (bp::arg("snapshot"), bp::arg("reset")=true));
+
+  bp::class_<LaneFollower, bp::bases<Planner>, boost::noncopyable>(
+      "LaneFollower", bp::init<boost::shared_ptr<World>, bp::optional<double>>(
+        (bp::arg("world"), bp::arg("lattice_range")=55.0)));
+}
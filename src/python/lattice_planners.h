@@ -0,0 +1,324 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <utility>
+#include <boost/smart_ptr.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+
+#include <carla/client/Map.h>
+#include <carla/rpc/MapInfo.h>
+
+#include <router/loop_router/loop_router.h>
+#include <planner/common/snapshot.h>
+#include <planner/common/fast_waypoint_map.h>
+#include <planner/common/vehicle_path.h>
+#include <planner/common/vehicle_speed_planner.h>
+#include <planner/lane_follower/lane_follower.h>
+#include <planner/idm_lattice_planner/idm_lattice_planner.h>
+#include <planner/slc_lattice_planner/slc_lattice_planner.h>
+#include <planner/spatiotemporal_lattice_planner/spatiotemporal_lattice_planner.h>
+
+/**
+ * \brief Python bindings of the planners for offline evaluation.
+ *
+ * Snapshots are created from numpy arrays of vehicle states, and the planners
+ * are invoked in-process without ROS or a carla server. The carla map is
+ * loaded directly from an OpenDRIVE file, e.g. the \c Town04.xodr shipped with
+ * the carla distribution. The GIL is released while the snapshots are
+ * created and the planners run, so that Python threads plan in parallel.
+ */
+namespace bindings {
+
+/**
+ * \brief Releases the GIL within its scope.
+ *
+ * Nothing in the scope should touch Python objects.
+ */
+class ScopedGILRelease : private boost::noncopyable {
+  PyThreadState* state_;
+public:
+  ScopedGILRelease() : state_(PyEval_SaveThread()) {}
+  ~ScopedGILRelease() { PyEval_RestoreThread(state_); }
+}; // End class ScopedGILRelease.
+
+/**
+ * \brief Columns of a vehicle state row in the numpy arrays.
+ *
+ * The transforms are in the carla (left handed) frame, and the angles are in degrees.
+ */
+enum VehicleColumn {
+  kId = 0, kX, kY, kZ, kRoll, kPitch, kYaw,
+  kSpeed, kPolicySpeed, kAcceleration, kCurvature,
+  kExtentX, kExtentY, kExtentZ, kVehicleColumns
+};
+
+/// Columns of a path sample row in the numpy arrays.
+enum PathColumn {
+  kPathX = 0, kPathY, kPathZ, kPathYaw, kPathCurvature, kPathColumns
+};
+
+/**
+ * \brief World holds the map, fast waypoint map, and router shared by the
+ *        snapshots and the planners.
+ *
+ * The object is immutable after construction, and can be shared by the
+ * planners running on different threads.
+ */
+class World : private boost::noncopyable {
+
+protected:
+
+  using CarlaMap = carla::client::Map;
+
+  boost::shared_ptr<CarlaMap> map_ = nullptr;
+  boost::shared_ptr<utils::FastWaypointMap> fast_map_ = nullptr;
+  boost::shared_ptr<router::LoopRouter> router_ = nullptr;
+
+public:
+
+  /**
+   * \brief Load the map from an OpenDRIVE file.
+   * \param[in] opendrive_file Path of the OpenDRIVE (.xodr) file.
+   * \param[in] name Name of the map.
+   */
+  World(const std::string& opendrive_file, const std::string& name = "Town04");
+
+  const boost::shared_ptr<CarlaMap>& map() const { return map_; }
+  const boost::shared_ptr<utils::FastWaypointMap>& fastMap() const { return fast_map_; }
+  const boost::shared_ptr<router::LoopRouter>& router() const { return router_; }
+
+  /**
+   * \brief Waypoints on the roads of the router, e.g. to place the vehicles.
+   * \param[in] distance The approximate distance between the waypoints.
+   * \return One row of \c kPathColumns for each waypoint.
+   */
+  boost::python::numpy::ndarray routeWaypoints(const double distance) const;
+
+}; // End class World.
+
+/**
+ * \brief Snapshot wraps a \c planner::Snapshot created from numpy arrays.
+ */
+class Snapshot {
+
+protected:
+
+  boost::shared_ptr<planner::Snapshot> snapshot_ = nullptr;
+
+public:
+
+  /**
+   * \brief Create a snapshot.
+   *
+   * \param[in] world The world the vehicles are in.
+   * \param[in] ego State of the ego, a row of \c kVehicleColumns.
+   * \param[in] agents States of the agents, one row of \c kVehicleColumns for each agent.
+   *                   Rows with a NaN ID are ignored, so that padded arrays can be used.
+   */
+  Snapshot(const boost::shared_ptr<World>& world,
+           const boost::python::numpy::ndarray& ego,
+           const boost::python::numpy::ndarray& agents);
+
+  const planner::Snapshot& snapshot() const { return *snapshot_; }
+
+  size_t egoId() const { return snapshot_->ego().id(); }
+
+  /// IDs of the agents in the snapshot.
+  boost::python::list agentIds() const;
+
+  /// States of all vehicles, the ego in the first row.
+  boost::python::numpy::ndarray vehicles() const;
+
+  /**
+   * \brief Find the front vehicle of a vehicle on the traffic lattice.
+   * \return A (front vehicle ID, distance) tuple, or \c None if there is
+   *         no front vehicle within the lattice.
+   */
+  boost::python::object front(const size_t vehicle) const;
+
+}; // End class Snapshot.
+
+/**
+ * \brief Evaluate the intelligent driver model on arrays of samples.
+ *
+ * This is used to calibrate the driver models of the agents against
+ * recorded trajectories, see \c scripts/calibrate_driver_models.py.
+ *
+ * \param[in] params The model parameters, keyed by the names of the
+ *                   \c planner::IntelligentDriverModel constructor arguments,
+ *                   e.g. \c time_gap. Missing parameters take the defaults.
+ * \param[in] speeds Speeds of the following vehicles.
+ * \param[in] policy_speeds Desired speeds of the following vehicles.
+ * \param[in] lead_speeds Speeds of the leading vehicles, NaN if there is no leader.
+ * \param[in] gaps Distances to the leading vehicles, NaN if there is no leader.
+ * \return The accelerations given by the model.
+ */
+boost::python::numpy::ndarray driverModelAccelerations(
+    const boost::python::dict& params,
+    const boost::python::numpy::ndarray& speeds,
+    const boost::python::numpy::ndarray& policy_speeds,
+    const boost::python::numpy::ndarray& lead_speeds,
+    const boost::python::numpy::ndarray& gaps);
+
+/**
+ * \brief Base class of the planner bindings.
+ *
+ * Each object owns its planner, which is not safe to be used by multiple
+ * threads at the same time. Use one object for each thread.
+ */
+class Planner : private boost::noncopyable {
+
+protected:
+
+  boost::shared_ptr<World> world_;
+
+public:
+
+  Planner(const boost::shared_ptr<World>& world) : world_(world) {}
+
+  virtual ~Planner() {}
+
+  /**
+   * \brief Plan the path and acceleration of the ego in a snapshot.
+   *
+   * \param[in] snapshot The snapshot to plan in.
+   * \param[in] reset If true, the state of the planner kept from the
+   *                  previous call is discarded. This should be set unless
+   *                  the snapshots are consecutive states of an episode.
+   * \return A dict with the path samples (\c path, rows of \c kPathColumns),
+   *         the lane change type of the path (\c lane_change), and the
+   *         acceleration of the ego (\c acceleration).
+   */
+  boost::python::dict planPath(const Snapshot& snapshot, const bool reset = true);
+
+protected:
+
+  /// Plan the path and the acceleration. This is called without the GIL.
+  virtual std::pair<planner::DiscretePath, double> plan(
+      const planner::Snapshot& snapshot, const bool reset) = 0;
+
+}; // End class Planner.
+
+/**
+ * \brief Binding of the lattice planners which plan paths only, i.e.
+ *        the IDM and SLC lattice planners. The acceleration is planned
+ *        by the intelligent driver model along the path.
+ */
+template<typename LatticePlanner>
+class PathLatticePlanner : public Planner {
+
+protected:
+
+  double sim_time_step_;
+  double spatial_horizon_;
+  boost::shared_ptr<LatticePlanner> planner_ = nullptr;
+
+public:
+
+  PathLatticePlanner(const boost::shared_ptr<World>& world,
+                     const double sim_time_step = 0.1,
+                     const double spatial_horizon = 150.0) :
+    Planner(world),
+    sim_time_step_(sim_time_step),
+    spatial_horizon_(spatial_horizon) {}
+
+protected:
+
+  virtual std::pair<planner::DiscretePath, double> plan(
+      const planner::Snapshot& snapshot, const bool reset) override {
+    if (reset || !planner_) {
+      planner_ = boost::make_shared<LatticePlanner>(
+          sim_time_step_, spatial_horizon_,
+          world_->router(), world_->map(), world_->fastMap());
+    }
+
+    const planner::DiscretePath path = planner_->planPath(snapshot.ego().id(), snapshot);
+    planner::VehicleSpeedPlanner speed_planner;
+    const double acceleration = speed_planner.planSpeed(snapshot.ego().id(), snapshot);
+    return std::make_pair(path, acceleration);
+  }
+
+}; // End class PathLatticePlanner.
+
+using IDMLatticePlanner = PathLatticePlanner<planner::IDMLatticePlanner>;
+using SLCLatticePlanner = PathLatticePlanner<planner::SLCLatticePlanner>;
+
+/**
+ * \brief Binding of the spatiotemporal lattice planner, which plans the
+ *        path together with the acceleration.
+ */
+class SpatiotemporalLatticePlanner : public Planner {
+
+protected:
+
+  double sim_time_step_;
+  double spatial_horizon_;
+  boost::shared_ptr<planner::SpatiotemporalLatticePlanner> planner_ = nullptr;
+
+public:
+
+  SpatiotemporalLatticePlanner(const boost::shared_ptr<World>& world,
+                               const double sim_time_step = 0.1,
+                               const double spatial_horizon = 150.0) :
+    Planner(world),
+    sim_time_step_(sim_time_step),
+    spatial_horizon_(spatial_horizon) {}
+
+  /**
+   * \brief Plan the trajectory of the ego in a snapshot.
+   * \return A list of (path samples, acceleration) tuples, one for each
+   *         piece of the trajectory.
+   */
+  boost::python::list planTraj(const Snapshot& snapshot, const bool reset = true);
+
+protected:
+
+  virtual std::pair<planner::DiscretePath, double> plan(
+      const planner::Snapshot& snapshot, const bool reset) override;
+
+  void resetPlanner(const bool reset);
+
+}; // End class SpatiotemporalLatticePlanner.
+
+/**
+ * \brief Binding of the lane follower, with the acceleration planned by
+ *        the intelligent driver model. The planner is stateless.
+ */
+class LaneFollower : public Planner {
+
+protected:
+
+  double lattice_range_;
+
+public:
+
+  LaneFollower(const boost::shared_ptr<World>& world,
+               const double lattice_range = 55.0) :
+    Planner(world), lattice_range_(lattice_range) {}
+
+protected:
+
+  virtual std::pair<planner::DiscretePath, double> plan(
+      const planner::Snapshot& snapshot, const bool reset) override;
+
+}; // End class LaneFollower.
+
+} // End namespace bindings.
@@ -0,0 +1,84 @@
+#!/usr/bin/env python
+
+"""
+Smoke test of the lattice_planners module.
+
+The Town04 map is loaded from its OpenDRIVE file, given by the TOWN04_OPENDRIVE
+environment variable, or found in $Carla_DIST. The test is skipped if neither
+the module nor the map is available.
+"""
+
+from __future__ import division
+from __future__ import print_function
+
+import os
+import unittest
+
+import numpy as np
+
+try:
+    import lattice_planners as lp
+except ImportError:
+    lp = None
+
+def town04_opendrive():
+    """ Path of the Town04 OpenDRIVE file, None if not found. """
+    path = os.environ.get('TOWN04_OPENDRIVE')
+    if path: return path
+    path = os.path.join(os.environ.get('Carla_DIST', ''),
+            'CarlaUE4', 'Content', 'Carla', 'Maps', 'OpenDrive', 'Town04.xodr')
+    return path if os.path.isfile(path) else None
+
+@unittest.skipIf(lp is None, 'lattice_planners module is not built.')
+@unittest.skipIf(town04_opendrive() is None, 'Town04 OpenDRIVE file is not found.')
+class TestLatticePlanners(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        cls.world = lp.World(town04_opendrive())
+
+    def ego_snapshot(self):
+        """ A snapshot with the ego on the route and no agents. """
+        waypoints = self.world.route_waypoints(5.0)
+        self.assertGreater(waypoints.shape[0], 0)
+        x, y, z, yaw = waypoints[0, :4]
+
+        columns = lp.VEHICLE_COLUMNS
+        ego = np.zeros(len(columns))
+        for name, value in [('id', 1), ('x', x), ('y', y), ('z', z+0.5), ('yaw', yaw),
+                            ('speed', 20.0), ('policy_speed', 25.0),
+                            ('extent_x', 2.5), ('extent_y', 1.0), ('extent_z', 0.8)]:
+            ego[columns.index(name)] = value
+        agents = np.full((1, len(columns)), np.nan)
+        return lp.Snapshot(self.world, ego, agents)
+
+    def check_result(self, result):
+        self.assertGreater(result['path'].shape[0], 1)
+        self.assertEqual(result['path'].shape[1], len(lp.PATH_COLUMNS))
+        self.assertTrue(np.all(np.isfinite(result['path'])))
+        self.assertIn(result['lane_change'],
+                ['keep_lane', 'left_lane_change', 'right_lane_change', 'none'])
+        self.assertTrue(np.isfinite(result['acceleration']))
+
+    def test_snapshot(self):
+        snapshot = self.ego_snapshot()
+        self.assertEqual(snapshot.ego_id, 1)
+        self.assertEqual(len(snapshot.agent_ids()), 0)
+        self.assertIsNone(snapshot.front(1))
+
+    def test_plan(self):
+        snapshot = self.ego_snapshot()
+        for planner in [lp.LaneFollower(self.world),
+                        lp.IDMLatticePlanner(self.world),
+                        lp.SLCLatticePlanner(self.world),
+                        lp.SpatiotemporalLatticePlanner(self.world)]:
+            self.check_result(planner.plan_path(snapshot))
+
+    def test_invalid_inputs(self):
+        with self.assertRaises(RuntimeError):
+            self.world.route_waypoints(0.0)
+        with self.assertRaises(RuntimeError):
+            lp.World(os.path.join(os.path.dirname(town04_opendrive()), 'missing.xodr'))
+
+if __name__ == '__main__':
+    unittest.main()
@@ -25,6 +25,10 @@ namespace router {
  *
  * The Router class should contain the road sequence and a vehicle is supposed
  * to follow. This helps the vehicle to define the forward direction.
+ *
+ * A router is shared by all planners and snapshots. Derived classes must
+ * keep the router immutable after construction, so that all the const
+ * member functions can be called concurrently from multiple threads.
  */
 class Router {
 
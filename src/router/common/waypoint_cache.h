@@ -0,0 +1,322 @@
+/*
+ * Copyright 2020 Ke Sun
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#pragma once
+
+#include <cmath>
+#include <list>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <stdexcept>
+#include <unordered_map>
+#include <boost/format.hpp>
+#include <boost/smart_ptr.hpp>
+#include <boost/functional/hash.hpp>
+#include <carla/client/Waypoint.h>
+
+namespace router {
+
+/**
+ * \brief WaypointCache memoizes the navigation queries of carla waypoints.
+ *
+ * \c carla::client::Waypoint::GetNext(), \c GetPrevious(), \c GetLeft(),
+ * and \c GetRight() recompute the result from the OpenDRIVE map every time
+ * they are called. Within a planning cycle, and across cycles, planners and
+ * agents keep asking the same questions, e.g. the front waypoint 1m ahead of
+ * a lattice node. The cache keeps the answers keyed by the waypoint ID, the
+ * query type, and the query distance (quantized to 1mm).
+ *
+ * \c GetTransform() is not cached, since carla already computes the transform
+ * once when a waypoint is constructed.
+ *
+ * The cache is split into shards by the hash of the query, each with its
+ * own lock, LRU list, and share of the capacity. A hit only locks the shard
+ * of the query to refresh its LRU order, so that threads asking different
+ * questions rarely contend. Once a shard is full, its least recently used
+ * query is evicted, i.e. the LRU order is kept per shard instead of over
+ * the whole cache. The number of cached queries never exceeds the capacity.
+ *
+ * The cache is process-wide, see \c instance(). Waypoint IDs are only unique
+ * within a map, so \c clear() should be called if a different map is loaded.
+ * All member functions are thread-safe. The lock is not held while querying
+ * carla, so concurrent misses of the same query may both reach carla.
+ */
+class WaypointCache {
+
+public:
+
+  using CarlaWaypoint = carla::client::Waypoint;
+  using Waypoints     = std::vector<boost::shared_ptr<CarlaWaypoint>>;
+
+  /// Statistics of the cache.
+  struct Stats {
+    size_t hits      = 0;
+    size_t misses    = 0;
+    size_t evictions = 0;
+    size_t size      = 0;
+
+    double hitRate() const {
+      const size_t queries = hits + misses;
+      return queries == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(queries);
+    }
+
+    std::string string(const std::string& prefix = "") const {
+      boost::format format(
+          "hits:%1% misses:%2% hit rate:%3% evictions:%4% size:%5%\n");
+      format % hits % misses % hitRate() % evictions % size;
+      return prefix + format.str();
+    }
+  }; // End struct Stats.
+
+protected:
+
+  enum class Query : uint8_t { Next, Previous, Left, Right };
+
+  struct Key {
+    uint64_t waypoint;
+    int64_t  distance;
+    Query    query;
+
+    bool operator==(const Key& other) const {
+      return waypoint == other.waypoint &&
+             distance == other.distance &&
+             query    == other.query;
+    }
+  }; // End struct Key.
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      size_t seed = 0;
+      boost::hash_combine(seed, key.waypoint);
+      boost::hash_combine(seed, key.distance);
+      boost::hash_combine(seed, static_cast<uint8_t>(key.query));
+      return seed;
+    }
+  }; // End struct KeyHash.
+
+  /// Cached queries, the most recently used at the front.
+  using Entries = std::list<std::pair<Key, Waypoints>>;
+
+  /// A part of the cache guarded by its own lock.
+  struct Shard {
+    /// Maximum number of cached queries in this shard.
+    size_t capacity = 0;
+
+    Entries entries;
+    std::unordered_map<Key, Entries::iterator, KeyHash> table;
+
+    /// Statistics of the shard, \c size is not used.
+    Stats stats;
+
+    mutable std::mutex mutex;
+  }; // End struct Shard.
+
+protected:
+
+  /// Maximum number of cached queries.
+  std::atomic<size_t> capacity_;
+
+  std::vector<Shard> shards_;
+
+public:
+
+  /// The process-wide cache used by the planners and routers.
+  static WaypointCache& instance() {
+    static WaypointCache cache;
+    return cache;
+  }
+
+  /**
+   * \brief Constructor of the class.
+   * \param[in] capacity The maximum number of cached queries.
+   * \param[in] shards The number of shards the cache is split into.
+   */
+  explicit WaypointCache(const size_t capacity = 65536, const size_t shards = 16) :
+    capacity_(capacity), shards_(shards) {
+    if (capacity == 0) throw std::runtime_error(
+        "WaypointCache::WaypointCache(): capacity must be positive.\n");
+    if (shards == 0) throw std::runtime_error(
+        "WaypointCache::WaypointCache(): the number of shards must be positive.\n");
+
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      shards_[i].capacity = shardCapacity(i);
+      shards_[i].table.reserve(shards_[i].capacity);
+    }
+    return;
+  }
+
+  WaypointCache(const WaypointCache&) = delete;
+  WaypointCache& operator=(const WaypointCache&) = delete;
+
+  /// Cached \c carla::client::Waypoint::GetNext().
+  Waypoints next(const boost::shared_ptr<const CarlaWaypoint>& waypoint,
+                 const double distance) {
+    return query(waypoint, Query::Next, distance);
+  }
+
+  /// Cached \c carla::client::Waypoint::GetPrevious().
+  Waypoints previous(const boost::shared_ptr<const CarlaWaypoint>& waypoint,
+                     const double distance) {
+    return query(waypoint, Query::Previous, distance);
+  }
+
+  /// Cached \c carla::client::Waypoint::GetLeft().
+  boost::shared_ptr<CarlaWaypoint> left(
+      const boost::shared_ptr<const CarlaWaypoint>& waypoint) {
+    const Waypoints waypoints = query(waypoint, Query::Left, 0.0);
+    return waypoints.empty() ? nullptr : waypoints.front();
+  }
+
+  /// Cached \c carla::client::Waypoint::GetRight().
+  boost::shared_ptr<CarlaWaypoint> right(
+      const boost::shared_ptr<const CarlaWaypoint>& waypoint) {
+    const Waypoints waypoints = query(waypoint, Query::Right, 0.0);
+    return waypoints.empty() ? nullptr : waypoints.front();
+  }
+
+  /**
+   * \brief Get the statistics of the cache.
+   *
+   * The shards are visited one at a time, so the statistics may not
+   * be a consistent snapshot while other threads are querying.
+   */
+  Stats stats() const {
+    Stats stats;
+    for (const Shard& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      stats.hits      += shard.stats.hits;
+      stats.misses    += shard.stats.misses;
+      stats.evictions += shard.stats.evictions;
+      stats.size      += shard.entries.size();
+    }
+    return stats;
+  }
+
+  /// Reset the hit, miss, and eviction counts.
+  void resetStats() {
+    for (Shard& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.stats = Stats();
+    }
+    return;
+  }
+
+  /// Get the capacity of the cache.
+  size_t capacity() const { return capacity_; }
+
+  /// Get the number of shards.
+  size_t shards() const { return shards_.size(); }
+
+  /// Set the capacity of the cache, evicting queries if necessary.
+  void setCapacity(const size_t capacity) {
+    if (capacity == 0) throw std::runtime_error(
+        "WaypointCache::setCapacity(): capacity must be positive.\n");
+    capacity_ = capacity;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      std::lock_guard<std::mutex> lock(shards_[i].mutex);
+      shards_[i].capacity = shardCapacity(i);
+      evict(shards_[i]);
+    }
+    return;
+  }
+
+  /// Remove all cached queries.
+  void clear() {
+    for (Shard& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.entries.clear();
+      shard.table.clear();
+    }
+    return;
+  }
+
+protected:
+
+  Waypoints query(const boost::shared_ptr<const CarlaWaypoint>& waypoint,
+                  const Query query,
+                  const double distance) {
+
+    const Key key{waypoint->GetId(),
+                  static_cast<int64_t>(std::llround(distance*1000.0)),
+                  query};
+
+    Shard& shard = shards_[KeyHash()(key) % shards_.size()];
+
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto iter = shard.table.find(key);
+      if (iter != shard.table.end()) {
+        ++shard.stats.hits;
+        shard.entries.splice(shard.entries.begin(), shard.entries, iter->second);
+        return iter->second->second;
+      }
+      ++shard.stats.misses;
+    }
+
+    Waypoints waypoints;
+    switch (query) {
+      case Query::Next:
+        waypoints = waypoint->GetNext(distance);
+        break;
+      case Query::Previous:
+        waypoints = waypoint->GetPrevious(distance);
+        break;
+      case Query::Left:
+        if (boost::shared_ptr<CarlaWaypoint> left = waypoint->GetLeft())
+          waypoints.push_back(left);
+        break;
+      case Query::Right:
+        if (boost::shared_ptr<CarlaWaypoint> right = waypoint->GetRight())
+          waypoints.push_back(right);
+        break;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      // Another thread may have inserted the same query meanwhile.
+      if (shard.table.count(key) == 0) {
+        shard.entries.emplace_front(key, waypoints);
+        shard.table[key] = shard.entries.begin();
+        evict(shard);
+      }
+    }
+
+    return waypoints;
+  }
+
+  /// The share of the capacity of the i-th shard. The shares add up to the capacity.
+  size_t shardCapacity(const size_t i) const {
+    const size_t capacity = capacity_;
+    return capacity/shards_.size() + (i < capacity%shards_.size() ? 1 : 0);
+  }
+
+  /// Evict the least recently used queries of a shard until its capacity is met.
+  /// The mutex of the shard must be held by the caller.
+  void evict(Shard& shard) {
+    while (shard.entries.size() > shard.capacity) {
+      shard.table.erase(shard.entries.back().first);
+      shard.entries.pop_back();
+      ++shard.stats.evictions;
+    }
+    return;
+  }
+
+}; // End class WaypointCache.
+
+} // End namespace router.
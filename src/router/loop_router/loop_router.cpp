@@ -18,6 +18,7 @@
 #include <stdexcept>
 #include <carla/road/Road.h>
 #include <carla/road/Lane.h>
+#include <router/common/waypoint_cache.h>
 #include <router/loop_router/loop_router.h>
 
 namespace router {
@@ -30,7 +31,8 @@ LoopRouter::LoopRouter() :
 boost::shared_ptr<LoopRouter::CarlaWaypoint> LoopRouter::waypointOnRoute(
     const boost::shared_ptr<const CarlaWaypoint>& waypoint) const {
 
-  std::vector<boost::shared_ptr<CarlaWaypoint>> candidates = waypoint->GetNext(0.01);
+  std::vector<boost::shared_ptr<CarlaWaypoint>> candidates =
+    WaypointCache::instance().next(waypoint, 0.01);
   for (const auto& candidate : candidates) {
     std::vector<size_t>::const_iterator iter = std::find(
         road_sequence_.begin(), road_sequence_.end(), candidate->GetRoadId());
@@ -96,7 +98,8 @@ boost::shared_ptr<LoopRouter::CarlaWaypoint> LoopRouter::frontWaypoint(
     throw std::runtime_error(error_msg + waypoint_msg + distance_msg);
   }
 
-  std::vector<boost::shared_ptr<CarlaWaypoint>> candidates = waypoint->GetNext(distance);
+  std::vector<boost::shared_ptr<CarlaWaypoint>> candidates =
+    WaypointCache::instance().next(waypoint, distance);
   const size_t this_road = waypoint->GetRoadId();
 
   boost::optional<size_t> is_next_road = nextRoad(this_road);
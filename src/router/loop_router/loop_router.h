@@ -23,6 +23,9 @@ namespace router {
  * \brief LoopRouter implements a predefined loop router which never ends.
  *
  * For now, the predefined route is the highway loop in the carla map Town04.
+ *
+ * The road sequence is fixed in the constructor. All queries are const and
+ * can be called concurrently.
  */
 class LoopRouter : public Router {
 